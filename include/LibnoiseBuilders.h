@@ -0,0 +1,369 @@
+// LibnoiseBuilders.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_BUILDERS_H
+#define NOISE_BUILDERS_H
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default error tolerance of an adaptive noise-map builder.
+        const NOISE_REAL DEFAULT_ADAPTIVE_TOLERANCE = 0.01;
+
+        /// Default size of the coarse cells evaluated first by an adaptive
+        /// noise-map builder, in points.
+        const int DEFAULT_ADAPTIVE_CELL_SIZE = 8;
+
+        /// Builds a noise map by evaluating a coarse lattice and refining it
+        /// only where it is needed.
+        ///
+        /// Large parts of a typical noise map (oceans, plains) are smooth enough
+        /// that bilinear interpolation between a few samples is
+        /// indistinguishable from the real output values.  This builder
+        /// exploits that to evaluate far fewer points than
+        /// noise::utils::NoiseMapBuilder.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// The builder first evaluates the source module on a coarse lattice
+        /// whose cells are SetInitialCellSize() points wide.  For each cell, it
+        /// evaluates the center and the midpoints of the four edges, and
+        /// compares them with the values predicted by bilinear interpolation
+        /// between the corners.  If every prediction is within the tolerance,
+        /// the cell is filled by bilinear interpolation; otherwise, it is split
+        /// into four cells that are tested in the same way, down to single
+        /// points, which are always evaluated.
+        ///
+        /// The cells are refined in parallel, using the thread count of the
+        /// build configuration.
+        ///
+        /// <b>Accuracy</b>
+        ///
+        /// The error is estimated from samples, so it is not a strict bound:
+        /// a feature smaller than a coarse cell that falls between the test
+        /// points is missed.  Choose an initial cell size smaller than the
+        /// smallest feature of interest (roughly the wavelength of the highest
+        /// octave, in points).
+        ///
+        /// After a build, GetEvaluatedSampleCount() returns the number of
+        /// output values that were actually computed by the source module.
+        class AdaptiveNoiseMapBuilder: public NoiseMapBuilder
+        {
+
+            public:
+
+                /// Constructor.
+                AdaptiveNoiseMapBuilder();
+
+                /// Builds the noise map.
+                ///
+                /// @pre SetBounds() was previously called.
+                /// @pre SetDestNoiseMap() was previously called.
+                /// @pre SetSourceModule() was previously called.
+                /// @pre The width and height values specified by SetDestSize() are
+                /// positive.
+                ///
+                /// @post The original contents of the destination noise map is
+                /// destroyed.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Build();
+
+                /// Returns the number of output values computed by the source
+                /// module during the last build.
+                ///
+                /// @returns The number of evaluated samples.
+                ///
+                /// With seamless tiling enabled, each sample evaluates the source
+                /// module four times; this count is still one per sample.
+                size_t GetEvaluatedSampleCount() const
+                {
+                    return m_evaluatedSampleCount;
+                }
+
+                /// Returns the size of the coarse cells evaluated first.
+                ///
+                /// @returns The initial cell size, in points.
+                int GetInitialCellSize() const
+                {
+                    return m_initialCellSize;
+                }
+
+                /// Returns the largest accepted difference between an output value
+                /// and its interpolated value.
+                ///
+                /// @returns The error tolerance.
+                NOISE_REAL GetTolerance() const
+                {
+                    return m_tolerance;
+                }
+
+                /// Sets the size of the coarse cells evaluated first.
+                ///
+                /// @param cellSize The initial cell size, in points.
+                ///
+                /// @pre The cell size is at least 1.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// A cell size of 1 evaluates every point.
+                void SetInitialCellSize(int cellSize)
+                {
+                    if (cellSize < 1)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_initialCellSize = cellSize;
+                }
+
+                /// Sets the largest accepted difference between an output value
+                /// and its interpolated value.
+                ///
+                /// @param tolerance The error tolerance.
+                ///
+                /// @pre The tolerance is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// A tolerance of zero still interpolates cells whose test points
+                /// are predicted exactly, such as the cells of a constant region.
+                void SetTolerance(NOISE_REAL tolerance)
+                {
+                    if (tolerance < 0.0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_tolerance = tolerance;
+                }
+
+            private:
+
+                /// Fills a cell of the destination noise map, splitting it if
+                /// interpolation is not accurate enough.
+                ///
+                /// @param x0 The x coordinate of the left edge of the cell.
+                /// @param z0 The z coordinate of the bottom edge of the cell.
+                /// @param x1 The x coordinate of the right edge of the cell.
+                /// @param z1 The z coordinate of the top edge of the cell.
+                /// @param v00 The output value at ( @a x0, @a z0 ).
+                /// @param v10 The output value at ( @a x1, @a z0 ).
+                /// @param v01 The output value at ( @a x0, @a z1 ).
+                /// @param v11 The output value at ( @a x1, @a z1 ).
+                ///
+                /// @returns The number of samples evaluated.
+                ///
+                /// The cell writes the points ( @a x, @a z ) with
+                /// @a x0 <= @a x < @a x1 and @a z0 <= @a z < @a z1, plus the right
+                /// and top edges when they are the edges of the noise map, so
+                /// neighbouring cells never write the same point.
+                size_t RefineCell(int x0, int z0, int x1, int z1, NOISE_REAL v00,
+                    NOISE_REAL v10, NOISE_REAL v01, NOISE_REAL v11) const;
+
+                /// Writes the bilinear interpolation of a cell's corners into the
+                /// points owned by the cell.
+                void FillCell(int x0, int z0, int x1, int z1, NOISE_REAL v00,
+                    NOISE_REAL v10, NOISE_REAL v01, NOISE_REAL v11) const;
+
+                /// The number of samples evaluated during the last build.
+                size_t m_evaluatedSampleCount;
+
+                /// The size of the coarse cells, in points.
+                int m_initialCellSize;
+
+                /// The error tolerance.
+                NOISE_REAL m_tolerance;
+
+        };
+
+        /// Default difference between neighbouring points above which a
+        /// supersampling noise-map builder supersamples a point.
+        const NOISE_REAL DEFAULT_SUPERSAMPLING_THRESHOLD = 0.1;
+
+        /// Default maximum number of samples per point of a supersampling
+        /// noise-map builder.
+        const int DEFAULT_SUPERSAMPLING_MAX_SAMPLES = 16;
+
+        /// Builds an anti-aliased noise map by supersampling only the points
+        /// that need it.
+        ///
+        /// High-frequency noise (such as the higher octaves of
+        /// noise::module::RidgedMulti or the cell edges of
+        /// noise::module::Voronoi) aliases when the noise map has a low
+        /// resolution.  Uniform supersampling fixes that at a cost proportional
+        /// to the number of samples for every point, while most points of a
+        /// typical noise map are smooth and do not need it.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// The builder first takes one sample per point, exactly as
+        /// noise::utils::NoiseMapBuilder::Build() does, on the same parallel
+        /// tile engine and with the same build configuration.  It then
+        /// estimates the local variation at each point as the largest
+        /// difference between the point and its four neighbours.  Points whose
+        /// variation is below the threshold keep their single sample.  The
+        /// other points are resampled with an @a n x @a n stratified pattern
+        /// covering the footprint of the point (the square of one point
+        /// spacing centered on it), with one jittered sample per stratum, and
+        /// take the average of these samples.  @a n grows with the variation
+        /// and is capped by SetMaxSampleCount().
+        ///
+        /// The jitter is derived from the point coordinates, so the noise map
+        /// is identical from one build to the next.
+        ///
+        /// The second pass reads the first-pass values from a temporary noise
+        /// map, so a build temporarily needs twice the memory of the
+        /// destination noise map.
+        class SupersamplingNoiseMapBuilder: public NoiseMapBuilder
+        {
+
+            public:
+
+                /// Constructor.
+                SupersamplingNoiseMapBuilder();
+
+                /// Builds the noise map.
+                ///
+                /// @pre SetBounds() was previously called.
+                /// @pre SetDestNoiseMap() was previously called.
+                /// @pre SetSourceModule() was previously called.
+                /// @pre The width and height values specified by SetDestSize() are
+                /// positive.
+                ///
+                /// @post The original contents of the destination noise map is
+                /// destroyed.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Build();
+
+                /// Returns the number of output values computed by the source
+                /// module during the last build.
+                ///
+                /// @returns The number of evaluated samples, including the first
+                /// sample of every point.
+                size_t GetEvaluatedSampleCount() const
+                {
+                    return m_evaluatedSampleCount;
+                }
+
+                /// Returns the maximum number of samples per point.
+                ///
+                /// @returns The maximum sample count.
+                int GetMaxSampleCount() const
+                {
+                    return m_maxSampleCount;
+                }
+
+                /// Returns the number of points that were supersampled during the
+                /// last build.
+                ///
+                /// @returns The number of supersampled points.
+                size_t GetSupersampledPointCount() const
+                {
+                    return m_supersampledPointCount;
+                }
+
+                /// Returns the variation above which a point is supersampled.
+                ///
+                /// @returns The variation threshold.
+                NOISE_REAL GetThreshold() const
+                {
+                    return m_threshold;
+                }
+
+                /// Sets the maximum number of samples per point.
+                ///
+                /// @param maxSampleCount The maximum sample count.
+                ///
+                /// @pre The maximum sample count is at least 4.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The samples are laid out in a square pattern, so the number of
+                /// samples actually taken is the largest square number that does
+                /// not exceed this value.
+                void SetMaxSampleCount(int maxSampleCount)
+                {
+                    if (maxSampleCount < 4)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_maxSampleCount = maxSampleCount;
+                }
+
+                /// Sets the variation above which a point is supersampled.
+                ///
+                /// @param threshold The variation threshold.
+                ///
+                /// @pre The threshold is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// A point whose variation is @a k times the threshold is sampled
+                /// with a ( @a k + 1 ) x ( @a k + 1 ) pattern, up to the maximum
+                /// sample count.
+                void SetThreshold(NOISE_REAL threshold)
+                {
+                    if (threshold <= 0.0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threshold = threshold;
+                }
+
+            private:
+
+                /// Resamples a tile of points whose variation is above the
+                /// threshold.
+                ///
+                /// @param source The first-pass noise map.
+                /// @param x0 The x coordinate of the lower-left point of the tile.
+                /// @param z0 The z coordinate of the lower-left point of the tile.
+                /// @param width The width of the tile, in points.
+                /// @param height The height of the tile, in points.
+                /// @param pointCount Receives the number of supersampled points.
+                ///
+                /// @returns The number of samples evaluated.
+                size_t SupersampleTile(const NoiseMap& source, int x0, int z0,
+                    int width, int height, size_t& pointCount) const;
+
+                /// The number of samples evaluated during the last build.
+                size_t m_evaluatedSampleCount;
+
+                /// The maximum number of samples per point.
+                int m_maxSampleCount;
+
+                /// The number of points supersampled during the last build.
+                size_t m_supersampledPointCount;
+
+                /// The variation threshold.
+                NOISE_REAL m_threshold;
+
+        };
+
+    }
+
+}
+
+#endif
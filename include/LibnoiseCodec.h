@@ -0,0 +1,388 @@
+// LibnoiseCodec.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_CODEC_H
+#define NOISE_CODEC_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default width and height of the tiles of a compressed height map.
+        const int DEFAULT_CODEC_TILE_SIZE = 64;
+
+        /// Number of values that share a bit width in a compressed tile.
+        const int CODEC_BLOCK_SIZE = 32;
+
+        /// Compresses height maps with a bounded absolute error.
+        ///
+        /// Every value of the decoded height map differs from the original
+        /// value by at most the maximum error set by SetMaxError().  The bound
+        /// is checked for every point when encoding; values that cannot be
+        /// quantized within it (infinities, NaNs, or values so large that the
+        /// bound is below the precision of a float) make their tile stored
+        /// uncompressed, so the bound always holds.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// Every value is quantized to the nearest multiple of twice the
+        /// maximum error.  The quantized values of each tile are predicted
+        /// from their left, upper and upper-left neighbours (the Lorenzo
+        /// predictor, which is exact on planes), and the prediction residuals
+        /// are packed in blocks of CODEC_BLOCK_SIZE values, each block with the
+        /// bit width of its largest residual.  On smooth terrain most residuals
+        /// are a few quantization steps, so a block takes a few bits per value
+        /// instead of 32.
+        ///
+        /// Each tile is coded on its own, and the stream starts with the
+        /// offsets of the tiles, so noise::utils::HeightMapDecoder decodes any
+        /// tile without touching the others.  Decoding is a fixed-width
+        /// unpack, a running sum along the rows, an addition of the previous
+        /// row and a scaling, which have no data-dependent branches and are
+        /// vectorized by the compiler.
+        ///
+        /// The tiles are encoded in parallel on the thread count set by
+        /// SetThreadCount(); the stream does not depend on it.  The stream is
+        /// little-endian on every host.
+        class HeightMapEncoder
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The default maximum error is 0.001.  The default tile size
+                /// is DEFAULT_CODEC_TILE_SIZE.
+                HeightMapEncoder();
+
+                /// Compresses a height map.
+                ///
+                /// @param heightMap The height map.
+                /// @param stream The vector that receives the compressed height
+                /// map; its previous contents are discarded.
+                ///
+                /// @pre The height map is not empty.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Encode(const NoiseMap& heightMap,
+                    std::vector<uint8>& stream) const;
+
+                /// Returns the maximum absolute error of the decoded values.
+                double GetMaxError() const
+                {
+                    return m_maxError;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the width and height of the tiles, in points.
+                int GetTileSize() const
+                {
+                    return m_tileSize;
+                }
+
+                /// Sets the maximum absolute error of the decoded values.
+                ///
+                /// @param maxError The maximum error.
+                ///
+                /// @pre The maximum error is positive and finite.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetMaxError(double maxError);
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+                /// Sets the width and height of the tiles.
+                ///
+                /// @param tileSize The tile size, in points.
+                ///
+                /// @pre The tile size ranges from 8 to 1024.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Smaller tiles decode with a finer granularity; larger tiles
+                /// spend fewer bits on their borders, which are predicted from
+                /// one neighbour only.
+                void SetTileSize(int tileSize);
+
+            private:
+
+                /// The maximum absolute error.
+                double m_maxError;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The width and height of the tiles.
+                int m_tileSize;
+
+        };
+
+        /// Decodes height maps compressed by noise::utils::HeightMapEncoder.
+        ///
+        /// The decoder reads the stream in place; the stream must outlive it.
+        /// Any tile can be decoded on its own, from any number of threads.
+        class HeightMapDecoder
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// @param pStream The compressed height map.
+                /// @param size The size of the compressed height map, in bytes.
+                ///
+                /// @pre The stream was written by HeightMapEncoder::Encode().
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The header and the tile offsets are checked; the tiles
+                /// themselves are trusted.
+                HeightMapDecoder(const uint8* pStream, size_t size);
+
+                /// Constructor for a stream whose tiles are read separately,
+                /// such as a stream stored in a file.
+                ///
+                /// @param pIndex The start of the stream: its header and its
+                /// tile offsets.
+                /// @param indexSize The size of the start of the stream, in
+                /// bytes.
+                /// @param streamSize The size of the whole stream, in bytes.
+                ///
+                /// @pre The stream was written by HeightMapEncoder::Encode().
+                /// @pre The start of the stream holds at least GetIndexSize()
+                /// bytes.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The tiles are decoded from copies of their bytes (see
+                /// GetTileRange()) by the DecodeTile() overload that takes
+                /// them; Decode() and the other overload throw
+                /// noise::ExceptionInvalidParam.
+                HeightMapDecoder(const uint8* pIndex, size_t indexSize,
+                    uint64 streamSize);
+
+                /// Decodes the whole height map.
+                ///
+                /// @param heightMap The noise map that receives the height map.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The tiles are decoded in parallel on the thread count set by
+                /// SetThreadCount().
+                void Decode(NoiseMap& heightMap) const;
+
+                /// Decodes a tile.
+                ///
+                /// @param tileX The column of the tile.
+                /// @param tileZ The row of the tile.
+                /// @param pDest The values of the tile, row by row.
+                /// @param destStride The distance, in values, between two rows of
+                /// @a pDest.
+                ///
+                /// @pre The tile exists (see GetTileCountX() and
+                /// GetTileCountZ()).
+                /// @pre The stride is at least the width of the tile.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The tiles on the right and bottom edges may be narrower and
+                /// shorter than GetTileSize(); see GetTileWidth() and
+                /// GetTileHeight().
+                void DecodeTile(int tileX, int tileZ, float* pDest,
+                    int destStride) const;
+
+                /// Decodes a tile from a copy of its bytes.
+                ///
+                /// @param tileX The column of the tile.
+                /// @param tileZ The row of the tile.
+                /// @param pTileData The bytes of the tile, as given by
+                /// GetTileRange(), followed by at least eight bytes of any
+                /// value.
+                /// @param pDest The values of the tile, row by row.
+                /// @param destStride The distance, in values, between two rows of
+                /// @a pDest.
+                ///
+                /// @pre The tile exists (see GetTileCountX() and
+                /// GetTileCountZ()).
+                /// @pre The stride is at least the width of the tile.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void DecodeTile(int tileX, int tileZ, const uint8* pTileData,
+                    float* pDest, int destStride) const;
+
+                /// Returns the height of the height map, in points.
+                int GetHeight() const
+                {
+                    return m_height;
+                }
+
+                /// Returns the maximum absolute error of the decoded values.
+                double GetMaxError() const
+                {
+                    return m_maxError;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the number of tile columns.
+                int GetTileCountX() const
+                {
+                    return (m_width + m_tileSize - 1) / m_tileSize;
+                }
+
+                /// Returns the number of tile rows.
+                int GetTileCountZ() const
+                {
+                    return (m_height + m_tileSize - 1) / m_tileSize;
+                }
+
+                /// Returns the size of the header and the tile offsets of a
+                /// stream.
+                ///
+                /// @param pStream The start of the stream.
+                /// @param size The size of the start of the stream, in bytes.
+                ///
+                /// @returns The size of the header and the tile offsets, in
+                /// bytes, or zero if the start of the stream is too short to
+                /// hold the header.
+                ///
+                /// @throw noise::ExceptionInvalidParam The header is invalid.
+                static size_t GetIndexSize(const uint8* pStream, size_t size);
+
+                /// Returns the height of a row of tiles, in points.
+                ///
+                /// @param tileZ The row of tiles.
+                int GetTileHeight(int tileZ) const
+                {
+                    return GetMin(m_tileSize, m_height - tileZ * m_tileSize);
+                }
+
+                /// Returns the width and height of the tiles, in points.
+                int GetTileSize() const
+                {
+                    return m_tileSize;
+                }
+
+                /// Returns where the bytes of a tile are in the stream.
+                ///
+                /// @param tileX The column of the tile.
+                /// @param tileZ The row of the tile.
+                /// @param offset Receives the offset of the first byte of the
+                /// tile.
+                /// @param size Receives the number of bytes of the tile.
+                ///
+                /// @pre The tile exists (see GetTileCountX() and
+                /// GetTileCountZ()).
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void GetTileRange(int tileX, int tileZ, uint64& offset,
+                    uint64& size) const;
+
+                /// Returns the width of a column of tiles, in points.
+                ///
+                /// @param tileX The column of tiles.
+                int GetTileWidth(int tileX) const
+                {
+                    return GetMin(m_tileSize, m_width - tileX * m_tileSize);
+                }
+
+                /// Returns the width of the height map, in points.
+                int GetWidth() const
+                {
+                    return m_width;
+                }
+
+                /// Sets the number of workers used by Decode().
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+            private:
+
+                /// Reads the header and checks the tile offsets.
+                void ReadIndex(uint64 streamSize);
+
+                /// Determines if the stream holds the tiles, or only the
+                /// header and the tile offsets.
+                bool m_hasTiles;
+
+                /// The height of the height map.
+                int m_height;
+
+                /// The maximum absolute error.
+                double m_maxError;
+
+                /// The quantization step.
+                double m_step;
+
+                /// The compressed height map, or its header and its tile offsets.
+                const uint8* m_pStream;
+
+                /// The size of the compressed height map.
+                uint64 m_size;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The width and height of the tiles.
+                int m_tileSize;
+
+                /// The width of the height map.
+                int m_width;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,162 @@
+// LibnoiseCodegen.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_CODEGEN_H
+#define NOISE_CODEGEN_H
+
+#include <string>
+
+#include <noise.h>
+
+#include "LibnoiseGraph.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Version of the text format written by SaveModuleGraph().
+        const int MODULE_GRAPH_FORMAT_VERSION = 1;
+
+        /// Writes a graph of noise modules as text.
+        ///
+        /// @param root The noise module whose output value the graph computes.
+        /// @param text The string that receives the graph; its previous
+        /// contents are discarded.
+        ///
+        /// @pre Every noise module of the graph is one of the noise modules
+        /// of the library.
+        /// @pre The graph has no cycles.
+        ///
+        /// @throw noise::ExceptionInvalidParam See the preconditions.
+        /// @throw noise::ExceptionNoModule A source module is missing.
+        ///
+        /// The first line is <tt>noisegraph</tt> followed by the format
+        /// version.  Each noise module then takes one line:
+        ///
+        /// <tt>node</tt> <i>id</i> <i>type</i> [<i>source id</i>...]
+        /// [<i>parameter</i>=<i>value</i>...]
+        ///
+        /// where the identifiers count from zero in the order of the lines,
+        /// and the source modules of a noise module come before it.  The last
+        /// line is <tt>root</tt> followed by the identifier of the root
+        /// module.  A noise module used by several noise modules is written
+        /// once.  Values are written with 17 significant digits, so they are
+        /// read back exactly.
+        ///
+        /// A noise::module::Instrument is not written; the noise modules that
+        /// use it are connected to its source module instead.
+        void SaveModuleGraph(const noise::module::Module& root,
+            std::string& text);
+
+        /// Reads a graph of noise modules written by SaveModuleGraph().
+        ///
+        /// @param text The graph.
+        /// @param graph The versioned graph that receives the noise modules.
+        ///
+        /// @returns The identifier, in @a graph, of the root module.
+        ///
+        /// @pre The text is a graph written by SaveModuleGraph().
+        ///
+        /// @throw noise::ExceptionInvalidParam See the preconditions.
+        ///
+        /// The noise modules are added to @a graph and connected; the caller
+        /// commits the graph.  If the text is invalid, the noise modules
+        /// already added stay in @a graph.
+        int LoadModuleGraph(const std::string& text, VersionedGraph& graph);
+
+        /// Generates C++ source code that evaluates a graph of noise modules.
+        ///
+        /// The generated source code defines two functions, named after
+        /// SetFunctionName():
+        ///
+        /// - <tt>NOISE_REAL Name (NOISE_REAL x, NOISE_REAL y)</tt> returns
+        ///   the output value of the root module at (@a x, @a y).
+        /// - <tt>void NameBatch (const NOISE_REAL* pX, const NOISE_REAL* pY,
+        ///   int count, NOISE_REAL* pOut)</tt> writes the output values at
+        ///   @a count points.
+        ///
+        /// Each noise module becomes an inline function of the generated
+        /// source code with its parameters as constants: the octave loops are
+        /// unrolled, with the seed and the persistence of every octave
+        /// precomputed, the rotation matrices and the spectral weights are
+        /// literals, and the control points are constant arrays.  There are
+        /// no virtual calls and no source-module pointers, so the compiler
+        /// inlines the whole graph into the two functions.
+        ///
+        /// The generated source code only needs the headers of the library
+        /// and its coherent-noise functions (noisegen.h); it does not need
+        /// the noise modules.  Every function performs the floating-point
+        /// operations of noise::module::Module::GetValue() in the same order,
+        /// so, compiled with the floating-point settings of the library, it
+        /// returns the same values, bit for bit.
+        ///
+        /// The generated functions evaluate the graph itself; they ignore
+        /// the active module variant.  noise::module::Cache modules are
+        /// evaluated as their source module.
+        class GraphCodeGenerator
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The default function name is <tt>GetGraphValue</tt>.
+                GraphCodeGenerator();
+
+                /// Generates the source code for a graph.
+                ///
+                /// @param graphText The graph, written by SaveModuleGraph().
+                /// @param source The string that receives the source code;
+                /// its previous contents are discarded.
+                ///
+                /// @pre The text is a graph written by SaveModuleGraph().
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void Generate(const std::string& graphText,
+                    std::string& source) const;
+
+                /// Returns the name of the generated scalar function.
+                const std::string& GetFunctionName() const
+                {
+                    return m_functionName;
+                }
+
+                /// Sets the name of the generated scalar function.
+                ///
+                /// @param functionName The name.  The batch function is
+                /// named after it, followed by <tt>Batch</tt>.
+                ///
+                /// @pre The name is a C++ identifier.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetFunctionName(const std::string& functionName);
+
+            private:
+
+                /// The name of the scalar function.
+                std::string m_functionName;
+
+        };
+
+    }
+
+}
+
+#endif
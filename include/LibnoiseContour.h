@@ -0,0 +1,219 @@
+// LibnoiseContour.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_CONTOUR_H
+#define NOISE_CONTOUR_H
+
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default size of the tiles of a contour extractor, in cells.
+        const int DEFAULT_CONTOUR_TILE_SIZE = 256;
+
+        /// The contour lines extracted by a noise::utils::ContourExtractor.
+        ///
+        /// The polylines are stored one after the other in flat arrays.
+        struct ContourSet
+        {
+            /// The vertices of all polylines: two @a float values ( @a x,
+            /// @a y ) per vertex, in points of the noise map.
+            std::vector<float> vertices;
+
+            /// The index, in vertices, of the first vertex of each polyline,
+            /// followed by the total number of vertices.  Polyline @a i runs
+            /// from polylineOffsets[@a i] to polylineOffsets[@a i + 1]
+            /// excluded.
+            std::vector<uint32> polylineOffsets;
+
+            /// The index of the iso-level of each polyline.
+            std::vector<int> polylineLevels;
+
+            /// For each polyline, 1 if it is closed, 0 if both of its ends lie
+            /// on the edge of the noise map.  The first vertex of a closed
+            /// polyline is not repeated at its end.
+            std::vector<uint8> polylineClosed;
+
+            /// Returns the number of polylines.
+            int GetPolylineCount() const
+            {
+                return (int)polylineLevels.size();
+            }
+        };
+
+        /// Extracts contour lines from a noise map with marching squares.
+        ///
+        /// A contour line at an iso-level separates the points at or above
+        /// the level from the points below it; with the sea level as the
+        /// iso-level of a height map, the contour lines are the coastlines.
+        /// The vertices are the crossings of the contour lines with the edges
+        /// between neighbouring points, found by linear interpolation; a cell
+        /// whose diagonal corners are above and below the level (a saddle) is
+        /// split according to the average of its corners.  A point exactly at
+        /// the level is the crossing of the edges it ends, and appears once
+        /// in a polyline; a contour line that shrinks to a single point is
+        /// dropped.
+        ///
+        /// The polylines are oriented so that the points above the level are
+        /// on their left, with the @a x axis to the right and the @a y axis up:
+        /// a coastline runs counter-clockwise around an island and clockwise
+        /// around a lake.  Polylines that reach the edge of the noise map are
+        /// open; all others are closed.
+        ///
+        /// <b>Parallelism</b>
+        ///
+        /// The cells are split into square tiles of SetTileSize() cells, which
+        /// are processed in parallel on the thread count set by
+        /// SetThreadCount().  The segments of a tile are chained into pieces of
+        /// polylines, and the pieces are stitched across the tile borders by
+        /// the edges they cross, which both tiles compute identically.  The
+        /// result does not depend on the tile size or on the thread count.
+        ///
+        /// <b>Simplification</b>
+        ///
+        /// With a positive tolerance (see SetTolerance()), each polyline is
+        /// simplified with the Douglas-Peucker algorithm: the vertices
+        /// removed lie within the tolerance of the simplified polyline.  The
+        /// ends of open polylines are kept.
+        class ContourExtractor
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The tile size is DEFAULT_CONTOUR_TILE_SIZE, and the tolerance
+                /// is zero.
+                ContourExtractor();
+
+                /// Extracts the contour lines of a noise map.
+                ///
+                /// @param sourceNoiseMap The noise map.
+                /// @param pLevels The iso-levels.
+                /// @param levelCount The number of iso-levels.
+                /// @param contours The contour set that receives the polylines;
+                /// its previous contents are discarded.
+                ///
+                /// @pre The noise map is at least two points wide and high.
+                /// @pre The level count is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The polylines are sorted by iso-level, then by the first
+                /// edge between points that they cross, in row order; a closed
+                /// polyline starts at the first of its edges.
+                void Extract(const NoiseMap& sourceNoiseMap,
+                    const NOISE_REAL* pLevels, int levelCount,
+                    ContourSet& contours) const;
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the size of the tiles, in cells.
+                int GetTileSize() const
+                {
+                    return m_tileSize;
+                }
+
+                /// Returns the largest distance, in points, between a removed
+                /// vertex and the simplified polyline.
+                NOISE_REAL GetTolerance() const
+                {
+                    return m_tolerance;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+                /// Sets the size of the tiles.
+                ///
+                /// @param tileSize The size of the tiles, in cells.
+                ///
+                /// @pre The tile size is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetTileSize(int tileSize)
+                {
+                    if (tileSize <= 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_tileSize = tileSize;
+                }
+
+                /// Sets the largest distance between a removed vertex and the
+                /// simplified polyline.
+                ///
+                /// @param tolerance The tolerance, in points, or zero to keep
+                /// every vertex.
+                ///
+                /// @pre The tolerance is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetTolerance(NOISE_REAL tolerance)
+                {
+                    if (tolerance < 0.0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_tolerance = tolerance;
+                }
+
+            private:
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The size of the tiles, in cells.
+                int m_tileSize;
+
+                /// The simplification tolerance.
+                NOISE_REAL m_tolerance;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,192 @@
+// LibnoiseDistance.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_DISTANCE_H
+#define NOISE_DISTANCE_H
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Number of columns processed together by the column pass of a
+        /// distance transform.
+        const int DISTANCE_COLUMN_STRIP_WIDTH = 16;
+
+        /// Computes exact Euclidean distance maps.
+        ///
+        /// The input is a noise map, whose <i>feature</i> points are the points
+        /// at or above the threshold (see SetThreshold()), or a mask, whose
+        /// feature points are the non-zero bytes.  The output noise map
+        /// receives, for every point, the Euclidean distance in points to the
+        /// nearest feature point; feature points get zero.  With a noise map
+        /// of elevations and the sea level as the threshold, this is the
+        /// distance to the coast for every point at sea; with a river mask, the
+        /// distance to the nearest river.
+        ///
+        /// <b>Signed distances</b>
+        ///
+        /// With SetSigned(), feature points get the negated distance to the
+        /// nearest non-feature point instead of zero, so the output is
+        /// positive at sea, negative on land, and its magnitude grows away from
+        /// the coast on both sides.
+        ///
+        /// If no point can be reached (no feature points, or no non-feature
+        /// points for the signed distances inside), the distance is infinite.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// The transform runs the separable algorithm of Felzenszwalb and
+        /// Huttenlocher: a row pass finds the distance to the nearest feature
+        /// point of the same row, then a column pass takes the lower envelope
+        /// of the parabolas centered on each point of the column.  Both passes
+        /// are linear in the number of points, and exact.  The rows, then
+        /// strips of DISTANCE_COLUMN_STRIP_WIDTH columns, are processed in
+        /// parallel on the thread count set by SetThreadCount().
+        class DistanceTransform
+        {
+
+            public:
+
+                /// Constructor.
+                DistanceTransform();
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the value at or above which a point of a noise map is a
+                /// feature point.
+                NOISE_REAL GetThreshold() const
+                {
+                    return m_threshold;
+                }
+
+                /// Determines if the feature points get signed distances.
+                ///
+                /// @returns
+                /// - @a true if feature points get the negated distance to the
+                ///   nearest non-feature point.
+                /// - @a false if feature points get zero.
+                bool IsSigned() const
+                {
+                    return m_isSigned;
+                }
+
+                /// Enables or disables signed distances.
+                ///
+                /// @param isSigned @a true to give feature points the negated
+                /// distance to the nearest non-feature point.
+                void SetSigned(bool isSigned)
+                {
+                    m_isSigned = isSigned;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+                /// Sets the value at or above which a point of a noise map is a
+                /// feature point.
+                ///
+                /// @param threshold The threshold.
+                void SetThreshold(NOISE_REAL threshold)
+                {
+                    m_threshold = threshold;
+                }
+
+                /// Computes the distance map of a noise map.
+                ///
+                /// @param sourceNoiseMap The noise map.  Points at or above the
+                /// threshold are feature points.
+                /// @param destNoiseMap The noise map that receives the distances.
+                /// It may be the source noise map.
+                ///
+                /// @pre The source noise map is not empty.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Transform(const NoiseMap& sourceNoiseMap,
+                    NoiseMap& destNoiseMap) const;
+
+                /// Computes the distance map of a mask.
+                ///
+                /// @param pMask The mask: @a width bytes per row, @a height rows.
+                /// Non-zero bytes are feature points.
+                /// @param width The width of the mask.
+                /// @param height The height of the mask.
+                /// @param destNoiseMap The noise map that receives the distances.
+                ///
+                /// @pre The width and height are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Transform(const uint8* pMask, int width, int height,
+                    NoiseMap& destNoiseMap) const;
+
+            private:
+
+                /// Runs both passes.
+                ///
+                /// @param width The width of the map.
+                /// @param height The height of the map.
+                /// @param fReadRow Fills @a width flags for a row: its first
+                /// parameter is the row index, its second parameter receives one
+                /// non-zero byte per feature point.  The row pass calls it before
+                /// it writes the row, so the source may be the destination.
+                /// @param destNoiseMap The noise map that receives the distances,
+                /// already sized.
+                void Run(int width, int height,
+                    const std::function<void(int, uint8*)>& fReadRow,
+                    NoiseMap& destNoiseMap) const;
+
+                /// Determines if the feature points get signed distances.
+                bool m_isSigned;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The feature threshold of noise maps.
+                NOISE_REAL m_threshold;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,365 @@
+// LibnoiseErosion.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_EROSION_H
+#define NOISE_EROSION_H
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default number of iterations of an erosion stage.
+        const int DEFAULT_EROSION_ITERATION_COUNT = 50;
+
+        /// Default height difference between neighbouring points above which
+        /// material slides down, for thermal erosion.
+        const float DEFAULT_THERMAL_TALUS = 0.01f;
+
+        /// Default fraction of the excess height difference moved per
+        /// iteration, for thermal erosion.
+        const float DEFAULT_THERMAL_RATE = 0.5f;
+
+        /// Default amount of water added to every point per iteration, for
+        /// hydraulic erosion.
+        const float DEFAULT_HYDRAULIC_RAIN_RATE = 0.01f;
+
+        /// Default amount of sediment that a unit of moving water can carry,
+        /// for hydraulic erosion.
+        const float DEFAULT_HYDRAULIC_CAPACITY = 0.5f;
+
+        /// Default fraction of the missing sediment picked up per iteration, for
+        /// hydraulic erosion.
+        const float DEFAULT_HYDRAULIC_EROSION_RATE = 0.3f;
+
+        /// Default fraction of the excess sediment dropped per iteration, for
+        /// hydraulic erosion.
+        const float DEFAULT_HYDRAULIC_DEPOSITION_RATE = 0.3f;
+
+        /// Default fraction of the water that evaporates per iteration, for
+        /// hydraulic erosion.
+        const float DEFAULT_HYDRAULIC_EVAPORATION_RATE = 0.05f;
+
+        /// Number of rows processed by one task of an erosion stage.
+        const int EROSION_BAND_HEIGHT = 16;
+
+        /// Applies thermal erosion to a height map.
+        ///
+        /// Thermal erosion models material that breaks loose and slides down
+        /// slopes steeper than the <i>talus</i> height difference.  At each
+        /// iteration, every point whose height exceeds one of its four
+        /// neighbours by more than the talus moves a fraction (the rate) of its
+        /// largest excess to its lower neighbours, in proportion to their
+        /// height differences.
+        ///
+        /// <b>Parallelism</b>
+        ///
+        /// Each iteration runs as two passes over bands of rows.  The first pass
+        /// computes the outflow of every point toward each neighbour; the
+        /// second pass subtracts a point's outflows and adds the inflows read
+        /// from its neighbours.  A point is only ever written by the task that
+        /// owns it, so the bands run on several worker threads without locks,
+        /// and the result does not depend on the number of threads.  The inner
+        /// loops run over contiguous rows of @a float values so that the
+        /// compiler can vectorize them.
+        ///
+        /// Positions outside the height map are not part of the terrain;
+        /// material never leaves the height map.
+        class ThermalErosion
+        {
+
+            public:
+
+                /// Constructor.
+                ThermalErosion();
+
+                /// Erodes a height map in place.
+                ///
+                /// @param heightMap The height map.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The stage needs five @a float values of scratch space per point.
+                void Erode(NoiseMap& heightMap) const;
+
+                /// Returns the number of iterations.
+                int GetIterationCount() const
+                {
+                    return m_iterationCount;
+                }
+
+                /// Returns the fraction of the excess height difference moved per
+                /// iteration.
+                float GetRate() const
+                {
+                    return m_rate;
+                }
+
+                /// Returns the height difference above which material slides down.
+                float GetTalus() const
+                {
+                    return m_talus;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Sets the number of iterations.
+                ///
+                /// @param iterationCount The number of iterations.
+                ///
+                /// @pre The number of iterations is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetIterationCount(int iterationCount);
+
+                /// Sets the fraction of the excess height difference moved per
+                /// iteration.
+                ///
+                /// @param rate The rate.
+                ///
+                /// @pre The rate ranges from 0.0 to 0.5.  Larger values make the
+                /// terrain oscillate.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetRate(float rate);
+
+                /// Sets the height difference above which material slides down.
+                ///
+                /// @param talus The talus height difference, in height units per
+                /// point.
+                ///
+                /// @pre The talus is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetTalus(float talus);
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+            private:
+
+                /// The number of iterations.
+                int m_iterationCount;
+
+                /// The fraction of the excess height difference moved per
+                /// iteration.
+                float m_rate;
+
+                /// The talus height difference.
+                float m_talus;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+        /// Applies hydraulic erosion to a height map.
+        ///
+        /// Hydraulic erosion models rain water that flows downhill, picks up
+        /// sediment where it moves fast and drops it where it slows down.  The
+        /// stage keeps a water depth and a suspended-sediment amount for every
+        /// point.  At each iteration:
+        /// - Rain adds the same amount of water to every point.
+        /// - Water flows from every point to its four neighbours whose water
+        ///   surface (height plus water depth) is lower, in proportion to the
+        ///   differences; suspended sediment moves with the water.
+        /// - The sediment capacity of a point is proportional to the amount of
+        ///   water that left it.  Below capacity, the water erodes the terrain;
+        ///   above it, the water deposits sediment.
+        /// - Part of the water evaporates.
+        ///
+        /// The remaining sediment is deposited when the last iteration ends.
+        ///
+        /// The stage runs in parallel in the same way as
+        /// noise::utils::ThermalErosion: each iteration is split into passes
+        /// in which every point is written by a single task, reading its
+        /// neighbours' values from the previous pass.
+        class HydraulicErosion
+        {
+
+            public:
+
+                /// Constructor.
+                HydraulicErosion();
+
+                /// Erodes a height map in place.
+                ///
+                /// @param heightMap The height map.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The stage needs nine @a float values of scratch space per point.
+                void Erode(NoiseMap& heightMap) const;
+
+                /// Returns the amount of sediment that a unit of moving water can
+                /// carry.
+                float GetCapacity() const
+                {
+                    return m_capacity;
+                }
+
+                /// Returns the fraction of the excess sediment dropped per
+                /// iteration.
+                float GetDepositionRate() const
+                {
+                    return m_depositionRate;
+                }
+
+                /// Returns the fraction of the missing sediment picked up per
+                /// iteration.
+                float GetErosionRate() const
+                {
+                    return m_erosionRate;
+                }
+
+                /// Returns the fraction of the water that evaporates per iteration.
+                float GetEvaporationRate() const
+                {
+                    return m_evaporationRate;
+                }
+
+                /// Returns the number of iterations.
+                int GetIterationCount() const
+                {
+                    return m_iterationCount;
+                }
+
+                /// Returns the amount of water added to every point per iteration.
+                float GetRainRate() const
+                {
+                    return m_rainRate;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Sets the amount of sediment that a unit of moving water can
+                /// carry.
+                ///
+                /// @param capacity The sediment capacity.
+                ///
+                /// @pre The capacity is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetCapacity(float capacity);
+
+                /// Sets the fraction of the excess sediment dropped per iteration.
+                ///
+                /// @param depositionRate The deposition rate.
+                ///
+                /// @pre The rate ranges from 0.0 to 1.0.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetDepositionRate(float depositionRate);
+
+                /// Sets the fraction of the missing sediment picked up per
+                /// iteration.
+                ///
+                /// @param erosionRate The erosion rate.
+                ///
+                /// @pre The rate ranges from 0.0 to 1.0.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetErosionRate(float erosionRate);
+
+                /// Sets the fraction of the water that evaporates per iteration.
+                ///
+                /// @param evaporationRate The evaporation rate.
+                ///
+                /// @pre The rate ranges from 0.0 to 1.0.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetEvaporationRate(float evaporationRate);
+
+                /// Sets the number of iterations.
+                ///
+                /// @param iterationCount The number of iterations.
+                ///
+                /// @pre The number of iterations is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetIterationCount(int iterationCount);
+
+                /// Sets the amount of water added to every point per iteration.
+                ///
+                /// @param rainRate The rain rate.
+                ///
+                /// @pre The rain rate is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetRainRate(float rainRate);
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+            private:
+
+                /// The sediment capacity.
+                float m_capacity;
+
+                /// The deposition rate.
+                float m_depositionRate;
+
+                /// The erosion rate.
+                float m_erosionRate;
+
+                /// The evaporation rate.
+                float m_evaporationRate;
+
+                /// The number of iterations.
+                int m_iterationCount;
+
+                /// The rain rate.
+                float m_rainRate;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,278 @@
+// LibnoiseExecutor.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_EXECUTOR_H
+#define NOISE_EXECUTOR_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Counts the tasks of a group that have not finished yet.
+        ///
+        /// A task is added to the group with Add() before it is submitted, and
+        /// calls Done() when it finishes.  Executor::Wait() returns once every
+        /// task of the group is done.
+        class WaitGroup
+        {
+
+            public:
+
+                /// Constructor.
+                WaitGroup():
+                    m_count(0)
+                {
+                }
+
+                /// Adds tasks to the group.
+                ///
+                /// @param count The number of tasks to add.
+                void Add(int count);
+
+                /// Marks a task of the group as finished.
+                void Done();
+
+                /// Returns true if every task of the group has finished.
+                bool IsDone() const;
+
+                /// Blocks the calling thread until every task of the group has
+                /// finished.
+                void Wait();
+
+            private:
+
+                /// Copy constructor.  Wait groups cannot be copied.
+                WaitGroup(const WaitGroup&);
+
+                /// Assignment operator.  Wait groups cannot be copied.
+                WaitGroup& operator= (const WaitGroup&);
+
+                /// Signaled when the count drops to zero.
+                std::condition_variable m_condition;
+
+                /// The number of unfinished tasks.
+                int m_count;
+
+                /// Protects the count.
+                mutable std::mutex m_mutex;
+
+        };
+
+        /// Interface for the thread pool that runs the parallel stages of the
+        /// library.
+        ///
+        /// Every parallel stage of the library (noise-map builders, erosion,
+        /// meshing and so on) runs its work through ParallelFor(), which submits
+        /// tasks to an executor and waits for them.  By default, this is a
+        /// noise::utils::ThreadPoolExecutor owned by the library.  An
+        /// application that has its own job system implements this interface
+        /// and installs it with SetDefaultExecutor(), so that the library never
+        /// starts threads of its own.
+        ///
+        /// <b>Nested parallelism</b>
+        ///
+        /// A task may itself start a parallel stage, and so wait for other
+        /// tasks.  To avoid deadlocks when every thread of the executor is
+        /// waiting, Wait() should run pending tasks while the group is not
+        /// done, as job systems usually do.  The default implementation only
+        /// blocks.
+        class Executor
+        {
+
+            public:
+
+                /// Destructor.
+                virtual ~Executor() {}
+
+                /// Returns the number of tasks that can usefully run at the same
+                /// time, counting the thread that waits for them.
+                ///
+                /// @returns The concurrency of the executor, at least 1.
+                ///
+                /// Parallel stages whose thread count is zero split their work
+                /// into this many workers.
+                virtual int GetConcurrency() const = 0;
+
+                /// Submits a task.
+                ///
+                /// @param fTask The task.
+                ///
+                /// The task may run on any thread, including a thread that is
+                /// inside Wait().  It does not throw exceptions: ParallelFor()
+                /// catches them and rethrows them on the waiting thread.
+                virtual void Submit(const std::function<void()>& fTask) = 0;
+
+                /// Waits until every task of a group has finished.
+                ///
+                /// @param group The wait group.
+                virtual void Wait(WaitGroup& group)
+                {
+                    group.Wait();
+                }
+
+        };
+
+        /// The built-in executor: a fixed set of worker threads sharing a task
+        /// queue.
+        ///
+        /// Waiting threads run queued tasks while they wait, so nested parallel
+        /// stages never deadlock and never start additional threads.
+        class ThreadPoolExecutor: public Executor
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// @param concurrency The concurrency of the pool, or zero for one
+                /// per hardware thread.
+                ///
+                /// The pool starts one thread less than its concurrency, since the
+                /// thread waiting for a group of tasks helps running them.
+                explicit ThreadPoolExecutor(int concurrency = 0);
+
+                /// Destructor.
+                ///
+                /// Runs the remaining queued tasks, then stops the worker threads.
+                ~ThreadPoolExecutor();
+
+                virtual int GetConcurrency() const
+                {
+                    return m_concurrency;
+                }
+
+                virtual void Submit(const std::function<void()>& fTask);
+
+                virtual void Wait(WaitGroup& group);
+
+            private:
+
+                /// Copy constructor.  Thread pools cannot be copied.
+                ThreadPoolExecutor(const ThreadPoolExecutor&);
+
+                /// Assignment operator.  Thread pools cannot be copied.
+                ThreadPoolExecutor& operator= (const ThreadPoolExecutor&);
+
+                /// Runs a queued task, then wakes the threads waiting for a group.
+                ///
+                /// @param lock The lock on the queue, held on entry and on return.
+                void RunTask(std::unique_lock<std::mutex>& lock);
+
+                /// The body of a worker thread.
+                void WorkerLoop();
+
+                /// The concurrency of the pool.
+                int m_concurrency;
+
+                /// Signaled when a task is queued, when a task finishes and when
+                /// the pool stops.
+                std::condition_variable m_condition;
+
+                /// Protects the queue and the stop flag.
+                std::mutex m_mutex;
+
+                /// The queued tasks.
+                std::deque<std::function<void()> > m_queue;
+
+                /// Set when the pool is destroyed.
+                bool m_stop;
+
+                /// The worker threads.
+                std::vector<std::thread> m_threads;
+
+        };
+
+        /// Returns the executor used by the parallel stages of the library.
+        ///
+        /// @returns The executor installed with SetDefaultExecutor(), or the
+        /// built-in noise::utils::ThreadPoolExecutor, which is created the
+        /// first time it is needed.
+        Executor& GetDefaultExecutor();
+
+        /// Returns the number of threads the machine can run concurrently.
+        ///
+        /// @returns The number of hardware threads, or 1 if it cannot be
+        /// determined.
+        int GetHardwareThreadCount();
+
+        /// Runs a set of independent tasks on several workers.
+        ///
+        /// @param taskCount The number of tasks.
+        /// @param threadCount The number of workers, or zero to use the
+        /// concurrency of the default executor.
+        /// @param fTask The function that runs a task.  Its first parameter is
+        /// the index of the task, its second parameter is the index of the
+        /// worker running it, which ranges from 0 to one less than the number
+        /// of workers.
+        ///
+        /// @throw Any exception thrown by @a fTask.  Once a task throws, the
+        /// remaining tasks are skipped and the first exception is rethrown to
+        /// the caller after all workers have finished.
+        ///
+        /// The calling thread is worker 0; the other workers are submitted to
+        /// the default executor.  Tasks are handed out in increasing order.  If
+        /// only one worker is needed, the tasks run on the calling thread.
+        void ParallelFor(int taskCount, int threadCount,
+            const std::function<void(int, int)>& fTask);
+
+        /// Runs a set of independent tasks on several workers of an executor.
+        ///
+        /// @param executor The executor.
+        /// @param taskCount The number of tasks.
+        /// @param threadCount The number of workers, or zero to use the
+        /// concurrency of the executor.
+        /// @param fTask The function that runs a task.
+        ///
+        /// @throw Any exception thrown by @a fTask.
+        ///
+        /// See the other overload.
+        void ParallelFor(Executor& executor, int taskCount, int threadCount,
+            const std::function<void(int, int)>& fTask);
+
+        /// Returns the number of workers a parallel stage uses.
+        ///
+        /// @param threadCount The thread count requested by the stage, or zero.
+        ///
+        /// @returns @a threadCount if it is positive, or the concurrency of the
+        /// default executor.
+        ///
+        /// Stages call this method to size their per-worker scratch space.
+        int ResolveThreadCount(int threadCount);
+
+        /// Installs the executor used by the parallel stages of the library.
+        ///
+        /// @param pExecutor The executor, or a null pointer to go back to the
+        /// built-in executor.
+        ///
+        /// The executor must outlive every parallel stage that uses it.  Do not
+        /// change the executor while a parallel stage is running.
+        void SetDefaultExecutor(Executor* pExecutor);
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,333 @@
+// LibnoiseGraph.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_GRAPH_H
+#define NOISE_GRAPH_H
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <noise.h>
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Source-module identifier of a versioned graph that is not linked to
+        /// any noise module.
+        const int GRAPH_NO_MODULE = -1;
+
+        /// Copies a noise module of type @a T.
+        ///
+        /// @param m The noise module, of type @a T.
+        ///
+        /// @returns A new noise module, connected to the same source modules.
+        ///
+        /// VersionedGraph stores a pointer to this function for every noise
+        /// module, so that it can copy a noise module without knowing its type.
+        template<class T>
+        noise::module::Module* CloneGraphModule(const noise::module::Module& m)
+        {
+            return new T(static_cast<const T&>(m));
+        }
+
+        /// A noise module of a versioned graph, and the identifiers of its
+        /// source modules.
+        struct GraphNode
+        {
+            /// The noise module.
+            std::shared_ptr<noise::module::Module> pModule;
+
+            /// Copies the noise module.
+            noise::module::Module* (*fClone)(const noise::module::Module&);
+
+            /// The identifier of the source module at every index, or
+            /// GRAPH_NO_MODULE.
+            std::vector<int> sourceIds;
+        };
+
+        /// An immutable version of a VersionedGraph.
+        ///
+        /// A snapshot holds every noise module of its version.  No noise module
+        /// of a snapshot is ever modified, so a snapshot can be evaluated from
+        /// any number of threads while the graph is being edited.  Noise
+        /// modules that did not change between two versions are shared by
+        /// their snapshots; a noise module is destroyed when the last snapshot
+        /// that holds it is released.
+        class GraphSnapshot
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// Creates an empty snapshot.
+                GraphSnapshot();
+
+                /// Returns a noise module of the snapshot.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @returns The noise module.
+                ///
+                /// @pre The snapshot contains a noise module with this identifier.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                const noise::module::Module& GetModule(int id) const;
+
+                /// Returns the version of the snapshot: the number of commits of
+                /// the graph, when it was taken.
+                uint64 GetVersion() const
+                {
+                    return m_version;
+                }
+
+                /// Determines if the snapshot contains a noise module.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @returns
+                /// - @a true if the identifier was returned by
+                ///   VersionedGraph::Add() and the noise module was not removed.
+                /// - @a false otherwise.
+                bool HasModule(int id) const
+                {
+                    return id >= 0 && id < (int)m_nodes.size()
+                        && m_nodes[id] != NULL;
+                }
+
+            private:
+
+                friend class VersionedGraph;
+
+                /// The noise modules, indexed by identifier.  Removed noise
+                /// modules are @a NULL.
+                std::vector<std::shared_ptr<const GraphNode> > m_nodes;
+
+                /// The version of the snapshot.
+                uint64 m_version;
+
+        };
+
+        /// A graph of noise modules that can be edited while it is being
+        /// evaluated.
+        ///
+        /// The graph owns its noise modules.  They are created with Add(),
+        /// connected with Link(), and identified by the integers that Add()
+        /// returns.  Edits do not modify the noise modules that are being
+        /// evaluated: the first time a noise module is edited after a commit,
+        /// Edit() copies it, and the edits apply to the copy.  Commit() then
+        /// publishes the edited noise modules as a new GraphSnapshot.
+        ///
+        /// Since noise modules hold direct references to their source modules,
+        /// the noise modules that depend on an edited noise module are copied
+        /// as well when the graph is committed, and their copies are
+        /// connected to the new source modules.  The other noise modules are
+        /// shared with the previous snapshot, so a commit only copies the
+        /// edited noise modules and their dependents.  To find the
+        /// dependents, Commit() sweeps the whole graph once per level of
+        /// dependents, and the new snapshot copies the pointers to every
+        /// noise module, so a commit still takes time proportional to the
+        /// size of the graph times the depth of the edited chain.
+        ///
+        /// Builds call GetSnapshot() and evaluate the noise modules of the
+        /// snapshot; they keep running on their snapshot while the graph is
+        /// edited and committed, without locks and without pauses.  The
+        /// noise modules that no snapshot uses anymore are destroyed when the
+        /// last build that uses them releases its snapshot.
+        ///
+        /// GetSnapshot() can be called from any thread.  The other methods
+        /// must be called from a single editing thread.  Noise modules are
+        /// copied with their copy constructor, so noise modules whose state
+        /// cannot be copied, such as noise::module::Instrument, cannot be
+        /// added to a versioned graph.
+        class VersionedGraph
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The graph starts empty, with an empty snapshot.
+                VersionedGraph();
+
+                /// Adds a noise module to the graph.
+                ///
+                /// @param args The arguments of the constructor of the noise
+                /// module.
+                ///
+                /// @returns The identifier of the noise module.
+                ///
+                /// The noise module is visible in the snapshots after the next
+                /// commit.  Its source modules are not linked.
+                template<class T, class... Args>
+                int Add(Args&&... args)
+                {
+                    static_assert(std::is_base_of<noise::module::Module, T>::value,
+                        "VersionedGraph only holds noise modules.");
+
+                    std::shared_ptr<GraphNode> pNode(new GraphNode);
+                    pNode->pModule.reset(new T(std::forward<Args>(args)...));
+                    pNode->fClone = &CloneGraphModule<T>;
+                    pNode->sourceIds.assign(
+                        pNode->pModule->GetSourceModuleCount(), GRAPH_NO_MODULE);
+                    return AddNode(pNode);
+                }
+
+                /// Commits the edits.
+                ///
+                /// @returns The new snapshot, which GetSnapshot() returns from
+                /// now on.
+                ///
+                /// Every noise module that depends, directly or not, on an edited
+                /// noise module is copied and connected to the new versions of
+                /// its source modules.
+                std::shared_ptr<const GraphSnapshot> Commit();
+
+                /// Returns a noise module for editing.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @returns The noise module of the next snapshot, which only
+                /// the editing thread can see until the next commit.
+                ///
+                /// @pre The graph contains a noise module with this identifier.
+                /// @pre The noise module is of type @a T.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Do not call the SetSourceModule() method of the returned noise
+                /// module; call Link() instead.
+                template<class T>
+                T& Edit(int id)
+                {
+                    T* pModule = dynamic_cast<T*>(&EditModule(id));
+                    if (pModule == NULL)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    return *pModule;
+                }
+
+                /// Returns the last committed snapshot.
+                ///
+                /// @returns The snapshot.  The caller keeps it for as long as it
+                /// evaluates its noise modules.
+                ///
+                /// This method can be called from any thread.
+                std::shared_ptr<const GraphSnapshot> GetSnapshot() const;
+
+                /// Determines if the graph has edits that are not committed.
+                bool IsModified() const
+                {
+                    return m_isModified;
+                }
+
+                /// Connects a source module to a noise module.
+                ///
+                /// @param id The identifier of the noise module.
+                /// @param index The index of the source module.
+                /// @param sourceId The identifier of the source module, or
+                /// GRAPH_NO_MODULE to disconnect it.
+                ///
+                /// @pre The graph contains noise modules with these identifiers.
+                /// @pre The index ranges from 0 to one less than the number of
+                /// source modules of the noise module.
+                /// @pre The source module does not depend on the noise module.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// A noise module whose source modules are not all connected
+                /// cannot be evaluated.
+                void Link(int id, int index, int sourceId);
+
+                /// Removes a noise module from the graph.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @pre The graph contains a noise module with this identifier.
+                /// @pre No noise module of the graph is connected to it.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The identifier is not reused.  The snapshots taken before the
+                /// next commit still contain the noise module.
+                void Remove(int id);
+
+            private:
+
+                /// Copy constructor.  Versioned graphs cannot be copied.
+                VersionedGraph(const VersionedGraph&);
+
+                /// Assignment operator.  Versioned graphs cannot be copied.
+                VersionedGraph& operator= (const VersionedGraph&);
+
+                /// Adds a new node to the graph.
+                ///
+                /// @param pNode The node.
+                ///
+                /// @returns The identifier of the noise module.
+                int AddNode(const std::shared_ptr<GraphNode>& pNode);
+
+                /// Returns the node of a noise module, after copying it if it
+                /// belongs to a snapshot.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @returns The node, owned by the editing thread.
+                ///
+                /// @pre The graph contains a noise module with this identifier.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                GraphNode& EditNode(int id);
+
+                /// Returns a noise module for editing.
+                ///
+                /// @param id The identifier of the noise module.
+                ///
+                /// @returns The noise module, owned by the editing thread.
+                noise::module::Module& EditModule(int id)
+                {
+                    return *EditNode(id).pModule;
+                }
+
+                /// Determines if the graph has edits that are not committed.
+                bool m_isModified;
+
+                /// Determines, for every node of the next snapshot, if it was
+                /// created or copied since the last commit.
+                std::vector<bool> m_isEdited;
+
+                /// The nodes of the next snapshot, indexed by identifier.
+                std::vector<std::shared_ptr<GraphNode> > m_nodes;
+
+                /// The last committed snapshot.  It is read and written with
+                /// the atomic operations of std::shared_ptr.
+                std::shared_ptr<const GraphSnapshot> m_pSnapshot;
+
+        };
+
+    }
+
+}
+
+#endif
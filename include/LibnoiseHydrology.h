@@ -0,0 +1,262 @@
+// LibnoiseHydrology.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_HYDROLOGY_H
+#define NOISE_HYDROLOGY_H
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Number of neighbours of a point that water can flow to.
+        const int FLOW_DIRECTION_COUNT = 8;
+
+        /// Horizontal offsets of the neighbours of a point, indexed by D8
+        /// direction code.  Code 0 points toward +x; the codes turn toward +y.
+        const int FLOW_OFFSET_X[FLOW_DIRECTION_COUNT] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+        /// Vertical offsets of the neighbours of a point, indexed by D8
+        /// direction code.
+        const int FLOW_OFFSET_Y[FLOW_DIRECTION_COUNT] = {0, 1, 1, 1, 0, -1, -1, -1};
+
+        /// Value of a direction map at a point from which water does not flow
+        /// to any neighbour: a pit, or a point on the edge of the map that
+        /// drains out of it.
+        const float FLOW_DIRECTION_NONE = -1.0f;
+
+        /// Number of rows processed by one task of a flow stage.
+        const int FLOW_BAND_HEIGHT = 16;
+
+        /// Flow-routing methods.
+        enum FlowMethod
+        {
+
+            /// Water flows to the neighbour with the steepest downward slope,
+            /// among the eight neighbours.  The direction map holds the D8
+            /// code of that neighbour (see FLOW_OFFSET_X and FLOW_OFFSET_Y).
+            FLOW_METHOD_D8 = 0,
+
+            /// Water flows along the steepest downward slope of the eight
+            /// triangular facets around the point (Tarboton's D-infinity),
+            /// and is split between the two neighbours on either side of that
+            /// slope.  The direction map holds the angle of the slope, in
+            /// radians, from 0 (toward +x) to 2 pi, turning toward +y.
+            FLOW_METHOD_DINF = 1
+
+        };
+
+        /// Width and height of the tiles of a depression fill.
+        const int DEPRESSION_FILL_TILE_SIZE = 256;
+
+        /// Fills the depressions of a height map.
+        ///
+        /// Every point is raised to the lowest level at which water standing
+        /// on it could flow out of the height map, so that water flows to an
+        /// edge from every point.  Points on the edges of the height map are
+        /// outlets and keep their heights.  Filled depressions are flat;
+        /// noise::utils::FlowRouter::ComputeDirections() routes the water
+        /// across them.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// The stage runs the parallel Priority-Flood of Barnes.  The height
+        /// map is split into tiles of DEPRESSION_FILL_TILE_SIZE points.  Each
+        /// tile is filled toward its own border: the border points go in a
+        /// priority queue, and the lowest point of the queue repeatedly floods
+        /// its unvisited neighbours, raising those below the flood level.
+        /// Every point of the tile is labelled with the border point whose
+        /// flood reached it, and the lowest level at which two labels meet is
+        /// recorded.  A Priority-Flood over the graph of labels, linked across
+        /// tile borders, then gives the level at which the water of every
+        /// label leaves the height map, and the points below that level are
+        /// raised to it.
+        ///
+        /// The tiles are filled and raised in parallel on the thread count set
+        /// by SetThreadCount(); the result does not depend on it.  The flood
+        /// front is a radix heap, since the flood levels never decrease.  The
+        /// stage needs two bytes of scratch space per point.
+        class DepressionFiller
+        {
+
+            public:
+
+                /// Constructor.
+                DepressionFiller();
+
+                /// Fills the depressions of a height map in place.
+                ///
+                /// @param heightMap The height map.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Fill(NoiseMap& heightMap) const;
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+            private:
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+        /// Computes flow directions and flow accumulation over height maps.
+        ///
+        /// ComputeDirections() writes, for every point of a height map, the
+        /// direction in which water flows from it (see noise::utils::FlowMethod).
+        /// Accumulate() then writes, for every point, the amount of water that
+        /// flows through it: its own rain plus the water of all the points
+        /// upstream.  By default each point receives one unit of rain, so the
+        /// accumulation is the upstream area in points.  Thresholding the
+        /// accumulation map (for example with
+        /// noise::utils::DistanceTransform::SetThreshold()) gives a river
+        /// network.
+        ///
+        /// Run noise::utils::DepressionFiller on the height map first;
+        /// otherwise water stops in every pit of the terrain.
+        ///
+        /// <b>Parallelism</b>
+        ///
+        /// The directions are computed over bands of rows on several worker
+        /// threads; only the routing across flats is serial.  The accumulation
+        /// is a topological traversal of the flow graph: parallel passes
+        /// decode the directions into a byte per point and count, for every
+        /// point, the neighbours that flow into it.  Then each task starts
+        /// from the points of its band that no water flows into and follows
+        /// the flow downstream; the task that completes the last upstream
+        /// neighbour of a point, as recorded by an atomic counter, goes on
+        /// with that point.
+        /// Every point is computed once, by summing the water of its upstream
+        /// neighbours in a fixed order, so the result does not depend on the
+        /// number of threads.
+        class FlowRouter
+        {
+
+            public:
+
+                /// Constructor.
+                FlowRouter();
+
+                /// Computes the flow accumulation.
+                ///
+                /// @param directionMap The direction map written by
+                /// ComputeDirections() with the same method.
+                /// @param accumulationMap The noise map that receives the
+                /// accumulation.
+                /// @param pRainMap The amount of rain on every point, or @a NULL
+                /// for one unit everywhere.
+                ///
+                /// @pre The direction map is not empty.
+                /// @pre The rain map, if any, has the size of the direction map.
+                /// @pre The accumulation map is neither the direction map nor the
+                /// rain map.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The accumulation is computed in single precision.  The stage
+                /// needs two bytes of scratch space per point.
+                void Accumulate(const NoiseMap& directionMap,
+                    NoiseMap& accumulationMap, const NoiseMap* pRainMap = NULL)
+                    const;
+
+                /// Computes the flow directions of a height map.
+                ///
+                /// @param heightMap The height map.
+                /// @param directionMap The noise map that receives the directions.
+                ///
+                /// @pre The height map is not empty.
+                /// @pre The direction map is not the height map.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The slopes toward diagonal neighbours are divided by the square
+                /// root of 2.  On flats, such as the depressions filled by
+                /// noise::utils::DepressionFiller, a breadth-first search from
+                /// the points that drain the flat directs every point toward
+                /// its outlet along the shortest path.  Points lower than all
+                /// their neighbours, and points on the edges without a downward
+                /// slope, get FLOW_DIRECTION_NONE.
+                void ComputeDirections(const NoiseMap& heightMap,
+                    NoiseMap& directionMap) const;
+
+                /// Returns the flow-routing method.
+                FlowMethod GetMethod() const
+                {
+                    return m_method;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Sets the flow-routing method.
+                ///
+                /// @param method The flow-routing method.
+                void SetMethod(FlowMethod method)
+                {
+                    m_method = method;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+            private:
+
+                /// The flow-routing method.
+                FlowMethod m_method;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,306 @@
+// LibnoiseMemory.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_MEMORY_H
+#define NOISE_MEMORY_H
+
+#include <stddef.h>
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Enumerates the kinds of memory tracked by the memory accounting.
+        ///
+        /// <b>Memory accounting</b>
+        ///
+        /// Every large buffer allocated by the library (noise-map buffers,
+        /// caches, arenas and scratch space) is reserved against a single
+        /// library-wide account before it is allocated, and released from it
+        /// when it is freed.  The current and peak usage can be queried at any
+        /// time with GetMemoryStats().
+        ///
+        /// A <i>memory budget</i> may be set with SetMemoryBudget().  When a
+        /// reservation would exceed the budget, the library first asks every
+        /// registered noise::utils::MemoryReclaimer (typically a cache) to give
+        /// memory back.  Builders also query GetAvailableMemory() to shrink
+        /// their scratch space or to stream their output instead of holding it
+        /// all in memory.  noise::ExceptionOutOfMemory is only thrown when none
+        /// of this frees enough memory.
+        enum MemoryCategory
+        {
+
+            /// Noise-map buffers and other rasters.
+            MEMORY_RASTER = 0,
+
+            /// Cached results that can be recomputed.
+            MEMORY_CACHE = 1,
+
+            /// Arenas holding noise modules and their connections.
+            MEMORY_ARENA = 2,
+
+            /// Temporary buffers used while building.
+            MEMORY_SCRATCH = 3,
+
+            /// The number of memory categories.
+            MEMORY_CATEGORY_COUNT = 4
+
+        };
+
+        /// A snapshot of the memory accounting.
+        struct MemoryStats
+        {
+            /// The number of bytes currently reserved, per category.
+            size_t usage[MEMORY_CATEGORY_COUNT];
+
+            /// The number of bytes currently reserved, in all categories.
+            size_t totalUsage;
+
+            /// The largest value of @a totalUsage since the last call to
+            /// ResetPeakMemoryUsage().
+            size_t peakUsage;
+
+            /// The memory budget, in bytes, or zero if there is no budget.
+            size_t budget;
+        };
+
+        /// Interface for an object that can give memory back when the memory
+        /// budget is exhausted.
+        ///
+        /// Caches implement this interface and register themselves with
+        /// RegisterMemoryReclaimer().  When a reservation would exceed the
+        /// memory budget, ReclaimMemory() is called on each registered
+        /// reclaimer until enough memory has been released.
+        ///
+        /// ReclaimMemory() may be called from any thread that is reserving
+        /// memory.  An implementation must therefore never reserve memory
+        /// itself, and the object must never reserve memory while holding a
+        /// lock that ReclaimMemory() takes.
+        class MemoryReclaimer
+        {
+
+            public:
+
+                /// Destructor.
+                virtual ~MemoryReclaimer() {}
+
+                /// Releases memory.
+                ///
+                /// @param bytes The number of bytes the caller would like to be
+                /// released.
+                ///
+                /// @returns The number of bytes actually released through
+                /// ReleaseMemory().
+                virtual size_t ReclaimMemory(size_t bytes) = 0;
+
+        };
+
+        /// Returns the number of bytes that can still be reserved before the
+        /// memory budget is exceeded.
+        ///
+        /// @returns The number of available bytes, or the largest @a size_t
+        /// value if there is no budget.
+        size_t GetAvailableMemory();
+
+        /// Returns the memory budget.
+        ///
+        /// @returns The memory budget, in bytes, or zero if there is no budget.
+        size_t GetMemoryBudget();
+
+        /// Returns a snapshot of the memory accounting.
+        ///
+        /// @returns The current usage per category, the peak usage and the
+        /// budget.
+        MemoryStats GetMemoryStats();
+
+        /// Returns the number of bytes reserved in a category.
+        ///
+        /// @param category The memory category.
+        ///
+        /// @returns The number of bytes reserved in that category.
+        size_t GetMemoryUsage(MemoryCategory category);
+
+        /// Asks the registered reclaimers to release memory.
+        ///
+        /// @param bytes The number of bytes to release.
+        ///
+        /// @returns The number of bytes that were released.
+        size_t ReclaimMemory(size_t bytes);
+
+        /// Registers an object that can give memory back when the memory budget
+        /// is exhausted.
+        ///
+        /// @param pReclaimer The reclaimer.
+        ///
+        /// The reclaimer must be unregistered with UnregisterMemoryReclaimer()
+        /// before it is destroyed.
+        void RegisterMemoryReclaimer(MemoryReclaimer* pReclaimer);
+
+        /// Releases memory previously reserved with ReserveMemory() or
+        /// TryReserveMemory().
+        ///
+        /// @param category The memory category.
+        /// @param bytes The number of bytes to release.
+        void ReleaseMemory(MemoryCategory category, size_t bytes);
+
+        /// Reserves memory against the memory budget.
+        ///
+        /// @param category The memory category.
+        /// @param bytes The number of bytes to reserve.
+        ///
+        /// @throw noise::ExceptionOutOfMemory The reservation would exceed the
+        /// memory budget even after the registered reclaimers released all the
+        /// memory they could.
+        void ReserveMemory(MemoryCategory category, size_t bytes);
+
+        /// Resets the peak memory usage to the current memory usage.
+        void ResetPeakMemoryUsage();
+
+        /// Sets the memory budget.
+        ///
+        /// @param bytes The memory budget, in bytes, or zero to remove the
+        /// budget.
+        ///
+        /// Setting a budget lower than the current usage does not release any
+        /// memory immediately; it only causes later reservations to fail or to
+        /// trigger reclamation.
+        void SetMemoryBudget(size_t bytes);
+
+        /// Reserves memory against the memory budget without throwing an
+        /// exception.
+        ///
+        /// @param category The memory category.
+        /// @param bytes The number of bytes to reserve.
+        ///
+        /// @returns
+        /// - @a true if the memory was reserved.
+        /// - @a false if the reservation would exceed the memory budget even
+        ///   after the registered reclaimers released all the memory they
+        ///   could.
+        bool TryReserveMemory(MemoryCategory category, size_t bytes);
+
+        /// Unregisters an object registered with RegisterMemoryReclaimer().
+        ///
+        /// @param pReclaimer The reclaimer.
+        ///
+        /// This method waits until no other thread is calling the reclaimer.
+        void UnregisterMemoryReclaimer(MemoryReclaimer* pReclaimer);
+
+
+        /// Holds a memory reservation for the lifetime of the object.
+        ///
+        /// This class is convenient for scratch buffers: the reservation is
+        /// released when the object goes out of scope, including when an
+        /// exception is thrown.
+        class MemoryReservation
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// Creates an object that does not hold a reservation.
+                MemoryReservation():
+                    m_bytes(0),
+                    m_category(MEMORY_SCRATCH)
+                {
+                }
+
+                /// Constructor.
+                ///
+                /// @param category The memory category.
+                /// @param bytes The number of bytes to reserve.
+                ///
+                /// @throw noise::ExceptionOutOfMemory See ReserveMemory().
+                MemoryReservation(MemoryCategory category, size_t bytes):
+                    m_bytes(0),
+                    m_category(category)
+                {
+                    ReserveMemory(category, bytes);
+                    m_bytes = bytes;
+                }
+
+                /// Destructor.
+                ///
+                /// Releases the reservation.
+                ~MemoryReservation()
+                {
+                    Release();
+                }
+
+                /// Returns the number of bytes held by this reservation.
+                ///
+                /// @returns The number of reserved bytes.
+                size_t GetBytes() const
+                {
+                    return m_bytes;
+                }
+
+                /// Releases the reservation.
+                void Release()
+                {
+                    if (m_bytes > 0)
+                    {
+                        ReleaseMemory(m_category, m_bytes);
+                        m_bytes = 0;
+                    }
+                }
+
+                /// Replaces the reservation without throwing an exception.
+                ///
+                /// @param category The memory category.
+                /// @param bytes The number of bytes to reserve.
+                ///
+                /// @returns
+                /// - @a true if the memory was reserved.
+                /// - @a false if it was not; this object then holds no
+                ///   reservation.
+                bool TryReserve(MemoryCategory category, size_t bytes)
+                {
+                    Release();
+                    m_category = category;
+                    if (!TryReserveMemory(category, bytes))
+                    {
+                        return false;
+                    }
+                    m_bytes = bytes;
+                    return true;
+                }
+
+            private:
+
+                /// Copy constructor.  Reservations cannot be copied.
+                MemoryReservation(const MemoryReservation&);
+
+                /// Assignment operator.  Reservations cannot be copied.
+                MemoryReservation& operator= (const MemoryReservation&);
+
+                /// The number of reserved bytes.
+                size_t m_bytes;
+
+                /// The category of the reservation.
+                MemoryCategory m_category;
+
+        };
+
+    }
+
+}
+
+#endif
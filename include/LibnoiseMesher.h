@@ -0,0 +1,324 @@
+// LibnoiseMesher.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_MESHER_H
+#define NOISE_MESHER_H
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default size of the tiles of a height-map mesher, in cells.
+        const int DEFAULT_MESHER_TILE_SIZE = 64;
+
+        /// Default largest height difference between a simplified mesh and the
+        /// height map.
+        const NOISE_REAL DEFAULT_MESHER_TOLERANCE = 0.01;
+
+        /// Enumerates the triangulations of a height-map mesher.
+        enum MeshMode
+        {
+
+            /// Two triangles per cell of the height map.  No simplification.
+            MESH_GRID = 0,
+
+            /// Restricted quadtree: square blocks of a power-of-two size are
+            /// split until they are flat enough, and neighbouring blocks differ
+            /// by at most one level of detail wherever that is possible.
+            MESH_QUADTREE = 1,
+
+            /// Error-bounded greedy merging: rectangles of cells are grown as
+            /// large as possible while they remain flat enough.  Produces fewer
+            /// triangles than the quadtree, with longer and thinner triangles.
+            MESH_GREEDY = 2
+
+        };
+
+        /// The output buffers of one mesh tile.
+        ///
+        /// The caller owns the buffers.  They must hold at least the number of
+        /// values returned by HeightMapMesher::GetMaxVertexCount() and
+        /// HeightMapMesher::GetMaxIndexCount() for the tile.
+        struct MeshBuffer
+        {
+            /// The vertex buffer: three @a float values ( @a x, @a y, @a z ) per
+            /// vertex.
+            float* pVertices;
+
+            /// The capacity of the vertex buffer, in vertices.
+            int vertexCapacity;
+
+            /// The index buffer: three indices per triangle, into the vertex
+            /// buffer of the same tile.
+            uint32* pIndices;
+
+            /// The capacity of the index buffer, in indices.
+            int indexCapacity;
+
+            /// Receives the number of vertices written.
+            int vertexCount;
+
+            /// Receives the number of indices written.
+            int indexCount;
+        };
+
+        /// Converts a height map into triangle meshes.
+        ///
+        /// The height map is split into square tiles of SetTileSize() cells,
+        /// aligned on multiples of the tile size; each tile becomes an indexed
+        /// triangle mesh written into a caller-provided noise::utils::MeshBuffer.
+        /// The point ( @a x, @a z ) of the height map becomes the vertex
+        /// ( @a x * spacing, value * height scale, @a z * spacing ), and the
+        /// triangles face the +y axis (counter-clockwise when seen from above
+        /// in a right-handed coordinate system).
+        ///
+        /// <b>Simplification</b>
+        ///
+        /// See noise::utils::MeshMode.  The simplified modes guarantee that
+        /// every point of the height map lies within the tolerance of the mesh,
+        /// measured vertically.
+        ///
+        /// <b>Borders</b>
+        ///
+        /// Neighbouring tiles always have exactly the same vertices, with
+        /// bit-identical positions, along their common border, so meshes of
+        /// neighbouring tiles join without cracks or T-junctions.  The border
+        /// vertices only depend on height-map values that both tiles can see,
+        /// so a tile can be meshed on its own (see MeshTile()) and still match
+        /// tiles meshed in another run.
+        ///
+        /// <b>Parallelism</b>
+        ///
+        /// MeshTiles() meshes the tiles in parallel on the thread count set by
+        /// SetThreadCount().  Each tile only writes its own buffers.
+        class HeightMapMesher
+        {
+
+            public:
+
+                /// Constructor.
+                HeightMapMesher();
+
+                /// Returns the largest number of indices that a tile can produce.
+                ///
+                /// @param heightMap The height map.
+                /// @param tileX The x index of the tile.
+                /// @param tileZ The z index of the tile.
+                ///
+                /// @returns The maximum index count of the tile.
+                int GetMaxIndexCount(const NoiseMap& heightMap, int tileX,
+                    int tileZ) const;
+
+                /// Returns the largest number of vertices that a tile can produce.
+                ///
+                /// @param heightMap The height map.
+                /// @param tileX The x index of the tile.
+                /// @param tileZ The z index of the tile.
+                ///
+                /// @returns The maximum vertex count of the tile.
+                int GetMaxVertexCount(const NoiseMap& heightMap, int tileX,
+                    int tileZ) const;
+
+                /// Returns the triangulation mode.
+                MeshMode GetMode() const
+                {
+                    return m_mode;
+                }
+
+                /// Returns the factor applied to the height-map values.
+                NOISE_REAL GetHeightScale() const
+                {
+                    return m_heightScale;
+                }
+
+                /// Returns the distance between neighbouring vertices of the grid.
+                NOISE_REAL GetSpacing() const
+                {
+                    return m_spacing;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the number of tiles covering a height map.
+                ///
+                /// @param heightMap The height map.
+                /// @param tileCountX Receives the number of tiles along the x axis.
+                /// @param tileCountZ Receives the number of tiles along the z axis.
+                ///
+                /// A height map of @a w x @a h points has ( @a w - 1 ) x
+                /// ( @a h - 1 ) cells; a height map with fewer than two points
+                /// along an axis has no tiles.
+                void GetTileCount(const NoiseMap& heightMap, int& tileCountX,
+                    int& tileCountZ) const;
+
+                /// Returns the size of the tiles.
+                ///
+                /// @returns The tile size, in cells.
+                int GetTileSize() const
+                {
+                    return m_tileSize;
+                }
+
+                /// Returns the largest height difference between a simplified mesh
+                /// and the height map.
+                NOISE_REAL GetTolerance() const
+                {
+                    return m_tolerance;
+                }
+
+                /// Meshes one tile.
+                ///
+                /// @param heightMap The height map.
+                /// @param tileX The x index of the tile.
+                /// @param tileZ The z index of the tile.
+                /// @param buffer The output buffers.
+                ///
+                /// @pre The tile indices are within the counts returned by
+                /// GetTileCount().
+                /// @pre The capacities of the buffers are at least the counts
+                /// returned by GetMaxVertexCount() and GetMaxIndexCount().
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void MeshTile(const NoiseMap& heightMap, int tileX, int tileZ,
+                    MeshBuffer& buffer) const;
+
+                /// Meshes every tile of a height map in parallel.
+                ///
+                /// @param heightMap The height map.
+                /// @param pBuffers The output buffers, one per tile, in row-major
+                /// order: the buffers of tile ( @a tileX, @a tileZ ) are
+                /// @a pBuffers [ @a tileZ * @a tileCountX + @a tileX ].
+                ///
+                /// @pre Every buffer satisfies the preconditions of MeshTile().
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void MeshTiles(const NoiseMap& heightMap, MeshBuffer* pBuffers) const;
+
+                /// Sets the factor applied to the height-map values.
+                ///
+                /// @param heightScale The height scale.
+                void SetHeightScale(NOISE_REAL heightScale)
+                {
+                    m_heightScale = heightScale;
+                }
+
+                /// Sets the triangulation mode.
+                ///
+                /// @param mode The triangulation mode.
+                void SetMode(MeshMode mode)
+                {
+                    m_mode = mode;
+                }
+
+                /// Sets the distance between neighbouring vertices of the grid.
+                ///
+                /// @param spacing The spacing.
+                void SetSpacing(NOISE_REAL spacing)
+                {
+                    m_spacing = spacing;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+                /// Sets the size of the tiles.
+                ///
+                /// @param tileSize The tile size, in cells.
+                ///
+                /// @pre The tile size is a power of two, at least 2.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetTileSize(int tileSize)
+                {
+                    if (tileSize < 2 || (tileSize & (tileSize - 1)) != 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_tileSize = tileSize;
+                }
+
+                /// Sets the largest height difference between a simplified mesh and
+                /// the height map.
+                ///
+                /// @param tolerance The tolerance, in height-map units (before the
+                /// height scale is applied).
+                ///
+                /// @pre The tolerance is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetTolerance(NOISE_REAL tolerance)
+                {
+                    if (tolerance < 0.0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_tolerance = tolerance;
+                }
+
+            private:
+
+                /// The factor applied to the height-map values.
+                NOISE_REAL m_heightScale;
+
+                /// The triangulation mode.
+                MeshMode m_mode;
+
+                /// The distance between neighbouring vertices.
+                NOISE_REAL m_spacing;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The tile size, in cells.
+                int m_tileSize;
+
+                /// The tolerance.
+                NOISE_REAL m_tolerance;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,382 @@
+// LibnoisePipeline.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_PIPELINE_H
+#define NOISE_PIPELINE_H
+
+#include <functional>
+#include <stddef.h>
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default width and height of the tiles of a pipeline.
+        const int DEFAULT_PIPELINE_TILE_SIZE = 128;
+
+        /// A tile being computed by a stage of a noise::utils::TilePipeline.
+        ///
+        /// The stage writes the values of its raster over the tile, and may
+        /// read the rasters of its inputs over the tile enlarged by the halo of
+        /// each input.  Coordinates are in points of the whole raster.  Halo
+        /// points outside the raster hold the value of the nearest point on its
+        /// edge.
+        class PipelineTile
+        {
+
+            public:
+
+                /// Returns the height of the tile, in points.
+                int GetHeight() const
+                {
+                    return m_height;
+                }
+
+                /// Returns a pointer to a value of an input.
+                ///
+                /// @param input The index of the input, in the order of
+                /// TilePipeline::AddInput().
+                /// @param x The x coordinate of the value.
+                /// @param z The z coordinate of the value.
+                ///
+                /// @returns The pointer.  The values of the same row follow it.
+                ///
+                /// The point must lie in the tile enlarged by the halo of the
+                /// input.
+                const float* GetInputPtr(int input, int x, int z) const
+                {
+                    const Window& window = m_inputs[input];
+                    return window.pData + (size_t)(z - window.z0)
+                        * (size_t)window.stride + (size_t)(x - window.x0);
+                }
+
+                /// Returns the distance, in values, between two rows of an input.
+                ///
+                /// @param input The index of the input.
+                int GetInputStride(int input) const
+                {
+                    return m_inputs[input].stride;
+                }
+
+                /// Returns a pointer to a value of the tile.
+                ///
+                /// @param x The x coordinate of the value.
+                /// @param z The z coordinate of the value.
+                ///
+                /// @returns The pointer.  The values of the same row follow it.
+                float* GetOutputPtr(int x, int z) const
+                {
+                    return m_pOutput + (size_t)(z - m_z0) * (size_t)m_width
+                        + (size_t)(x - m_x0);
+                }
+
+                /// Returns the distance, in values, between two rows of the tile.
+                int GetOutputStride() const
+                {
+                    return m_width;
+                }
+
+                /// Returns the width of the tile, in points.
+                int GetWidth() const
+                {
+                    return m_width;
+                }
+
+                /// Returns the index of the worker computing the tile, from 0 to
+                /// one less than the thread count of the pipeline.
+                ///
+                /// Stages use it to index per-worker scratch space.
+                int GetWorker() const
+                {
+                    return m_worker;
+                }
+
+                /// Returns the x coordinate of the left column of the tile.
+                int GetX0() const
+                {
+                    return m_x0;
+                }
+
+                /// Returns the z coordinate of the top row of the tile.
+                int GetZ0() const
+                {
+                    return m_z0;
+                }
+
+            private:
+
+                friend class TilePipeline;
+
+                /// A rectangle of an input raster.
+                struct Window
+                {
+                    const float* pData;
+                    int stride;
+                    int x0;
+                    int z0;
+                };
+
+                /// The height of the tile.
+                int m_height;
+
+                /// The input rectangles.
+                std::vector<Window> m_inputs;
+
+                /// The values of the tile.
+                float* m_pOutput;
+
+                /// The width of the tile.
+                int m_width;
+
+                /// The worker computing the tile.
+                int m_worker;
+
+                /// The left column of the tile.
+                int m_x0;
+
+                /// The top row of the tile.
+                int m_z0;
+
+        };
+
+        /// Runs a chain of raster stages tile by tile.
+        ///
+        /// Each stage computes one raster, with the size of the pipeline, from
+        /// the rasters of earlier stages, its inputs.  For every input, the stage
+        /// declares a halo: the number of points around a tile that it reads.
+        /// A bake such as noise evaluation, then erosion, then normals, then
+        /// splat weights, then compression, is a chain of stages whose last
+        /// stage writes its tiles where the application wants them.
+        ///
+        /// Instead of running each stage over the whole raster before the next
+        /// one starts, the pipeline splits the rasters into tiles of
+        /// SetTileSize() points and runs a tile of a stage as soon as the tiles
+        /// of its inputs under the tile and its halo are done.  A tile of an
+        /// intermediate raster is freed as soon as the last tile that reads it
+        /// is done, so only a band of tiles of each raster, a few tile rows
+        /// deep, is held at any time, and the tiles are still in cache when
+        /// the next stage reads them.
+        ///
+        /// <b>Scheduling</b>
+        ///
+        /// The workers take the ready tile of the deepest stage first, then
+        /// the tile that comes first in row-major order, so the tiles flow
+        /// through the chain before new ones are started.  The tiles of the
+        /// stages without inputs are started in row-major order, and only while
+        /// the pipeline holds fewer tiles than SetMaxHeldTiles(); if nothing
+        /// else can run, one is started anyway, so a low limit slows the
+        /// pipeline down but never stops it.
+        ///
+        /// The results do not depend on the number of threads, as long as each
+        /// stage computes a tile from its inputs only.  Stages that consume a
+        /// halo of an iterative full-map process, such as erosion, compute an
+        /// approximation of the full-map result that improves with the halo.
+        class TilePipeline
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// @param width The width of the rasters, in points.
+                /// @param height The height of the rasters, in points.
+                ///
+                /// @pre The width and the height are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                TilePipeline(int width, int height);
+
+                /// Connects an input to a stage.
+                ///
+                /// @param stage The stage.
+                /// @param sourceStage The stage whose raster is read.
+                /// @param halo The number of points read around each tile.
+                ///
+                /// @pre Both stages exist.
+                /// @pre The source stage was added before the stage.
+                /// @pre The halo is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The inputs of a stage are numbered in the order in which they
+                /// are connected.
+                void AddInput(int stage, int sourceStage, int halo);
+
+                /// Adds a stage.
+                ///
+                /// @param fRun Computes a tile of the raster of the stage.  It is
+                /// called from several threads at the same time, for different
+                /// tiles.
+                ///
+                /// @returns The identifier of the stage.
+                int AddStage(const std::function<void(PipelineTile&)>& fRun);
+
+                /// Returns the height of the rasters, in points.
+                int GetHeight() const
+                {
+                    return m_height;
+                }
+
+                /// Returns the largest number of tiles the pipeline may hold
+                /// before it starts new tiles, or zero for an automatic limit.
+                int GetMaxHeldTiles() const
+                {
+                    return m_maxHeldTiles;
+                }
+
+                /// Returns the largest number of raster tiles held at the same
+                /// time during the last run.
+                int GetPeakHeldTileCount() const
+                {
+                    return m_peakHeldTileCount;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Returns the width and height of the tiles, in points.
+                int GetTileSize() const
+                {
+                    return m_tileSize;
+                }
+
+                /// Returns the width of the rasters, in points.
+                int GetWidth() const
+                {
+                    return m_width;
+                }
+
+                /// Runs the pipeline.
+                ///
+                /// @pre The pipeline has at least one stage.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                /// @throw Any exception thrown by a stage.  The other stages stop
+                /// at the end of their current tile.
+                ///
+                /// The tiles are held in scratch memory, reserved against the
+                /// memory budget as they are created.
+                void Run();
+
+                /// Sets the largest number of tiles the pipeline may hold before
+                /// it starts new tiles.
+                ///
+                /// @param maxHeldTiles The number of tiles, or zero for a limit
+                /// that covers the halos of the whole chain over a row of tiles.
+                ///
+                /// @pre The number of tiles is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetMaxHeldTiles(int maxHeldTiles);
+
+                /// Sets the noise map that receives the raster of a stage.
+                ///
+                /// @param stage The stage.
+                /// @param pNoiseMap The noise map, or @a NULL to drop the tiles
+                /// of the stage once no other stage needs them.
+                ///
+                /// @pre The stage exists.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The noise map is resized to the size of the pipeline when the
+                /// pipeline runs, and receives every tile as soon as it is done.
+                void SetOutputNoiseMap(int stage, NoiseMap* pNoiseMap);
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount);
+
+                /// Sets the width and height of the tiles.
+                ///
+                /// @param tileSize The tile size, in points.
+                ///
+                /// @pre The tile size is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The default size keeps a tile, and the halo windows of a
+                /// stage, within the second-level cache.
+                void SetTileSize(int tileSize);
+
+            private:
+
+                /// An input of a stage.
+                struct Input
+                {
+                    int sourceStage;
+                    int halo;
+                };
+
+                /// A stage of the pipeline.
+                struct Stage
+                {
+                    std::function<void(PipelineTile&)> fRun;
+                    std::vector<Input> inputs;
+                    NoiseMap* pOutputNoiseMap;
+                };
+
+                /// Checks a stage identifier.
+                ///
+                /// @throw noise::ExceptionInvalidParam The stage does not exist.
+                void CheckStage(int stage) const;
+
+                /// The height of the rasters.
+                int m_height;
+
+                /// The tile limit, or zero.
+                int m_maxHeldTiles;
+
+                /// The peak number of tiles held during the last run.
+                int m_peakHeldTileCount;
+
+                /// The stages, in the order in which they were added.
+                std::vector<Stage> m_stages;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+                /// The width and height of the tiles.
+                int m_tileSize;
+
+                /// The width of the rasters.
+                int m_width;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,271 @@
+// LibnoisePlacement.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_PLACEMENT_H
+#define NOISE_PLACEMENT_H
+
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default number of candidate points a noise::utils::PoissonDiskPlacer
+        /// tries per cell.
+        const int DEFAULT_PLACEMENT_ATTEMPT_COUNT = 16;
+
+        /// Places points at random over a region, with a minimum distance
+        /// between them (Poisson-disk or blue-noise sampling).
+        ///
+        /// The points are spread evenly, without the clumps and the holes of
+        /// independent random points, which suits vegetation and props.  Two
+        /// controls shape the result:
+        ///
+        /// - The <i>minimum distance</i> is either constant (see SetRadius())
+        ///   or given by a <i>radius module</i> (see SetRadiusModule()).  Two
+        ///   points are at least the larger of their radii apart.
+        /// - The <i>density module</i> (see SetDensityModule()) gives, at each
+        ///   point, the probability, from 0 to 1, that the point is kept.
+        ///   The number of points in an area scales with the density, and a
+        ///   density of 0 leaves an area empty.  The points are thinned once
+        ///   placed, so a low density also spreads them less evenly; to keep
+        ///   sparse areas evenly spaced, raise the radius there instead.
+        ///
+        /// <b>Algorithm</b>
+        ///
+        /// The region is split into a grid of cells whose diagonal does not
+        /// exceed the smallest radius, so that a cell holds at most one point,
+        /// and candidate points are thrown into the empty cells in rounds; a
+        /// candidate is kept if no point already placed in the neighbouring
+        /// cells is too close.  The cells are grouped into square tiles,
+        /// which are processed in four phases: the tiles of a phase are a
+        /// whole tile apart, farther than the largest radius, so they are
+        /// processed in parallel.  Inside a tile, each round runs in steps
+        /// over cells far enough apart not to interact, in a random order, so
+        /// that the scan order leaves no pattern in the points.
+        ///
+        /// The radius module is evaluated with
+        /// noise::module::Module::GetValues(), for the candidates of a step
+        /// at a time that passed the distance test against the radii of the
+        /// placed points.  The density module is evaluated the same way, for
+        /// a row of placed points at a time.
+        ///
+        /// The candidates of a cell only depend on the seed and on the
+        /// coordinates of the cell, so the points only depend on the seed,
+        /// the bounds, the modules and the settings, never on the thread
+        /// count.
+        ///
+        /// The density and radius modules must support being called from
+        /// several threads at once.
+        class PoissonDiskPlacer
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The radius is 1, the seed is 0, and the attempt count is
+                /// DEFAULT_PLACEMENT_ATTEMPT_COUNT.  No density module is set,
+                /// so every point is kept.
+                PoissonDiskPlacer();
+
+                /// Returns the number of candidate points tried per cell.
+                int GetAttemptCount() const
+                {
+                    return m_attemptCount;
+                }
+
+                /// Returns the largest minimum distance between two points.
+                NOISE_REAL GetMaxRadius() const
+                {
+                    return m_maxRadius;
+                }
+
+                /// Returns the smallest minimum distance between two points.
+                NOISE_REAL GetMinRadius() const
+                {
+                    return m_minRadius;
+                }
+
+                /// Returns the seed of the random candidates.
+                int GetSeed() const
+                {
+                    return m_seed;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Places the points.
+                ///
+                /// @param points The vector that receives the points: two values
+                /// ( @a x, @a z ) per point.  Its previous contents are
+                /// discarded.
+                ///
+                /// @pre SetBounds() was previously called.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The points are sorted by cell, row by row.
+                void Place(std::vector<NOISE_REAL>& points) const;
+
+                /// Sets the number of candidate points tried per cell.
+                ///
+                /// @param attemptCount The number of rounds of candidates.
+                ///
+                /// @pre The attempt count is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// More attempts fill the region more densely, up to the point
+                /// where no point can be added.
+                void SetAttemptCount(int attemptCount)
+                {
+                    if (attemptCount <= 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_attemptCount = attemptCount;
+                }
+
+                /// Sets the region where the points are placed.
+                ///
+                /// @param lowerXBound The lower x boundary of the region.
+                /// @param upperXBound The upper x boundary of the region.
+                /// @param lowerZBound The lower z boundary of the region.
+                /// @param upperZBound The upper z boundary of the region.
+                ///
+                /// @pre The lower x boundary is less than the upper x boundary.
+                /// @pre The lower z boundary is less than the upper z boundary.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The modules are evaluated at the coordinates ( @a x, @a z ).
+                void SetBounds(NOISE_REAL lowerXBound, NOISE_REAL upperXBound,
+                    NOISE_REAL lowerZBound, NOISE_REAL upperZBound);
+
+                /// Sets the density module.
+                ///
+                /// @param densityModule The module whose output value, clamped
+                /// to 0 to 1, is the probability that a candidate point is kept.
+                ///
+                /// This object keeps a pointer to the module.
+                void SetDensityModule(const noise::module::Module& densityModule)
+                {
+                    m_pDensityModule = &densityModule;
+                }
+
+                /// Sets a constant minimum distance between the points.
+                ///
+                /// @param radius The minimum distance.
+                ///
+                /// @pre The radius is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Removes the radius module.
+                void SetRadius(NOISE_REAL radius);
+
+                /// Sets a variable minimum distance between the points.
+                ///
+                /// @param radiusModule The module whose output value, clamped
+                /// to the range of radii, is the radius of a point.
+                /// @param minRadius The smallest radius.
+                /// @param maxRadius The largest radius.
+                ///
+                /// @pre The smallest radius is positive, and does not exceed the
+                /// largest radius.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// This object keeps a pointer to the module.  The work per
+                /// candidate grows with the square of the ratio of the radii.
+                void SetRadiusModule(const noise::module::Module& radiusModule,
+                    NOISE_REAL minRadius, NOISE_REAL maxRadius);
+
+                /// Sets the seed of the random candidates.
+                ///
+                /// @param seed The seed.
+                void SetSeed(int seed)
+                {
+                    m_seed = seed;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+            private:
+
+                /// The number of rounds of candidates.
+                int m_attemptCount;
+
+                /// Determines if the bounds were set.
+                bool m_hasBounds;
+
+                /// The bounds of the region.
+                NOISE_REAL m_lowerXBound;
+                NOISE_REAL m_lowerZBound;
+                NOISE_REAL m_upperXBound;
+                NOISE_REAL m_upperZBound;
+
+                /// The range of radii.
+                NOISE_REAL m_maxRadius;
+                NOISE_REAL m_minRadius;
+
+                /// The density module, or @a NULL to keep every point.
+                const noise::module::Module* m_pDensityModule;
+
+                /// The radius module, or @a NULL for a constant radius.
+                const noise::module::Module* m_pRadiusModule;
+
+                /// The seed.
+                int m_seed;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+    }
+
+}
+
+#endif
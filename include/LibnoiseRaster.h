@@ -0,0 +1,209 @@
+// LibnoiseRaster.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_RASTER_H
+#define NOISE_RASTER_H
+
+#include <memory>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Number of points of a row evaluated together by a
+        /// noise::utils::RasterExpression.
+        const int RASTER_ALGEBRA_BLOCK_WIDTH = 256;
+
+        /// An expression over noise maps, evaluated point by point.
+        ///
+        /// A raster expression composites pre-baked layers without going
+        /// back to the noise modules: its leaves are noise maps and
+        /// constants, and its operations are the elementwise operations of
+        /// the combiner and modifier modules (noise::module::Add,
+        /// noise::module::Min, noise::module::ScaleBias,
+        /// noise::module::Curve and so on), plus mask-driven blending and
+        /// selection.  For example:
+        ///
+        /// @code
+        /// RasterExpression ground = RasterExpression(hills).Lerp(mountains,
+        ///     mountainMask);
+        /// (ground * 0.5f + erosion).Clamp(-1.0f, 1.0f).Evaluate(heightMap);
+        /// @endcode
+        ///
+        /// Expressions are immutable and cheap to copy: each operation
+        /// returns a new expression that shares its operands.  An expression
+        /// refers to its noise maps, which must not be destroyed or resized
+        /// before it is evaluated.
+        ///
+        /// <b>Evaluation</b>
+        ///
+        /// Evaluate() compiles the expression into a short program, so the
+        /// whole expression runs in a single pass over the noise maps.  The
+        /// rows are split into blocks of RASTER_ALGEBRA_BLOCK_WIDTH points;
+        /// each operation of the program runs over a block in a simple loop
+        /// that the compiler vectorizes, and the intermediate results stay
+        /// in blocks of scratch space that fit in the first-level cache.  The
+        /// noise maps are read in place, row by row, so any stride is
+        /// supported; the last operation writes its block into the
+        /// destination noise map.  Operations whose operands are all
+        /// constants are computed once, and a subexpression used several
+        /// times is computed once per block.  The rows are processed in
+        /// parallel.
+        class RasterExpression
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// @param value The value of the expression at every point.
+                RasterExpression(float value);
+
+                /// Constructor.
+                ///
+                /// @param layer The noise map whose values the expression
+                /// takes.  It must outlive the evaluation of the expression.
+                RasterExpression(const NoiseMap& layer);
+
+                /// Returns the absolute value of this expression.
+                RasterExpression Abs() const;
+
+                /// Returns this expression clamped to a range.
+                ///
+                /// @param lowerBound The lower bound.
+                /// @param upperBound The upper bound.
+                ///
+                /// @pre The lower bound does not exceed the upper bound.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                RasterExpression Clamp(float lowerBound, float upperBound) const;
+
+                /// Evaluates the expression at every point of a noise map.
+                ///
+                /// @param destNoiseMap The noise map that receives the values.
+                /// It may be one of the noise maps of the expression.
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The noise maps of the expression have the same size.
+                /// @pre If the expression has no noise maps, the destination
+                /// noise map is not empty.
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The destination noise map is resized to the size of the
+                /// noise maps of the expression.  If the expression has no
+                /// noise maps, it keeps its size and is filled with the
+                /// constant value of the expression.
+                void Evaluate(NoiseMap& destNoiseMap, int threadCount = 0) const;
+
+                /// Returns a blend of this expression and another one.
+                ///
+                /// @param other The expression blended in.
+                /// @param mask The weight of @a other, usually between 0
+                /// and 1.
+                ///
+                /// @returns An expression whose value is the value of this
+                /// expression where the mask is 0, the value of @a other where
+                /// the mask is 1, and the linear interpolation of both in
+                /// between.
+                RasterExpression Lerp(const RasterExpression& other,
+                    const RasterExpression& mask) const;
+
+                /// Returns the larger of this expression and another one.
+                RasterExpression Max(const RasterExpression& other) const;
+
+                /// Returns the smaller of this expression and another one.
+                RasterExpression Min(const RasterExpression& other) const;
+
+                /// Returns this expression remapped by a curve.
+                ///
+                /// @param curve The curve module whose control points define
+                /// the mapping.  They are copied.
+                ///
+                /// @pre The curve has at least four control points.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The mapping is the cubic interpolation of
+                /// noise::module::Curve.
+                RasterExpression Remap(const noise::module::Curve& curve) const;
+
+                /// Returns this expression scaled and biased.
+                ///
+                /// @param scale The scaling factor.
+                /// @param bias The bias added after scaling.
+                RasterExpression ScaleBias(float scale, float bias) const;
+
+                /// Returns, at every point, this expression or another one
+                /// depending on a mask.
+                ///
+                /// @param other The expression selected where the mask is at
+                /// or above the threshold.
+                /// @param mask The mask.
+                /// @param threshold The threshold.
+                RasterExpression Select(const RasterExpression& other,
+                    const RasterExpression& mask, float threshold) const;
+
+                friend RasterExpression operator+ (const RasterExpression& lhs,
+                    const RasterExpression& rhs);
+                friend RasterExpression operator- (const RasterExpression& lhs,
+                    const RasterExpression& rhs);
+                friend RasterExpression operator* (const RasterExpression& lhs,
+                    const RasterExpression& rhs);
+
+                /// A node of an expression.  Its layout is private to the
+                /// implementation.
+                struct Node;
+
+            private:
+
+                /// Constructor.
+                ///
+                /// @param pNode The root node of the expression.
+                explicit RasterExpression(
+                    const std::shared_ptr<const Node>& pNode);
+
+                /// The root node of the expression.
+                std::shared_ptr<const Node> m_pNode;
+
+        };
+
+        /// Returns the sum of two expressions.
+        RasterExpression operator+ (const RasterExpression& lhs,
+            const RasterExpression& rhs);
+
+        /// Returns the difference of two expressions.
+        RasterExpression operator- (const RasterExpression& lhs,
+            const RasterExpression& rhs);
+
+        /// Returns the product of two expressions.
+        RasterExpression operator* (const RasterExpression& lhs,
+            const RasterExpression& rhs);
+
+    }
+
+}
+
+#endif
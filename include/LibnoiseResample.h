@@ -0,0 +1,371 @@
+// LibnoiseResample.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_RESAMPLE_H
+#define NOISE_RESAMPLE_H
+
+#include <functional>
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Number of fractional positions between two points for which a
+        /// noise::utils::RasterResampler precomputes the filter weights.
+        const int RESAMPLE_PHASE_COUNT = 256;
+
+        /// Largest number of source points, along each axis, that a
+        /// noise::utils::RasterResampler weighs for a destination point of a
+        /// non-separable mapping.
+        const int RESAMPLE_MAX_TAP_COUNT = 32;
+
+        /// Filters of a noise::utils::RasterResampler.
+        enum ResampleFilter
+        {
+
+            /// Linear interpolation between the two nearest points along each
+            /// axis.
+            RESAMPLE_FILTER_BILINEAR = 0,
+
+            /// Cubic convolution (Catmull-Rom) over the four nearest points
+            /// along each axis.
+            RESAMPLE_FILTER_BICUBIC = 1,
+
+            /// Three-lobed Lanczos window over the six nearest points along
+            /// each axis.
+            RESAMPLE_FILTER_LANCZOS = 2
+
+        };
+
+        /// Faces of a cube map.
+        ///
+        /// The faces follow the layout of OpenGL cube maps: the direction of
+        /// a face is an axis of the sphere of noise::LatLonToXYZ(), whose
+        /// @a y axis points to the north pole.
+        enum CubeFace
+        {
+            CUBE_FACE_POSITIVE_X = 0,
+            CUBE_FACE_NEGATIVE_X = 1,
+            CUBE_FACE_POSITIVE_Y = 2,
+            CUBE_FACE_NEGATIVE_Y = 3,
+            CUBE_FACE_POSITIVE_Z = 4,
+            CUBE_FACE_NEGATIVE_Z = 5
+        };
+
+        /// Transforms noise maps into another projection or resolution.
+        ///
+        /// A resampler is set up with a <i>mapping</i>, which gives, for each
+        /// point of the destination noise map, its position in the source
+        /// noise map:
+        ///
+        /// - SetResizeMapping() scales a noise map to another size, for
+        ///   example for a preview.
+        /// - SetAffineMapping() scales, rotates and translates a noise map.
+        /// - SetCubeFaceMapping() projects an equirectangular planet map onto
+        ///   a face of a cube map.
+        /// - SetPolarMapping() projects a polar cap of an equirectangular
+        ///   planet map with the polar stereographic projection.
+        ///
+        /// An equirectangular map covers longitudes -180 to +180 from left to
+        /// right, and latitudes -90 to +90 from its first row to its last row
+        /// (noise maps store their rows from bottom to top).  Positions past
+        /// its left and right edges wrap around, and positions past a pole
+        /// continue on the other side of the pole.
+        ///
+        /// The mapping is computed once, into a table of source positions and
+        /// filter phases, so Resample() can transform any number of noise maps
+        /// of the same size (height, moisture and so on) at the cost of the
+        /// filtering alone.
+        ///
+        /// <b>Filtering</b>
+        ///
+        /// The value of a destination point is the sum of the nearby source
+        /// points weighed by the filter (see SetFilter()).  Where the mapping
+        /// shrinks the source noise map, the filter is widened by the same
+        /// factor, so downscaling averages the source points instead of
+        /// aliasing.  The factor of SetResizeMapping() is exact; the other
+        /// mappings take the factor at the center of the destination noise
+        /// map, and widen the filter to at most RESAMPLE_MAX_TAP_COUNT points.
+        /// The weights are precomputed for RESAMPLE_PHASE_COUNT fractional
+        /// positions between two source points.
+        ///
+        /// SetResizeMapping() filters the rows then the columns, and the
+        /// column pass runs over whole rows so that the compiler vectorizes
+        /// it.  The rows of the destination noise map are processed in
+        /// parallel.
+        class RasterResampler
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The filter is RESAMPLE_FILTER_BILINEAR.  No mapping is set.
+                RasterResampler();
+
+                /// Returns the filter.
+                ResampleFilter GetFilter() const
+                {
+                    return m_filter;
+                }
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Transforms a noise map.
+                ///
+                /// @param sourceNoiseMap The source noise map.
+                /// @param destNoiseMap The noise map that receives the result.
+                /// It is resized to the destination size of the mapping.
+                ///
+                /// @pre A mapping was set.
+                /// @pre The source noise map has the source size of the
+                /// mapping.
+                /// @pre The destination noise map is not the source noise map.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                void Resample(const NoiseMap& sourceNoiseMap,
+                    NoiseMap& destNoiseMap) const;
+
+                /// Maps the destination noise map through an affine transform.
+                ///
+                /// @param sourceWidth The width of the source noise maps.
+                /// @param sourceHeight The height of the source noise maps.
+                /// @param destWidth The width of the destination noise maps.
+                /// @param destHeight The height of the destination noise maps.
+                /// @param pMatrix The six coefficients of the transform, row by
+                /// row: the point ( @a x, @a y ) of the destination noise map
+                /// takes the value at ( @a pMatrix[0] * @a x + @a pMatrix[1] *
+                /// @a y + @a pMatrix[2], @a pMatrix[3] * @a x + @a pMatrix[4] *
+                /// @a y + @a pMatrix[5] ) in the source noise map.
+                ///
+                /// @pre The sizes are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// Positions outside of the source noise map take its border
+                /// value.
+                void SetAffineMapping(int sourceWidth, int sourceHeight,
+                    int destWidth, int destHeight, const double* pMatrix);
+
+                /// Maps a face of a cube map onto an equirectangular map.
+                ///
+                /// @param sourceWidth The width of the equirectangular maps.
+                /// @param sourceHeight The height of the equirectangular maps.
+                /// @param face The face.
+                /// @param faceSize The width and height of the destination noise
+                /// maps.
+                ///
+                /// @pre The sizes are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The first row of the face is its bottom edge, as seen from
+                /// the center of the cube with the OpenGL orientation of the
+                /// face.
+                void SetCubeFaceMapping(int sourceWidth, int sourceHeight,
+                    CubeFace face, int faceSize);
+
+                /// Sets the filter.
+                ///
+                /// @param filter The filter.
+                void SetFilter(ResampleFilter filter);
+
+                /// Maps a polar cap onto an equirectangular map, with the polar
+                /// stereographic projection.
+                ///
+                /// @param sourceWidth The width of the equirectangular maps.
+                /// @param sourceHeight The height of the equirectangular maps.
+                /// @param destSize The width and height of the destination noise
+                /// maps.
+                /// @param isNorth @a true for the north polar cap, @a false for
+                /// the south polar cap.
+                /// @param boundLatitude The latitude, in degrees, of the circle
+                /// inscribed in the destination noise maps.
+                ///
+                /// @pre The sizes are positive.
+                /// @pre The bound latitude is between 0 and 90 for the north
+                /// polar cap, and between -90 and 0 for the south polar cap,
+                /// both excluded.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The pole is at the center of the destination noise maps.
+                /// Longitude 0 points to the right, and longitude 90 points up
+                /// for the north polar cap and down for the south polar cap, so
+                /// both caps are seen from above the pole.
+                void SetPolarMapping(int sourceWidth, int sourceHeight,
+                    int destSize, bool isNorth, double boundLatitude);
+
+                /// Scales noise maps to another size.
+                ///
+                /// @param sourceWidth The width of the source noise maps.
+                /// @param sourceHeight The height of the source noise maps.
+                /// @param destWidth The width of the destination noise maps.
+                /// @param destHeight The height of the destination noise maps.
+                ///
+                /// @pre The sizes are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The edges of the noise maps are aligned, and positions past
+                /// the edges take the value of the nearest edge point.
+                void SetResizeMapping(int sourceWidth, int sourceHeight,
+                    int destWidth, int destHeight);
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+            private:
+
+                /// What a position past an edge of the source noise map takes.
+                enum EdgeMode
+                {
+                    /// The border value of the source noise map.
+                    EDGE_BORDER,
+
+                    /// The value of the nearest edge point.
+                    EDGE_CLAMP,
+
+                    /// The value at the other edge.
+                    EDGE_WRAP,
+
+                    /// The value on the other side of the pole.
+                    EDGE_POLE
+                };
+
+                /// The position of a destination point in the source noise map.
+                struct SourcePosition
+                {
+                    /// The integer part of the coordinates.
+                    int x;
+                    int y;
+
+                    /// The fractional part of the coordinates, in phases of the
+                    /// filter weights.
+                    int phaseX;
+                    int phaseY;
+                };
+
+                /// The kinds of mapping.
+                enum MappingKind
+                {
+                    MAPPING_NONE,
+                    MAPPING_RESIZE,
+                    MAPPING_TABLE
+                };
+
+                /// Builds the table of a non-separable mapping.
+                ///
+                /// @param sourceWidth The width of the source noise maps.
+                /// @param sourceHeight The height of the source noise maps.
+                /// @param destWidth The width of the destination noise maps.
+                /// @param destHeight The height of the destination noise maps.
+                /// @param scaleX The factor by which the mapping shrinks the
+                /// source noise maps horizontally, at the center.
+                /// @param scaleY The same factor, vertically.
+                /// @param fGetPosition Receives the coordinates of a
+                /// destination point and returns its source coordinates, in
+                /// points.
+                void BuildTable(int sourceWidth, int sourceHeight,
+                    int destWidth, int destHeight, double scaleX, double scaleY,
+                    const std::function<void(int, int, double&, double&)>&
+                        fGetPosition);
+
+                /// Computes the filter weights for the filter and the scales of
+                /// the mapping.
+                void BuildWeights();
+
+                /// The size of the destination noise maps.
+                int m_destHeight;
+                int m_destWidth;
+
+                /// The edge modes of the source noise map.
+                EdgeMode m_edgeModeX;
+                EdgeMode m_edgeModeY;
+
+                /// The filter.
+                ResampleFilter m_filter;
+
+                /// The kind of the current mapping.
+                MappingKind m_mappingKind;
+
+                /// The source positions of the destination points of a table
+                /// mapping, row by row.
+                std::vector<SourcePosition> m_positions;
+
+                /// The source positions of the destination columns (@a x) and
+                /// rows (@a y) of a resize mapping.
+                std::vector<SourcePosition> m_resizeColumns;
+                std::vector<SourcePosition> m_resizeRows;
+
+                /// The factors by which the mapping shrinks the source noise
+                /// maps.
+                double m_scaleX;
+                double m_scaleY;
+
+                /// The size of the source noise maps.
+                int m_sourceHeight;
+                int m_sourceWidth;
+
+                /// The numbers of source points weighed along each axis.
+                int m_tapCountX;
+                int m_tapCountY;
+
+                /// The number of workers.
+                int m_threadCount;
+
+                /// The weights of the source points along each axis, by phase.
+                std::vector<float> m_weightsX;
+                std::vector<float> m_weightsY;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,329 @@
+// LibnoiseSharedCache.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_SHAREDCACHE_H
+#define NOISE_SHAREDCACHE_H
+
+#include <functional>
+#include <stddef.h>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Maximum number of cache objects, over all processes, attached to
+        /// the same shared tile cache.
+        const int SHARED_TILE_CACHE_MAX_PROCESSES = 64;
+
+        /// Maximum number of tiles that one cache object holds at the same
+        /// time.
+        const int SHARED_TILE_CACHE_MAX_HELD_TILES = 64;
+
+        class SharedTileCache;
+
+        /// A tile held from a noise::utils::SharedTileCache.
+        ///
+        /// The tile is read in place, in the shared-memory segment of the
+        /// cache; it is not evicted while this object holds it.  The tile is
+        /// released by Release(), by the destructor, or by passing this object
+        /// to SharedTileCache::Find() again.
+        class SharedTile
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// Creates an object that does not hold a tile.
+                SharedTile();
+
+                /// Destructor.
+                ///
+                /// Releases the tile.
+                ~SharedTile()
+                {
+                    Release();
+                }
+
+                /// Returns a pointer to the values of the tile.
+                ///
+                /// @returns The values, row by row, or @a NULL if this object
+                /// does not hold a tile.
+                ///
+                /// Consecutive rows are GetWidth() values apart.
+                const float* GetData() const
+                {
+                    return m_pData;
+                }
+
+                /// Returns the height of the tile, in points.
+                int GetHeight() const
+                {
+                    return m_height;
+                }
+
+                /// Returns the key of the tile.
+                uint64 GetKey() const
+                {
+                    return m_key;
+                }
+
+                /// Returns the width of the tile, in points.
+                int GetWidth() const
+                {
+                    return m_width;
+                }
+
+                /// Determines if this object holds a tile.
+                bool IsHeld() const
+                {
+                    return m_pData != NULL;
+                }
+
+                /// Releases the tile.
+                ///
+                /// The values of the tile must not be read anymore.
+                void Release();
+
+            private:
+
+                friend class SharedTileCache;
+
+                /// Copy constructor.  Held tiles cannot be copied.
+                SharedTile(const SharedTile&);
+
+                /// Assignment operator.  Held tiles cannot be copied.
+                SharedTile& operator= (const SharedTile&);
+
+                /// The cache object that holds the tile.
+                SharedTileCache* m_pCache;
+
+                /// The values of the tile.
+                const float* m_pData;
+
+                /// The height of the tile.
+                int m_height;
+
+                /// The index of the hold in the table of the cache object.
+                int m_holdIndex;
+
+                /// The key of the tile.
+                uint64 m_key;
+
+                /// The width of the tile.
+                int m_width;
+
+        };
+
+        /// A cache of noise-map tiles shared by the processes of a host.
+        ///
+        /// The tiles live in a POSIX shared-memory segment, so every process
+        /// that opens the cache under the same name reads the tiles built by
+        /// the others, without copies, and the host keeps one copy of each
+        /// tile.  Tiles are identified by a 64-bit key chosen by the
+        /// application, for example a hash of the noise-module graph and of
+        /// the tile bounds.  All tiles of a cache have the same size.
+        ///
+        /// <b>Layout</b>
+        ///
+        /// The segment holds a fixed number of tile slots and a hash index
+        /// of chained buckets.  The buckets are split over a set of stripes,
+        /// each protected by its own mutex, so lookups of different tiles
+        /// rarely contend.  A tile is written into a slot that is not in the
+        /// index yet, and is linked into the index once complete; readers
+        /// never see a partial tile.  When no slot is free, a clock sweep
+        /// over the slots evicts a tile that was neither read nor written
+        /// since the previous sweep (an approximation of least recently used
+        /// that does not touch shared state on a hit beyond one flag), and
+        /// that no process holds.
+        ///
+        /// <b>Crashes</b>
+        ///
+        /// The mutexes are process-shared robust mutexes.  If a process dies
+        /// while holding one, the next process that takes it rebuilds the
+        /// data the mutex protects from the slot states, which are always
+        /// consistent.  Every attached cache object has an entry in the
+        /// segment that records its process ID and the tiles it holds, and
+        /// every slot being written records the entry of its writer.  When a
+        /// slot is needed and none is free, or when a cache object attaches,
+        /// the entries of dead processes are reclaimed: their partial tiles
+        /// are freed and their holds dropped.
+        ///
+        /// The methods of this class are thread-safe.  The cache needs POSIX
+        /// shared memory and robust mutexes, so it is only compiled into the
+        /// library on Unix systems other than macOS; it is not available on
+        /// macOS or Windows.
+        class SharedTileCache
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// Opens the shared tile cache of this name, or creates it if it
+                /// does not exist.
+                ///
+                /// @param name The name of the shared-memory object, starting
+                /// with a slash.
+                /// @param tileWidth The width of the tiles, in points.
+                /// @param tileHeight The height of the tiles, in points.
+                /// @param slotCount The number of tiles the cache holds.
+                ///
+                /// @pre The name starts with a slash.
+                /// @pre The tile size and the slot count are positive.
+                /// @pre If the cache exists, it was created with the same tile
+                /// size and slot count.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Too many cache objects
+                /// are attached to the cache.
+                /// @throw noise::ExceptionUnknown The shared-memory segment
+                /// could not be created or mapped.
+                SharedTileCache(const char* name, int tileWidth, int tileHeight,
+                    int slotCount);
+
+                /// Destructor.
+                ///
+                /// Detaches from the cache.  The cache, and its tiles, remain
+                /// until Unlink() is called and every process has detached.
+                ///
+                /// @pre This object holds no tile.
+                ~SharedTileCache();
+
+                /// Looks up a tile.
+                ///
+                /// @param key The key of the tile.
+                /// @param tile The object that receives the tile.  It releases
+                /// the tile it held, if any.
+                ///
+                /// @returns
+                /// - @a true if the tile is in the cache; @a tile then holds it.
+                /// - @a false otherwise.
+                ///
+                /// @pre This object holds fewer than
+                /// SHARED_TILE_CACHE_MAX_HELD_TILES tiles, counting the tile
+                /// released from @a tile.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                bool Find(uint64 key, SharedTile& tile);
+
+                /// Returns the number of tiles the cache holds.
+                int GetSlotCount() const
+                {
+                    return m_slotCount;
+                }
+
+                /// Returns the height of the tiles, in points.
+                int GetTileHeight() const
+                {
+                    return m_tileHeight;
+                }
+
+                /// Returns the width of the tiles, in points.
+                int GetTileWidth() const
+                {
+                    return m_tileWidth;
+                }
+
+                /// Adds a tile to the cache.
+                ///
+                /// @param key The key of the tile.
+                /// @param fFill Writes the values of the tile, row by row, to the
+                /// pointer it receives; consecutive rows are GetTileWidth()
+                /// values apart.
+                ///
+                /// @returns
+                /// - @a true if the tile was added.
+                /// - @a false if the cache already holds a tile with this key,
+                ///   or if every tile is held and none can be evicted.
+                ///
+                /// The tile is written in place, in the shared-memory segment,
+                /// and becomes visible to the other processes when @a fFill
+                /// returns.  If @a fFill throws an exception, the slot is freed
+                /// and the exception is propagated.
+                bool Insert(uint64 key, const std::function<void(float*)>& fFill);
+
+                /// Adds a tile to the cache.
+                ///
+                /// @param key The key of the tile.
+                /// @param tileMap The tile.
+                ///
+                /// @returns See the other overload.
+                ///
+                /// @pre The noise map has the size of the tiles.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                bool Insert(uint64 key, const NoiseMap& tileMap);
+
+                /// Removes a shared tile cache.
+                ///
+                /// @param name The name of the cache.
+                ///
+                /// The name becomes free at once; the segment is destroyed when
+                /// the last process detaches from it.
+                static void Unlink(const char* name);
+
+            private:
+
+                friend class SharedTile;
+
+                /// Copy constructor.  Caches cannot be copied.
+                SharedTileCache(const SharedTileCache&);
+
+                /// Assignment operator.  Caches cannot be copied.
+                SharedTileCache& operator= (const SharedTileCache&);
+
+                /// Takes a free slot, evicting a tile if needed.
+                ///
+                /// @returns The index of the slot, or -1 if no slot can be freed.
+                int ClaimSlot();
+
+                /// Releases a held tile.
+                ///
+                /// @param holdIndex The index of the hold.
+                void ReleaseHold(int holdIndex);
+
+                /// The base address of the shared-memory segment.
+                unsigned char* m_pSegment;
+
+                /// The size of the shared-memory segment, in bytes.
+                size_t m_segmentSize;
+
+                /// The index of the entry of this object in the segment.
+                int m_processIndex;
+
+                /// The number of slots.
+                int m_slotCount;
+
+                /// The height of the tiles.
+                int m_tileHeight;
+
+                /// The width of the tiles.
+                int m_tileWidth;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,357 @@
+// LibnoiseTileCache.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_TILECACHE_H
+#define NOISE_TILECACHE_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+#include "LibnoiseMemory.h"
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default number of decompressed tiles kept by a
+        /// noise::utils::TileCache.
+        const int DEFAULT_TILE_CACHE_HOT_TILE_COUNT = 8;
+
+        /// Counters of a noise::utils::TileCache.
+        struct TileCacheStats
+        {
+            /// The number of lookups that found their tile.
+            uint64 hitCount;
+
+            /// The number of those lookups served by a decompressed tile.
+            uint64 hotHitCount;
+
+            /// The number of lookups that did not find their tile.
+            uint64 missCount;
+
+            /// The number of tiles in the cache.
+            int tileCount;
+
+            /// The number of decompressed copies of compressed tiles.
+            int hotTileCount;
+
+            /// The number of bytes held by the tiles, without their
+            /// decompressed copies.
+            size_t storedBytes;
+
+            /// The number of bytes held by the decompressed copies.
+            size_t hotBytes;
+        };
+
+        /// A cache of noise-map tiles in the memory of the process.
+        ///
+        /// Tiles are identified by a 64-bit key chosen by the application,
+        /// for example a hash of the noise-module graph and of the tile
+        /// bounds.  All tiles of a cache have the same size.  The cache holds
+        /// at most GetCapacity() bytes and evicts the least recently used
+        /// tiles beyond that.  Its memory is reserved in the
+        /// noise::utils::MEMORY_CACHE category, and the cache gives memory
+        /// back when the memory budget is exhausted.
+        ///
+        /// <b>Compression</b>
+        ///
+        /// Once EnableCompression() is called, the tiles inserted are stored
+        /// compressed, losslessly.  The float values are mapped to integers
+        /// that keep their order, predicted from their left, upper and
+        /// upper-left neighbours, and the prediction residuals are split
+        /// into bit planes and packed by a byte-oriented LZ77 coder.
+        /// Coherent noise is smooth, so the high bit planes of the residuals
+        /// are nearly all zero and collapse into long matches.  A tile that
+        /// does not shrink is stored as is.
+        ///
+        /// Decompression is a copy loop, a bit transpose and a running sum,
+        /// and runs outside
+        /// the lock of the cache.  The last SetHotTileCount() tiles found in
+        /// compressed form keep a decompressed copy, which the next lookups
+        /// read directly; the copies count against the capacity, and are the
+        /// first memory given back.
+        ///
+        /// The methods of this class are thread-safe.
+        class TileCache: public MemoryReclaimer
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// @param tileWidth The width of the tiles, in points.
+                /// @param tileHeight The height of the tiles, in points.
+                /// @param capacity The largest number of bytes the cache holds.
+                ///
+                /// @pre The tile size and the capacity are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Compression is disabled.  The default number of hot tiles is
+                /// DEFAULT_TILE_CACHE_HOT_TILE_COUNT.
+                TileCache(int tileWidth, int tileHeight, size_t capacity);
+
+                /// Destructor.
+                ///
+                /// Releases the memory of the tiles.
+                virtual ~TileCache();
+
+                /// Removes every tile from the cache.
+                void Clear();
+
+                /// Enables or disables the compression of the tiles inserted
+                /// from now on.
+                ///
+                /// @param enable Specifies whether the tiles are compressed.
+                ///
+                /// The tiles already in the cache keep their form.
+                void EnableCompression(bool enable = true)
+                {
+                    m_isCompressionEnabled = enable;
+                }
+
+                /// Looks up a tile.
+                ///
+                /// @param key The key of the tile.
+                /// @param pDest The values of the tile, row by row.
+                /// @param destStride The distance, in values, between two rows of
+                /// @a pDest.
+                ///
+                /// @returns
+                /// - @a true if the tile is in the cache; @a pDest then holds
+                ///   its values.
+                /// - @a false otherwise.
+                ///
+                /// @pre The stride is at least the width of the tiles.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory for the
+                /// scratch space of the decompression.
+                bool Find(uint64 key, float* pDest, int destStride);
+
+                /// Looks up a tile.
+                ///
+                /// @param key The key of the tile.
+                /// @param tileMap The noise map that receives the tile.  It is
+                /// resized to the size of the tiles.
+                ///
+                /// @returns See the other overload.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                bool Find(uint64 key, NoiseMap& tileMap);
+
+                /// Returns the largest number of bytes the cache holds.
+                size_t GetCapacity() const
+                {
+                    return m_capacity;
+                }
+
+                /// Returns the number of decompressed tiles the cache keeps.
+                int GetHotTileCount() const
+                {
+                    return m_hotTileCount;
+                }
+
+                /// Returns the counters of the cache.
+                TileCacheStats GetStats() const;
+
+                /// Returns the height of the tiles, in points.
+                int GetTileHeight() const
+                {
+                    return m_tileHeight;
+                }
+
+                /// Returns the width of the tiles, in points.
+                int GetTileWidth() const
+                {
+                    return m_tileWidth;
+                }
+
+                /// Adds a tile to the cache.
+                ///
+                /// @param key The key of the tile.
+                /// @param pValues The values of the tile, row by row.
+                /// @param stride The distance, in values, between two rows of
+                /// @a pValues.
+                ///
+                /// @returns
+                /// - @a true if the tile was added.
+                /// - @a false if the cache already holds a tile with this key,
+                ///   or if the memory budget or the capacity leaves no room
+                ///   for the tile.
+                ///
+                /// @pre The stride is at least the width of the tiles.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory for the
+                /// scratch space of the compression.
+                bool Insert(uint64 key, const float* pValues, int stride);
+
+                /// Adds a tile to the cache.
+                ///
+                /// @param key The key of the tile.
+                /// @param tileMap The tile.
+                ///
+                /// @returns See the other overload.
+                ///
+                /// @pre The noise map has the size of the tiles.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                bool Insert(uint64 key, const NoiseMap& tileMap);
+
+                /// Determines if the tiles inserted are compressed.
+                bool IsCompressionEnabled() const
+                {
+                    return m_isCompressionEnabled;
+                }
+
+                /// Releases memory when the memory budget is exhausted.
+                ///
+                /// The decompressed copies go first, then the least recently
+                /// used tiles.
+                virtual size_t ReclaimMemory(size_t bytes);
+
+                /// Sets the largest number of bytes the cache holds.
+                ///
+                /// @param capacity The capacity, in bytes.
+                ///
+                /// @pre The capacity is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// Tiles are evicted at once if the cache holds more.
+                void SetCapacity(size_t capacity);
+
+                /// Sets the number of decompressed tiles the cache keeps.
+                ///
+                /// @param hotTileCount The number of tiles, or zero to
+                /// decompress every lookup of a compressed tile.
+                ///
+                /// @pre The number of tiles is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetHotTileCount(int hotTileCount);
+
+            private:
+
+                /// A tile of the cache.
+                struct Entry
+                {
+                    /// The compressed tile, or @a NULL if the tile is stored
+                    /// as is.
+                    std::shared_ptr<const std::vector<uint8> > pPacked;
+
+                    /// The values of the tile: the tile itself, or the
+                    /// decompressed copy of a compressed tile.
+                    std::shared_ptr<const std::vector<float> > pValues;
+
+                    /// The position of the tile in the recency list.
+                    std::list<uint64>::iterator recentPos;
+
+                    /// The position of the decompressed copy in the hot list.
+                    std::list<uint64>::iterator hotPos;
+                };
+
+                /// Copy constructor.  Caches cannot be copied.
+                TileCache(const TileCache&);
+
+                /// Assignment operator.  Caches cannot be copied.
+                TileCache& operator= (const TileCache&);
+
+                /// Drops the least recently used decompressed copy.
+                ///
+                /// @returns The number of bytes to release.
+                ///
+                /// @pre The lock is held and the hot list is not empty.
+                size_t DropHotTile();
+
+                /// Evicts entries until the cache holds at most its capacity,
+                /// decompressed copies first.
+                ///
+                /// @param bytes The number of bytes to add to the cache.
+                ///
+                /// @returns The number of bytes to release.
+                ///
+                /// @pre The lock is held.
+                size_t Evict(size_t bytes);
+
+                /// Evicts the least recently used tile.
+                ///
+                /// @returns The number of bytes to release.
+                ///
+                /// @pre The lock is held and the cache is not empty.
+                size_t EvictTile();
+
+                /// The largest number of bytes held.
+                size_t m_capacity;
+
+                /// The tiles, by key.
+                std::unordered_map<uint64, Entry> m_entries;
+
+                /// The number of lookups that found their tile.
+                uint64 m_hitCount;
+
+                /// The number of bytes held by the decompressed copies.
+                size_t m_hotBytes;
+
+                /// The number of lookups served by a decompressed copy.
+                uint64 m_hotHitCount;
+
+                /// The keys of the decompressed copies, most recent first.
+                std::list<uint64> m_hotKeys;
+
+                /// The number of decompressed copies kept.
+                int m_hotTileCount;
+
+                /// Specifies whether inserted tiles are compressed.
+                std::atomic<bool> m_isCompressionEnabled;
+
+                /// The number of lookups that did not find their tile.
+                uint64 m_missCount;
+
+                /// Protects the entries, the lists and the counters.
+                mutable std::mutex m_mutex;
+
+                /// The keys of the tiles, most recently used first.
+                std::list<uint64> m_recentKeys;
+
+                /// The number of bytes held by the tiles.
+                size_t m_storedBytes;
+
+                /// The height of the tiles.
+                int m_tileHeight;
+
+                /// The width of the tiles.
+                int m_tileWidth;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,453 @@
+// LibnoiseTileReader.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_TILEREADER_H
+#define NOISE_TILEREADER_H
+
+#include <vector>
+
+#include "LibnoiseCodec.h"
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default number of reads a noise::utils::TileFileReader keeps in
+        /// flight.
+        const int DEFAULT_TILE_READ_QUEUE_DEPTH = 32;
+
+        /// Default number of tiles noise::utils::TileFileReader::ReadTile()
+        /// reads ahead of the consumer.
+        const int DEFAULT_TILE_READ_PREFETCH_COUNT = 8;
+
+        /// Maximum number of reads a noise::utils::TileFileReader keeps in
+        /// flight.
+        const int TILE_READ_MAX_QUEUE_DEPTH = 4096;
+
+        /// How a noise::utils::TileFileReader issues its reads.
+        enum TileReadMethod
+        {
+
+            /// The reads are queued to the kernel through an io_uring
+            /// instance (Linux 5.6 and later).
+            TILE_READ_IO_URING = 0,
+
+            /// The reads are blocking reads run by a pool of threads.
+            TILE_READ_THREAD_POOL = 1
+
+        };
+
+        class TileReadQueue;
+
+        /// Reads a compressed height map from a file.
+        ///
+        /// The file holds a stream written by HeightMapEncoder::Encode(), as
+        /// is.  Its header and its tile offsets are read once by Open(); the
+        /// tiles are then read on demand, with many reads in flight at once,
+        /// and decoded straight into the destination: Read() streams the
+        /// whole height map into a noise map, and ReadTile() reads single
+        /// tiles into any buffer, such as a slab of a noise map (see
+        /// NoiseMap::GetSlabPtr()).
+        ///
+        /// <b>Asynchronous reads</b>
+        ///
+        /// The reads are queued to the kernel through io_uring, which keeps
+        /// GetQueueDepth() reads in flight with one system call per batch of
+        /// reads.  Where io_uring is not available (older kernels, or a
+        /// sandbox that forbids it), the reads are blocking reads run by a
+        /// pool of threads, one per read in flight; GetMethod() returns the
+        /// method in use.  Read() decodes the tiles on the thread count set
+        /// by SetThreadCount() while the next tiles are read, so the decoding
+        /// overlaps with the reads.
+        ///
+        /// <b>Direct I/O</b>
+        ///
+        /// With EnableDirectIO(), the file is opened with @a O_DIRECT, so the
+        /// tiles are read from the device into aligned buffers without going
+        /// through the page cache: large height maps read once do not evict
+        /// the rest of the page cache, and the reads cost less CPU.  Every
+        /// read then covers whole blocks of 4096 bytes around its tile.  If
+        /// the file system does not support direct I/O, the file is read
+        /// through the page cache; IsDirectIOEnabled() returns the mode in
+        /// use.
+        ///
+        /// <b>Prefetching</b>
+        ///
+        /// ReadTile() follows the access pattern of the consumer: the
+        /// distance, in tiles, between two consecutive requests becomes the
+        /// predicted stride once two consecutive requests agree, and the next
+        /// GetPrefetchCount() tiles along that stride are read ahead and kept
+        /// until they are requested.  Before any pattern is known, the
+        /// predicted stride is one tile, for row-by-row scans.
+        ///
+        /// The methods of this class are not thread-safe.  The reader uses
+        /// POSIX file I/O, so it is only compiled into the library on Unix
+        /// systems; it is not available on Windows.
+        class TileFileReader
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// The method is TILE_READ_IO_URING, direct I/O is disabled,
+                /// the queue depth is DEFAULT_TILE_READ_QUEUE_DEPTH and the
+                /// prefetch count is DEFAULT_TILE_READ_PREFETCH_COUNT.
+                TileFileReader();
+
+                /// Destructor.
+                ///
+                /// Closes the file.
+                ~TileFileReader();
+
+                /// Closes the file.
+                ///
+                /// Waits for the reads in flight, then frees the buffers.
+                void Close();
+
+                /// Enables or disables direct I/O.
+                ///
+                /// @param enable Specifies whether direct I/O is enabled.
+                ///
+                /// The setting takes effect at the next call to Open().
+                void EnableDirectIO(bool enable = true)
+                {
+                    m_isDirectIORequested = enable;
+                }
+
+                /// Returns the decoder of the file, which gives the size of
+                /// the height map and the layout of its tiles.
+                ///
+                /// @pre A file is open.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                const HeightMapDecoder& GetDecoder() const
+                {
+                    if (m_pDecoder == NULL)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    return *m_pDecoder;
+                }
+
+                /// Returns the method of the reads.
+                ///
+                /// Open() replaces TILE_READ_IO_URING with
+                /// TILE_READ_THREAD_POOL if io_uring is not available.
+                TileReadMethod GetMethod() const
+                {
+                    return m_method;
+                }
+
+                /// Returns the number of tiles ReadTile() reads ahead.
+                int GetPrefetchCount() const
+                {
+                    return m_prefetchCount;
+                }
+
+                /// Returns the number of reads kept in flight.
+                int GetQueueDepth() const
+                {
+                    return m_queueDepth;
+                }
+
+                /// Returns the number of workers Read() decodes on, or zero to
+                /// use the concurrency of the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Determines if the open file is read with direct I/O.
+                bool IsDirectIOEnabled() const
+                {
+                    return m_isDirectIO;
+                }
+
+                /// Determines if a file is open.
+                bool IsOpen() const
+                {
+                    return m_fd >= 0;
+                }
+
+                /// Opens a file.
+                ///
+                /// @param pFileName The name of the file.
+                ///
+                /// @pre The file name is not @a NULL.
+                /// @pre The file holds a stream written by
+                /// HeightMapEncoder::Encode().
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                /// @throw noise::ExceptionUnknown The file cannot be opened or
+                /// read.
+                ///
+                /// Closes the previous file.  Reads the header and the tile
+                /// offsets, and sets up the queue of reads with the method,
+                /// the queue depth and the direct I/O setting requested.
+                void Open(const char* pFileName);
+
+                /// Reads the whole height map.
+                ///
+                /// @param heightMap The noise map that receives the height map.
+                ///
+                /// @pre A file is open.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                /// @throw noise::ExceptionUnknown The file cannot be read.  If
+                /// the queue of reads itself failed, the file is closed.
+                ///
+                /// The tiles are read in the order of the file, with as many
+                /// reads in flight as the queue depth at Open(), and decoded
+                /// as they arrive.
+                void Read(NoiseMap& heightMap);
+
+                /// Reads a tile.
+                ///
+                /// @param tileX The column of the tile.
+                /// @param tileZ The row of the tile.
+                /// @param pDest The values of the tile, row by row.
+                /// @param destStride The distance, in values, between two rows of
+                /// @a pDest.
+                ///
+                /// @pre A file is open.
+                /// @pre The tile exists.
+                /// @pre The stride is at least the width of the tile.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                /// @throw noise::ExceptionUnknown The file cannot be read.
+                ///
+                /// Reads ahead the tiles the consumer is predicted to request
+                /// next, at most one less than the queue depth at Open().
+                void ReadTile(int tileX, int tileZ, float* pDest,
+                    int destStride);
+
+                /// Sets the method of the reads.
+                ///
+                /// @param method The method.
+                ///
+                /// The setting takes effect at the next call to Open().
+                void SetMethod(TileReadMethod method)
+                {
+                    m_method = method;
+                }
+
+                /// Sets the number of tiles ReadTile() reads ahead.
+                ///
+                /// @param prefetchCount The number of tiles, or zero to disable
+                /// prefetching.
+                ///
+                /// @pre The prefetch count is not negative, and is less than the
+                /// queue depth.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetPrefetchCount(int prefetchCount);
+
+                /// Sets the number of reads kept in flight.
+                ///
+                /// @param queueDepth The number of reads.
+                ///
+                /// @pre The queue depth is positive, and does not exceed
+                /// TILE_READ_MAX_QUEUE_DEPTH.
+                /// @pre The queue depth is greater than the prefetch count.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The setting takes effect at the next call to Open().  Fast
+                /// devices need many reads in flight to reach their
+                /// throughput.
+                void SetQueueDepth(int queueDepth);
+
+                /// Sets the number of workers Read() decodes on.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+            private:
+
+                /// A read of a tile into a buffer.
+                struct TileRead
+                {
+                    /// Constructor.
+                    TileRead():
+                        pBuffer(NULL),
+                        capacity(0),
+                        dataOffset(0),
+                        doneSize(0),
+                        error(0),
+                        fileOffset(0),
+                        isPending(false),
+                        readSize(0),
+                        requiredSize(0),
+                        tileIndex(-1),
+                        useStamp(0)
+                    {
+                    }
+
+                    /// The buffer, aligned for direct I/O.
+                    uint8* pBuffer;
+
+                    /// The size of the buffer, in bytes.
+                    size_t capacity;
+
+                    /// The offset in the buffer of the first byte of the tile.
+                    size_t dataOffset;
+
+                    /// The number of bytes already read.
+                    size_t doneSize;
+
+                    /// The error of the read, as a negative @a errno value, or
+                    /// zero.
+                    int error;
+
+                    /// The offset in the file of the first byte read.
+                    uint64 fileOffset;
+
+                    /// Determines if the read is in flight.
+                    bool isPending;
+
+                    /// The number of bytes to read.
+                    size_t readSize;
+
+                    /// The number of bytes that must be read to hold the tile.
+                    size_t requiredSize;
+
+                    /// The index of the tile, or -1.
+                    int tileIndex;
+
+                    /// The number of the request that last used the tile.
+                    uint64 useStamp;
+                };
+
+                /// Copy constructor.  Readers cannot be copied.
+                TileFileReader(const TileFileReader&);
+
+                /// Assignment operator.  Readers cannot be copied.
+                TileFileReader& operator= (const TileFileReader&);
+
+                /// Allocates the buffer of a read.
+                static void AllocateRead(TileRead& read, size_t capacity);
+
+                /// Handles the completion of a read.  Returns true if the read
+                /// is finished, or false if the rest of it was queued.
+                bool CompleteRead(TileRead& read, uint64 tag, long long result);
+
+                /// Leaks the buffers of the reads in flight, which a broken
+                /// queue may still complete.
+                static void DropPendingReads(std::vector<TileRead>& reads);
+
+                /// Frees the buffers of reads.
+                static void FreeReads(std::vector<TileRead>& reads);
+
+                /// Waits for the prefetches in flight.
+                void FinishPrefetches();
+
+                /// Reads a range of the file synchronously.  Returns zero or a
+                /// negative @a errno value.
+                int ReadRange(uint64 offset, size_t size, TileRead& read);
+
+                /// Queues the read of a range of the file.
+                void SubmitRange(TileRead& read, uint64 offset, uint64 size,
+                    uint64 tag);
+
+                /// Queues the read of a tile.
+                void SubmitTile(TileRead& read, int tileIndex, uint64 tag);
+
+                /// Waits for a read to finish.
+                void WaitRead(std::vector<TileRead>& reads, int index);
+
+                /// The file descriptor, or -1.
+                int m_fd;
+
+                /// The header and the tile offsets of the file.
+                std::vector<uint8> m_index;
+
+                /// Determines if the open file is read with direct I/O.
+                bool m_isDirectIO;
+
+                /// Determines if direct I/O is requested.
+                bool m_isDirectIORequested;
+
+                /// The index of the last tile requested, or -1.
+                int m_lastTileIndex;
+
+                /// The distance between the last two tiles requested.
+                int m_lastTileStep;
+
+                /// The largest buffer a tile needs, in bytes.
+                size_t m_maxReadCapacity;
+
+                /// The method of the reads.
+                TileReadMethod m_method;
+
+                /// The queue depth the queue of the open file was created
+                /// with, or zero.
+                int m_openQueueDepth;
+
+                /// The decoder of the file.
+                HeightMapDecoder* m_pDecoder;
+
+                /// The queue of reads.
+                TileReadQueue* m_pQueue;
+
+                /// The predicted distance between two tiles requested.
+                int m_predictedTileStep;
+
+                /// The number of tiles read ahead.
+                int m_prefetchCount;
+
+                /// The tiles read or being read by ReadTile().
+                std::vector<TileRead> m_prefetches;
+
+                /// The number of reads kept in flight.
+                int m_queueDepth;
+
+                /// The number of requests served by ReadTile().
+                uint64 m_requestCount;
+
+                /// The size of the file.
+                uint64 m_streamSize;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,269 @@
+// LibnoiseTuner.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_TUNER_H
+#define NOISE_TUNER_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// Default width and height of the region built during a calibration
+        /// run, in points.
+        const int DEFAULT_TUNER_CALIBRATION_SIZE = 256;
+
+        /// Default number of times each candidate configuration is built during
+        /// a calibration run.  The fastest of these builds is kept.
+        const int DEFAULT_TUNER_REPEAT_COUNT = 2;
+
+        /// Chooses the fastest build configuration for a noise-map builder.
+        ///
+        /// The fastest tile size, batch width and thread count for a
+        /// noise::utils::NoiseMapBuilder depend on the source module (a graph of
+        /// Voronoi modules behaves very differently from a single Perlin
+        /// module) and on the caches of the machine.  A tuner finds that
+        /// configuration by running short calibration builds of the actual
+        /// source module over a set of candidate configurations and timing
+        /// them.
+        ///
+        /// <b>Calibration</b>
+        ///
+        /// A calibration run builds a small region (see SetCalibrationSize())
+        /// of the builder's noise map into a scratch noise map.  The candidate
+        /// values are searched one parameter at a time: first the thread
+        /// count, then the tile size, then the batch width, each time keeping
+        /// the fastest value found so far.
+        ///
+        /// <b>Persistence</b>
+        ///
+        /// The chosen configurations are keyed by a hash of the source module's
+        /// graph (see HashGraph()) and by the model name of the CPU (see
+        /// GetCpuModel()).  If a cache file is set, the tuner loads it on
+        /// construction and rewrites it after each calibration, so later
+        /// processes running the same graph on the same kind of machine skip
+        /// the calibration entirely.
+        ///
+        /// <b>Usage</b>
+        ///
+        /// Pass the tuner to noise::utils::NoiseMapBuilder::SetTuner().  Each
+        /// call to Build() then asks the tuner for a configuration through
+        /// GetConfig(), which looks it up by the graph hash the builder keeps
+        /// (see noise::utils::NoiseMapBuilder::GetSourceModuleHash()).
+        ///
+        /// All methods of this class are thread-safe.
+        class BuildTuner
+        {
+
+            public:
+
+                /// Constructor.
+                ///
+                /// Creates a tuner that keeps its configurations in memory only.
+                BuildTuner();
+
+                /// Constructor.
+                ///
+                /// @param cacheFilename The name of the file that persists the
+                /// chosen configurations.
+                ///
+                /// Loads the configurations stored in the file, if it exists.
+                explicit BuildTuner(const std::string& cacheFilename);
+
+                /// Runs a calibration for the builder's source module and stores
+                /// the fastest configuration.
+                ///
+                /// @param builder The builder whose source module, bounds and
+                /// seamless flag are used for the calibration.
+                ///
+                /// @returns The fastest configuration.
+                ///
+                /// @pre The builder has a source module and valid bounds.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// The builder's destination noise map is not modified.
+                BuildConfig Calibrate(const NoiseMapBuilder& builder);
+
+                /// Returns the name of the file that persists the chosen
+                /// configurations.
+                ///
+                /// @returns The file name, or an empty string if the
+                /// configurations are kept in memory only.
+                std::string GetCacheFile() const;
+
+                /// Returns the configuration to use for a builder.
+                ///
+                /// @param builder The builder.
+                ///
+                /// @returns The stored configuration for the builder's source
+                /// module if there is one; otherwise, the result of
+                /// Calibrate().
+                BuildConfig GetConfig(const NoiseMapBuilder& builder);
+
+                /// Returns the model name of the CPU.
+                ///
+                /// @returns The CPU model name, or a generic string that contains
+                /// the hardware thread count if the model name cannot be
+                /// determined.
+                static std::string GetCpuModel();
+
+                /// Computes a hash of a noise-module graph.
+                ///
+                /// @param sourceModule The root of the graph.
+                ///
+                /// @returns The hash value.
+                ///
+                /// The hash covers the type of every noise module in the graph, the
+                /// way they are connected, and a set of output values of the root
+                /// module at fixed probe positions.  Since noise modules do not
+                /// expose their parameters generically, the probe values are what
+                /// distinguishes two graphs with the same shape but different
+                /// parameters.
+                static uint64 HashGraph(const module::Module& sourceModule);
+
+                /// Loads the configurations stored in the cache file.
+                ///
+                /// Entries that are already in memory are replaced by the entries
+                /// in the file.  Malformed lines are ignored.
+                void Load();
+
+                /// Looks up the stored configuration for a noise-module graph.
+                ///
+                /// @param sourceModule The root of the graph.
+                /// @param config Receives the configuration, if one is stored.
+                ///
+                /// @returns
+                /// - @a true if a configuration was stored for the graph on this
+                ///   CPU model.
+                /// - @a false otherwise.
+                bool Lookup(const module::Module& sourceModule,
+                    BuildConfig& config) const;
+
+                /// Writes all stored configurations to the cache file.
+                ///
+                /// This method does nothing if no cache file is set.
+                void Save() const;
+
+                /// Sets the name of the file that persists the chosen
+                /// configurations and loads it.
+                ///
+                /// @param cacheFilename The file name, or an empty string to keep
+                /// the configurations in memory only.
+                void SetCacheFile(const std::string& cacheFilename);
+
+                /// Sets the size of the region built during a calibration run.
+                ///
+                /// @param width The width of the region, in points.
+                /// @param height The height of the region, in points.
+                ///
+                /// @pre The width and height are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetCalibrationSize(int width, int height);
+
+                /// Sets the candidate values searched during a calibration run.
+                ///
+                /// @param tileSizes The candidate tile widths and heights.
+                /// @param batchWidths The candidate batch widths.
+                /// @param threadCounts The candidate thread counts.
+                ///
+                /// @pre No list is empty and every value is a valid value for the
+                /// matching member of noise::utils::BuildConfig.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                ///
+                /// By default, the tile sizes are 16, 32, 64 and 128 points, the
+                /// batch widths are 16, 64 and 256 points, and the thread counts
+                /// are 1, half of the concurrency of the default executor and
+                /// all of it.
+                void SetCandidates(const std::vector<int>& tileSizes,
+                    const std::vector<int>& batchWidths,
+                    const std::vector<int>& threadCounts);
+
+                /// Sets the number of times each candidate configuration is built
+                /// during a calibration run.
+                ///
+                /// @param repeatCount The number of builds per candidate.
+                ///
+                /// @pre The repeat count is positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetRepeatCount(int repeatCount);
+
+            private:
+
+                /// Returns the key under which the configuration for a graph is
+                /// stored, given the hash of the graph.
+                std::string MakeKey(uint64 graphHash) const;
+
+                /// Builds the calibration region with a configuration and returns
+                /// the fastest build time, in seconds.
+                double TimeConfig(const NoiseMapBuilder& builder,
+                    const BuildConfig& config) const;
+
+                /// Writes the configurations to the cache file.
+                ///
+                /// @pre The caller holds @a m_mutex.
+                void SaveLocked() const;
+
+                /// Candidate batch widths.
+                std::vector<int> m_batchWidths;
+
+                /// Name of the file that persists the configurations.
+                std::string m_cacheFilename;
+
+                /// Height of the calibration region, in points.
+                int m_calibrationHeight;
+
+                /// Width of the calibration region, in points.
+                int m_calibrationWidth;
+
+                /// Stored configurations, keyed by CPU model and graph hash.
+                std::map<std::string, BuildConfig> m_configs;
+
+                /// Model name of this machine's CPU.
+                std::string m_cpuModel;
+
+                /// Protects every member variable of this object.
+                mutable std::mutex m_mutex;
+
+                /// Number of builds per candidate configuration.
+                int m_repeatCount;
+
+                /// Candidate thread counts.
+                std::vector<int> m_threadCounts;
+
+                /// Candidate tile sizes.
+                std::vector<int> m_tileSizes;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef NOISEUTILS_H
 #define NOISEUTILS_H
 
+#include <atomic>
 #include <stdlib.h>
 #include <string.h>
 #include <string>
@@ -30,6 +31,9 @@
 
 #include <noise.h>
 
+#include "LibnoiseExecutor.h"
+#include "LibnoiseMemory.h"
+
 
 namespace noise
 {
@@ -86,6 +90,43 @@ namespace noise
         const int RASTER_STRIDE_BOUNDARY = 4;
 #endif
 
+        /// Default width and height of a tile built by a noise-map builder, in
+        /// points.
+        const int DEFAULT_BUILDER_TILE_SIZE = 64;
+
+        /// Default number of points passed to the source module in a single
+        /// batch by a noise-map builder.
+        const int DEFAULT_BUILDER_BATCH_WIDTH = 64;
+
+        /// The maximum number of points a noise-map builder passes to the
+        /// source module in a single batch.
+        const int BUILDER_MAX_BATCH_WIDTH = 4096;
+
+        class BuildTuner;
+
+        /// Describes how a noise-map builder divides its work.
+        ///
+        /// The noise map is split into rectangular tiles that are built
+        /// independently by a set of worker threads.  Within a tile, each row
+        /// is passed to the source module in batches of @a batchWidth points.
+        struct BuildConfig
+        {
+            /// Width of a tile, in points.
+            int tileWidth = DEFAULT_BUILDER_TILE_SIZE;
+
+            /// Height of a tile, in points.
+            int tileHeight = DEFAULT_BUILDER_TILE_SIZE;
+
+            /// Number of points passed to the source module in a single batch.
+            int batchWidth = DEFAULT_BUILDER_BATCH_WIDTH;
+
+            /// Number of workers, or zero to use the concurrency of the default
+            /// executor (see noise::utils::Executor).  With several workers,
+            /// the source module is evaluated from several threads at once
+            /// (see noise::module::Module).
+            int threadCount = 0;
+        };
+
 
         /// Implements a noise map, a 2-dimensional array of floating-point
         /// values.
@@ -109,6 +150,12 @@ namespace noise
         /// NOISE_REALlocated.
         /// Call ReclaimMem() to reclaim the wasted memory.
         ///
+        /// The buffer is reserved against the library-wide memory account in
+        /// the noise::utils::MEMORY_RASTER category (see
+        /// noise::utils::GetMemoryStats()).  If the memory budget is exhausted,
+        /// the registered memory reclaimers are asked to release memory before
+        /// noise::ExceptionOutOfMemory is thrown.
+        ///
         /// <b>Border Values</b>
         ///
         /// All of the values outside of the noise map are assumed to have a
@@ -402,6 +449,21 @@ namespace noise
 
             private:
 
+                /// Reserves and allocates a noise-map buffer.
+                ///
+                /// @param count The number of @a float values in the buffer.
+                ///
+                /// @returns A pointer to the new buffer.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                static float* AllocateBuffer(size_t count);
+
+                /// Frees and releases a buffer allocated by AllocateBuffer().
+                ///
+                /// @param pBuffer The buffer, or @a NULL.
+                /// @param count The number of @a float values in the buffer.
+                static void FreeBuffer(float* pBuffer, size_t count);
+
                 /// Returns the minimum amount of memory required to store a noise map
                 /// of the specified size.
                 ///
@@ -515,9 +577,15 @@ namespace noise
         /// function has a single integer parameter that contains a count of the
         /// rows that have been completed.  It returns void.
         ///
-        /// Note that SetBounds() is not defined in the abstract base class; it is
-        /// only defined in the derived classes.  This is because each model uses
-        /// a different coordinate system.
+        /// <b>Tiles, batches and threads</b>
+        ///
+        /// The Build() method divides the noise map into tiles that are built
+        /// concurrently by several worker threads; the points within a tile row
+        /// are passed to the source module in batches (see
+        /// noise::module::Module::GetValues()).  The best tile size, batch
+        /// width and thread count depend on the source module and on the
+        /// machine, so they can either be set by SetBuildConfig() or chosen
+        /// automatically by a noise::utils::BuildTuner passed to SetTuner().
         class NoiseMapBuilder
         {
 
@@ -526,6 +594,14 @@ namespace noise
                 /// Constructor.
 				NoiseMapBuilder() {};
 
+                /// Copy constructor.
+                NoiseMapBuilder(const NoiseMapBuilder& rhs);
+
+                /// Assignment operator.
+                ///
+                /// @returns Reference to self.
+                NoiseMapBuilder& operator= (const NoiseMapBuilder& rhs);
+
                 /// Builds the noise map.
                 ///
                 /// @pre SetBounds() was previously called.
@@ -547,8 +623,160 @@ namespace noise
                 /// SetSourceModule().
                 void Build();
 
+                /// Builds the noise map one band of rows at a time, without
+                /// materializing the whole noise map.
+                ///
+                /// @param fRowCallback The function that receives each row.  Its
+                /// first parameter is the row index, or @a z coordinate; its
+                /// second parameter points to the @a width values of that row.
+                /// The pointer is only valid during the call.
+                ///
+                /// @pre SetBounds() was previously called.
+                /// @pre SetSourceModule() was previously called.
+                /// @pre The width and height values specified by SetDestSize() are
+                /// positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The rows are passed to the callback function in increasing
+                /// order, from the calling thread.  The height of each band
+                /// depends on the available memory (see
+                /// noise::utils::GetAvailableMemory()), so this method keeps
+                /// working under a memory budget too small for the whole noise
+                /// map.  The destination noise map is not used.
+                void BuildRows(std::function<void(int, const float*)> fRowCallback);
+
 				void Build(std::function<void(int, int, float)> fCallback);
 
+                /// Builds one noise map per variant of the source module.
+                ///
+                /// @param pDestNoiseMaps An array of noise maps, one per variant,
+                /// that receive the output values.
+                /// @param pVariants An array containing the variants.
+                /// @param variantCount The number of variants.
+                ///
+                /// @pre SetBounds() was previously called.
+                /// @pre SetSourceModule() was previously called.
+                /// @pre The width and height values specified by SetDestSize() are
+                /// positive.
+                /// @pre The number of variants is positive.
+                ///
+                /// @post The original contents of the destination noise maps are
+                /// destroyed.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// Noise map @a i receives the output values of the source module
+                /// under variant @a i (see noise::module::ModuleVariant), exactly
+                /// as Build() would produce them if every generator module of the
+                /// graph had the overridden parameters.  Each point is evaluated
+                /// once for all variants with
+                /// noise::module::Module::GetVariantValues(), which shares the
+                /// coordinate work between the variants; a set of seed previews
+                /// costs a fraction of one Build() per variant.  The rows are
+                /// built in parallel on the thread count of the build
+                /// configuration.  SetDestNoiseMap() is not used.
+                void BuildVariants(NoiseMap* pDestNoiseMaps,
+                    const module::ModuleVariant* pVariants, int variantCount);
+
+                /// Returns the tile size, batch width and thread count used by the
+                /// Build() method.
+                ///
+                /// @returns The current build configuration.
+                ///
+                /// If a tuner is attached, the Build() method replaces this
+                /// configuration with the one chosen by the tuner.
+                const BuildConfig& GetBuildConfig() const
+                {
+                    return m_buildConfig;
+                }
+
+                /// Returns the histograms that record the tile build latency.
+                ///
+                /// @returns A pointer to the histograms, or @a NULL if tile builds
+                /// are not recorded.
+                GraphLatency* GetLatency() const
+                {
+                    return m_pLatency;
+                }
+
+                /// Returns the source module.
+                ///
+                /// @returns A pointer to the source module, or @a NULL if no
+                /// source module was set.
+                const module::Module* GetSourceModule() const
+                {
+                    return m_pSourceModule;
+                }
+
+                /// Returns a hash of the source module's graph.
+                ///
+                /// @returns The hash computed by BuildTuner::HashGraph(), or
+                /// zero if no source module was set.
+                ///
+                /// The hash is computed on the first call after
+                /// SetSourceModule(), then reused, so that a tuner does not walk
+                /// and probe the graph on every build.  After changing the
+                /// graph or its parameters, call SetSourceModule() again.
+                uint64 GetSourceModuleHash() const;
+
+                /// Returns the tuner that chooses the build configuration.
+                ///
+                /// @returns A pointer to the tuner, or @a NULL if no tuner is
+                /// attached.
+                BuildTuner* GetTuner() const
+                {
+                    return m_pTuner;
+                }
+
+                /// Sets the tile size, batch width and thread count used by the
+                /// Build() method.
+                ///
+                /// @param config The new build configuration.
+                ///
+                /// @pre The tile width and height are positive.
+                /// @pre The batch width ranges from 1 to
+                /// noise::utils::BUILDER_MAX_BATCH_WIDTH.
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetBuildConfig(const BuildConfig& config);
+
+                /// Sets the histograms that record the tile build latency.
+                ///
+                /// @param pLatency The histograms, or @a NULL to stop recording.
+                ///
+                /// The time taken by each tile is recorded into the
+                /// noise::LATENCY_TILE_BUILD histogram while latency recording is
+                /// enabled (see noise::SetLatencyRecordingEnabled()).  Passing the
+                /// histograms of a noise::module::Instrument module at the root of
+                /// the source graph reports tile builds and queries together.
+                ///
+                /// The histograms must exist throughout the lifetime of this object
+                /// unless others replace them.
+                void SetLatency(GraphLatency* pLatency)
+                {
+                    m_pLatency = pLatency;
+                }
+
+                /// Attaches a tuner that chooses the build configuration.
+                ///
+                /// @param pTuner The tuner, or @a NULL to detach the current
+                /// tuner.
+                ///
+                /// Each call to Build() asks the tuner for the configuration that
+                /// is fastest for the source module on this machine; the tuner
+                /// calibrates the source module the first time it sees it.
+                ///
+                /// The tuner must exist throughout the lifetime of this object
+                /// unless another tuner replaces that tuner.
+                void SetTuner(BuildTuner* pTuner)
+                {
+                    m_pTuner = pTuner;
+                }
+
 
                 /// Returns the height of the destination noise map.
                 ///
@@ -599,6 +827,7 @@ namespace noise
                 void SetSourceModule(const module::Module& sourceModule)
                 {
                     m_pSourceModule = &sourceModule;
+                    m_sourceModuleHash = 0;
                 }
 
                 /// Sets the size of the destination noise map.
@@ -705,6 +934,68 @@ namespace noise
 
             protected:
 
+                /// Fills a rectangular region of a noise map.
+                ///
+                /// @param destNoiseMap The noise map that receives the region.
+                /// @param rowOffset The row of the full noise map that is stored in
+                /// row 0 of @a destNoiseMap.
+                /// @param x0 The x coordinate of the lower-left point of the
+                /// region.
+                /// @param z0 The z coordinate of the lower-left point of the
+                /// region.
+                /// @param width The width of the region, in points.
+                /// @param height The height of the region, in points.
+                /// @param batchWidth The number of points passed to the source
+                /// module in a single batch.
+                /// @param pScratch A buffer that can hold at least eight batches of
+                /// @a NOISE_REAL values.
+                ///
+                /// The noise map must already be large enough for the region.
+                void BuildTile(NoiseMap& destNoiseMap, int rowOffset, int x0,
+                    int z0, int width, int height, int batchWidth,
+                    NOISE_REAL* pScratch) const;
+
+                /// Fills a band of rows of a noise map using several worker
+                /// threads.
+                ///
+                /// @param destNoiseMap The noise map that receives the band.  Row
+                /// @a rowOffset of the full noise map is written to its row 0.
+                /// @param rowOffset The first row of the band.
+                /// @param rowCount The number of rows in the band.
+                /// @param config The configuration used to divide the work.
+                ///
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// If the scratch space for the configuration does not fit in the
+                /// memory budget, the batch width and then the thread count are
+                /// reduced until it does.
+                void BuildBand(NoiseMap& destNoiseMap, int rowOffset,
+                    int rowCount, const BuildConfig& config) const;
+
+                /// Returns the configuration used by Build() and BuildRows().
+                BuildConfig GetEffectiveConfig() const;
+
+                /// Returns the output value of the source module at a position of
+                /// the noise map.
+                ///
+                /// @param x The x coordinate of the position, in points.
+                /// @param z The z coordinate of the position, in points.
+                ///
+                /// @returns The output value, blended with the values from the
+                /// opposite edges when seamless tiling is enabled.
+                ///
+                /// The coordinates need not be integers; this method is used by the
+                /// builders that sample between the points of the noise map.
+                NOISE_REAL GetPointValue(NOISE_REAL x, NOISE_REAL z) const;
+
+                /// Configuration used to divide the work of the Build() method.
+                BuildConfig m_buildConfig;
+
+                /// Histograms recording the tile build latency, or @a NULL.
+                GraphLatency* m_pLatency = nullptr;
+
+                /// Tuner that chooses the build configuration, or @a NULL.
+                BuildTuner* m_pTuner = nullptr;
 
                 /// Height of the destination noise map, in points.
                 int m_destHeight = 0;
@@ -718,6 +1009,10 @@ namespace noise
                 /// Source noise module that will generate the coherent-noise values.
                 const module::Module* m_pSourceModule = nullptr;
 
+                /// Hash of the source module's graph, or zero if not computed
+                /// yet.
+                mutable std::atomic<uint64> m_sourceModuleHash{0};
+
 				/// A flag specifying whether seamless tiling is enabled.
 				bool m_isSeamlessEnabled = false;
 
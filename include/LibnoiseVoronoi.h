@@ -0,0 +1,238 @@
+// LibnoiseVoronoi.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_VORONOI_H
+#define NOISE_VORONOI_H
+
+#include <vector>
+
+#include "LibnoiseUtils.h"
+
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        /// A Voronoi cell found by a noise::utils::VoronoiRegionBuilder.
+        struct VoronoiCell
+        {
+            /// The coordinates of the unit square of the seed point, in the
+            /// space of the noise::module::Voronoi module (after the frequency
+            /// is applied).  They identify the cell across builds.
+            int latticeX;
+            int latticeZ;
+
+            /// The coordinates of the seed point, in units.
+            NOISE_REAL x;
+            NOISE_REAL z;
+
+            /// The number of points of the label map in the cell.  A cell whose
+            /// region only touches the edge of the label map has no points.
+            uint32 pointCount;
+        };
+
+        /// The Voronoi regions built by a noise::utils::VoronoiRegionBuilder:
+        /// a label map and the adjacency graph of the cells.
+        struct VoronoiRegions
+        {
+            /// The width of the label map, in points.
+            int width;
+
+            /// The height of the label map, in points.
+            int height;
+
+            /// The index, in cells, of the cell of each point, row by row.  Row
+            /// @a z holds the points at the @a z coordinate of row @a z of a
+            /// noise map built over the same bounds.
+            std::vector<uint32> labels;
+
+            /// The cells, sorted by their lattice coordinates, @a z first.
+            std::vector<VoronoiCell> cells;
+
+            /// The index, in neighbours, of the first neighbour of each cell,
+            /// followed by the total number of neighbours.  The neighbours of
+            /// cell @a i run from neighbourOffsets[@a i] to
+            /// neighbourOffsets[@a i + 1] excluded.
+            std::vector<uint32> neighbourOffsets;
+
+            /// The neighbours of every cell, sorted by index.
+            std::vector<uint32> neighbours;
+
+            /// The length of the border between a cell and each of its
+            /// neighbours: the number of pairs of horizontally or vertically
+            /// adjacent points, one in each cell.
+            std::vector<uint32> borderLengths;
+
+            /// Returns the number of cells.
+            int GetCellCount() const
+            {
+                return (int)cells.size();
+            }
+
+            /// Returns the label of a point.
+            ///
+            /// @param x The x coordinate of the point.
+            /// @param z The z coordinate of the point.
+            ///
+            /// @returns The index of the cell of the point.
+            uint32 GetLabel(int x, int z) const
+            {
+                return labels[(size_t)z * (size_t)width + (size_t)x];
+            }
+        };
+
+        /// Labels the points of a plane with the cells of a
+        /// noise::module::Voronoi module, and builds their adjacency graph.
+        ///
+        /// The points are the points of a noise map built by a
+        /// noise::utils::NoiseMapBuilder over the same bounds and size.  The
+        /// label of a point is the index of the cell of the seed point nearest
+        /// to it, found with the same seed points, the same neighbourhood and
+        /// the same arithmetic as noise::module::Voronoi::GetValue(), so the
+        /// labels match the cells of the noise map point for point.  Two cells
+        /// are neighbours if a point of one is horizontally or vertically
+        /// adjacent to a point of the other.
+        ///
+        /// The module provides the frequency and the seed; its displacement
+        /// and distance settings do not change the cells.
+        ///
+        /// <b>Parallelism</b>
+        ///
+        /// The label map is split into tiles, which are labelled in parallel
+        /// on the thread count set by SetThreadCount().  Each tile computes
+        /// the seed points of its neighbourhood once, then finds the nearest
+        /// one of every point and counts the borders between its cells in the
+        /// same pass.  The cells of the tiles are then merged and numbered.
+        /// The result does not depend on the thread count.
+        class VoronoiRegionBuilder
+        {
+
+            public:
+
+                /// Constructor.
+                VoronoiRegionBuilder();
+
+                /// Builds the Voronoi regions.
+                ///
+                /// @param regions The regions that receive the label map, the
+                /// cells and their adjacency graph.  Their previous contents
+                /// are discarded.
+                ///
+                /// @pre SetBounds() was previously called.
+                /// @pre SetSourceModule() was previously called.
+                /// @pre The width and height values specified by SetDestSize()
+                /// are positive.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                /// @throw noise::ExceptionOutOfMemory Out of memory.
+                ///
+                /// The cells of a label map are meant to span several points;
+                /// with more than one cell per point, the stage gets slower
+                /// than evaluating the module.
+                void Build(VoronoiRegions& regions) const;
+
+                /// Returns the number of workers, or zero to use the concurrency of
+                /// the default executor.
+                int GetThreadCount() const
+                {
+                    return m_threadCount;
+                }
+
+                /// Sets the boundaries of the plane.
+                ///
+                /// @param lowerXBound The lower x boundary of the plane, in units.
+                /// @param upperXBound The upper x boundary of the plane, in units.
+                /// @param lowerZBound The lower z boundary of the plane, in units.
+                /// @param upperZBound The upper z boundary of the plane, in units.
+                ///
+                /// @pre The lower x boundary is less than the upper x boundary.
+                /// @pre The lower z boundary is less than the upper z boundary.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetBounds(NOISE_REAL lowerXBound, NOISE_REAL upperXBound,
+                    NOISE_REAL lowerZBound, NOISE_REAL upperZBound);
+
+                /// Sets the size of the label map.
+                ///
+                /// @param destWidth The width of the label map, in points.
+                /// @param destHeight The height of the label map, in points.
+                void SetDestSize(int destWidth, int destHeight)
+                {
+                    m_destWidth = destWidth;
+                    m_destHeight = destHeight;
+                }
+
+                /// Sets the Voronoi module.
+                ///
+                /// @param sourceModule The Voronoi module.
+                ///
+                /// This object keeps a pointer to the module, and reads its
+                /// frequency and seed in Build().
+                void SetSourceModule(const module::Voronoi& sourceModule)
+                {
+                    m_pSourceModule = &sourceModule;
+                }
+
+                /// Sets the number of workers.
+                ///
+                /// @param threadCount The number of workers, or zero to use the
+                /// concurrency of the default executor.
+                ///
+                /// @pre The thread count is not negative.
+                ///
+                /// @throw noise::ExceptionInvalidParam See the preconditions.
+                void SetThreadCount(int threadCount)
+                {
+                    if (threadCount < 0)
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    m_threadCount = threadCount;
+                }
+
+            private:
+
+                /// Height of the label map.
+                int m_destHeight;
+
+                /// Width of the label map.
+                int m_destWidth;
+
+                /// Determines if the bounds were set.
+                bool m_hasBounds;
+
+                /// The bounds of the plane.
+                NOISE_REAL m_lowerXBound;
+                NOISE_REAL m_lowerZBound;
+                NOISE_REAL m_upperXBound;
+                NOISE_REAL m_upperZBound;
+
+                /// The Voronoi module.
+                const module::Voronoi* m_pSourceModule;
+
+                /// The number of worker threads.
+                int m_threadCount;
+
+        };
+
+    }
+
+}
+
+#endif
@@ -0,0 +1,349 @@
+// latency.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_LATENCY_H
+#define NOISE_LATENCY_H
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "basictypes.h"
+
+/// Set to 0 to compile latency recording out of the library.
+///
+/// With recording compiled out, noise::LatencyScope is empty and the
+/// instrumented entry points cost nothing.  The library and the application
+/// must be compiled with the same value (the LIBNOISE_LATENCY_METRICS CMake
+/// option sets it for the library).
+#ifndef NOISE_LATENCY_METRICS
+#define NOISE_LATENCY_METRICS 1
+#endif
+
+namespace noise
+{
+
+  /// @addtogroup libnoise
+  /// @{
+
+  /// Enumerates the operations whose latency is recorded.
+  enum LatencyOperation
+  {
+
+    /// A single call to noise::module::Module::GetValue().
+    LATENCY_POINT_QUERY = 0,
+
+    /// A single call to noise::module::Module::GetValues().
+    LATENCY_BATCH_QUERY = 1,
+
+    /// The build of one tile by a noise-map builder.
+    LATENCY_TILE_BUILD = 2,
+
+    /// The number of operations.
+    LATENCY_OPERATION_COUNT = 3
+
+  };
+
+  /// Number of bits of precision of a latency histogram.  Each power-of-two
+  /// range of values is split into 2 ^ (this value - 1) buckets, so a
+  /// recorded value is known to within about 3 percent.
+  const int LATENCY_PRECISION_BITS = 5;
+
+  /// Number of buckets of a latency histogram, enough for any 64-bit value.
+  const int LATENCY_BUCKET_COUNT
+    = (64 - LATENCY_PRECISION_BITS + 2) << (LATENCY_PRECISION_BITS - 1);
+
+  /// A copy of the counts of a latency histogram at one point in time.
+  class LatencySnapshot
+  {
+
+    public:
+
+      /// Constructor.
+      ///
+      /// Creates an empty snapshot.
+      LatencySnapshot ();
+
+      /// Returns the number of recorded values.
+      uint64 GetCount () const
+      {
+        return m_count;
+      }
+
+      /// Returns the largest recorded value.
+      ///
+      /// @returns The upper bound of the highest non-empty bucket, in
+      /// nanoseconds, or zero if the snapshot is empty.
+      uint64 GetMax () const;
+
+      /// Returns a percentile of the recorded values.
+      ///
+      /// @param percentile The percentile, from 0.0 to 100.0.
+      ///
+      /// @returns The upper bound of the bucket holding the value at that
+      /// percentile, in nanoseconds, or zero if the snapshot is empty.
+      uint64 GetPercentile (double percentile) const;
+
+      /// Returns the sum of the recorded values, in nanoseconds.
+      uint64 GetSum () const
+      {
+        return m_sum;
+      }
+
+    private:
+
+      friend class LatencyHistogram;
+
+      /// The count of each bucket.
+      std::vector<uint64> m_buckets;
+
+      /// The total count.
+      uint64 m_count;
+
+      /// The sum of the recorded values.
+      uint64 m_sum;
+
+  };
+
+  /// Records a distribution of latencies, in nanoseconds.
+  ///
+  /// The histogram uses the log-linear bucketing of HDR histograms: values
+  /// below 2 ^ LATENCY_PRECISION_BITS have a bucket each, and every larger
+  /// power-of-two range is split into the same number of buckets.  The
+  /// relative error of a reported value is therefore bounded, from
+  /// nanoseconds to hours, with a fixed number of buckets.
+  ///
+  /// Record() is two relaxed atomic additions, so any number of threads may
+  /// record into the same histogram; GetSnapshot() and Reset() may run
+  /// concurrently with them.
+  class LatencyHistogram
+  {
+
+    public:
+
+      /// Constructor.
+      LatencyHistogram ();
+
+      /// Returns the index of the bucket holding a value.
+      static int GetBucketIndex (uint64 value);
+
+      /// Returns the largest value held by a bucket.
+      static uint64 GetBucketUpperBound (int index);
+
+      /// Returns a copy of the counts.
+      ///
+      /// @param reset If true, the counts are reset as they are copied.
+      ///
+      /// @returns The snapshot.
+      ///
+      /// With @a reset set, every recorded value ends up in exactly one
+      /// snapshot, which suits periodic scraping.
+      LatencySnapshot GetSnapshot (bool reset = false);
+
+      /// Records a value.
+      ///
+      /// @param nanoseconds The value, in nanoseconds.
+      void Record (uint64 nanoseconds)
+      {
+        m_buckets[GetBucketIndex (nanoseconds)].fetch_add (1,
+          std::memory_order_relaxed);
+        m_sum.fetch_add (nanoseconds, std::memory_order_relaxed);
+      }
+
+      /// Clears the counts.
+      void Reset ();
+
+    private:
+
+      /// Copy constructor.  Histograms cannot be copied.
+      LatencyHistogram (const LatencyHistogram&);
+
+      /// Assignment operator.  Histograms cannot be copied.
+      LatencyHistogram& operator= (const LatencyHistogram&);
+
+      /// The count of each bucket.
+      std::atomic<uint64> m_buckets[LATENCY_BUCKET_COUNT];
+
+      /// The sum of the recorded values.
+      std::atomic<uint64> m_sum;
+
+  };
+
+  /// The latency histograms of one noise-module graph, one per operation.
+  ///
+  /// The histograms are registered under the name of the graph for as long
+  /// as the object exists, and are exported by WriteLatencyReport().
+  class GraphLatency
+  {
+
+    public:
+
+      /// Constructor.
+      ///
+      /// @param name The name of the graph, used in the report.
+      explicit GraphLatency (const std::string& name = "default");
+
+      /// Destructor.
+      ~GraphLatency ();
+
+      /// Returns the histogram of an operation.
+      LatencyHistogram& GetHistogram (LatencyOperation operation)
+      {
+        return m_histograms[operation];
+      }
+
+      /// Returns the name of the graph.
+      std::string GetName () const;
+
+      /// Sets the name of the graph.
+      void SetName (const std::string& name);
+
+    private:
+
+      friend void WriteLatencyReport (std::ostream& out, bool reset);
+
+      /// Copy constructor.  The histograms cannot be copied.
+      GraphLatency (const GraphLatency&);
+
+      /// Assignment operator.  The histograms cannot be copied.
+      GraphLatency& operator= (const GraphLatency&);
+
+      /// The histogram of each operation.
+      LatencyHistogram m_histograms[LATENCY_OPERATION_COUNT];
+
+      /// The name of the graph.
+      std::string m_name;
+
+  };
+
+  /// The flag set by SetLatencyRecordingEnabled().  Use
+  /// IsLatencyRecordingEnabled() to read it.
+  extern std::atomic<bool> g_latencyRecordingEnabled;
+
+  /// Returns true if latency recording is enabled.
+  inline bool IsLatencyRecordingEnabled ()
+  {
+#if NOISE_LATENCY_METRICS
+    return g_latencyRecordingEnabled.load (std::memory_order_relaxed);
+#else
+    return false;
+#endif
+  }
+
+  /// Clears every registered histogram.
+  void ResetLatencyHistograms ();
+
+  /// Enables or disables latency recording.
+  ///
+  /// @param enabled True to record latencies.
+  ///
+  /// Recording is disabled by default.  While it is disabled, an
+  /// instrumented entry point costs one relaxed atomic load.
+  void SetLatencyRecordingEnabled (bool enabled);
+
+  /// Writes the percentiles of every registered histogram.
+  ///
+  /// @param out The output stream.
+  /// @param reset If true, the histograms are reset as they are read, so
+  /// each report covers the interval since the previous one.
+  ///
+  /// The report uses the Prometheus text format, in nanoseconds: one summary
+  /// per graph and operation, followed by a gauge of the largest values:
+  /// @code
+  /// # TYPE noise_latency_ns summary
+  /// noise_latency_ns{graph="terrain",op="point_query",quantile="0.5"} 127
+  /// noise_latency_ns{graph="terrain",op="point_query",quantile="0.99"} 383
+  /// noise_latency_ns{graph="terrain",op="point_query",quantile="0.999"} 1023
+  /// noise_latency_ns_sum{graph="terrain",op="point_query"} 6530912
+  /// noise_latency_ns_count{graph="terrain",op="point_query"} 48213
+  /// # TYPE noise_latency_ns_max gauge
+  /// noise_latency_ns_max{graph="terrain",op="point_query"} 20479
+  /// @endcode
+  /// Operations that recorded nothing are omitted.  Backslashes, double
+  /// quotes and line feeds in graph names are escaped.
+  void WriteLatencyReport (std::ostream& out, bool reset = false);
+
+  /// Measures the time spent in a scope and records it into a histogram.
+  ///
+  /// Nothing is measured if recording is disabled when the scope starts, or
+  /// if the histogram is a null pointer.  With NOISE_LATENCY_METRICS set to
+  /// 0, this class is empty.
+  class LatencyScope
+  {
+
+    public:
+
+#if NOISE_LATENCY_METRICS
+
+      /// Constructor.
+      ///
+      /// @param pHistogram The histogram, or a null pointer.
+      explicit LatencyScope (LatencyHistogram* pHistogram):
+        m_pHistogram (IsLatencyRecordingEnabled () ? pHistogram : NULL)
+      {
+        if (m_pHistogram != NULL) {
+          m_start = std::chrono::steady_clock::now ();
+        }
+      }
+
+      /// Destructor.
+      ///
+      /// Records the time elapsed since the constructor.
+      ~LatencyScope ()
+      {
+        if (m_pHistogram != NULL) {
+          std::chrono::steady_clock::duration elapsed
+            = std::chrono::steady_clock::now () - m_start;
+          m_pHistogram->Record ((uint64)std::chrono::duration_cast<
+            std::chrono::nanoseconds> (elapsed).count ());
+        }
+      }
+
+#else
+
+      explicit LatencyScope (LatencyHistogram*)
+      {
+      }
+
+#endif
+
+    private:
+
+      /// Copy constructor.  Scopes cannot be copied.
+      LatencyScope (const LatencyScope&);
+
+      /// Assignment operator.  Scopes cannot be copied.
+      LatencyScope& operator= (const LatencyScope&);
+
+#if NOISE_LATENCY_METRICS
+
+      /// The histogram, or a null pointer if nothing is measured.
+      LatencyHistogram* m_pHistogram;
+
+      /// The time at which the scope started.
+      std::chrono::steady_clock::time_point m_start;
+
+#endif
+
+  };
+
+  /// @}
+
+}
+
+#endif
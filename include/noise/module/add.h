@@ -62,6 +62,10 @@ namespace noise
 
         virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const;
 
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
+
     };
 
     /// @}
@@ -164,6 +164,10 @@ namespace noise
 
         virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const;
 
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
+
         /// Sets the frequency of the first octave.
         ///
         /// @param frequency The frequency of the first octave.
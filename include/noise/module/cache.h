@@ -58,6 +58,10 @@ namespace noise
     /// If an application passes a new source module to the SetSourceModule()
     /// method, the cache is invalidated.
     ///
+    /// Each thread has its own cached value, so the noise module can be
+    /// evaluated by several threads at once, as the parallel noise-map
+    /// builders do; a thread only hits the values it computed itself.
+    ///
     /// Caching a noise module is useful if it is used as a source module for
     /// multiple noise modules.  If a source module is not cached, the source
     /// module will redundantly calculate the same output value once for each
@@ -79,26 +83,17 @@ namespace noise
 
         virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const;
 
-        virtual void SetSourceModule (int index, const Module& sourceModule)
-        {
-          Module::SetSourceModule (index, sourceModule);
-          m_isCached = false;
-        }
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
 
-      protected:
+        virtual void SetSourceModule (int index, const Module& sourceModule);
 
-        /// The cached output value at the cached input value.
-        mutable NOISE_REAL m_cachedValue;
-
-        /// Determines if a cached output value is stored in this noise
-        /// module.
-        mutable NOISE_REAL m_isCached;
-
-        /// @a x coordinate of the cached input value.
-        mutable NOISE_REAL m_xCache;
+      protected:
 
-        /// @a y coordinate of the cached input value.
-		mutable NOISE_REAL m_yCache;
+        /// Identifies the cached values of this noise module in the
+        /// per-thread cache.  A new identifier invalidates them.
+        uint64 m_cacheId;
 
     };
 
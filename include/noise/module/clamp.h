@@ -111,6 +111,10 @@ namespace noise
 
         virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const;
 
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
+
         /// Sets the lower and upper bounds of the clamping range.
         ///
         /// @param lowerBound The lower bound.
@@ -86,6 +86,11 @@ namespace noise
         /// Constructor.
         Curve ();
 
+        /// Copy constructor.
+        ///
+        /// @param m The noise module to copy, with its control points.
+        Curve (const Curve& m);
+
         /// Destructor.
         ~Curve ();
 
@@ -65,6 +65,17 @@ namespace noise
     /// displacement module; internally, there are three Perlin-noise modules
     /// that perform the displacement operation.
     ///
+    /// <b>Vector displacement</b>
+    ///
+    /// If the same noise module is both the @a x and the @a y displacement
+    /// module, the GetValue() method queries it only once per input value:
+    /// a multi-channel noise module (see Module::GetChannelCount()) displaces
+    /// the @a x coordinate by its channel 0 and the @a y coordinate by its
+    /// channel 1, and a single-channel noise module displaces both
+    /// coordinates by its output value.  Use SetDisplaceVectorModule() to
+    /// connect a noise::module::PerlinVector noise module this way, which
+    /// computes both offsets for little more than the cost of one.
+    ///
     /// This noise module requires four source modules.
     class Displace: public Module
     {
@@ -175,6 +186,29 @@ namespace noise
         SetZDisplaceModule (zDisplaceModule);
       }
 
+      /// Sets a noise module that displaces both the @a x and the @a y
+      /// coordinates.
+      ///
+      /// @param displaceModule Displacement module, usually with two
+      /// channels.
+      ///
+      /// The GetValue() method displaces the @a x coordinate of the input
+      /// value by channel 0 of this displacement module and the @a y
+      /// coordinate by channel 1, both computed by a single call to its
+      /// GetChannelValues() method.  A single-channel displacement module
+      /// displaces both coordinates by its output value.
+      ///
+      /// This method assigns this displacement module to both the index
+      /// values 1 and 2.
+      ///
+      /// This displacement module must exist throughout the lifetime of this
+      /// noise module unless another displacement module replaces it.
+      void SetDisplaceVectorModule (const Module& displaceModule)
+      {
+        SetXDisplaceModule (displaceModule);
+        SetYDisplaceModule (displaceModule);
+      }
+
       /// Sets the @a x displacement module.
       ///
       /// @param xDisplaceModule Displacement module that displaces the @a x
@@ -0,0 +1,118 @@
+// instrument.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_MODULE_INSTRUMENT_H
+#define NOISE_MODULE_INSTRUMENT_H
+
+#include <string>
+#include "modulebase.h"
+#include "../latency.h"
+
+namespace noise
+{
+
+  namespace module
+  {
+
+    /// @addtogroup libnoise
+    /// @{
+
+    /// @addtogroup modules
+    /// @{
+
+    /// @addtogroup miscmodules
+    /// @{
+
+    /// Noise module that records the latency of the queries made to a source
+    /// module.
+    ///
+    /// This noise module returns the output value of its source module
+    /// unchanged.  Placed at the root of a noise-module graph, it records the
+    /// time taken by every call to GetValue() and GetValues() into the
+    /// histograms of a noise::GraphLatency named after the graph.  The
+    /// histograms are exported with noise::WriteLatencyReport().
+    ///
+    /// Nothing is recorded until latency recording is enabled with
+    /// noise::SetLatencyRecordingEnabled(); until then, a query costs one
+    /// relaxed atomic load more than a direct query of the source module.
+    ///
+    /// To record tile builds in the same histograms, pass GetLatency() to
+    /// noise::utils::NoiseMapBuilder::SetLatency().
+    ///
+    /// This noise module requires one source module.
+    class Instrument: public Module
+    {
+
+      public:
+
+        /// Constructor.
+        ///
+        /// @param name The name of the graph, used in the latency report.
+        explicit Instrument (const std::string& name = "default");
+
+        /// Returns the latency histograms of this noise module.
+        GraphLatency& GetLatency () const
+        {
+          return m_latency;
+        }
+
+        /// Returns the name of the graph.
+        std::string GetName () const
+        {
+          return m_latency.GetName ();
+        }
+
+        virtual int GetSourceModuleCount () const
+        {
+          return 1;
+        }
+
+        virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const;
+
+        virtual void GetValues (const NOISE_REAL* x, const NOISE_REAL* y,
+          NOISE_REAL* out, int count) const;
+
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
+
+        /// Sets the name of the graph.
+        ///
+        /// @param name The name of the graph, used in the latency report.
+        void SetName (const std::string& name)
+        {
+          m_latency.SetName (name);
+        }
+
+      protected:
+
+        /// The latency histograms.
+        mutable GraphLatency m_latency;
+
+    };
+
+    /// @}
+
+    /// @}
+
+    /// @}
+
+  }
+
+}
+
+#endif
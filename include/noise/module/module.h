@@ -34,11 +34,13 @@
 #include "curve.h"
 #include "displace.h"
 #include "exponent.h"
+#include "instrument.h"
 #include "invert.h"
 #include "max.h"
 #include "min.h"
 #include "multiply.h"
 #include "perlin.h"
+#include "perlinvector.h"
 #include "power.h"
 #include "ridgedmulti.h"
 #include "rotatepoint.h"
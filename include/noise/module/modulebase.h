@@ -43,6 +43,68 @@ namespace noise
     /// @addtogroup modules
     /// @{
 
+    /// Maximum number of output channels of a noise module.
+    const int MODULE_MAX_CHANNEL_COUNT = 4;
+
+    /// Maximum number of variants evaluated by one call to
+    /// noise::module::Module::GetVariantValues().
+    const int MODULE_MAX_VARIANT_COUNT = 64;
+
+    /// A variant of a noise-module graph: parameter overrides applied to
+    /// every generator module of the graph.
+    ///
+    /// The seeded generator modules (noise::module::Perlin,
+    /// noise::module::Billow, noise::module::RidgedMulti,
+    /// noise::module::Voronoi, and the Perlin-noise modules inside
+    /// noise::module::Turbulence) evaluate a variant as if their seed were
+    /// increased by @a seedOffset and their frequency multiplied by
+    /// @a frequencyScale.  Other noise modules are not affected.
+    ///
+    /// A variant with a seed offset of 0 and a frequency scale of 1.0 is the
+    /// graph itself.
+    struct ModuleVariant
+    {
+      /// The offset added to the seed of each generator module.
+      int seedOffset;
+
+      /// The factor applied to the frequency of each generator module.
+      NOISE_REAL frequencyScale;
+    };
+
+    /// The variant being evaluated on the calling thread, or a null pointer.
+    ///
+    /// Set by the default implementation of Module::GetVariantValues() while
+    /// it calls GetValue() once per variant; the generator modules apply it
+    /// in their GetValue() method.  Applications do not use it directly.
+    extern thread_local const ModuleVariant* g_pActiveVariant;
+
+    /// Returns the number of leading variants whose frequency scale is the
+    /// frequency scale of the first variant.
+    ///
+    /// @param pVariant An array containing the variants.
+    /// @param variantCount The number of variants, at least 1.
+    ///
+    /// @returns The size of the leading group of variants.
+    ///
+    /// Generator modules evaluate such a group in one pass, since the
+    /// variants of the group sample the same lattice cells.
+    inline int GetVariantGroupSize (const ModuleVariant* pVariant,
+      int variantCount)
+    {
+      int groupSize = 1;
+      while (groupSize < variantCount
+        && pVariant[groupSize].frequencyScale == pVariant[0].frequencyScale) {
+        groupSize++;
+      }
+      return groupSize;
+    }
+
+    /// Number of source modules whose pointers are stored inside a noise
+    /// module rather than in a separately allocated array.
+    ///
+    /// This covers every noise module of the library.
+    const int MODULE_INLINE_SOURCE_COUNT = 4;
+
     /// Abstract base class for noise modules.
     ///
     /// A <i>noise module</i> is an object that calculates and outputs a value
@@ -217,6 +279,11 @@ namespace noise
     /// attempts to call the GetValue() method, your module will raise an
     /// assertion.
     ///
+    /// The parallel stages of noise::utils (the noise-map builders among
+    /// them) call the const methods of a module graph from several threads
+    /// at once.  A noise module that keeps state between calls, like
+    /// noise::module::Cache, must keep it per thread or synchronize it.
+    ///
     /// It shouldn't be too difficult to create your own noise module.  If you
     /// still have some problems, take a look at the source code for
     /// noise::module::Add, which is a very simple noise module.
@@ -228,9 +295,84 @@ namespace noise
         /// Constructor.
         Module (int sourceModuleCount);
 
+        /// Copy constructor.
+        ///
+        /// @param m The noise module to copy.
+        ///
+        /// The copy is connected to the same source modules as the original
+        /// noise module; the source modules themselves are not copied.
+        Module (const Module& m);
+
         /// Destructor.
         virtual ~Module ();
 
+        /// Returns the number of output channels of this noise module.
+        ///
+        /// @returns The number of values written by GetChannelValues(), from
+        /// 1 to noise::module::MODULE_MAX_CHANNEL_COUNT.
+        ///
+        /// Most noise modules have a single channel.  A multi-channel noise
+        /// module, such as noise::module::PerlinVector, computes several
+        /// related values per input value in a single pass, sharing the work
+        /// common to all channels; noise modules that need several values at
+        /// the same input value, such as noise::module::Displace, read them
+        /// all with one call to GetChannelValues().
+        virtual int GetChannelCount () const
+        {
+          return 1;
+        }
+
+        /// Generates the values of every output channel given the
+        /// coordinates of the specified input value.
+        ///
+        /// @param x The @a x coordinate of the input value.
+        /// @param y The @a y coordinate of the input value.
+        /// @param out An array that receives GetChannelCount() values.
+        ///
+        /// @pre All source modules required by this noise module have been
+        /// passed to the SetSourceModule() method.
+        ///
+        /// Channel 0 is always the value returned by GetValue().  The default
+        /// implementation calls GetValue().
+        virtual void GetChannelValues (NOISE_REAL x, NOISE_REAL y,
+          NOISE_REAL* out) const
+        {
+          out[0] = GetValue (x, y);
+        }
+
+        /// Generates the output values of several variants of this noise
+        /// module given the coordinates of the specified input value.
+        ///
+        /// @param x The @a x coordinate of the input value.
+        /// @param y The @a y coordinate of the input value.
+        /// @param pVariant An array containing the variants.
+        /// @param variantCount The number of variants.
+        /// @param out An array that receives one output value per variant.
+        ///
+        /// @pre All source modules required by this noise module have been
+        /// passed to the SetSourceModule() method.
+        /// @pre The number of variants does not exceed
+        /// noise::module::MODULE_MAX_VARIANT_COUNT.
+        ///
+        /// Output value @a i is the value that GetValue() would return if
+        /// every generator module of the graph applied variant @a i; see
+        /// noise::module::ModuleVariant.  The variants are evaluated together,
+        /// one lane per variant: generator modules share the coordinate
+        /// transforms and the lattice walk between the lanes, and the
+        /// transformer and combiner modules transform the input value once
+        /// and combine whole lanes.  This is much faster than evaluating the
+        /// graph once per variant, for instance to render a set of thumbnails
+        /// with different seeds.
+        ///
+        /// The default implementation calls GetValue() once per variant with
+        /// the variant active (see noise::module::g_pActiveVariant), which is
+        /// correct for every noise module.  Noise modules override it to
+        /// share work between the lanes; the output values must be identical
+        /// to those of the default implementation.
+        virtual void GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+          const ModuleVariant* pVariant, int variantCount,
+          NOISE_REAL* out) const;
+
         /// Returns a reference to a source module connected to this noise
         /// module.
         ///
@@ -295,6 +437,30 @@ namespace noise
         /// module, call the GetSourceModuleCount() method.
         virtual NOISE_REAL GetValue (NOISE_REAL x, NOISE_REAL y) const = 0;
 
+        /// Generates the output values for a batch of input values.
+        ///
+        /// @param x An array containing the @a x coordinates of the input
+        /// values.
+        /// @param y An array containing the @a y coordinates of the input
+        /// values.
+        /// @param out An array that receives the output values.
+        /// @param count The number of input values in the batch.
+        ///
+        /// @pre All source modules required by this noise module have been
+        /// passed to the SetSourceModule() method.
+        ///
+        /// The default implementation calls GetValue() once for each input
+        /// value.  Noise modules may override this method to amortize the
+        /// per-value overhead over the whole batch; the output values must be
+        /// identical to those returned by GetValue().
+        virtual void GetValues (const NOISE_REAL* x, const NOISE_REAL* y,
+          NOISE_REAL* out, int count) const
+        {
+          for (int i = 0; i < count; i++) {
+            out[i] = GetValue (x[i], y[i]);
+          }
+        }
+
         /// Connects a source module to this noise module.
         ///
         /// @param index An index value to assign to this source module.
@@ -338,10 +504,18 @@ namespace noise
 
         /// An array containing the pointers to each source module required by
         /// this noise module.
+        ///
+        /// For noise modules with up to MODULE_INLINE_SOURCE_COUNT source
+        /// modules, this array is stored inside the noise module itself, so
+        /// the links are read from the same cache lines as the module.
         const Module** m_pSourceModule;
 
       private:
 
+        /// Storage for the source-module pointers of noise modules that
+        /// require few source modules.
+        const Module* m_inlineSourceModule[MODULE_INLINE_SOURCE_COUNT];
+
         /// Assignment operator.
         ///
         /// This assignment operator does nothing and cannot be overridden.
@@ -0,0 +1,122 @@
+// perlinvector.h
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#ifndef NOISE_MODULE_PERLINVECTOR_H
+#define NOISE_MODULE_PERLINVECTOR_H
+
+#include "perlin.h"
+
+namespace noise
+{
+
+  namespace module
+  {
+
+    /// @addtogroup libnoise
+    /// @{
+
+    /// @addtogroup modules
+    /// @{
+
+    /// @addtogroup generatormodules
+    /// @{
+
+    /// Default number of channels for the noise::module::PerlinVector noise
+    /// module.
+    const int DEFAULT_PERLIN_VECTOR_CHANNEL_COUNT = 2;
+
+    /// Maximum number of channels for the noise::module::PerlinVector noise
+    /// module.
+    const int PERLIN_VECTOR_MAX_CHANNEL_COUNT = MODULE_MAX_CHANNEL_COUNT;
+
+    /// Noise module that outputs several channels of Perlin noise at once.
+    ///
+    /// Channel @a i is the Perlin noise that a noise::module::Perlin noise
+    /// module with the same parameters and a seed of @a seed + @a i would
+    /// output, bit for bit; channel 0 is also the value returned by
+    /// GetValue().  GetChannelValues() computes every channel in a single
+    /// pass: at each octave, the lattice cell, the S-curve and the position
+    /// within the cell are shared by all channels, and only the gradients
+    /// differ.  Two channels cost little more than one.
+    ///
+    /// The channels follow the active variant (see
+    /// noise::module::g_pActiveVariant) like Perlin::GetValue() does: under
+    /// a variant, channel @a i is still the output of the matching
+    /// noise::module::Perlin noise module, so a graph that displaces by a
+    /// PerlinVector evaluates every variant consistently.
+    ///
+    /// This makes it the natural displacement field for domain warping: pass
+    /// a two-channel PerlinVector to
+    /// noise::module::Displace::SetDisplaceVectorModule(), or enable
+    /// noise::module::Turbulence::SetJointDistortion().
+    ///
+    /// This noise module does not require any source modules.
+    class PerlinVector: public Perlin
+    {
+
+      public:
+
+        /// Constructor.
+        ///
+        /// The default number of channels is set to
+        /// noise::module::DEFAULT_PERLIN_VECTOR_CHANNEL_COUNT.
+        PerlinVector ();
+
+        virtual int GetChannelCount () const
+        {
+          return m_channelCount;
+        }
+
+        virtual void GetChannelValues (NOISE_REAL x, NOISE_REAL y,
+          NOISE_REAL* out) const;
+
+        /// Sets the number of channels.
+        ///
+        /// @param channelCount The number of channels.
+        ///
+        /// @pre The number of channels ranges from 1 to
+        /// noise::module::PERLIN_VECTOR_MAX_CHANNEL_COUNT.
+        ///
+        /// @throw noise::ExceptionInvalidParam An invalid parameter was
+        /// specified; see the preconditions for more information.
+        void SetChannelCount (int channelCount)
+        {
+          if (channelCount < 1
+            || channelCount > PERLIN_VECTOR_MAX_CHANNEL_COUNT) {
+            throw noise::ExceptionInvalidParam ();
+          }
+          m_channelCount = channelCount;
+        }
+
+      protected:
+
+        /// Number of channels.
+        int m_channelCount;
+
+    };
+
+    /// @}
+
+    /// @}
+
+    /// @}
+
+  }
+
+}
+
+#endif
@@ -78,6 +78,11 @@ namespace noise
 	      /// Constructor.
 	      Terrace ();
 
+	      /// Copy constructor.
+	      ///
+	      /// @param m The noise module to copy, with its control points.
+	      Terrace (const Terrace& m);
+
 	      /// Destructor.
 	      ~Terrace ();
 
@@ -23,7 +23,7 @@
 #ifndef NOISE_MODULE_TURBULENCE_H
 #define NOISE_MODULE_TURBULENCE_H
 
-#include "perlin.h"
+#include "perlinvector.h"
 
 namespace noise
 {
@@ -109,6 +109,18 @@ namespace noise
     /// that displace the input value; one for the @a x, one for the @a y,
     /// and one for the @a z coordinate.
     ///
+    /// <b>Joint distortion</b>
+    ///
+    /// By default, the @a x and @a y displacements are sampled at two
+    /// different offsets of the input value, so each one walks the noise
+    /// lattice on its own.  With SetJointDistortion(), both displacements
+    /// are sampled at the same point by a two-channel
+    /// noise::module::PerlinVector noise module, which shares the lattice
+    /// walk between them and nearly halves the cost of the displacement.
+    /// The @a x displacement is unchanged; the @a y displacement is the same
+    /// kind of noise, sampled elsewhere, so the output differs from the
+    /// default mode.
+    ///
     /// This noise module requires one source module.
     class Turbulence: public Module
     {
@@ -138,6 +150,18 @@ namespace noise
         /// displacement amount changes.
         NOISE_REAL GetFrequency () const;
 
+        /// Determines if the displacements share their lattice walk.
+        ///
+        /// @returns
+        /// - @a true if the displacements are computed jointly.
+        /// - @a false if they are computed separately.
+        ///
+        /// See SetJointDistortion().
+        bool GetJointDistortion () const
+        {
+          return m_jointDistortion;
+        }
+
         /// Returns the power of the turbulence.
         ///
         /// @returns The power of the turbulence.
@@ -191,6 +215,19 @@ namespace noise
           m_xDistortModule.SetFrequency (frequency);
           m_yDistortModule.SetFrequency (frequency);
           m_zDistortModule.SetFrequency (frequency);
+          m_distortVectorModule.SetFrequency (frequency);
+        }
+
+        /// Enables or disables the joint computation of the displacements.
+        ///
+        /// @param jointDistortion @a true to compute the @a x and @a y
+        /// displacements jointly.
+        ///
+        /// Joint distortion is faster, but produces a different output; see
+        /// the class description.  It is disabled by default.
+        void SetJointDistortion (bool jointDistortion)
+        {
+          m_jointDistortion = jointDistortion;
         }
 
         /// Sets the power of the turbulence.
@@ -224,6 +261,7 @@ namespace noise
           m_xDistortModule.SetOctaveCount (roughness);
           m_yDistortModule.SetOctaveCount (roughness);
           m_zDistortModule.SetOctaveCount (roughness);
+          m_distortVectorModule.SetOctaveCount (roughness);
         }
 
         /// Sets the seed value of the internal noise modules that are used to
@@ -242,6 +280,12 @@ namespace noise
 
       protected:
 
+        /// Noise module that displaces the @a x and @a y coordinates jointly.
+        PerlinVector m_distortVectorModule;
+
+        /// Determines if the displacements are computed jointly.
+        bool m_jointDistortion;
+
         /// The power (scale) of the displacement.
         NOISE_REAL m_power;
 
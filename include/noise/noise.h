@@ -69,6 +69,7 @@
 
 #include "module/module.h"
 #include "model/model.h"
+#include "latency.h"
 #include "misc.h"
 
 #endif
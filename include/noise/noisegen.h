@@ -78,6 +78,24 @@ namespace noise
   NOISE_REAL GradientCoherentNoise2D (NOISE_REAL x, NOISE_REAL y, int seed = 0,
     NoiseQuality noiseQuality = QUALITY_STD);
 
+  /// Generates gradient-coherent-noise values for several seeds from the
+  /// coordinates of a two-dimensional input value.
+  ///
+  /// @param x The @a x coordinate of the input value.
+  /// @param y The @a y coordinate of the input value.
+  /// @param pSeed The random number seeds, one per output value.
+  /// @param seedCount The number of seeds.
+  /// @param pValue Receives one gradient-coherent-noise value per seed.
+  /// @param noiseQuality The quality of the coherent-noise.
+  ///
+  /// Each output value is exactly the value returned by
+  /// GradientCoherentNoise2D() for the corresponding seed.  The lattice cell,
+  /// the S-curve and the position within the cell are only computed once, so
+  /// this function is faster than one call per seed.
+  void GradientCoherentNoise2DMultiSeed (NOISE_REAL x, NOISE_REAL y,
+    const int* pSeed, int seedCount, NOISE_REAL* pValue,
+    NoiseQuality noiseQuality = QUALITY_STD);
+
   /// Generates a gradient-noise value from the coordinates of a
   /// two-dimensional input value and the integer coordinates of a
   /// nearby two-dimensional value.
@@ -0,0 +1,130 @@
+// LibnoiseArena.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <stdint.h>
+
+#include "LibnoiseArena.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+
+//////////////////////////////////////////////////////////////////////////////
+// GraphArena class
+
+GraphArena::GraphArena(size_t blockSize):
+    m_blockSize(blockSize > 0 ? blockSize : DEFAULT_GRAPH_ARENA_BLOCK_SIZE),
+    m_capacity(0),
+    m_offset(0),
+    m_usedSize(0)
+{
+}
+
+GraphArena::~GraphArena()
+{
+    Clear();
+}
+
+void* GraphArena::Allocate(size_t size, size_t alignment)
+{
+    if (!m_blocks.empty())
+    {
+        const Block& block = m_blocks.back();
+        uintptr_t address = (uintptr_t)(block.pMemory + m_offset);
+        size_t padding = (size_t)((alignment - (address & (alignment - 1)))
+            & (alignment - 1));
+        if (m_offset + padding + size <= block.size)
+        {
+            m_offset += padding + size;
+            m_usedSize += padding + size;
+            return (void*)(address + padding);
+        }
+    }
+
+    // Start a new block; the end of the current one stays unused.
+    size_t blockSize = size + alignment;
+    if (blockSize < m_blockSize)
+    {
+        blockSize = m_blockSize;
+    }
+    ReserveMemory(MEMORY_ARENA, blockSize);
+    Block block;
+    block.pMemory = new (std::nothrow) char[blockSize];
+    if (block.pMemory == NULL)
+    {
+        ReleaseMemory(MEMORY_ARENA, blockSize);
+        throw noise::ExceptionOutOfMemory();
+    }
+    block.size = blockSize;
+    try
+    {
+        m_blocks.push_back(block);
+    }
+    catch (...)
+    {
+        delete[] block.pMemory;
+        ReleaseMemory(MEMORY_ARENA, blockSize);
+        throw noise::ExceptionOutOfMemory();
+    }
+    m_capacity += blockSize;
+    m_offset = 0;
+    return Allocate(size, alignment);
+}
+
+void GraphArena::Clear()
+{
+    for (size_t i = m_modules.size(); i > 0; i--)
+    {
+        m_modules[i - 1]->~Module();
+    }
+    m_modules.clear();
+
+    for (size_t i = 0; i < m_blocks.size(); i++)
+    {
+        delete[] m_blocks[i].pMemory;
+    }
+    m_blocks.clear();
+    ReleaseMemory(MEMORY_ARENA, m_capacity);
+    m_capacity = 0;
+    m_offset = 0;
+    m_usedSize = 0;
+}
+
+void GraphArena::Deallocate(size_t blockCount, size_t offset,
+    size_t usedSize)
+{
+    // If Allocate() started a new block, the block stays empty and the end
+    // of the previous one stays unused.
+    m_offset = m_blocks.size() == blockCount ? offset : 0;
+    m_usedSize = usedSize;
+}
+
+void GraphArena::ReserveModule()
+{
+    if (m_modules.size() < m_modules.capacity())
+    {
+        return;
+    }
+    try
+    {
+        m_modules.reserve(2 * m_modules.size() + 1);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+}
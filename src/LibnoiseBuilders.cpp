@@ -0,0 +1,385 @@
+// LibnoiseBuilders.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <vector>
+
+#include <interp.h>
+
+#include "LibnoiseBuilders.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+
+//////////////////////////////////////////////////////////////////////////////
+// AdaptiveNoiseMapBuilder class
+
+AdaptiveNoiseMapBuilder::AdaptiveNoiseMapBuilder():
+    m_evaluatedSampleCount(0),
+    m_initialCellSize(DEFAULT_ADAPTIVE_CELL_SIZE),
+    m_tolerance(DEFAULT_ADAPTIVE_TOLERANCE)
+{
+}
+
+void AdaptiveNoiseMapBuilder::Build()
+{
+    if (m_upperXBound <= m_lowerXBound
+        || m_upperZBound <= m_lowerZBound
+        || m_destWidth <= 0
+        || m_destHeight <= 0
+        || m_pSourceModule == NULL
+        || m_pDestNoiseMap == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_pDestNoiseMap->SetSize(m_destWidth, m_destHeight);
+    int threadCount = GetEffectiveConfig().threadCount;
+
+    // Positions of the coarse lattice.  The last row and column of the noise
+    // map are always part of the lattice, so the cells along the top and
+    // right edges may be narrower than the others.
+    std::vector<int> latticeX, latticeZ;
+    for (int x = 0; x < m_destWidth - 1; x += m_initialCellSize)
+    {
+        latticeX.push_back(x);
+    }
+    latticeX.push_back(m_destWidth - 1);
+    for (int z = 0; z < m_destHeight - 1; z += m_initialCellSize)
+    {
+        latticeZ.push_back(z);
+    }
+    latticeZ.push_back(m_destHeight - 1);
+    int latticeWidth  = (int)latticeX.size();
+    int latticeHeight = (int)latticeZ.size();
+
+    if (latticeWidth == 1 || latticeHeight == 1)
+    {
+        // The noise map is a single row or column; there are no cells to
+        // interpolate, so evaluate every point directly.
+        for (int z = 0; z < m_destHeight; z++)
+        {
+            for (int x = 0; x < m_destWidth; x++)
+            {
+                m_pDestNoiseMap->SetValue(x, z,
+                    (float)GetPointValue((NOISE_REAL)x, (NOISE_REAL)z));
+            }
+        }
+        m_evaluatedSampleCount = (size_t)m_destWidth * (size_t)m_destHeight;
+        return;
+    }
+
+    size_t latticeBytes = (size_t)latticeWidth * (size_t)latticeHeight
+        * sizeof(NOISE_REAL);
+    MemoryReservation reservation(MEMORY_SCRATCH, latticeBytes);
+    std::vector<NOISE_REAL> lattice((size_t)latticeWidth * (size_t)latticeHeight);
+
+    // Evaluate the coarse lattice.
+    ParallelFor(latticeHeight, threadCount,
+        [&](int j, int)
+        {
+            for (int i = 0; i < latticeWidth; i++)
+            {
+                lattice[(size_t)j * latticeWidth + i] = GetPointValue(
+                    (NOISE_REAL)latticeX[i], (NOISE_REAL)latticeZ[j]);
+            }
+        });
+    size_t sampleCount = lattice.size();
+
+    // Refine each row of cells in parallel.  Every cell only writes the points
+    // it owns, so the workers never write the same point.
+    std::vector<size_t> workerSampleCounts(
+        (size_t)ResolveThreadCount(threadCount), 0);
+    ParallelFor(latticeHeight - 1, (int)workerSampleCounts.size(),
+        [&](int j, int worker)
+        {
+            const NOISE_REAL* pRow0 = &lattice[(size_t)j * latticeWidth];
+            const NOISE_REAL* pRow1 = pRow0 + latticeWidth;
+            for (int i = 0; i < latticeWidth - 1; i++)
+            {
+                workerSampleCounts[worker] += RefineCell(
+                    latticeX[i], latticeZ[j], latticeX[i + 1], latticeZ[j + 1],
+                    pRow0[i], pRow0[i + 1], pRow1[i], pRow1[i + 1]);
+            }
+        });
+    for (size_t i = 0; i < workerSampleCounts.size(); i++)
+    {
+        sampleCount += workerSampleCounts[i];
+    }
+    m_evaluatedSampleCount = sampleCount;
+}
+
+void AdaptiveNoiseMapBuilder::FillCell(int x0, int z0, int x1, int z1,
+    NOISE_REAL v00, NOISE_REAL v10, NOISE_REAL v01, NOISE_REAL v11) const
+{
+    int xEnd = (x1 == m_destWidth  - 1) ? x1 + 1 : x1;
+    int zEnd = (z1 == m_destHeight - 1) ? z1 + 1 : z1;
+    NOISE_REAL xScale = (x1 > x0) ? 1.0 / (NOISE_REAL)(x1 - x0) : 0.0;
+    NOISE_REAL zScale = (z1 > z0) ? 1.0 / (NOISE_REAL)(z1 - z0) : 0.0;
+    for (int z = z0; z < zEnd; z++)
+    {
+        NOISE_REAL zAlpha = (NOISE_REAL)(z - z0) * zScale;
+        NOISE_REAL left  = LinearInterp(v00, v01, zAlpha);
+        NOISE_REAL right = LinearInterp(v10, v11, zAlpha);
+        float* pDest = m_pDestNoiseMap->GetSlabPtr(x0, z);
+        for (int x = x0; x < xEnd; x++)
+        {
+            *pDest++ = (float)LinearInterp(left, right,
+                (NOISE_REAL)(x - x0) * xScale);
+        }
+    }
+}
+
+size_t AdaptiveNoiseMapBuilder::RefineCell(int x0, int z0, int x1, int z1,
+    NOISE_REAL v00, NOISE_REAL v10, NOISE_REAL v01, NOISE_REAL v11) const
+{
+    bool splitX = (x1 - x0 >= 2);
+    bool splitZ = (z1 - z0 >= 2);
+    if (!splitX && !splitZ)
+    {
+        // Every point of the cell is a corner, and the corners are exact.
+        FillCell(x0, z0, x1, z1, v00, v10, v01, v11);
+        return 0;
+    }
+
+    int xm = splitX ? (x0 + x1) / 2 : x0;
+    int zm = splitZ ? (z0 + z1) / 2 : z0;
+    NOISE_REAL xAlpha = (NOISE_REAL)(xm - x0) / (NOISE_REAL)(x1 - x0);
+    NOISE_REAL zAlpha = (z1 > z0)
+        ? (NOISE_REAL)(zm - z0) / (NOISE_REAL)(z1 - z0) : 0.0;
+
+    // Evaluate the test points and compare them with their interpolated
+    // values.
+    size_t sampleCount = 0;
+    NOISE_REAL maxError = 0.0;
+    NOISE_REAL bottom = 0.0, top = 0.0, left = 0.0, right = 0.0, center = 0.0;
+    if (splitX)
+    {
+        bottom = GetPointValue((NOISE_REAL)xm, (NOISE_REAL)z0);
+        top    = GetPointValue((NOISE_REAL)xm, (NOISE_REAL)z1);
+        sampleCount += 2;
+        maxError = GetMax(maxError,
+            std::abs(bottom - LinearInterp(v00, v10, xAlpha)));
+        maxError = GetMax(maxError,
+            std::abs(top    - LinearInterp(v01, v11, xAlpha)));
+    }
+    if (splitZ)
+    {
+        left  = GetPointValue((NOISE_REAL)x0, (NOISE_REAL)zm);
+        right = GetPointValue((NOISE_REAL)x1, (NOISE_REAL)zm);
+        sampleCount += 2;
+        maxError = GetMax(maxError,
+            std::abs(left  - LinearInterp(v00, v01, zAlpha)));
+        maxError = GetMax(maxError,
+            std::abs(right - LinearInterp(v10, v11, zAlpha)));
+    }
+    if (splitX && splitZ)
+    {
+        center = GetPointValue((NOISE_REAL)xm, (NOISE_REAL)zm);
+        sampleCount += 1;
+        maxError = GetMax(maxError, std::abs(center - LinearInterp(
+            LinearInterp(v00, v10, xAlpha), LinearInterp(v01, v11, xAlpha),
+            zAlpha)));
+    }
+
+    if (maxError <= m_tolerance)
+    {
+        // Interpolation is accurate enough.  Keep the exact values of the test
+        // points that this cell owns.
+        FillCell(x0, z0, x1, z1, v00, v10, v01, v11);
+        if (splitX)
+        {
+            m_pDestNoiseMap->SetValue(xm, z0, (float)bottom);
+            if (z1 == m_destHeight - 1)
+            {
+                m_pDestNoiseMap->SetValue(xm, z1, (float)top);
+            }
+        }
+        if (splitZ)
+        {
+            m_pDestNoiseMap->SetValue(x0, zm, (float)left);
+            if (x1 == m_destWidth - 1)
+            {
+                m_pDestNoiseMap->SetValue(x1, zm, (float)right);
+            }
+        }
+        if (splitX && splitZ)
+        {
+            m_pDestNoiseMap->SetValue(xm, zm, (float)center);
+        }
+        return sampleCount;
+    }
+
+    // Split the cell along the axes that are wide enough and refine the
+    // halves or quarters.
+    if (splitX && splitZ)
+    {
+        sampleCount += RefineCell(x0, z0, xm, zm, v00, bottom, left, center);
+        sampleCount += RefineCell(xm, z0, x1, zm, bottom, v10, center, right);
+        sampleCount += RefineCell(x0, zm, xm, z1, left, center, v01, top);
+        sampleCount += RefineCell(xm, zm, x1, z1, center, right, top, v11);
+    }
+    else if (splitX)
+    {
+        sampleCount += RefineCell(x0, z0, xm, z1, v00, bottom, v01, top);
+        sampleCount += RefineCell(xm, z0, x1, z1, bottom, v10, top, v11);
+    }
+    else
+    {
+        sampleCount += RefineCell(x0, z0, x1, zm, v00, v10, left, right);
+        sampleCount += RefineCell(x0, zm, x1, z1, left, right, v01, v11);
+    }
+    return sampleCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SupersamplingNoiseMapBuilder class
+
+SupersamplingNoiseMapBuilder::SupersamplingNoiseMapBuilder():
+    m_evaluatedSampleCount(0),
+    m_maxSampleCount(DEFAULT_SUPERSAMPLING_MAX_SAMPLES),
+    m_supersampledPointCount(0),
+    m_threshold(DEFAULT_SUPERSAMPLING_THRESHOLD)
+{
+}
+
+void SupersamplingNoiseMapBuilder::Build()
+{
+    if (m_upperXBound <= m_lowerXBound
+        || m_upperZBound <= m_lowerZBound
+        || m_destWidth <= 0
+        || m_destHeight <= 0
+        || m_pSourceModule == NULL
+        || m_pDestNoiseMap == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // First pass: one sample per point.
+    m_pDestNoiseMap->SetSize(m_destWidth, m_destHeight);
+    BuildConfig config = GetEffectiveConfig();
+    BuildBand(*m_pDestNoiseMap, 0, m_destHeight, config);
+
+    // Second pass: resample the points with a high variation.  The variation
+    // is measured on an untouched copy of the first pass, so that the result
+    // does not depend on the order in which the tiles are processed.
+    NoiseMap firstPass(*m_pDestNoiseMap);
+    int tileCountX = (m_destWidth  + config.tileWidth  - 1) / config.tileWidth ;
+    int tileCountZ = (m_destHeight + config.tileHeight - 1) / config.tileHeight;
+    int threadCount = ResolveThreadCount(config.threadCount);
+    std::vector<size_t> workerSampleCounts((size_t)threadCount, 0);
+    std::vector<size_t> workerPointCounts ((size_t)threadCount, 0);
+    ParallelFor(tileCountX * tileCountZ, threadCount,
+        [&](int tile, int worker)
+        {
+            int x0 = (tile % tileCountX) * config.tileWidth ;
+            int z0 = (tile / tileCountX) * config.tileHeight;
+            workerSampleCounts[worker] += SupersampleTile(firstPass, x0, z0,
+                GetMin(config.tileWidth , m_destWidth  - x0),
+                GetMin(config.tileHeight, m_destHeight - z0),
+                workerPointCounts[worker]);
+        });
+
+    m_evaluatedSampleCount = (size_t)m_destWidth * (size_t)m_destHeight;
+    m_supersampledPointCount = 0;
+    for (int i = 0; i < threadCount; i++)
+    {
+        m_evaluatedSampleCount += workerSampleCounts[i];
+        m_supersampledPointCount += workerPointCounts[i];
+    }
+}
+
+size_t SupersamplingNoiseMapBuilder::SupersampleTile(const NoiseMap& source,
+    int x0, int z0, int width, int height, size_t& pointCount) const
+{
+    // The largest pattern that fits in the maximum sample count.
+    int maxGridSize = 2;
+    while ((maxGridSize + 1) * (maxGridSize + 1) <= m_maxSampleCount)
+    {
+        maxGridSize++;
+    }
+
+    size_t sampleCount = 0;
+    for (int z = z0; z < z0 + height; z++)
+    {
+        for (int x = x0; x < x0 + width; x++)
+        {
+            // Estimate the variation from the four neighbours that lie inside
+            // the noise map.
+            float value = *source.GetConstSlabPtr(x, z);
+            float variation = 0.0f;
+            if (x > 0)
+            {
+                variation = GetMax(variation,
+                    std::abs(value - *source.GetConstSlabPtr(x - 1, z)));
+            }
+            if (x < m_destWidth - 1)
+            {
+                variation = GetMax(variation,
+                    std::abs(value - *source.GetConstSlabPtr(x + 1, z)));
+            }
+            if (z > 0)
+            {
+                variation = GetMax(variation,
+                    std::abs(value - *source.GetConstSlabPtr(x, z - 1)));
+            }
+            if (z < m_destHeight - 1)
+            {
+                variation = GetMax(variation,
+                    std::abs(value - *source.GetConstSlabPtr(x, z + 1)));
+            }
+            if (variation <= m_threshold)
+            {
+                continue;
+            }
+
+            // Take one jittered sample in each stratum of an n x n grid that
+            // covers the footprint of the point.  The grid size is clamped
+            // before the conversion to int; a NaN or infinite variation gets
+            // the largest grid.
+            NOISE_REAL gridScale = 1.0 + variation / m_threshold;
+            int gridSize = maxGridSize;
+            if (gridScale < (NOISE_REAL)maxGridSize)
+            {
+                gridSize = (int)gridScale;
+            }
+            NOISE_REAL stratumSize = 1.0 / (NOISE_REAL)gridSize;
+            NOISE_REAL sum = 0.0;
+            for (int j = 0; j < gridSize; j++)
+            {
+                for (int i = 0; i < gridSize; i++)
+                {
+                    int xKey = x * gridSize + i;
+                    int zKey = z * gridSize + j;
+                    NOISE_REAL xJitter = (NOISE_REAL)IntValueNoise2D(xKey, zKey, 0)
+                        / 2147483648.0;
+                    NOISE_REAL zJitter = (NOISE_REAL)IntValueNoise2D(xKey, zKey, 1)
+                        / 2147483648.0;
+                    sum += GetPointValue(
+                        (NOISE_REAL)x - 0.5 + ((NOISE_REAL)i + xJitter) * stratumSize,
+                        (NOISE_REAL)z - 0.5 + ((NOISE_REAL)j + zJitter) * stratumSize);
+                }
+            }
+            m_pDestNoiseMap->SetValue(x, z,
+                (float)(sum / (NOISE_REAL)(gridSize * gridSize)));
+            sampleCount += (size_t)(gridSize * gridSize);
+            pointCount++;
+        }
+    }
+    return sampleCount;
+}
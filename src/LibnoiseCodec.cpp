@@ -0,0 +1,675 @@
+// LibnoiseCodec.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <math.h>
+#include <string.h>
+
+#include "LibnoiseCodec.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // "NHMC" in little-endian order.
+    const uint32 CODEC_MAGIC = 0x434d484e;
+
+    // Version of the stream format.
+    const uint32 CODEC_VERSION = 1;
+
+    // Size of the stream header: magic, version, width, height, tile size,
+    // quantization step, maximum error.
+    const size_t CODEC_HEADER_SIZE = 32;
+
+    // Zero bytes at the end of the stream, so that the unpacking can always
+    // load eight bytes.
+    const size_t CODEC_PADDING = 8;
+
+    // Limits of the tile size.
+    const int CODEC_MIN_TILE_SIZE = 8;
+    const int CODEC_MAX_TILE_SIZE = 1024;
+
+    // Largest magnitude of a quantized value.  The Lorenzo residual of four
+    // such values fits in 32 bits.
+    const double CODEC_MAX_QUANTUM = (double)(1 << 28);
+
+    // Tile encodings.
+    const uint8 TILE_PACKED = 0;
+    const uint8 TILE_RAW = 1;
+
+    void StoreLE32(uint8* p, uint32 value)
+    {
+        p[0] = (uint8)value;
+        p[1] = (uint8)(value >> 8);
+        p[2] = (uint8)(value >> 16);
+        p[3] = (uint8)(value >> 24);
+    }
+
+    void StoreLE64(uint8* p, uint64 value)
+    {
+        StoreLE32(p, (uint32)value);
+        StoreLE32(p + 4, (uint32)(value >> 32));
+    }
+
+    uint32 LoadLE32(const uint8* p)
+    {
+        return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16)
+            | ((uint32)p[3] << 24);
+    }
+
+    // Compilers turn this into a single load on little-endian hosts.
+    uint64 LoadLE64(const uint8* p)
+    {
+        return (uint64)LoadLE32(p) | ((uint64)LoadLE32(p + 4) << 32);
+    }
+
+    uint32 FloatToBits(float value)
+    {
+        uint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    float BitsToFloat(uint32 bits)
+    {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint64 DoubleToBits(double value)
+    {
+        uint64 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    double BitsToDouble(uint64 bits)
+    {
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint32 EncodeZigZag(int32 value)
+    {
+        return ((uint32)value << 1) ^ (uint32)(value >> 31);
+    }
+
+    int32 DecodeZigZag(uint32 value)
+    {
+        return (int32)(value >> 1) ^ -(int32)(value & 1);
+    }
+
+    // Quantizes a tile.  Returns false if a value cannot be quantized within
+    // the maximum error; the tile is then stored raw.  The reconstruction is
+    // computed exactly as the decoder computes it.
+    bool QuantizeTile(const NoiseMap& heightMap, int x0, int z0, int width,
+        int height, float step, double maxError, int32* pQuanta)
+    {
+        for (int z = 0; z < height; z++)
+        {
+            const float* pSource = heightMap.GetConstSlabPtr(x0, z0 + z);
+            int32* pRow = pQuanta + (size_t)z * (size_t)width;
+            for (int x = 0; x < width; x++)
+            {
+                double value = (double)pSource[x];
+                double quantum = floor(value / (double)step + 0.5);
+                if (!(fabs(quantum) <= CODEC_MAX_QUANTUM))
+                {
+                    return false;
+                }
+
+                // The division and the float reconstruction round; one of
+                // the neighbouring quanta may be the one within the bound.
+                int32 k = (int32)quantum;
+                bool isFound = false;
+                for (int delta = 0; delta < 3 && !isFound; delta++)
+                {
+                    int32 candidate = k + ((delta == 2) ? -1 : delta);
+                    float decoded = (float)candidate * step;
+                    if (fabs((double)decoded - value) <= maxError)
+                    {
+                        k = candidate;
+                        isFound = true;
+                    }
+                }
+                if (!isFound)
+                {
+                    return false;
+                }
+                pRow[x] = k;
+            }
+        }
+        return true;
+    }
+
+    // Appends the packed residuals of a quantized tile.
+    void PackTile(const int32* pQuanta, int width, int height,
+        std::vector<uint8>& tile)
+    {
+        int count = width * height;
+        uint32 block[CODEC_BLOCK_SIZE];
+        for (int start = 0; start < count; start += CODEC_BLOCK_SIZE)
+        {
+            // Lorenzo residuals; the points outside the tile are zero.
+            uint32 bits = 0;
+            for (int i = 0; i < CODEC_BLOCK_SIZE; i++)
+            {
+                int index = start + i;
+                if (index >= count)
+                {
+                    block[i] = 0;
+                    continue;
+                }
+                int x = index % width;
+                int z = index / width;
+                const int32* pRow = pQuanta + (size_t)z * (size_t)width;
+                int32 left = (x > 0) ? pRow[x - 1] : 0;
+                int32 up = (z > 0) ? pRow[x - width] : 0;
+                int32 upLeft = (x > 0 && z > 0) ? pRow[x - width - 1] : 0;
+                block[i] = EncodeZigZag(pRow[x] - left - up + upLeft);
+                bits |= block[i];
+            }
+
+            int blockWidth = 0;
+            while (blockWidth < 32 && (bits >> blockWidth) != 0)
+            {
+                blockWidth++;
+            }
+            tile.push_back((uint8)blockWidth);
+
+            uint64 accumulator = 0;
+            int accumulated = 0;
+            for (int i = 0; i < CODEC_BLOCK_SIZE; i++)
+            {
+                accumulator |= (uint64)block[i] << accumulated;
+                accumulated += blockWidth;
+                while (accumulated >= 8)
+                {
+                    tile.push_back((uint8)accumulator);
+                    accumulator >>= 8;
+                    accumulated -= 8;
+                }
+            }
+        }
+    }
+
+    // Unpacks a block of residuals of a given bit width.  The block holds
+    // 4 * BLOCK_WIDTH bytes.  With the width known, the shifts and the masks
+    // are constants and the loop is unrolled.
+    template<int BLOCK_WIDTH>
+    void UnpackBlock(const uint8* pBlock, uint32* pDest)
+    {
+        const uint64 mask = ((uint64)1 << BLOCK_WIDTH) - 1;
+        for (int i = 0; i < CODEC_BLOCK_SIZE; i++)
+        {
+            const int bit = i * BLOCK_WIDTH;
+            pDest[i] = (uint32)((LoadLE64(pBlock + (bit >> 3)) >> (bit & 7))
+                & mask);
+        }
+    }
+
+    template<>
+    void UnpackBlock<0>(const uint8*, uint32* pDest)
+    {
+        for (int i = 0; i < CODEC_BLOCK_SIZE; i++)
+        {
+            pDest[i] = 0;
+        }
+    }
+
+    typedef void (*UnpackFunction)(const uint8*, uint32*);
+
+    // Unpacking functions, indexed by bit width.
+    const UnpackFunction UNPACK_FUNCTIONS[33] = {
+        UnpackBlock<0>, UnpackBlock<1>, UnpackBlock<2>, UnpackBlock<3>,
+        UnpackBlock<4>, UnpackBlock<5>, UnpackBlock<6>, UnpackBlock<7>,
+        UnpackBlock<8>, UnpackBlock<9>, UnpackBlock<10>, UnpackBlock<11>,
+        UnpackBlock<12>, UnpackBlock<13>, UnpackBlock<14>, UnpackBlock<15>,
+        UnpackBlock<16>, UnpackBlock<17>, UnpackBlock<18>, UnpackBlock<19>,
+        UnpackBlock<20>, UnpackBlock<21>, UnpackBlock<22>, UnpackBlock<23>,
+        UnpackBlock<24>, UnpackBlock<25>, UnpackBlock<26>, UnpackBlock<27>,
+        UnpackBlock<28>, UnpackBlock<29>, UnpackBlock<30>, UnpackBlock<31>,
+        UnpackBlock<32>
+    };
+
+    // Decodes a packed tile.  @a pResiduals holds the tile size rounded up to
+    // a block; @a pRows holds two rows.
+    void DecodePackedTile(const uint8* pTile, int width, int height,
+        float step, float* pDest, int destStride, uint32* pResiduals,
+        int32* pRows)
+    {
+        int count = width * height;
+        const uint8* pBlock = pTile;
+        for (int start = 0; start < count; start += CODEC_BLOCK_SIZE)
+        {
+            int blockWidth = GetMin((int)pBlock[0], 32);
+            UNPACK_FUNCTIONS[blockWidth](pBlock + 1, pResiduals + start);
+            pBlock += 1 + 4 * blockWidth;
+        }
+
+        // The quantum of a point is the quantum above it plus the running sum
+        // of the residuals of its row.
+        int32* pPrevious = pRows;
+        int32* pCurrent = pRows + width;
+        for (int x = 0; x < width; x++)
+        {
+            pPrevious[x] = 0;
+        }
+        for (int z = 0; z < height; z++)
+        {
+            const uint32* pRow = pResiduals + (size_t)z * (size_t)width;
+            int32 sum = 0;
+            for (int x = 0; x < width; x++)
+            {
+                sum += DecodeZigZag(pRow[x]);
+                pCurrent[x] = pPrevious[x] + sum;
+            }
+            float* pLine = pDest + (size_t)z * (size_t)destStride;
+            for (int x = 0; x < width; x++)
+            {
+                pLine[x] = (float)pCurrent[x] * step;
+            }
+            int32* pSwap = pPrevious;
+            pPrevious = pCurrent;
+            pCurrent = pSwap;
+        }
+    }
+
+    // Scratch space of one decoding worker.
+    struct DecodeScratch
+    {
+        std::vector<uint32> residuals;
+        std::vector<int32> rows;
+    };
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// HeightMapEncoder class
+
+HeightMapEncoder::HeightMapEncoder():
+    m_maxError(0.001),
+    m_threadCount(0),
+    m_tileSize(DEFAULT_CODEC_TILE_SIZE)
+{
+}
+
+void HeightMapEncoder::Encode(const NoiseMap& heightMap,
+    std::vector<uint8>& stream) const
+{
+    int width = heightMap.GetWidth();
+    int height = heightMap.GetHeight();
+    if (width <= 0 || height <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int tileSize = m_tileSize;
+    int tileCountX = (width + tileSize - 1) / tileSize;
+    int tileCountZ = (height + tileSize - 1) / tileSize;
+    int tileCount = tileCountX * tileCountZ;
+    int threadCount = ResolveThreadCount(m_threadCount);
+    float step = (float)(2.0 * m_maxError);
+    double maxError = m_maxError;
+
+    MemoryReservation reservation(MEMORY_SCRATCH, (size_t)threadCount
+        * (size_t)tileSize * (size_t)tileSize * sizeof(int32));
+    std::vector<std::vector<int32> > quanta((size_t)threadCount);
+    std::vector<std::vector<uint8> > tiles((size_t)tileCount);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            quanta[i].resize((size_t)tileSize * (size_t)tileSize);
+        }
+
+        ParallelFor(tileCount, threadCount,
+            [&](int tileIndex, int worker)
+            {
+                int x0 = (tileIndex % tileCountX) * tileSize;
+                int z0 = (tileIndex / tileCountX) * tileSize;
+                int tileWidth = GetMin(tileSize, width - x0);
+                int tileHeight = GetMin(tileSize, height - z0);
+                int32* pQuanta = &quanta[worker][0];
+                std::vector<uint8>& tile = tiles[tileIndex];
+                if (QuantizeTile(heightMap, x0, z0, tileWidth, tileHeight,
+                    step, maxError, pQuanta))
+                {
+                    tile.push_back(TILE_PACKED);
+                    PackTile(pQuanta, tileWidth, tileHeight, tile);
+                    return;
+                }
+
+                tile.resize(1 + (size_t)tileWidth * (size_t)tileHeight * 4);
+                tile[0] = TILE_RAW;
+                uint8* pRaw = &tile[1];
+                for (int z = 0; z < tileHeight; z++)
+                {
+                    const float* pSource = heightMap.GetConstSlabPtr(x0, z0 + z);
+                    for (int x = 0; x < tileWidth; x++)
+                    {
+                        StoreLE32(pRaw, FloatToBits(pSource[x]));
+                        pRaw += 4;
+                    }
+                }
+            });
+
+        size_t offsetTableSize = ((size_t)tileCount + 1) * sizeof(uint64);
+        size_t size = CODEC_HEADER_SIZE + offsetTableSize;
+        for (int i = 0; i < tileCount; i++)
+        {
+            size += tiles[i].size();
+        }
+        stream.assign(size + CODEC_PADDING, 0);
+    }
+    catch (noise::Exception&)
+    {
+        throw;
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    uint8* pStream = &stream[0];
+    StoreLE32(pStream, CODEC_MAGIC);
+    StoreLE32(pStream + 4, CODEC_VERSION);
+    StoreLE32(pStream + 8, (uint32)width);
+    StoreLE32(pStream + 12, (uint32)height);
+    StoreLE32(pStream + 16, (uint32)tileSize);
+    StoreLE32(pStream + 20, FloatToBits(step));
+    StoreLE64(pStream + 24, DoubleToBits(maxError));
+
+    uint8* pOffset = pStream + CODEC_HEADER_SIZE;
+    size_t offset = CODEC_HEADER_SIZE + ((size_t)tileCount + 1) * sizeof(uint64);
+    for (int i = 0; i < tileCount; i++)
+    {
+        StoreLE64(pOffset, offset);
+        pOffset += sizeof(uint64);
+        if (!tiles[i].empty())
+        {
+            memcpy(pStream + offset, &tiles[i][0], tiles[i].size());
+        }
+        offset += tiles[i].size();
+    }
+    StoreLE64(pOffset, offset);
+}
+
+void HeightMapEncoder::SetMaxError(double maxError)
+{
+    if (!(maxError > 0.0) || !(maxError <= 1.0e30))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_maxError = maxError;
+}
+
+void HeightMapEncoder::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
+
+void HeightMapEncoder::SetTileSize(int tileSize)
+{
+    if (tileSize < CODEC_MIN_TILE_SIZE || tileSize > CODEC_MAX_TILE_SIZE)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_tileSize = tileSize;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// HeightMapDecoder class
+
+HeightMapDecoder::HeightMapDecoder(const uint8* pStream, size_t size):
+    m_hasTiles(true),
+    m_height(0),
+    m_maxError(0.0),
+    m_step(0.0),
+    m_pStream(pStream),
+    m_size(size),
+    m_threadCount(0),
+    m_tileSize(0),
+    m_width(0)
+{
+    if (pStream == NULL || GetIndexSize(pStream, size) == 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    ReadIndex(size);
+}
+
+HeightMapDecoder::HeightMapDecoder(const uint8* pIndex, size_t indexSize,
+    uint64 streamSize):
+    m_hasTiles(false),
+    m_height(0),
+    m_maxError(0.0),
+    m_step(0.0),
+    m_pStream(pIndex),
+    m_size(streamSize),
+    m_threadCount(0),
+    m_tileSize(0),
+    m_width(0)
+{
+    if (pIndex == NULL || indexSize > streamSize)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    size_t requiredSize = GetIndexSize(pIndex, indexSize);
+    if (requiredSize == 0 || requiredSize > indexSize)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    ReadIndex(streamSize);
+}
+
+void HeightMapDecoder::Decode(NoiseMap& heightMap) const
+{
+    if (!m_hasTiles)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    heightMap.SetSize(m_width, m_height);
+
+    int tileCountX = GetTileCountX();
+    int tileCount = tileCountX * GetTileCountZ();
+    int threadCount = ResolveThreadCount(m_threadCount);
+    size_t residualCount = (size_t)m_tileSize * (size_t)m_tileSize
+        + CODEC_BLOCK_SIZE;
+    MemoryReservation reservation(MEMORY_SCRATCH, (size_t)threadCount
+        * (residualCount * sizeof(uint32) + 2 * m_tileSize * sizeof(int32)));
+    std::vector<DecodeScratch> scratch((size_t)threadCount);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].residuals.resize(residualCount);
+            scratch[i].rows.resize(2 * (size_t)m_tileSize);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    float step = (float)m_step;
+    ParallelFor(tileCount, threadCount,
+        [&](int tileIndex, int worker)
+        {
+            int tileX = tileIndex % tileCountX;
+            int tileZ = tileIndex / tileCountX;
+            int tileWidth = GetTileWidth(tileX);
+            int tileHeight = GetTileHeight(tileZ);
+            const uint8* pTile = m_pStream + LoadLE64(m_pStream
+                + CODEC_HEADER_SIZE + (size_t)tileIndex * sizeof(uint64));
+            float* pDest = heightMap.GetSlabPtr(tileX * m_tileSize,
+                tileZ * m_tileSize);
+            int destStride = heightMap.GetStride();
+            if (pTile[0] == TILE_PACKED)
+            {
+                DecodePackedTile(pTile + 1, tileWidth, tileHeight, step, pDest,
+                    destStride, &scratch[worker].residuals[0],
+                    &scratch[worker].rows[0]);
+                return;
+            }
+            DecodeTile(tileX, tileZ, pDest, destStride);
+        });
+}
+
+void HeightMapDecoder::DecodeTile(int tileX, int tileZ, float* pDest,
+    int destStride) const
+{
+    if (!m_hasTiles)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    uint64 offset;
+    uint64 size;
+    GetTileRange(tileX, tileZ, offset, size);
+    DecodeTile(tileX, tileZ, m_pStream + offset, pDest, destStride);
+}
+
+void HeightMapDecoder::DecodeTile(int tileX, int tileZ,
+    const uint8* pTileData, float* pDest, int destStride) const
+{
+    if (tileX < 0 || tileX >= GetTileCountX() || tileZ < 0
+        || tileZ >= GetTileCountZ() || pTileData == NULL || pDest == NULL
+        || destStride < GetTileWidth(tileX))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int tileWidth = GetTileWidth(tileX);
+    int tileHeight = GetTileHeight(tileZ);
+    if (pTileData[0] == TILE_RAW)
+    {
+        const uint8* pRaw = pTileData + 1;
+        for (int z = 0; z < tileHeight; z++)
+        {
+            float* pLine = pDest + (size_t)z * (size_t)destStride;
+            for (int x = 0; x < tileWidth; x++)
+            {
+                pLine[x] = BitsToFloat(LoadLE32(pRaw));
+                pRaw += 4;
+            }
+        }
+        return;
+    }
+
+    std::vector<uint32> residuals;
+    std::vector<int32> rows;
+    try
+    {
+        residuals.resize((size_t)tileWidth * (size_t)tileHeight
+            + CODEC_BLOCK_SIZE);
+        rows.resize(2 * (size_t)tileWidth);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    DecodePackedTile(pTileData + 1, tileWidth, tileHeight, (float)m_step,
+        pDest, destStride, &residuals[0], &rows[0]);
+}
+
+size_t HeightMapDecoder::GetIndexSize(const uint8* pStream, size_t size)
+{
+    if (size < CODEC_HEADER_SIZE)
+    {
+        return 0;
+    }
+    if (pStream == NULL || LoadLE32(pStream) != CODEC_MAGIC
+        || LoadLE32(pStream + 4) != CODEC_VERSION)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int width = (int)LoadLE32(pStream + 8);
+    int height = (int)LoadLE32(pStream + 12);
+    int tileSize = (int)LoadLE32(pStream + 16);
+    if (width <= 0 || height <= 0 || tileSize < CODEC_MIN_TILE_SIZE
+        || tileSize > CODEC_MAX_TILE_SIZE)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    size_t tileCount = (size_t)((width + tileSize - 1) / tileSize)
+        * (size_t)((height + tileSize - 1) / tileSize);
+    return CODEC_HEADER_SIZE + (tileCount + 1) * sizeof(uint64);
+}
+
+void HeightMapDecoder::GetTileRange(int tileX, int tileZ, uint64& offset,
+    uint64& size) const
+{
+    if (tileX < 0 || tileX >= GetTileCountX() || tileZ < 0
+        || tileZ >= GetTileCountZ())
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    size_t tileIndex = (size_t)tileZ * (size_t)GetTileCountX() + (size_t)tileX;
+    const uint8* pOffset = m_pStream + CODEC_HEADER_SIZE
+        + tileIndex * sizeof(uint64);
+    offset = LoadLE64(pOffset);
+    size = LoadLE64(pOffset + sizeof(uint64)) - offset;
+}
+
+void HeightMapDecoder::ReadIndex(uint64 streamSize)
+{
+    m_width = (int)LoadLE32(m_pStream + 8);
+    m_height = (int)LoadLE32(m_pStream + 12);
+    m_tileSize = (int)LoadLE32(m_pStream + 16);
+    m_step = (double)BitsToFloat(LoadLE32(m_pStream + 20));
+    m_maxError = BitsToDouble(LoadLE64(m_pStream + 24));
+
+    // The offsets must increase and stay inside the stream.
+    size_t tileCount = (size_t)GetTileCountX() * (size_t)GetTileCountZ();
+    uint64 offsetTableEnd = CODEC_HEADER_SIZE
+        + (tileCount + 1) * sizeof(uint64);
+    if (streamSize < CODEC_PADDING
+        || offsetTableEnd > streamSize - CODEC_PADDING)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    uint64 previous = offsetTableEnd;
+    for (size_t i = 0; i <= tileCount; i++)
+    {
+        uint64 offset = LoadLE64(m_pStream + CODEC_HEADER_SIZE
+            + i * sizeof(uint64));
+        if (offset < previous || offset > streamSize - CODEC_PADDING)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        previous = offset;
+    }
+}
+
+void HeightMapDecoder::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
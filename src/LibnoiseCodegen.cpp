@@ -0,0 +1,1501 @@
+// LibnoiseCodegen.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "LibnoiseCodegen.h"
+
+using namespace noise;
+using namespace noise::utils;
+using namespace noise::module;
+
+namespace
+{
+    // The types of noise modules of a graph.
+    enum NodeType
+    {
+        NODE_ABS,
+        NODE_ADD,
+        NODE_BILLOW,
+        NODE_BLEND,
+        NODE_CACHE,
+        NODE_CHECKERBOARD,
+        NODE_CLAMP,
+        NODE_CONST,
+        NODE_CURVE,
+        NODE_DISPLACE,
+        NODE_EXPONENT,
+        NODE_INVERT,
+        NODE_MAX,
+        NODE_MIN,
+        NODE_MULTIPLY,
+        NODE_PERLIN,
+        NODE_PERLIN_VECTOR,
+        NODE_POWER,
+        NODE_RIDGED_MULTI,
+        NODE_ROTATE_POINT,
+        NODE_SCALE_BIAS,
+        NODE_SCALE_POINT,
+        NODE_SELECT,
+        NODE_TERRACE,
+        NODE_TRANSLATE_POINT,
+        NODE_TURBULENCE,
+        NODE_VORONOI,
+        NODE_TYPE_COUNT
+    };
+
+    // The name of each type in the text format, and its number of source
+    // modules.
+    struct NodeTypeInfo
+    {
+        const char* name;
+        int sourceCount;
+    };
+
+    const NodeTypeInfo NODE_TYPES[NODE_TYPE_COUNT] =
+    {
+        { "abs", 1 },
+        { "add", 2 },
+        { "billow", 0 },
+        { "blend", 3 },
+        { "cache", 1 },
+        { "checkerboard", 0 },
+        { "clamp", 1 },
+        { "const", 0 },
+        { "curve", 1 },
+        { "displace", 3 },
+        { "exponent", 1 },
+        { "invert", 1 },
+        { "max", 2 },
+        { "min", 2 },
+        { "multiply", 2 },
+        { "perlin", 0 },
+        { "perlinvector", 0 },
+        { "power", 2 },
+        { "ridgedmulti", 0 },
+        { "rotatepoint", 1 },
+        { "scalebias", 1 },
+        { "scalepoint", 1 },
+        { "select", 3 },
+        { "terrace", 1 },
+        { "translatepoint", 1 },
+        { "turbulence", 1 },
+        { "voronoi", 0 }
+    };
+
+    // The names of the noise qualities in the generated source code.
+    const char* const QUALITY_NAMES[] =
+    {
+        "QUALITY_FAST",
+        "QUALITY_STD",
+        "QUALITY_BEST"
+    };
+
+    // A noise module read from the text format.
+    struct NodeDesc
+    {
+        NodeType type;
+        std::vector<int> sourceIds;
+        std::map<std::string, double> params;
+    };
+
+    // Appends formatted text to a string.
+    void AppendFormat(std::string& s, const char* format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        if (length >= (int)sizeof(buffer))
+        {
+            std::vector<char> large(length + 1);
+            va_start(args, format);
+            vsnprintf(&large[0], large.size(), format, args);
+            va_end(args);
+            s.append(&large[0], length);
+        }
+        else if (length > 0)
+        {
+            s.append(buffer, length);
+        }
+    }
+
+    // Formats a double with 17 significant digits, like "%.17g" in the "C"
+    // locale.  The decimal separator does not follow the locale of the
+    // process, so that the text format and the generated source code stay
+    // valid everywhere.
+    std::string FormatReal(double value)
+    {
+        if (std::isnan(value))
+        {
+            return "nan";
+        }
+        if (std::isinf(value))
+        {
+            return value > 0.0 ? "inf" : "-inf";
+        }
+        std::ostringstream stream;
+        stream.imbue(std::locale::classic());
+        stream.precision(17);
+        stream << value;
+        return stream.str();
+    }
+
+    // Parses a whole token written by FormatReal().  Returns false if the
+    // token is not a number.
+    bool ParseReal(const std::string& text, double& value)
+    {
+        if (text == "nan" || text == "-nan")
+        {
+            value = NAN;
+            return true;
+        }
+        if (text == "inf" || text == "-inf")
+        {
+            value = text[0] == '-' ? -HUGE_VAL : HUGE_VAL;
+            return true;
+        }
+        std::istringstream stream(text);
+        stream.imbue(std::locale::classic());
+        return (stream >> value) && stream.get() == EOF;
+    }
+
+    // Appends a parameter to a line of the text format.
+    void AppendParam(std::string& line, const char* key, double value)
+    {
+        AppendFormat(line, " %s=%s", key, FormatReal(value).c_str());
+    }
+
+    // Adds a constant to a seed the way the noise modules do, wrapping
+    // around instead of overflowing.
+    int OffsetSeed(int seed, int offset)
+    {
+        return (int)((unsigned int)seed + (unsigned int)offset);
+    }
+
+    // Returns a double literal of the generated source code that holds the
+    // value exactly.
+    std::string RealLiteral(double value)
+    {
+        if (std::isnan(value))
+        {
+            return "NAN";
+        }
+        if (std::isinf(value))
+        {
+            return value > 0.0 ? "HUGE_VAL" : "(-HUGE_VAL)";
+        }
+        std::string literal = FormatReal(value);
+        if (literal.find_first_of(".e") == std::string::npos)
+        {
+            literal += ".0";
+        }
+        return value < 0.0 ? "(" + literal + ")" : literal;
+    }
+
+    // Returns an int literal of the generated source code.
+    std::string IntLiteral(int value)
+    {
+        // The most negative int has no literal of type int.
+        if (value == INT_MIN)
+        {
+            return "(-2147483647 - 1)";
+        }
+        std::string literal;
+        AppendFormat(literal, "%d", value);
+        return literal;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Writing
+
+    // Writes a noise module and, first, its source modules.  Returns the
+    // identifier of the noise module.
+    int WriteNode(const Module& m, std::map<const Module*, int>& ids,
+        std::set<const Module*>& path, int& nextId, std::string& text)
+    {
+        // An instrument only measures its source module.
+        const Instrument* pInstrument = dynamic_cast<const Instrument*>(&m);
+        if (pInstrument != NULL)
+        {
+            return WriteNode(m.GetSourceModule(0), ids, path, nextId, text);
+        }
+
+        std::map<const Module*, int>::const_iterator written = ids.find(&m);
+        if (written != ids.end())
+        {
+            return written->second;
+        }
+        if (!path.insert(&m).second)
+        {
+            // The graph has a cycle.
+            throw noise::ExceptionInvalidParam();
+        }
+
+        std::string params;
+        NodeType type;
+        if (dynamic_cast<const Abs*>(&m) != NULL)
+        {
+            type = NODE_ABS;
+        }
+        else if (dynamic_cast<const Add*>(&m) != NULL)
+        {
+            type = NODE_ADD;
+        }
+        else if (const Billow* p = dynamic_cast<const Billow*>(&m))
+        {
+            type = NODE_BILLOW;
+            AppendParam(params, "frequency", p->GetFrequency());
+            AppendParam(params, "lacunarity", p->GetLacunarity());
+            AppendParam(params, "octaves", p->GetOctaveCount());
+            AppendParam(params, "persistence", p->GetPersistence());
+            AppendParam(params, "quality", p->GetNoiseQuality());
+            AppendParam(params, "seed", p->GetSeed());
+        }
+        else if (dynamic_cast<const Blend*>(&m) != NULL)
+        {
+            type = NODE_BLEND;
+        }
+        else if (dynamic_cast<const Cache*>(&m) != NULL)
+        {
+            type = NODE_CACHE;
+        }
+        else if (dynamic_cast<const Checkerboard*>(&m) != NULL)
+        {
+            type = NODE_CHECKERBOARD;
+        }
+        else if (const Clamp* p = dynamic_cast<const Clamp*>(&m))
+        {
+            type = NODE_CLAMP;
+            AppendParam(params, "lower", p->GetLowerBound());
+            AppendParam(params, "upper", p->GetUpperBound());
+        }
+        else if (const Const* p = dynamic_cast<const Const*>(&m))
+        {
+            type = NODE_CONST;
+            AppendParam(params, "value", p->GetConstValue());
+        }
+        else if (const Curve* p = dynamic_cast<const Curve*>(&m))
+        {
+            type = NODE_CURVE;
+            const ControlPoint* pPoints = p->GetControlPointArray();
+            AppendParam(params, "count", p->GetControlPointCount());
+            for (int i = 0; i < p->GetControlPointCount(); i++)
+            {
+                AppendFormat(params, " in%d=%s out%d=%s", i,
+                    FormatReal(pPoints[i].inputValue).c_str(), i,
+                    FormatReal(pPoints[i].outputValue).c_str());
+            }
+        }
+        else if (dynamic_cast<const Displace*>(&m) != NULL)
+        {
+            type = NODE_DISPLACE;
+        }
+        else if (const Exponent* p = dynamic_cast<const Exponent*>(&m))
+        {
+            type = NODE_EXPONENT;
+            AppendParam(params, "exponent", p->GetExponent());
+        }
+        else if (dynamic_cast<const Invert*>(&m) != NULL)
+        {
+            type = NODE_INVERT;
+        }
+        else if (dynamic_cast<const Max*>(&m) != NULL)
+        {
+            type = NODE_MAX;
+        }
+        else if (dynamic_cast<const Min*>(&m) != NULL)
+        {
+            type = NODE_MIN;
+        }
+        else if (dynamic_cast<const Multiply*>(&m) != NULL)
+        {
+            type = NODE_MULTIPLY;
+        }
+        else if (const Perlin* p = dynamic_cast<const Perlin*>(&m))
+        {
+            // PerlinVector derives from Perlin.
+            type = NODE_PERLIN;
+            if (dynamic_cast<const PerlinVector*>(&m) != NULL)
+            {
+                type = NODE_PERLIN_VECTOR;
+                AppendParam(params, "channels", p->GetChannelCount());
+            }
+            AppendParam(params, "frequency", p->GetFrequency());
+            AppendParam(params, "lacunarity", p->GetLacunarity());
+            AppendParam(params, "octaves", p->GetOctaveCount());
+            AppendParam(params, "persistence", p->GetPersistence());
+            AppendParam(params, "quality", p->GetNoiseQuality());
+            AppendParam(params, "seed", p->GetSeed());
+        }
+        else if (dynamic_cast<const Power*>(&m) != NULL)
+        {
+            type = NODE_POWER;
+        }
+        else if (const RidgedMulti* p = dynamic_cast<const RidgedMulti*>(&m))
+        {
+            type = NODE_RIDGED_MULTI;
+            AppendParam(params, "frequency", p->GetFrequency());
+            AppendParam(params, "lacunarity", p->GetLacunarity());
+            AppendParam(params, "octaves", p->GetOctaveCount());
+            AppendParam(params, "quality", p->GetNoiseQuality());
+            AppendParam(params, "seed", p->GetSeed());
+        }
+        else if (const RotatePoint* p = dynamic_cast<const RotatePoint*>(&m))
+        {
+            type = NODE_ROTATE_POINT;
+            AppendParam(params, "xangle", p->GetXAngle());
+            AppendParam(params, "yangle", p->GetYAngle());
+            AppendParam(params, "zangle", p->GetZAngle());
+        }
+        else if (const ScaleBias* p = dynamic_cast<const ScaleBias*>(&m))
+        {
+            type = NODE_SCALE_BIAS;
+            AppendParam(params, "scale", p->GetScale());
+            AppendParam(params, "bias", p->GetBias());
+        }
+        else if (const ScalePoint* p = dynamic_cast<const ScalePoint*>(&m))
+        {
+            type = NODE_SCALE_POINT;
+            AppendParam(params, "xscale", p->GetXScale());
+            AppendParam(params, "yscale", p->GetYScale());
+            AppendParam(params, "zscale", p->GetZScale());
+        }
+        else if (const Select* p = dynamic_cast<const Select*>(&m))
+        {
+            type = NODE_SELECT;
+            AppendParam(params, "lower", p->GetLowerBound());
+            AppendParam(params, "upper", p->GetUpperBound());
+            AppendParam(params, "falloff", p->GetEdgeFalloff());
+        }
+        else if (const Terrace* p = dynamic_cast<const Terrace*>(&m))
+        {
+            type = NODE_TERRACE;
+            const NOISE_REAL* pPoints = p->GetControlPointArray();
+            AppendParam(params, "count", p->GetControlPointCount());
+            for (int i = 0; i < p->GetControlPointCount(); i++)
+            {
+                AppendFormat(params, " p%d=%s", i,
+                    FormatReal(pPoints[i]).c_str());
+            }
+            AppendParam(params, "inverted", p->IsTerracesInverted() ? 1 : 0);
+        }
+        else if (const TranslatePoint* p
+            = dynamic_cast<const TranslatePoint*>(&m))
+        {
+            type = NODE_TRANSLATE_POINT;
+            AppendParam(params, "x", p->GetXTranslation());
+            AppendParam(params, "y", p->GetYTranslation());
+            AppendParam(params, "z", p->GetZTranslation());
+        }
+        else if (const Turbulence* p = dynamic_cast<const Turbulence*>(&m))
+        {
+            type = NODE_TURBULENCE;
+            AppendParam(params, "frequency", p->GetFrequency());
+            AppendParam(params, "joint", p->GetJointDistortion() ? 1 : 0);
+            AppendParam(params, "power", p->GetPower());
+            AppendParam(params, "roughness", p->GetRoughnessCount());
+            AppendParam(params, "seed", p->GetSeed());
+        }
+        else if (const Voronoi* p = dynamic_cast<const Voronoi*>(&m))
+        {
+            type = NODE_VORONOI;
+            AppendParam(params, "displacement", p->GetDisplacement());
+            AppendParam(params, "distance", p->IsDistanceEnabled() ? 1 : 0);
+            AppendParam(params, "frequency", p->GetFrequency());
+            AppendParam(params, "seed", p->GetSeed());
+        }
+        else
+        {
+            // A noise module defined outside of the library.
+            throw noise::ExceptionInvalidParam();
+        }
+
+        // Displace declares a z displacement module, which 2D evaluation
+        // does not use; only the source modules of the table are written.
+        std::vector<int> sourceIds;
+        for (int i = 0; i < NODE_TYPES[type].sourceCount; i++)
+        {
+            sourceIds.push_back(WriteNode(m.GetSourceModule(i), ids, path,
+                nextId, text));
+        }
+        path.erase(&m);
+
+        int id = nextId++;
+        AppendFormat(text, "node %d %s", id, NODE_TYPES[type].name);
+        for (size_t i = 0; i < sourceIds.size(); i++)
+        {
+            AppendFormat(text, " %d", sourceIds[i]);
+        }
+        text += params;
+        text += '\n';
+        ids[&m] = id;
+        return id;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Reading
+
+    // Returns a parameter of a noise module.
+    double GetParam(const NodeDesc& node, const char* key)
+    {
+        std::map<std::string, double>::const_iterator it
+            = node.params.find(key);
+        if (it == node.params.end())
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return it->second;
+    }
+
+    // Returns a parameter of a noise module that holds an integer.
+    int GetIntParam(const NodeDesc& node, const char* key)
+    {
+        double value = GetParam(node, key);
+        if (!(value >= INT_MIN && value <= INT_MAX) || value != floor(value))
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return (int)value;
+    }
+
+    // Returns a parameter of a noise module that holds a noise quality.
+    NoiseQuality GetQualityParam(const NodeDesc& node)
+    {
+        int quality = GetIntParam(node, "quality");
+        if (quality < QUALITY_FAST || quality > QUALITY_BEST)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return (NoiseQuality)quality;
+    }
+
+    // Returns the number of control points of a noise module.
+    int GetControlPointCountParam(const NodeDesc& node)
+    {
+        int count = GetIntParam(node, "count");
+        if (count < 0 || count > (int)node.params.size())
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return count;
+    }
+
+    // Returns a numbered parameter of a noise module, such as a control
+    // point.
+    double GetIndexedParam(const NodeDesc& node, const char* key, int index)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%s%d", key, index);
+        return GetParam(node, name);
+    }
+
+    // Parses a graph written by SaveModuleGraph().  Returns the identifier of
+    // the root module.
+    int ParseGraph(const std::string& text, std::vector<NodeDesc>& nodes)
+    {
+        std::istringstream lines(text);
+        std::string line;
+        int version = 0;
+        int rootId = -1;
+        bool hasHeader = false;
+        while (std::getline(lines, line))
+        {
+            std::istringstream tokens(line);
+            tokens.imbue(std::locale::classic());
+            std::string keyword;
+            if (!(tokens >> keyword) || keyword[0] == '#')
+            {
+                continue;
+            }
+            if (rootId >= 0)
+            {
+                // Nothing follows the root.
+                throw noise::ExceptionInvalidParam();
+            }
+
+            if (!hasHeader)
+            {
+                if (keyword != "noisegraph" || !(tokens >> version)
+                    || version != MODULE_GRAPH_FORMAT_VERSION)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                hasHeader = true;
+            }
+            else if (keyword == "node")
+            {
+                int id;
+                std::string typeName;
+                if (!(tokens >> id >> typeName) || id != (int)nodes.size())
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                NodeDesc node;
+                int type = 0;
+                while (type < NODE_TYPE_COUNT
+                    && typeName != NODE_TYPES[type].name)
+                {
+                    type++;
+                }
+                if (type == NODE_TYPE_COUNT)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                node.type = (NodeType)type;
+
+                std::string token;
+                while (tokens >> token)
+                {
+                    size_t equal = token.find('=');
+                    double value;
+                    if (!ParseReal(token.substr(equal == std::string::npos ? 0
+                        : equal + 1), value))
+                    {
+                        throw noise::ExceptionInvalidParam();
+                    }
+                    if (equal != std::string::npos)
+                    {
+                        node.params[token.substr(0, equal)] = value;
+                    }
+                    else
+                    {
+                        // Source modules are written before the noise modules
+                        // that use them, so the graph has no cycles.
+                        int sourceId = (int)value;
+                        if (!node.params.empty() || sourceId != value
+                            || sourceId < 0 || sourceId >= id)
+                        {
+                            throw noise::ExceptionInvalidParam();
+                        }
+                        node.sourceIds.push_back(sourceId);
+                    }
+                }
+                if ((int)node.sourceIds.size() != NODE_TYPES[type].sourceCount)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                nodes.push_back(node);
+            }
+            else if (keyword == "root")
+            {
+                if (!(tokens >> rootId) || rootId < 0
+                    || rootId >= (int)nodes.size())
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+            }
+            else
+            {
+                throw noise::ExceptionInvalidParam();
+            }
+        }
+        if (rootId < 0)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return rootId;
+    }
+
+    // Adds a noise module to a versioned graph.  Returns the noise module,
+    // to set its parameters.
+    template<class T>
+    T& AddModule(VersionedGraph& graph, int& id)
+    {
+        id = graph.Add<T>();
+        return graph.Edit<T>(id);
+    }
+
+    // Sets the parameters shared by the fractal generator modules.
+    template<class T>
+    void SetFractalParams(T& m, const NodeDesc& node)
+    {
+        int octaveCount = GetIntParam(node, "octaves");
+        if (octaveCount < 1)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        m.SetFrequency(GetParam(node, "frequency"));
+        m.SetLacunarity(GetParam(node, "lacunarity"));
+        m.SetNoiseQuality(GetQualityParam(node));
+        m.SetOctaveCount(octaveCount);
+        m.SetSeed(GetIntParam(node, "seed"));
+    }
+
+    // Adds a noise module read from the text format to a versioned graph.
+    // Returns its identifier.
+    int LoadNode(const NodeDesc& node, VersionedGraph& graph)
+    {
+        int id;
+        switch (node.type)
+        {
+            case NODE_ABS:
+                AddModule<Abs>(graph, id);
+                break;
+            case NODE_ADD:
+                AddModule<Add>(graph, id);
+                break;
+            case NODE_BILLOW:
+            {
+                Billow& m = AddModule<Billow>(graph, id);
+                SetFractalParams(m, node);
+                m.SetPersistence(GetParam(node, "persistence"));
+                break;
+            }
+            case NODE_BLEND:
+                AddModule<Blend>(graph, id);
+                break;
+            case NODE_CACHE:
+                AddModule<Cache>(graph, id);
+                break;
+            case NODE_CHECKERBOARD:
+                AddModule<Checkerboard>(graph, id);
+                break;
+            case NODE_CLAMP:
+            {
+                Clamp& m = AddModule<Clamp>(graph, id);
+                double lower = GetParam(node, "lower");
+                double upper = GetParam(node, "upper");
+                if (!(lower < upper))
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                m.SetBounds(lower, upper);
+                break;
+            }
+            case NODE_CONST:
+                AddModule<Const>(graph, id).SetConstValue(
+                    GetParam(node, "value"));
+                break;
+            case NODE_CURVE:
+            {
+                Curve& m = AddModule<Curve>(graph, id);
+                int count = GetControlPointCountParam(node);
+                for (int i = 0; i < count; i++)
+                {
+                    m.AddControlPoint(GetIndexedParam(node, "in", i),
+                        GetIndexedParam(node, "out", i));
+                }
+                break;
+            }
+            case NODE_DISPLACE:
+                AddModule<Displace>(graph, id);
+                break;
+            case NODE_EXPONENT:
+                AddModule<Exponent>(graph, id).SetExponent(
+                    GetParam(node, "exponent"));
+                break;
+            case NODE_INVERT:
+                AddModule<Invert>(graph, id);
+                break;
+            case NODE_MAX:
+                AddModule<Max>(graph, id);
+                break;
+            case NODE_MIN:
+                AddModule<Min>(graph, id);
+                break;
+            case NODE_MULTIPLY:
+                AddModule<Multiply>(graph, id);
+                break;
+            case NODE_PERLIN:
+            {
+                Perlin& m = AddModule<Perlin>(graph, id);
+                SetFractalParams(m, node);
+                m.SetPersistence(GetParam(node, "persistence"));
+                break;
+            }
+            case NODE_PERLIN_VECTOR:
+            {
+                PerlinVector& m = AddModule<PerlinVector>(graph, id);
+                SetFractalParams(m, node);
+                m.SetPersistence(GetParam(node, "persistence"));
+                m.SetChannelCount(GetIntParam(node, "channels"));
+                break;
+            }
+            case NODE_POWER:
+                AddModule<Power>(graph, id);
+                break;
+            case NODE_RIDGED_MULTI:
+                SetFractalParams(AddModule<RidgedMulti>(graph, id), node);
+                break;
+            case NODE_ROTATE_POINT:
+                AddModule<RotatePoint>(graph, id).SetAngles(
+                    GetParam(node, "xangle"), GetParam(node, "yangle"),
+                    GetParam(node, "zangle"));
+                break;
+            case NODE_SCALE_BIAS:
+            {
+                ScaleBias& m = AddModule<ScaleBias>(graph, id);
+                m.SetScale(GetParam(node, "scale"));
+                m.SetBias(GetParam(node, "bias"));
+                break;
+            }
+            case NODE_SCALE_POINT:
+                AddModule<ScalePoint>(graph, id).SetScale(
+                    GetParam(node, "xscale"), GetParam(node, "yscale"),
+                    GetParam(node, "zscale"));
+                break;
+            case NODE_SELECT:
+            {
+                Select& m = AddModule<Select>(graph, id);
+                double lower = GetParam(node, "lower");
+                double upper = GetParam(node, "upper");
+                if (!(lower < upper))
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                m.SetBounds(lower, upper);
+                m.SetEdgeFalloff(GetParam(node, "falloff"));
+                break;
+            }
+            case NODE_TERRACE:
+            {
+                Terrace& m = AddModule<Terrace>(graph, id);
+                int count = GetControlPointCountParam(node);
+                for (int i = 0; i < count; i++)
+                {
+                    m.AddControlPoint(GetIndexedParam(node, "p", i));
+                }
+                m.InvertTerraces(GetIntParam(node, "inverted") != 0);
+                break;
+            }
+            case NODE_TRANSLATE_POINT:
+                AddModule<TranslatePoint>(graph, id).SetTranslation(
+                    GetParam(node, "x"), GetParam(node, "y"),
+                    GetParam(node, "z"));
+                break;
+            case NODE_TURBULENCE:
+            {
+                Turbulence& m = AddModule<Turbulence>(graph, id);
+                int roughness = GetIntParam(node, "roughness");
+                if (roughness < 1)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                m.SetFrequency(GetParam(node, "frequency"));
+                m.SetJointDistortion(GetIntParam(node, "joint") != 0);
+                m.SetPower(GetParam(node, "power"));
+                m.SetRoughness(roughness);
+                m.SetSeed(GetIntParam(node, "seed"));
+                break;
+            }
+            case NODE_VORONOI:
+            {
+                Voronoi& m = AddModule<Voronoi>(graph, id);
+                m.SetDisplacement(GetParam(node, "displacement"));
+                m.EnableDistance(GetIntParam(node, "distance") != 0);
+                m.SetFrequency(GetParam(node, "frequency"));
+                m.SetSeed(GetIntParam(node, "seed"));
+                break;
+            }
+            default:
+                throw noise::ExceptionInvalidParam();
+        }
+        return id;
+    }
+
+    //////////////////////////////////////////////////////////////////////////
+    // Code generation
+
+    // The kinds of fractal generator modules, which share their octave loop.
+    enum FractalKind
+    {
+        FRACTAL_BILLOW,
+        FRACTAL_PERLIN,
+        FRACTAL_RIDGED_MULTI
+    };
+
+    // The parameters of a fractal generator module.
+    struct FractalDesc
+    {
+        FractalKind kind;
+        double frequency;
+        double lacunarity;
+        int octaveCount;
+        double persistence;
+        NoiseQuality quality;
+        int seed;
+    };
+
+    // Reads the parameters of a fractal generator module.
+    FractalDesc GetFractalDesc(const NodeDesc& node, FractalKind kind)
+    {
+        FractalDesc desc;
+        desc.kind = kind;
+        desc.frequency = GetParam(node, "frequency");
+        desc.lacunarity = GetParam(node, "lacunarity");
+        desc.octaveCount = GetIntParam(node, "octaves");
+        desc.persistence = kind == FRACTAL_RIDGED_MULTI ? 0.0
+            : GetParam(node, "persistence");
+        desc.quality = GetQualityParam(node);
+        desc.seed = GetIntParam(node, "seed");
+        int maxOctaveCount = kind == FRACTAL_RIDGED_MULTI ? RIDGED_MAX_OCTAVE
+            : kind == FRACTAL_BILLOW ? BILLOW_MAX_OCTAVE : PERLIN_MAX_OCTAVE;
+        if (desc.octaveCount < 1 || desc.octaveCount > maxOctaveCount)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        return desc;
+    }
+
+    // Emits the function of a fractal generator module, with its octave
+    // loop unrolled.  The arithmetic follows Perlin::GetValue(),
+    // Billow::GetValue() and RidgedMulti::GetValue().
+    void EmitFractal(std::string& s, const std::string& name,
+        const FractalDesc& desc)
+    {
+        AppendFormat(s, "  inline NOISE_REAL %s (NOISE_REAL x, NOISE_REAL y)\n"
+            "  {\n", name.c_str());
+        s += "    NOISE_REAL value = 0.0;\n";
+        s += "    NOISE_REAL signal;\n";
+        if (desc.kind == FRACTAL_RIDGED_MULTI)
+        {
+            s += "    NOISE_REAL weight = 1.0;\n";
+        }
+        AppendFormat(s, "    x *= %s;\n    y *= %s;\n",
+            RealLiteral(desc.frequency).c_str(),
+            RealLiteral(desc.frequency).c_str());
+
+        // The persistence and the spectral weight of each octave are
+        // computed here exactly as the noise modules compute them.
+        NOISE_REAL curPersistence = 1.0;
+        NOISE_REAL spectralFrequency = 1.0;
+        for (int curOctave = 0; curOctave < desc.octaveCount; curOctave++)
+        {
+            int seed = OffsetSeed(desc.seed, curOctave);
+            if (desc.kind == FRACTAL_RIDGED_MULTI)
+            {
+                seed &= 0x7fffffff;
+            }
+            AppendFormat(s, "    signal = GradientCoherentNoise2D "
+                "(MakeInt32Range (x), MakeInt32Range (y), %s, %s);\n",
+                IntLiteral(seed).c_str(), QUALITY_NAMES[desc.quality]);
+            if (desc.kind == FRACTAL_RIDGED_MULTI)
+            {
+                NOISE_REAL spectralWeight = pow(spectralFrequency, -1.0);
+                spectralFrequency *= desc.lacunarity;
+                s += "    signal = 1.0 - fabs (signal);\n";
+                s += "    signal *= signal;\n";
+                s += "    signal *= weight;\n";
+                if (curOctave + 1 < desc.octaveCount)
+                {
+                    s += "    weight = signal * 2.0;\n";
+                    s += "    if (weight > 1.0) {\n      weight = 1.0;\n    }\n";
+                    s += "    if (weight < 0.0) {\n      weight = 0.0;\n    }\n";
+                }
+                AppendFormat(s, "    value += (signal * %s);\n",
+                    RealLiteral(spectralWeight).c_str());
+            }
+            else
+            {
+                if (desc.kind == FRACTAL_BILLOW)
+                {
+                    s += "    signal = 2.0f * std::abs (signal) - 1.0f;\n";
+                }
+                AppendFormat(s, "    value += signal * %s;\n",
+                    RealLiteral(curPersistence).c_str());
+                curPersistence *= desc.persistence;
+            }
+            if (curOctave + 1 < desc.octaveCount)
+            {
+                AppendFormat(s, "    x *= %s;\n    y *= %s;\n",
+                    RealLiteral(desc.lacunarity).c_str(),
+                    RealLiteral(desc.lacunarity).c_str());
+            }
+        }
+
+        if (desc.kind == FRACTAL_RIDGED_MULTI)
+        {
+            s += "    return (value * 1.25f) - 1.0f;\n";
+        }
+        else if (desc.kind == FRACTAL_BILLOW)
+        {
+            s += "    value += 0.5;\n    return value;\n";
+        }
+        else
+        {
+            s += "    return value;\n";
+        }
+        s += "  }\n\n";
+    }
+
+    // Returns the call of the function of a noise module.
+    std::string Call(int id, const char* x = "x", const char* y = "y")
+    {
+        std::string call;
+        AppendFormat(call, "Node%d (%s, %s)", id, x, y);
+        return call;
+    }
+
+    // Emits the function of a noise module, after the functions of its
+    // source modules.  The arithmetic follows the GetValue() method of the
+    // noise module.
+    void EmitNode(std::string& s, const std::vector<NodeDesc>& nodes, int id)
+    {
+        const NodeDesc& node = nodes[id];
+        const std::vector<int>& src = node.sourceIds;
+        char name[32];
+        snprintf(name, sizeof(name), "Node%d", id);
+
+        switch (node.type)
+        {
+            case NODE_BILLOW:
+                EmitFractal(s, name, GetFractalDesc(node, FRACTAL_BILLOW));
+                return;
+            case NODE_PERLIN:
+                EmitFractal(s, name, GetFractalDesc(node, FRACTAL_PERLIN));
+                return;
+            case NODE_PERLIN_VECTOR:
+            {
+                // The channels are Perlin noise with consecutive seeds;
+                // Displace reads the second one.
+                FractalDesc desc = GetFractalDesc(node, FRACTAL_PERLIN);
+                EmitFractal(s, name, desc);
+                if (GetIntParam(node, "channels") >= 2)
+                {
+                    desc.seed = OffsetSeed(desc.seed, 1);
+                    EmitFractal(s, std::string(name) + "Channel1", desc);
+                }
+                return;
+            }
+            case NODE_RIDGED_MULTI:
+                EmitFractal(s, name,
+                    GetFractalDesc(node, FRACTAL_RIDGED_MULTI));
+                return;
+            case NODE_TURBULENCE:
+            {
+                // The distortion modules are Perlin modules with the default
+                // parameters of noise::module::Perlin.
+                FractalDesc desc;
+                desc.kind = FRACTAL_PERLIN;
+                desc.frequency = GetParam(node, "frequency");
+                desc.lacunarity = DEFAULT_PERLIN_LACUNARITY;
+                desc.octaveCount = GetIntParam(node, "roughness");
+                desc.persistence = DEFAULT_PERLIN_PERSISTENCE;
+                desc.quality = DEFAULT_PERLIN_QUALITY;
+                desc.seed = GetIntParam(node, "seed");
+                if (desc.octaveCount < 1
+                    || desc.octaveCount > PERLIN_MAX_OCTAVE)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                EmitFractal(s, std::string(name) + "X", desc);
+                desc.seed = OffsetSeed(desc.seed, 1);
+                EmitFractal(s, std::string(name) + "Y", desc);
+                break;
+            }
+            default:
+                break;
+        }
+
+        // A constant does not read its input value.
+        AppendFormat(s, node.type == NODE_CONST
+            ? "  inline NOISE_REAL %s (NOISE_REAL, NOISE_REAL)\n  {\n"
+            : "  inline NOISE_REAL %s (NOISE_REAL x, NOISE_REAL y)\n  {\n",
+            name);
+        switch (node.type)
+        {
+            case NODE_ABS:
+                AppendFormat(s, "    return std::abs (%s);\n",
+                    Call(src[0]).c_str());
+                break;
+            case NODE_ADD:
+                AppendFormat(s, "    return %s\n      + %s;\n",
+                    Call(src[0]).c_str(), Call(src[1]).c_str());
+                break;
+            case NODE_BLEND:
+                AppendFormat(s, "    NOISE_REAL v0 = %s;\n"
+                    "    NOISE_REAL v1 = %s;\n"
+                    "    NOISE_REAL alpha = (%s + 1.0f) / 2.0f;\n"
+                    "    return LinearInterp (v0, v1, alpha);\n",
+                    Call(src[0]).c_str(), Call(src[1]).c_str(),
+                    Call(src[2]).c_str());
+                break;
+            case NODE_CACHE:
+                AppendFormat(s, "    return %s;\n", Call(src[0]).c_str());
+                break;
+            case NODE_CHECKERBOARD:
+                s += "    int ix = (int)(floor (MakeInt32Range (x)));\n";
+                s += "    int iy = (int)(floor (MakeInt32Range (y)));\n";
+                s += "    return ((ix & 1) ^ (iy & 1))? -1.0f: 1.0f;\n";
+                break;
+            case NODE_CLAMP:
+                AppendFormat(s, "    NOISE_REAL value = %s;\n"
+                    "    if (value < %s) {\n      return %s;\n"
+                    "    } else if (value > %s) {\n      return %s;\n"
+                    "    } else {\n      return value;\n    }\n",
+                    Call(src[0]).c_str(),
+                    RealLiteral(GetParam(node, "lower")).c_str(),
+                    RealLiteral(GetParam(node, "lower")).c_str(),
+                    RealLiteral(GetParam(node, "upper")).c_str(),
+                    RealLiteral(GetParam(node, "upper")).c_str());
+                break;
+            case NODE_CONST:
+                AppendFormat(s, "    return %s;\n",
+                    RealLiteral(GetParam(node, "value")).c_str());
+                break;
+            case NODE_CURVE:
+            {
+                int count = GetControlPointCountParam(node);
+                if (count < 4)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                s += "    static const NOISE_REAL inputValues[] = {";
+                for (int i = 0; i < count; i++)
+                {
+                    AppendFormat(s, "%s\n      %s", i == 0 ? "" : ",",
+                        RealLiteral(GetIndexedParam(node, "in", i)).c_str());
+                }
+                s += "\n    };\n";
+                s += "    static const NOISE_REAL outputValues[] = {";
+                for (int i = 0; i < count; i++)
+                {
+                    AppendFormat(s, "%s\n      %s", i == 0 ? "" : ",",
+                        RealLiteral(GetIndexedParam(node, "out", i)).c_str());
+                }
+                s += "\n    };\n";
+                AppendFormat(s, "    NOISE_REAL sourceModuleValue = %s;\n",
+                    Call(src[0]).c_str());
+                AppendFormat(s, "    int indexPos;\n"
+                    "    for (indexPos = 0; indexPos < %d; indexPos++) {\n"
+                    "      if (sourceModuleValue < inputValues[indexPos]) {\n"
+                    "        break;\n      }\n    }\n", count);
+                AppendFormat(s,
+                    "    int index0 = ClampValue (indexPos - 2, 0, %d);\n"
+                    "    int index1 = ClampValue (indexPos - 1, 0, %d);\n"
+                    "    int index2 = ClampValue (indexPos    , 0, %d);\n"
+                    "    int index3 = ClampValue (indexPos + 1, 0, %d);\n",
+                    count - 1, count - 1, count - 1, count - 1);
+                s += "    if (index1 == index2) {\n"
+                    "      return outputValues[index1];\n    }\n";
+                s += "    NOISE_REAL input0 = inputValues[index1];\n";
+                s += "    NOISE_REAL input1 = inputValues[index2];\n";
+                s += "    NOISE_REAL alpha = (sourceModuleValue - input0)"
+                    " / (input1 - input0);\n";
+                s += "    return CubicInterp (outputValues[index0],"
+                    " outputValues[index1],\n"
+                    "      outputValues[index2], outputValues[index3],"
+                    " alpha);\n";
+                break;
+            }
+            case NODE_DISPLACE:
+                if (src[1] != src[2])
+                {
+                    AppendFormat(s, "    NOISE_REAL xDisplace = x + (%s);\n"
+                        "    NOISE_REAL yDisplace = y + (%s);\n",
+                        Call(src[1]).c_str(), Call(src[2]).c_str());
+                }
+                else if (nodes[src[1]].type == NODE_PERLIN_VECTOR
+                    && GetIntParam(nodes[src[1]], "channels") >= 2)
+                {
+                    AppendFormat(s, "    NOISE_REAL xDisplace = x + %s;\n"
+                        "    NOISE_REAL yDisplace = y + Node%dChannel1 (x, y);\n",
+                        Call(src[1]).c_str(), src[1]);
+                }
+                else
+                {
+                    AppendFormat(s, "    NOISE_REAL displace = %s;\n"
+                        "    NOISE_REAL xDisplace = x + displace;\n"
+                        "    NOISE_REAL yDisplace = y + displace;\n",
+                        Call(src[1]).c_str());
+                }
+                AppendFormat(s, "    return %s;\n",
+                    Call(src[0], "xDisplace", "yDisplace").c_str());
+                break;
+            case NODE_EXPONENT:
+                AppendFormat(s, "    NOISE_REAL value = %s;\n"
+                    "    return (std::pow (std::abs ((value + 1.0f) / 2.0f), %s)"
+                    " * 2.0f - 1.0f);\n", Call(src[0]).c_str(),
+                    RealLiteral(GetParam(node, "exponent")).c_str());
+                break;
+            case NODE_INVERT:
+                AppendFormat(s, "    return -(%s);\n", Call(src[0]).c_str());
+                break;
+            case NODE_MAX:
+            case NODE_MIN:
+                AppendFormat(s, "    NOISE_REAL v0 = %s;\n"
+                    "    NOISE_REAL v1 = %s;\n"
+                    "    return %s (v0, v1);\n",
+                    Call(src[0]).c_str(), Call(src[1]).c_str(),
+                    node.type == NODE_MAX ? "GetMax" : "GetMin");
+                break;
+            case NODE_MULTIPLY:
+                AppendFormat(s, "    return %s\n      * %s;\n",
+                    Call(src[0]).c_str(), Call(src[1]).c_str());
+                break;
+            case NODE_POWER:
+                AppendFormat(s, "    return pow (%s,\n      %s);\n",
+                    Call(src[0]).c_str(), Call(src[1]).c_str());
+                break;
+            case NODE_ROTATE_POINT:
+            {
+                // The same matrix as RotatePoint::SetAngles().
+                NOISE_REAL xAngle = GetParam(node, "xangle");
+                NOISE_REAL yAngle = GetParam(node, "yangle");
+                NOISE_REAL zAngle = GetParam(node, "zangle");
+                NOISE_REAL xCos, yCos, zCos, xSin, ySin, zSin;
+                xCos = cos(xAngle * DEG_TO_RAD);
+                yCos = cos(yAngle * DEG_TO_RAD);
+                zCos = cos(zAngle * DEG_TO_RAD);
+                xSin = sin(xAngle * DEG_TO_RAD);
+                ySin = sin(yAngle * DEG_TO_RAD);
+                zSin = sin(zAngle * DEG_TO_RAD);
+                NOISE_REAL x1Matrix = ySin * xSin * zSin + yCos * zCos;
+                NOISE_REAL y1Matrix = xCos * zSin;
+                NOISE_REAL x2Matrix = ySin * xSin * zCos - yCos * zSin;
+                NOISE_REAL y2Matrix = xCos * zCos;
+                AppendFormat(s, "    NOISE_REAL nx = (%s * x) + (%s * y);\n"
+                    "    NOISE_REAL ny = (%s * x) + (%s * y);\n"
+                    "    return %s;\n",
+                    RealLiteral(x1Matrix).c_str(),
+                    RealLiteral(y1Matrix).c_str(),
+                    RealLiteral(x2Matrix).c_str(),
+                    RealLiteral(y2Matrix).c_str(),
+                    Call(src[0], "nx", "ny").c_str());
+                break;
+            }
+            case NODE_SCALE_BIAS:
+                AppendFormat(s, "    return %s * %s + %s;\n",
+                    Call(src[0]).c_str(),
+                    RealLiteral(GetParam(node, "scale")).c_str(),
+                    RealLiteral(GetParam(node, "bias")).c_str());
+                break;
+            case NODE_SCALE_POINT:
+            {
+                std::string xScaled = "x * "
+                    + RealLiteral(GetParam(node, "xscale"));
+                std::string yScaled = "y * "
+                    + RealLiteral(GetParam(node, "yscale"));
+                AppendFormat(s, "    return %s;\n", Call(src[0],
+                    xScaled.c_str(), yScaled.c_str()).c_str());
+                break;
+            }
+            case NODE_SELECT:
+            {
+                NOISE_REAL lowerBound = GetParam(node, "lower");
+                NOISE_REAL upperBound = GetParam(node, "upper");
+                NOISE_REAL edgeFalloff = GetParam(node, "falloff");
+                AppendFormat(s, "    NOISE_REAL controlValue = %s;\n",
+                    Call(src[2]).c_str());
+                if (edgeFalloff > 0.0)
+                {
+                    // The curve bounds, as Select::GetValue() computes them.
+                    NOISE_REAL lowerCurve0 = lowerBound - edgeFalloff;
+                    NOISE_REAL upperCurve0 = lowerBound + edgeFalloff;
+                    NOISE_REAL lowerCurve1 = upperBound - edgeFalloff;
+                    NOISE_REAL upperCurve1 = upperBound + edgeFalloff;
+                    AppendFormat(s, "    if (controlValue < %s) {\n"
+                        "      return %s;\n",
+                        RealLiteral(lowerCurve0).c_str(), Call(src[0]).c_str());
+                    AppendFormat(s, "    } else if (controlValue < %s) {\n"
+                        "      NOISE_REAL alpha = SCurve3 (\n"
+                        "        (controlValue - %s) / %s);\n"
+                        "      return LinearInterp (%s,\n        %s,\n"
+                        "        alpha);\n",
+                        RealLiteral(upperCurve0).c_str(),
+                        RealLiteral(lowerCurve0).c_str(),
+                        RealLiteral(upperCurve0 - lowerCurve0).c_str(),
+                        Call(src[0]).c_str(), Call(src[1]).c_str());
+                    AppendFormat(s, "    } else if (controlValue < %s) {\n"
+                        "      return %s;\n",
+                        RealLiteral(lowerCurve1).c_str(), Call(src[1]).c_str());
+                    AppendFormat(s, "    } else if (controlValue < %s) {\n"
+                        "      NOISE_REAL alpha = SCurve3 (\n"
+                        "        (controlValue - %s) / %s);\n"
+                        "      return LinearInterp (%s,\n        %s,\n"
+                        "        alpha);\n",
+                        RealLiteral(upperCurve1).c_str(),
+                        RealLiteral(lowerCurve1).c_str(),
+                        RealLiteral(upperCurve1 - lowerCurve1).c_str(),
+                        Call(src[1]).c_str(), Call(src[0]).c_str());
+                    AppendFormat(s, "    } else {\n      return %s;\n    }\n",
+                        Call(src[0]).c_str());
+                }
+                else
+                {
+                    AppendFormat(s, "    if (controlValue < %s"
+                        " || controlValue > %s) {\n"
+                        "      return %s;\n    } else {\n"
+                        "      return %s;\n    }\n",
+                        RealLiteral(lowerBound).c_str(),
+                        RealLiteral(upperBound).c_str(),
+                        Call(src[0]).c_str(), Call(src[1]).c_str());
+                }
+                break;
+            }
+            case NODE_TERRACE:
+            {
+                int count = GetControlPointCountParam(node);
+                if (count < 2)
+                {
+                    throw noise::ExceptionInvalidParam();
+                }
+                s += "    static const NOISE_REAL controlPoints[] = {";
+                for (int i = 0; i < count; i++)
+                {
+                    AppendFormat(s, "%s\n      %s", i == 0 ? "" : ",",
+                        RealLiteral(GetIndexedParam(node, "p", i)).c_str());
+                }
+                s += "\n    };\n";
+                AppendFormat(s, "    NOISE_REAL sourceModuleValue = %s;\n",
+                    Call(src[0]).c_str());
+                AppendFormat(s, "    int indexPos;\n"
+                    "    for (indexPos = 0; indexPos < %d; indexPos++) {\n"
+                    "      if (sourceModuleValue < controlPoints[indexPos]) {\n"
+                    "        break;\n      }\n    }\n", count);
+                AppendFormat(s,
+                    "    int index0 = ClampValue (indexPos - 1, 0, %d);\n"
+                    "    int index1 = ClampValue (indexPos    , 0, %d);\n",
+                    count - 1, count - 1);
+                s += "    if (index0 == index1) {\n"
+                    "      return controlPoints[index1];\n    }\n";
+                s += "    NOISE_REAL value0 = controlPoints[index0];\n";
+                s += "    NOISE_REAL value1 = controlPoints[index1];\n";
+                s += "    NOISE_REAL alpha = (sourceModuleValue - value0)"
+                    " / (value1 - value0);\n";
+                if (GetIntParam(node, "inverted") != 0)
+                {
+                    s += "    alpha = 1.0f - alpha;\n";
+                    s += "    SwapValues (value0, value1);\n";
+                }
+                s += "    alpha *= alpha;\n";
+                s += "    return LinearInterp (value0, value1, alpha);\n";
+                break;
+            }
+            case NODE_TRANSLATE_POINT:
+            {
+                std::string xMoved = "x + " + RealLiteral(GetParam(node, "x"));
+                std::string yMoved = "y + " + RealLiteral(GetParam(node, "y"));
+                AppendFormat(s, "    return %s;\n", Call(src[0],
+                    xMoved.c_str(), yMoved.c_str()).c_str());
+                break;
+            }
+            case NODE_TURBULENCE:
+            {
+                std::string power = RealLiteral(GetParam(node, "power"));
+                s += "    NOISE_REAL x0 = x + (12414.0f / 65536.0f);\n";
+                s += "    NOISE_REAL y0 = y + (65124.0f / 65536.0f);\n";
+                if (GetIntParam(node, "joint") != 0)
+                {
+                    // The joint distortion module samples both channels at
+                    // the first offset.
+                    AppendFormat(s, "    NOISE_REAL xDistort = x"
+                        " + (Node%dX (x0, y0) * %s);\n"
+                        "    NOISE_REAL yDistort = y"
+                        " + (Node%dY (x0, y0) * %s);\n",
+                        id, power.c_str(), id, power.c_str());
+                }
+                else
+                {
+                    s += "    NOISE_REAL x1 = x + (26519.0f / 65536.0f);\n";
+                    s += "    NOISE_REAL y1 = y + (18128.0f / 65536.0f);\n";
+                    AppendFormat(s, "    NOISE_REAL xDistort = x"
+                        " + (Node%dX (x0, y0) * %s);\n"
+                        "    NOISE_REAL yDistort = y"
+                        " + (Node%dY (x1, y1) * %s);\n",
+                        id, power.c_str(), id, power.c_str());
+                }
+                AppendFormat(s, "    return %s;\n",
+                    Call(src[0], "xDistort", "yDistort").c_str());
+                break;
+            }
+            case NODE_VORONOI:
+            {
+                int seed = GetIntParam(node, "seed");
+                std::string frequency
+                    = RealLiteral(GetParam(node, "frequency"));
+                AppendFormat(s, "    x *= %s;\n    y *= %s;\n",
+                    frequency.c_str(), frequency.c_str());
+                s += "    int xInt = (x > 0.0 ? (int)x : (int)x - 1);\n";
+                s += "    int yInt = (y > 0.0 ? (int)y : (int)y - 1);\n";
+                s += "    NOISE_REAL minDist = 2147483647.0f;\n";
+                s += "    NOISE_REAL xCandidate = 0;\n";
+                s += "    NOISE_REAL yCandidate = 0;\n";
+                s += "    for (int yCur = yInt - 2; yCur <= yInt + 2; yCur++) {\n";
+                s += "      for (int xCur = xInt - 2; xCur <= xInt + 2; xCur++) {\n";
+                AppendFormat(s, "        NOISE_REAL xPos = xCur"
+                    " + ValueNoise2D (xCur, yCur, %s);\n"
+                    "        NOISE_REAL yPos = yCur"
+                    " + ValueNoise2D (xCur, yCur, %s);\n",
+                    IntLiteral(seed).c_str(),
+                    IntLiteral(OffsetSeed(seed, 1)).c_str());
+                s += "        NOISE_REAL xDist = xPos - x;\n";
+                s += "        NOISE_REAL yDist = yPos - y;\n";
+                s += "        NOISE_REAL dist = xDist * xDist + yDist * yDist;\n";
+                s += "        if (dist < minDist) {\n";
+                s += "          minDist = dist;\n";
+                s += "          xCandidate = xPos;\n";
+                s += "          yCandidate = yPos;\n";
+                s += "        }\n      }\n    }\n";
+                if (GetIntParam(node, "distance") != 0)
+                {
+                    s += "    NOISE_REAL xDist = xCandidate - x;\n";
+                    s += "    NOISE_REAL yDist = yCandidate - y;\n";
+                    s += "    NOISE_REAL value = (sqrt (xDist * xDist"
+                        " + yDist * yDist)) * SQRT_3 - 1.0f;\n";
+                }
+                else
+                {
+                    s += "    NOISE_REAL value = 0.0;\n";
+                }
+                AppendFormat(s, "    return value + (%s * (NOISE_REAL)"
+                    "ValueNoise2D (\n"
+                    "      (int)(floor (xCandidate)),\n"
+                    "      (int)(floor (yCandidate))));\n",
+                    RealLiteral(GetParam(node, "displacement")).c_str());
+                break;
+            }
+            default:
+                throw noise::ExceptionInvalidParam();
+        }
+        s += "  }\n\n";
+    }
+
+    // Returns true if a string is a C++ identifier.
+    bool IsIdentifier(const std::string& name)
+    {
+        if (name.empty() || (name[0] >= '0' && name[0] <= '9'))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < name.size(); i++)
+        {
+            char c = name[i];
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                || (c >= '0' && c <= '9') || c == '_'))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Graph text format
+
+void noise::utils::SaveModuleGraph(const Module& root, std::string& text)
+{
+    std::string graphText;
+    AppendFormat(graphText, "noisegraph %d\n", MODULE_GRAPH_FORMAT_VERSION);
+
+    std::map<const Module*, int> ids;
+    std::set<const Module*> path;
+    int nextId = 0;
+    int rootId = WriteNode(root, ids, path, nextId, graphText);
+    AppendFormat(graphText, "root %d\n", rootId);
+    text.swap(graphText);
+}
+
+int noise::utils::LoadModuleGraph(const std::string& text,
+    VersionedGraph& graph)
+{
+    std::vector<NodeDesc> nodes;
+    int rootId = ParseGraph(text, nodes);
+
+    std::vector<int> graphIds(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        graphIds[i] = LoadNode(nodes[i], graph);
+        for (size_t j = 0; j < nodes[i].sourceIds.size(); j++)
+        {
+            graph.Link(graphIds[i], (int)j, graphIds[nodes[i].sourceIds[j]]);
+        }
+    }
+    return graphIds[rootId];
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// GraphCodeGenerator class
+
+GraphCodeGenerator::GraphCodeGenerator():
+    m_functionName("GetGraphValue")
+{
+}
+
+void GraphCodeGenerator::Generate(const std::string& graphText,
+    std::string& source) const
+{
+    std::vector<NodeDesc> nodes;
+    int rootId = ParseGraph(graphText, nodes);
+
+    // Only the noise modules that the root module uses are emitted.
+    std::vector<bool> isUsed(nodes.size(), false);
+    isUsed[rootId] = true;
+    for (int id = rootId; id >= 0; id--)
+    {
+        if (isUsed[id])
+        {
+            for (size_t i = 0; i < nodes[id].sourceIds.size(); i++)
+            {
+                isUsed[nodes[id].sourceIds[i]] = true;
+            }
+        }
+    }
+
+    std::string s;
+    s += "// Generated by noise::utils::GraphCodeGenerator.  Do not edit.\n";
+    s += "//\n";
+    s += "// Evaluates a graph of noise modules; see the documentation of\n";
+    s += "// noise::utils::GraphCodeGenerator.\n\n";
+    s += "#include <noise/interp.h>\n";
+    s += "#include <noise/mathconsts.h>\n";
+    s += "#include <noise/misc.h>\n";
+    s += "#include <noise/noisegen.h>\n\n";
+    s += "using namespace noise;\n\n";
+    s += "namespace\n{\n\n";
+    for (int id = 0; id <= rootId; id++)
+    {
+        if (isUsed[id])
+        {
+            EmitNode(s, nodes, id);
+        }
+    }
+    s += "}\n\n";
+
+    const char* name = m_functionName.c_str();
+    AppendFormat(s, "NOISE_REAL %s (NOISE_REAL x, NOISE_REAL y)\n"
+        "{\n  return %s;\n}\n\n", name, Call(rootId).c_str());
+    AppendFormat(s, "void %sBatch (const NOISE_REAL* pX, const NOISE_REAL* pY,"
+        " int count,\n  NOISE_REAL* pOut)\n"
+        "{\n  for (int i = 0; i < count; i++) {\n"
+        "    pOut[i] = %s;\n  }\n}\n", name,
+        Call(rootId, "pX[i]", "pY[i]").c_str());
+    source.swap(s);
+}
+
+void GraphCodeGenerator::SetFunctionName(const std::string& functionName)
+{
+    if (!IsIdentifier(functionName))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_functionName = functionName;
+}
@@ -0,0 +1,771 @@
+// LibnoiseContour.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "LibnoiseContour.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // The edges of a cell are numbered counter-clockwise from the bottom
+    // one: 0 joins the corners (x, y) and (x + 1, y), 1 joins (x + 1, y) and
+    // (x + 1, y + 1), 2 joins (x, y + 1) and (x + 1, y + 1), and 3 joins
+    // (x, y) and (x, y + 1).  The corners are numbered the same way, from
+    // (x, y), so that edge i runs from corner i to corner i + 1 around the
+    // cell.
+
+    // The segment of each non-saddle cell, by the bit mask of its corners at
+    // or above the level: the edge where the walk around the cell leaves the
+    // points above the level, then the edge where it enters them.  Following
+    // the segment from the first edge to the second keeps the points above
+    // the level on the left.
+    const int CELL_SEGMENTS[16][2] =
+    {
+        {-1, -1}, { 0,  3}, { 1,  0}, { 1,  3},
+        { 2,  1}, {-1, -1}, { 2,  0}, { 2,  3},
+        { 3,  2}, { 0,  2}, {-1, -1}, { 1,  2},
+        { 3,  1}, { 0,  1}, { 3,  0}, {-1, -1}
+    };
+
+    // The two segments of the saddle cells (masks 5 and 10), when the center
+    // of the cell is below the level, then when it is above.
+    const int SADDLE_SEGMENTS[2][2][4] =
+    {
+        {{0, 3, 2, 1}, {0, 1, 2, 3}},
+        {{1, 0, 3, 2}, {1, 2, 3, 0}}
+    };
+
+    // The offsets of the cell across each edge.
+    const int EDGE_NEIGHBOUR_X[4] = {0, 1, 0, -1};
+    const int EDGE_NEIGHBOUR_Y[4] = {-1, 0, 1, 0};
+
+    // A segment of a contour line inside a cell.
+    struct ContourSegment
+    {
+        int cellX;
+        int cellY;
+        int startEdge;
+        int endEdge;
+    };
+
+    // A piece of a polyline: a chain of segments inside a tile.  The edges
+    // are the identifiers of the edges of the noise map where the chain
+    // starts and ends; a chain that ends on a tile border continues in the
+    // chain of the neighbouring tile that starts on the same edge.  The
+    // smallest edge the chain crosses, and the index of its vertex in the
+    // chain, place the start of the loops.
+    struct ContourChain
+    {
+        int level;
+        uint64 startEdge;
+        uint64 endEdge;
+        uint64 minEdge;
+        size_t firstVertex;
+        size_t vertexCount;
+        size_t minVertex;
+        bool isClosed;
+    };
+
+    // The chains of a tile, with their vertices.
+    struct TileContours
+    {
+        std::vector<float> vertices;
+        std::vector<ContourChain> chains;
+    };
+
+    // A polyline, before it is simplified and written.  The first edge is
+    // the edge where an open polyline starts, or the smallest edge that a
+    // closed one crosses; it orders the polylines of a level.
+    struct ContourPolyline
+    {
+        int level;
+        uint64 firstEdge;
+        bool isClosed;
+        std::vector<float> vertices;
+    };
+
+    // Scratch space of one worker.
+    struct ContourScratch
+    {
+        std::vector<uint8> flags;
+        std::vector<int> cellSegments;
+        std::vector<ContourSegment> segments;
+        std::vector<uint8> visited;
+    };
+
+    // Returns the identifier of an edge of a cell in a noise map.  Edges
+    // along rows get even identifiers, edges along columns odd ones.
+    uint64 GetEdgeId(int width, int x, int y, int edge)
+    {
+        switch (edge)
+        {
+            case 0:
+                return 2 * ((uint64)y * (uint64)width + (uint64)x);
+            case 1:
+                return 2 * ((uint64)y * (uint64)width + (uint64)x + 1) + 1;
+            case 2:
+                return 2 * ((uint64)(y + 1) * (uint64)width + (uint64)x);
+            default:
+                return 2 * ((uint64)y * (uint64)width + (uint64)x) + 1;
+        }
+    }
+
+    // Appends a vertex to the polyline that starts at a given vertex, unless
+    // it repeats the last vertex of the polyline.  A point exactly at the
+    // level is the crossing of every edge it ends that the contour line
+    // crosses, which would otherwise give zero-length segments.
+    void AppendVertex(float x, float y, size_t firstVertex,
+        std::vector<float>& vertices)
+    {
+        size_t size = vertices.size();
+        if (size > 2 * firstVertex && vertices[size - 2] == x
+            && vertices[size - 1] == y)
+        {
+            return;
+        }
+        vertices.push_back(x);
+        vertices.push_back(y);
+    }
+
+    // Removes the vertices at the end of a closed polyline that repeat its
+    // first vertex.
+    void RemoveClosingVertices(size_t firstVertex,
+        std::vector<float>& vertices)
+    {
+        const float* pFirst = &vertices[2 * firstVertex];
+        while (vertices.size() > 2 * firstVertex + 2
+            && vertices[vertices.size() - 2] == pFirst[0]
+            && vertices[vertices.size() - 1] == pFirst[1])
+        {
+            vertices.resize(vertices.size() - 2);
+        }
+    }
+
+    // Appends the crossing of a contour line with an edge.  The crossing is
+    // interpolated from the first point of the edge, so every tile computes
+    // the same vertex for an edge.
+    void AppendEdgePoint(const NoiseMap& noiseMap, uint64 edgeId,
+        double level, size_t firstVertex, std::vector<float>& vertices)
+    {
+        int width = noiseMap.GetWidth();
+        uint64 point = edgeId >> 1;
+        int x = (int)(point % (uint64)width);
+        int y = (int)(point / (uint64)width);
+        double value0 = *noiseMap.GetConstSlabPtr(x, y);
+        if ((edgeId & 1) == 0)
+        {
+            double value1 = *noiseMap.GetConstSlabPtr(x + 1, y);
+            AppendVertex((float)(x + (level - value0) / (value1 - value0)),
+                (float)y, firstVertex, vertices);
+        }
+        else
+        {
+            double value1 = *noiseMap.GetConstSlabPtr(x, y + 1);
+            AppendVertex((float)x,
+                (float)(y + (level - value0) / (value1 - value0)),
+                firstVertex, vertices);
+        }
+    }
+
+    // Marks, with the Douglas-Peucker algorithm, the vertices of a polyline
+    // to keep between two kept vertices.
+    void MarkKeptVertices(const float* pVertices, int first, int last,
+        double toleranceSquared, std::vector<uint8>& isKept,
+        std::vector<std::pair<int, int> >& stack)
+    {
+        stack.clear();
+        stack.push_back(std::make_pair(first, last));
+        while (!stack.empty())
+        {
+            int a = stack.back().first;
+            int b = stack.back().second;
+            stack.pop_back();
+            if (b - a < 2)
+            {
+                continue;
+            }
+
+            double ax = pVertices[2 * a];
+            double ay = pVertices[2 * a + 1];
+            double dx = pVertices[2 * b] - ax;
+            double dy = pVertices[2 * b + 1] - ay;
+            double lengthSquared = dx * dx + dy * dy;
+            double maxDistance = -1.0;
+            int farthest = a;
+            for (int i = a + 1; i < b; i++)
+            {
+                double px = pVertices[2 * i] - ax;
+                double py = pVertices[2 * i + 1] - ay;
+                double distance;
+                if (lengthSquared > 0.0)
+                {
+                    // Distance to the segment.
+                    double t = GetMax(GetMin((px * dx + py * dy)
+                        / lengthSquared, 1.0), 0.0);
+                    double ex = px - t * dx;
+                    double ey = py - t * dy;
+                    distance = ex * ex + ey * ey;
+                }
+                else
+                {
+                    distance = px * px + py * py;
+                }
+                if (distance > maxDistance)
+                {
+                    maxDistance = distance;
+                    farthest = i;
+                }
+            }
+
+            if (maxDistance > toleranceSquared)
+            {
+                isKept[farthest] = 1;
+                stack.push_back(std::make_pair(a, farthest));
+                stack.push_back(std::make_pair(farthest, b));
+            }
+        }
+    }
+
+    // Simplifies a polyline in place.
+    void SimplifyPolyline(ContourPolyline& polyline, double tolerance)
+    {
+        std::vector<float>& vertices = polyline.vertices;
+        int count = (int)(vertices.size() / 2);
+        if (count < 3)
+        {
+            return;
+        }
+
+        double toleranceSquared = tolerance * tolerance;
+        std::vector<std::pair<int, int> > stack;
+        std::vector<uint8> isKept;
+        if (polyline.isClosed)
+        {
+            // Split the loop at its first vertex and at the vertex farthest
+            // from it, and simplify both halves.
+            vertices.push_back(vertices[0]);
+            vertices.push_back(vertices[1]);
+            int farthest = 0;
+            double maxDistance = -1.0;
+            for (int i = 1; i < count; i++)
+            {
+                double dx = vertices[2 * i] - vertices[0];
+                double dy = vertices[2 * i + 1] - vertices[1];
+                if (dx * dx + dy * dy > maxDistance)
+                {
+                    maxDistance = dx * dx + dy * dy;
+                    farthest = i;
+                }
+            }
+            isKept.assign((size_t)count + 1, 0);
+            isKept[0] = 1;
+            isKept[farthest] = 1;
+            MarkKeptVertices(&vertices[0], 0, farthest, toleranceSquared,
+                isKept, stack);
+            MarkKeptVertices(&vertices[0], farthest, count, toleranceSquared,
+                isKept, stack);
+        }
+        else
+        {
+            isKept.assign((size_t)count, 0);
+            isKept[0] = 1;
+            isKept[count - 1] = 1;
+            MarkKeptVertices(&vertices[0], 0, count - 1, toleranceSquared,
+                isKept, stack);
+        }
+
+        size_t keptCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (isKept[i])
+            {
+                vertices[2 * keptCount] = vertices[2 * i];
+                vertices[2 * keptCount + 1] = vertices[2 * i + 1];
+                keptCount++;
+            }
+        }
+        vertices.resize(2 * keptCount);
+    }
+
+    // Rotates the vertices of a closed polyline so that it starts at a given
+    // vertex.  A vertex past the end was removed as a repeat of the first
+    // one.
+    void RotateLoop(size_t firstVertex, std::vector<float>& vertices)
+    {
+        if (2 * firstVertex < vertices.size())
+        {
+            std::rotate(vertices.begin(), vertices.begin() + 2 * firstVertex,
+                vertices.end());
+        }
+    }
+
+    // Returns true if a polyline comes before another one in a contour set.
+    bool IsPolylineBefore(const ContourPolyline& a, const ContourPolyline& b)
+    {
+        return (a.level != b.level) ? (a.level < b.level)
+            : (a.firstEdge < b.firstEdge);
+    }
+
+    // Appends the vertices of a chain to a polyline.  Consecutive chains
+    // share the vertex of the edge where they meet, which is kept once, as
+    // are the repeated vertices around the tile border, so that the polyline
+    // does not depend on where the tiles split it.
+    void AppendChain(const TileContours& tile, const ContourChain& chain,
+        std::vector<float>& vertices)
+    {
+        const float* pVertices = &tile.vertices[2 * chain.firstVertex];
+        for (size_t i = 0; i < chain.vertexCount; i++)
+        {
+            AppendVertex(pVertices[2 * i], pVertices[2 * i + 1], 0, vertices);
+        }
+    }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// ContourExtractor class
+
+ContourExtractor::ContourExtractor():
+    m_threadCount(0),
+    m_tileSize(DEFAULT_CONTOUR_TILE_SIZE),
+    m_tolerance(0.0)
+{
+}
+
+void ContourExtractor::Extract(const NoiseMap& sourceNoiseMap,
+    const NOISE_REAL* pLevels, int levelCount, ContourSet& contours) const
+{
+    int width = sourceNoiseMap.GetWidth();
+    int height = sourceNoiseMap.GetHeight();
+    if (width < 2 || height < 2 || pLevels == NULL || levelCount <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    contours.vertices.clear();
+    contours.polylineOffsets.clear();
+    contours.polylineLevels.clear();
+    contours.polylineClosed.clear();
+
+    // Trace the chains of every tile.
+    int tileSize = m_tileSize;
+    int tileCountX = (width - 2) / tileSize + 1;
+    int tileCountY = (height - 2) / tileSize + 1;
+    int tileCount = tileCountX * tileCountY;
+    int threadCount = ResolveThreadCount(m_threadCount);
+    std::vector<TileContours> tiles((size_t)tileCount);
+    std::vector<ContourScratch> scratch((size_t)threadCount);
+    try
+    {
+        size_t tileCellCount = (size_t)GetMin(tileSize, width - 1)
+            * (size_t)GetMin(tileSize, height - 1);
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].flags.resize(2 * ((size_t)tileSize + 1 + 8));
+            scratch[i].cellSegments.assign(2 * tileCellCount, -1);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    ParallelFor(tileCount, threadCount,
+        [&](int tile, int worker)
+        {
+            ContourScratch& s = scratch[worker];
+            TileContours& output = tiles[tile];
+            int cellX0 = (tile % tileCountX) * tileSize;
+            int cellY0 = (tile / tileCountX) * tileSize;
+            int cellX1 = GetMin(cellX0 + tileSize, width - 1);
+            int cellY1 = GetMin(cellY0 + tileSize, height - 1);
+            int tileWidth = cellX1 - cellX0;
+            int flagCount = tileWidth + 1;
+            uint8* pFlags0 = &s.flags[0];
+            uint8* pFlags1 = pFlags0 + tileSize + 1 + 8;
+
+            for (int level = 0; level < levelCount; level++)
+            {
+                double levelValue = pLevels[level];
+                float threshold = (float)levelValue;
+                if ((double)threshold < levelValue)
+                {
+                    // The smallest float at or above the level.
+                    threshold = nextafterf(threshold, HUGE_VALF);
+                }
+
+                // Find the segments, row by row.  The flags of a row tell
+                // which points are at or above the level.
+                s.segments.clear();
+                const float* pRow = sourceNoiseMap.GetConstSlabPtr(cellX0,
+                    cellY0);
+                for (int x = 0; x < flagCount; x++)
+                {
+                    pFlags1[x] = (pRow[x] >= threshold) ? 1 : 0;
+                }
+                for (int y = cellY0; y < cellY1; y++)
+                {
+                    SwapValues(pFlags0, pFlags1);
+                    pRow = sourceNoiseMap.GetConstSlabPtr(cellX0, y + 1);
+                    for (int x = 0; x < flagCount; x++)
+                    {
+                        pFlags1[x] = (pRow[x] >= threshold) ? 1 : 0;
+                    }
+
+                    for (int i = 0; i < tileWidth; i++)
+                    {
+                        // Skip eight cells at once where both rows are
+                        // entirely above or below the level.
+                        if (i + 8 < flagCount)
+                        {
+                            uint64 bits0;
+                            uint64 bits1;
+                            memcpy(&bits0, pFlags0 + i, 8);
+                            memcpy(&bits1, pFlags1 + i, 8);
+                            if (bits0 == bits1 && (bits0 == 0
+                                || bits0 == 0x0101010101010101ULL)
+                                && pFlags0[i + 8] == pFlags0[i]
+                                && pFlags1[i + 8] == pFlags0[i])
+                            {
+                                i += 7;
+                                continue;
+                            }
+                        }
+
+                        int mask = pFlags0[i] | (pFlags0[i + 1] << 1)
+                            | (pFlags1[i + 1] << 2) | (pFlags1[i] << 3);
+                        if (mask == 0 || mask == 15)
+                        {
+                            continue;
+                        }
+
+                        ContourSegment segment;
+                        segment.cellX = cellX0 + i;
+                        segment.cellY = y;
+                        if (mask == 5 || mask == 10)
+                        {
+                            const float* pCell = sourceNoiseMap.GetConstSlabPtr(
+                                segment.cellX, y);
+                            const float* pNext = sourceNoiseMap.GetConstSlabPtr(
+                                segment.cellX, y + 1);
+                            double center = ((double)pCell[0] + pCell[1]
+                                + pNext[0] + pNext[1]) / 4.0;
+                            const int* pEdges = SADDLE_SEGMENTS[mask == 10]
+                                [center >= levelValue];
+                            segment.startEdge = pEdges[0];
+                            segment.endEdge = pEdges[1];
+                            s.segments.push_back(segment);
+                            segment.startEdge = pEdges[2];
+                            segment.endEdge = pEdges[3];
+                        }
+                        else
+                        {
+                            segment.startEdge = CELL_SEGMENTS[mask][0];
+                            segment.endEdge = CELL_SEGMENTS[mask][1];
+                        }
+                        s.segments.push_back(segment);
+                    }
+                }
+
+                // Index the segments by cell.
+                int segmentCount = (int)s.segments.size();
+                for (int i = 0; i < segmentCount; i++)
+                {
+                    const ContourSegment& segment = s.segments[i];
+                    size_t cell = 2 * ((size_t)(segment.cellY - cellY0)
+                        * (size_t)tileWidth + (size_t)(segment.cellX - cellX0));
+                    s.cellSegments[cell + (s.cellSegments[cell] >= 0)] = i;
+                }
+                s.visited.assign((size_t)segmentCount, 0);
+
+                // Follows the contour line from a segment to the segment of
+                // the next cell, or returns -1 at the tile border.
+                auto fGetNext = [&](const ContourSegment& segment)
+                {
+                    int x = segment.cellX + EDGE_NEIGHBOUR_X[segment.endEdge];
+                    int y = segment.cellY + EDGE_NEIGHBOUR_Y[segment.endEdge];
+                    if (x < cellX0 || x >= cellX1 || y < cellY0 || y >= cellY1)
+                    {
+                        return -1;
+                    }
+                    size_t cell = 2 * ((size_t)(y - cellY0) * (size_t)tileWidth
+                        + (size_t)(x - cellX0));
+                    int next = s.cellSegments[cell];
+                    int edge = (segment.endEdge + 2) % 4;
+                    return (s.segments[next].startEdge == edge) ? next
+                        : s.cellSegments[cell + 1];
+                };
+
+                // Chain the segments: first the chains that start on the
+                // tile border, then the loops inside the tile.
+                for (int pass = 0; pass < 2; pass++)
+                {
+                    for (int i = 0; i < segmentCount; i++)
+                    {
+                        const ContourSegment& first = s.segments[i];
+                        if (s.visited[i])
+                        {
+                            continue;
+                        }
+                        if (pass == 0)
+                        {
+                            int x = first.cellX
+                                + EDGE_NEIGHBOUR_X[first.startEdge];
+                            int y = first.cellY
+                                + EDGE_NEIGHBOUR_Y[first.startEdge];
+                            if (x >= cellX0 && x < cellX1 && y >= cellY0
+                                && y < cellY1)
+                            {
+                                continue;
+                            }
+                        }
+
+                        ContourChain chain;
+                        chain.level = level;
+                        chain.startEdge = GetEdgeId(width, first.cellX,
+                            first.cellY, first.startEdge);
+                        chain.minEdge = chain.startEdge;
+                        chain.firstVertex = output.vertices.size() / 2;
+                        chain.minVertex = 0;
+                        chain.isClosed = (pass == 1);
+                        AppendEdgePoint(sourceNoiseMap, chain.startEdge,
+                            levelValue, chain.firstVertex, output.vertices);
+                        int current = i;
+                        while (current >= 0 && !s.visited[current])
+                        {
+                            const ContourSegment& segment = s.segments[current];
+                            s.visited[current] = 1;
+                            chain.endEdge = GetEdgeId(width, segment.cellX,
+                                segment.cellY, segment.endEdge);
+                            AppendEdgePoint(sourceNoiseMap, chain.endEdge,
+                                levelValue, chain.firstVertex,
+                                output.vertices);
+                            if (chain.endEdge < chain.minEdge)
+                            {
+                                chain.minEdge = chain.endEdge;
+                                chain.minVertex = output.vertices.size() / 2
+                                    - 1 - chain.firstVertex;
+                            }
+                            current = fGetNext(segment);
+                        }
+                        if (chain.isClosed)
+                        {
+                            // The last vertex repeats the first one.
+                            RemoveClosingVertices(chain.firstVertex,
+                                output.vertices);
+                        }
+                        chain.vertexCount = output.vertices.size() / 2
+                            - chain.firstVertex;
+                        output.chains.push_back(chain);
+                    }
+                }
+
+                for (int i = 0; i < segmentCount; i++)
+                {
+                    const ContourSegment& segment = s.segments[i];
+                    size_t cell = 2 * ((size_t)(segment.cellY - cellY0)
+                        * (size_t)tileWidth + (size_t)(segment.cellX - cellX0));
+                    s.cellSegments[cell] = -1;
+                    s.cellSegments[cell + 1] = -1;
+                }
+            }
+        });
+
+    // Stitch the chains that cross tile borders into polylines, level by
+    // level, in the order of the tiles.
+    std::vector<ContourPolyline> polylines;
+    try
+    {
+        for (int level = 0; level < levelCount; level++)
+        {
+            std::vector<std::pair<int, int> > openChains;
+            std::unordered_map<uint64, int> chainsByStart;
+            std::unordered_set<uint64> endEdges;
+            for (int tile = 0; tile < tileCount; tile++)
+            {
+                const std::vector<ContourChain>& chains = tiles[tile].chains;
+                for (size_t i = 0; i < chains.size(); i++)
+                {
+                    if (chains[i].level == level && !chains[i].isClosed)
+                    {
+                        chainsByStart[chains[i].startEdge]
+                            = (int)openChains.size();
+                        endEdges.insert(chains[i].endEdge);
+                        openChains.push_back(std::make_pair(tile, (int)i));
+                    }
+                }
+            }
+
+            std::vector<uint8> isUsed(openChains.size(), 0);
+            int openIndex = 0;
+            for (int tile = 0; tile < tileCount; tile++)
+            {
+                const std::vector<ContourChain>& chains = tiles[tile].chains;
+                for (size_t i = 0; i < chains.size(); i++)
+                {
+                    const ContourChain& chain = chains[i];
+                    if (chain.level != level)
+                    {
+                        continue;
+                    }
+                    if (chain.isClosed)
+                    {
+                        polylines.push_back(ContourPolyline());
+                        polylines.back().level = level;
+                        polylines.back().firstEdge = chain.minEdge;
+                        polylines.back().isClosed = true;
+                        AppendChain(tiles[tile], chain,
+                            polylines.back().vertices);
+                        RotateLoop(chain.minVertex, polylines.back().vertices);
+                        continue;
+                    }
+
+                    // An open chain starts a polyline if no chain leads to
+                    // it, that is, if it starts on the edge of the noise map.
+                    int index = openIndex++;
+                    if (endEdges.count(chain.startEdge) != 0)
+                    {
+                        continue;
+                    }
+                    polylines.push_back(ContourPolyline());
+                    polylines.back().level = level;
+                    polylines.back().firstEdge = chain.startEdge;
+                    polylines.back().isClosed = false;
+                    while (index >= 0)
+                    {
+                        isUsed[index] = 1;
+                        const TileContours& piece = tiles[openChains[index].first];
+                        const ContourChain& next
+                            = piece.chains[openChains[index].second];
+                        AppendChain(piece, next, polylines.back().vertices);
+                        std::unordered_map<uint64, int>::const_iterator it
+                            = chainsByStart.find(next.endEdge);
+                        index = (it != chainsByStart.end()) ? it->second : -1;
+                    }
+                }
+            }
+
+            // The remaining open chains form loops across tile borders.  A
+            // loop starts at the vertex of its smallest edge, wherever the
+            // tiles split it.
+            for (size_t start = 0; start < openChains.size(); start++)
+            {
+                if (isUsed[start])
+                {
+                    continue;
+                }
+                polylines.push_back(ContourPolyline());
+                ContourPolyline& polyline = polylines.back();
+                polyline.level = level;
+                polyline.firstEdge = ~(uint64)0;
+                polyline.isClosed = true;
+                size_t firstVertex = 0;
+                int index = (int)start;
+                while (!isUsed[index])
+                {
+                    isUsed[index] = 1;
+                    const TileContours& piece = tiles[openChains[index].first];
+                    const ContourChain& next
+                        = piece.chains[openChains[index].second];
+                    AppendChain(piece, next, polyline.vertices);
+                    if (next.minEdge < polyline.firstEdge)
+                    {
+                        // The first vertex of the chain may have been merged
+                        // into the last vertex of the polyline.
+                        polyline.firstEdge = next.minEdge;
+                        firstVertex = polyline.vertices.size() / 2
+                            - next.vertexCount + next.minVertex;
+                    }
+                    index = chainsByStart[next.endEdge];
+                }
+                RemoveClosingVertices(0, polyline.vertices);
+                RotateLoop(firstVertex, polyline.vertices);
+            }
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    tiles.clear();
+    std::sort(polylines.begin(), polylines.end(), IsPolylineBefore);
+
+    // Simplify the polylines.
+    if (m_tolerance > 0.0)
+    {
+        double tolerance = m_tolerance;
+        int polylineCount = (int)polylines.size();
+        int batchCount = (polylineCount + 63) / 64;
+        ParallelFor(batchCount, threadCount,
+            [&](int batch, int)
+            {
+                int end = GetMin(batch * 64 + 64, polylineCount);
+                for (int i = batch * 64; i < end; i++)
+                {
+                    SimplifyPolyline(polylines[i], tolerance);
+                }
+            });
+    }
+
+    // Write the flat arrays.
+    // A polyline that shrinks to a single point, around a point exactly at
+    // the level, is dropped.
+    size_t vertexCount = 0;
+    size_t writtenCount = 0;
+    for (size_t i = 0; i < polylines.size(); i++)
+    {
+        if (polylines[i].vertices.size() >= 4)
+        {
+            vertexCount += polylines[i].vertices.size() / 2;
+            writtenCount++;
+        }
+    }
+    try
+    {
+        contours.vertices.reserve(2 * vertexCount);
+        contours.polylineOffsets.reserve(writtenCount + 1);
+        contours.polylineLevels.reserve(writtenCount);
+        contours.polylineClosed.reserve(writtenCount);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    for (size_t i = 0; i < polylines.size(); i++)
+    {
+        if (polylines[i].vertices.size() < 4)
+        {
+            continue;
+        }
+        contours.polylineOffsets.push_back(
+            (uint32)(contours.vertices.size() / 2));
+        contours.polylineLevels.push_back(polylines[i].level);
+        contours.polylineClosed.push_back(polylines[i].isClosed ? 1 : 0);
+        contours.vertices.insert(contours.vertices.end(),
+            polylines[i].vertices.begin(), polylines[i].vertices.end());
+    }
+    contours.polylineOffsets.push_back((uint32)(contours.vertices.size() / 2));
+}
@@ -0,0 +1,334 @@
+// LibnoiseDistance.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <limits>
+#include <math.h>
+#include <vector>
+
+#include "LibnoiseDistance.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    const float FLOAT_INFINITY = std::numeric_limits<float>::infinity();
+    const double DOUBLE_INFINITY = std::numeric_limits<double>::infinity();
+
+    // Scratch space of one worker.
+    struct DistanceScratch
+    {
+        std::vector<uint8> flags;
+        std::vector<float> strip;
+        std::vector<double> f;
+        std::vector<double> d;
+        std::vector<double> z;
+        std::vector<int> v;
+    };
+
+    // Writes, for each point of a row, the distance to the nearest point of
+    // the row whose flag equals @a target, or infinity.  Only the points
+    // whose flag differs from @a target are written.
+    void Distance1D(const uint8* pFlags, int width, bool target, float sign,
+        float* pDest)
+    {
+        // Forward sweep: distance to the nearest target point on the left.
+        int last = -1;
+        for (int x = 0; x < width; x++)
+        {
+            if ((pFlags[x] != 0) == target)
+            {
+                last = x;
+            }
+            else
+            {
+                pDest[x] = (last >= 0) ? sign * (float)(x - last)
+                    : sign * FLOAT_INFINITY;
+            }
+        }
+
+        // Backward sweep: keep the nearest target point on the right if it is
+        // closer.
+        last = -1;
+        for (int x = width - 1; x >= 0; x--)
+        {
+            if ((pFlags[x] != 0) == target)
+            {
+                last = x;
+            }
+            else if (last >= 0 && (float)(last - x) < sign * pDest[x])
+            {
+                pDest[x] = sign * (float)(last - x);
+            }
+        }
+    }
+
+    // Computes the lower envelope of the parabolas ( q - p )^2 + f[ p ] and
+    // samples it at every point: d[ q ] = min over p of ( q - p )^2 + f[ p ].
+    // Infinite values of f are skipped; if every value is infinite, d is
+    // infinite everywhere.
+    void Envelope1D(const double* f, int n, double* d, double* z, int* v)
+    {
+        int k = -1;
+        for (int q = 0; q < n; q++)
+        {
+            if (f[q] == DOUBLE_INFINITY)
+            {
+                continue;
+            }
+            if (k < 0)
+            {
+                k = 0;
+                v[0] = q;
+                z[0] = -DOUBLE_INFINITY;
+                z[1] =  DOUBLE_INFINITY;
+                continue;
+            }
+
+            // Remove the parabolas hidden by the parabola of q.  The first one
+            // is never removed, since its left bound is minus infinity.
+            double fq = f[q] + (double)q * (double)q;
+            double s;
+            for (;;)
+            {
+                int p = v[k];
+                s = (fq - (f[p] + (double)p * (double)p))
+                    / (2.0 * (double)(q - p));
+                if (s > z[k])
+                {
+                    break;
+                }
+                k--;
+            }
+            k++;
+            v[k] = q;
+            z[k] = s;
+            z[k + 1] = DOUBLE_INFINITY;
+        }
+
+        if (k < 0)
+        {
+            for (int q = 0; q < n; q++)
+            {
+                d[q] = DOUBLE_INFINITY;
+            }
+            return;
+        }
+
+        k = 0;
+        for (int q = 0; q < n; q++)
+        {
+            while (z[k + 1] < (double)q)
+            {
+                k++;
+            }
+            double dq = (double)(q - v[k]);
+            d[q] = dq * dq + f[v[k]];
+        }
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DistanceTransform class
+
+DistanceTransform::DistanceTransform():
+    m_isSigned(false),
+    m_threadCount(0),
+    m_threshold(0.0)
+{
+}
+
+void DistanceTransform::Run(int width, int height,
+    const std::function<void(int, uint8*)>& fReadRow,
+    NoiseMap& destNoiseMap) const
+{
+    int threadCount = ResolveThreadCount(m_threadCount);
+    int stripWidth = DISTANCE_COLUMN_STRIP_WIDTH;
+    size_t scratchBytes = (size_t)width
+        + (size_t)stripWidth * (size_t)height * sizeof(float)
+        + (size_t)height * (3 * sizeof(double) + sizeof(int)) + sizeof(double);
+    MemoryReservation reservation(MEMORY_SCRATCH,
+        (size_t)threadCount * scratchBytes);
+
+    std::vector<DistanceScratch> scratch((size_t)threadCount);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].flags.resize((size_t)width);
+            scratch[i].strip.resize((size_t)stripWidth * (size_t)height);
+            scratch[i].f.resize((size_t)height);
+            scratch[i].d.resize((size_t)height);
+            scratch[i].z.resize((size_t)height + 1);
+            scratch[i].v.resize((size_t)height);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Row pass.  Each point receives the distance to the nearest feature
+    // point of its row, or, for a feature point, zero or the negated
+    // distance to the nearest non-feature point of its row.
+    bool isSigned = m_isSigned;
+    ParallelFor(height, threadCount,
+        [&](int z, int worker)
+        {
+            uint8* pFlags = &scratch[worker].flags[0];
+            float* pDest = destNoiseMap.GetSlabPtr(z);
+            fReadRow(z, pFlags);
+            Distance1D(pFlags, width, true, 1.0f, pDest);
+            if (isSigned)
+            {
+                Distance1D(pFlags, width, false, -1.0f, pDest);
+            }
+            else
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    if (pFlags[x] != 0)
+                    {
+                        pDest[x] = 0.0f;
+                    }
+                }
+            }
+        });
+
+    // Column pass, on strips of columns so that each cache line of the noise
+    // map is read and written once.  The strip keeps the row-major layout of
+    // the noise map, so copying it in and out is a copy of whole lines.  The
+    // sign of a row distance tells which side of the boundary a point is on.
+    int stripCount = (width + stripWidth - 1) / stripWidth;
+    ParallelFor(stripCount, threadCount,
+        [&](int strip, int worker)
+        {
+            DistanceScratch& s = scratch[worker];
+            int x0 = strip * stripWidth;
+            int columnCount = GetMin(stripWidth, width - x0);
+            float* pStrip = &s.strip[0];
+            for (int z = 0; z < height; z++)
+            {
+                const float* pSource = destNoiseMap.GetConstSlabPtr(x0, z);
+                float* pLine = pStrip + (size_t)z * (size_t)stripWidth;
+                for (int i = 0; i < columnCount; i++)
+                {
+                    pLine[i] = pSource[i];
+                }
+            }
+
+            for (int i = 0; i < columnCount; i++)
+            {
+                float* pColumn = pStrip + i;
+
+                // Distances to the feature points, for the non-feature points.
+                bool hasInside = false;
+                for (int z = 0; z < height; z++)
+                {
+                    float g = pColumn[(size_t)z * (size_t)stripWidth];
+                    hasInside = hasInside || (g < 0.0f);
+                    s.f[z] = (g > 0.0f) ? (double)g * (double)g : 0.0;
+                }
+                Envelope1D(&s.f[0], height, &s.d[0], &s.z[0], &s.v[0]);
+                for (int z = 0; z < height; z++)
+                {
+                    float& value = pColumn[(size_t)z * (size_t)stripWidth];
+                    if (value > 0.0f)
+                    {
+                        value = (float)sqrt(s.d[z]);
+                    }
+                }
+
+                // Distances to the non-feature points, for the feature points.
+                if (hasInside)
+                {
+                    for (int z = 0; z < height; z++)
+                    {
+                        float g = pColumn[(size_t)z * (size_t)stripWidth];
+                        s.f[z] = (g < 0.0f) ? (double)g * (double)g : 0.0;
+                    }
+                    Envelope1D(&s.f[0], height, &s.d[0], &s.z[0], &s.v[0]);
+                    for (int z = 0; z < height; z++)
+                    {
+                        float& value = pColumn[(size_t)z * (size_t)stripWidth];
+                        if (value < 0.0f)
+                        {
+                            value = -(float)sqrt(s.d[z]);
+                        }
+                    }
+                }
+            }
+
+            for (int z = 0; z < height; z++)
+            {
+                float* pDest = destNoiseMap.GetSlabPtr(x0, z);
+                const float* pLine = pStrip + (size_t)z * (size_t)stripWidth;
+                for (int i = 0; i < columnCount; i++)
+                {
+                    pDest[i] = pLine[i];
+                }
+            }
+        });
+}
+
+void DistanceTransform::Transform(const NoiseMap& sourceNoiseMap,
+    NoiseMap& destNoiseMap) const
+{
+    int width = sourceNoiseMap.GetWidth();
+    int height = sourceNoiseMap.GetHeight();
+    if (width <= 0 || height <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    destNoiseMap.SetSize(width, height);
+    float threshold = (float)m_threshold;
+    Run(width, height,
+        [&](int z, uint8* pFlags)
+        {
+            const float* pSource = sourceNoiseMap.GetConstSlabPtr(z);
+            for (int x = 0; x < width; x++)
+            {
+                pFlags[x] = (pSource[x] >= threshold) ? 1 : 0;
+            }
+        },
+        destNoiseMap);
+}
+
+void DistanceTransform::Transform(const uint8* pMask, int width, int height,
+    NoiseMap& destNoiseMap) const
+{
+    if (pMask == NULL || width <= 0 || height <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    destNoiseMap.SetSize(width, height);
+    Run(width, height,
+        [&](int z, uint8* pFlags)
+        {
+            const uint8* pRow = pMask + (size_t)z * (size_t)width;
+            for (int x = 0; x < width; x++)
+            {
+                pFlags[x] = pRow[x];
+            }
+        },
+        destNoiseMap);
+}
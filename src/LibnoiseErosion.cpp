@@ -0,0 +1,568 @@
+// LibnoiseErosion.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <functional>
+#include <string.h>
+#include <vector>
+
+#include "LibnoiseErosion.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // Directions of the four neighbours of a point.  A flow stored in
+    // direction d leaves a point toward its neighbour in direction d, and
+    // arrives at that neighbour from its OPPOSITE[d] side.
+    enum Direction
+    {
+        DIR_WEST  = 0,
+        DIR_EAST  = 1,
+        DIR_SOUTH = 2,
+        DIR_NORTH = 3,
+        DIR_COUNT = 4
+    };
+
+    // Scratch buffers of an erosion stage.  Every buffer stores the points
+    // contiguously, width values per row; the flow buffers store one plane
+    // per direction.
+    class ErosionBuffers
+    {
+
+        public:
+
+            ErosionBuffers(int width, int height, int planeCount):
+                m_reservation(MEMORY_SCRATCH, (size_t)width * (size_t)height
+                    * (size_t)planeCount * sizeof(float)),
+                m_width(width),
+                m_height(height)
+            {
+                try
+                {
+                    m_data.assign((size_t)width * (size_t)height
+                        * (size_t)planeCount, 0.0f);
+                }
+                catch (...)
+                {
+                    throw noise::ExceptionOutOfMemory();
+                }
+            }
+
+            float* GetPlane(int plane)
+            {
+                return &m_data[(size_t)plane * (size_t)m_width * (size_t)m_height];
+            }
+
+        private:
+
+            MemoryReservation m_reservation;
+            std::vector<float> m_data;
+            int m_width;
+            int m_height;
+
+    };
+
+    // Runs a function on every band of rows of a height map.
+    void ForEachBand(int height, int threadCount,
+        const std::function<void(int, int)>& fBand)
+    {
+        int bandCount = (height + EROSION_BAND_HEIGHT - 1) / EROSION_BAND_HEIGHT;
+        ParallelFor(bandCount, threadCount,
+            [&](int band, int)
+            {
+                int z0 = band * EROSION_BAND_HEIGHT;
+                fBand(z0, GetMin(z0 + EROSION_BAND_HEIGHT, height));
+            });
+    }
+
+    // Adds the flows that arrive at each point of a row from its neighbours.
+    // pFlows holds the four direction planes, pIn receives the sum.
+    void GatherInflows(const float* const* pFlows, int width, int height,
+        int z, float* pIn)
+    {
+        size_t row = (size_t)z * (size_t)width;
+        const float* pFromWest  = pFlows[DIR_EAST ] + row - 1;
+        const float* pFromEast  = pFlows[DIR_WEST ] + row + 1;
+        for (int x = 0; x < width; x++)
+        {
+            pIn[x] = 0.0f;
+        }
+        for (int x = 1; x < width; x++)
+        {
+            pIn[x] += pFromWest[x];
+        }
+        for (int x = 0; x < width - 1; x++)
+        {
+            pIn[x] += pFromEast[x];
+        }
+        if (z > 0)
+        {
+            const float* pFromSouth = pFlows[DIR_NORTH] + row - (size_t)width;
+            for (int x = 0; x < width; x++)
+            {
+                pIn[x] += pFromSouth[x];
+            }
+        }
+        if (z < height - 1)
+        {
+            const float* pFromNorth = pFlows[DIR_SOUTH] + row + (size_t)width;
+            for (int x = 0; x < width; x++)
+            {
+                pIn[x] += pFromNorth[x];
+            }
+        }
+    }
+
+    // Computes, for each point of a row, the positive differences between
+    // the point's level and the levels of its four neighbours.  Neighbours
+    // outside the height map get a zero difference.
+    void ComputeDrops(const float* pLevel, int width, int height, int z,
+        float* const* pDrops)
+    {
+        size_t row = (size_t)z * (size_t)width;
+        const float* pCur = pLevel + row;
+        for (int x = 0; x < width; x++)
+        {
+            pDrops[DIR_WEST ][x] = (x > 0)
+                ? GetMax(pCur[x] - pCur[x - 1], 0.0f) : 0.0f;
+            pDrops[DIR_EAST ][x] = (x < width - 1)
+                ? GetMax(pCur[x] - pCur[x + 1], 0.0f) : 0.0f;
+        }
+        if (z > 0)
+        {
+            const float* pSouth = pCur - width;
+            for (int x = 0; x < width; x++)
+            {
+                pDrops[DIR_SOUTH][x] = GetMax(pCur[x] - pSouth[x], 0.0f);
+            }
+        }
+        else
+        {
+            for (int x = 0; x < width; x++)
+            {
+                pDrops[DIR_SOUTH][x] = 0.0f;
+            }
+        }
+        if (z < height - 1)
+        {
+            const float* pNorth = pCur + width;
+            for (int x = 0; x < width; x++)
+            {
+                pDrops[DIR_NORTH][x] = GetMax(pCur[x] - pNorth[x], 0.0f);
+            }
+        }
+        else
+        {
+            for (int x = 0; x < width; x++)
+            {
+                pDrops[DIR_NORTH][x] = 0.0f;
+            }
+        }
+    }
+
+    // Copies a noise map into a contiguous buffer, and back.
+    void CopyToBuffer(const NoiseMap& heightMap, float* pBuffer)
+    {
+        int width = heightMap.GetWidth();
+        for (int z = 0; z < heightMap.GetHeight(); z++)
+        {
+            memcpy(pBuffer + (size_t)z * (size_t)width,
+                heightMap.GetConstSlabPtr(z), (size_t)width * sizeof(float));
+        }
+    }
+
+    void CopyFromBuffer(const float* pBuffer, NoiseMap& heightMap)
+    {
+        int width = heightMap.GetWidth();
+        for (int z = 0; z < heightMap.GetHeight(); z++)
+        {
+            memcpy(heightMap.GetSlabPtr(z), pBuffer + (size_t)z * (size_t)width,
+                (size_t)width * sizeof(float));
+        }
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ThermalErosion class
+
+ThermalErosion::ThermalErosion():
+    m_iterationCount(DEFAULT_EROSION_ITERATION_COUNT),
+    m_rate(DEFAULT_THERMAL_RATE),
+    m_talus(DEFAULT_THERMAL_TALUS),
+    m_threadCount(0)
+{
+}
+
+void ThermalErosion::Erode(NoiseMap& heightMap) const
+{
+    int width  = heightMap.GetWidth ();
+    int height = heightMap.GetHeight();
+    if (width == 0 || height == 0 || m_iterationCount == 0)
+    {
+        return;
+    }
+
+    // Plane 0 holds the heights, planes 1 to 4 the outflows per direction.
+    ErosionBuffers buffers(width, height, 1 + DIR_COUNT);
+    float* pHeight = buffers.GetPlane(0);
+    float* pFlows[DIR_COUNT];
+    for (int d = 0; d < DIR_COUNT; d++)
+    {
+        pFlows[d] = buffers.GetPlane(1 + d);
+    }
+    CopyToBuffer(heightMap, pHeight);
+
+    for (int iteration = 0; iteration < m_iterationCount; iteration++)
+    {
+        // Pass 1: outflows.  Reads the heights of the neighbours, writes only
+        // the outflows of the band's own points.
+        ForEachBand(height, m_threadCount,
+            [&](int z0, int z1)
+            {
+                for (int z = z0; z < z1; z++)
+                {
+                    size_t row = (size_t)z * (size_t)width;
+                    float* pRowFlows[DIR_COUNT];
+                    for (int d = 0; d < DIR_COUNT; d++)
+                    {
+                        pRowFlows[d] = pFlows[d] + row;
+                    }
+                    ComputeDrops(pHeight, width, height, z, pRowFlows);
+
+                    // Keep the drops above the talus and scale them so that the
+                    // largest excess moves by the rate.
+                    for (int x = 0; x < width; x++)
+                    {
+                        float maxDrop = 0.0f;
+                        float totalDrop = 0.0f;
+                        for (int d = 0; d < DIR_COUNT; d++)
+                        {
+                            float drop = pRowFlows[d][x];
+                            drop = (drop > m_talus) ? drop : 0.0f;
+                            pRowFlows[d][x] = drop;
+                            maxDrop = GetMax(maxDrop, drop);
+                            totalDrop += drop;
+                        }
+                        float scale = (totalDrop > 0.0f)
+                            ? m_rate * (maxDrop - m_talus) / totalDrop : 0.0f;
+                        for (int d = 0; d < DIR_COUNT; d++)
+                        {
+                            pRowFlows[d][x] *= scale;
+                        }
+                    }
+                }
+            });
+
+        // Pass 2: apply.  Reads the outflows of the neighbours, writes only
+        // the heights of the band's own points.
+        ForEachBand(height, m_threadCount,
+            [&](int z0, int z1)
+            {
+                std::vector<float> inflow((size_t)width);
+                for (int z = z0; z < z1; z++)
+                {
+                    size_t row = (size_t)z * (size_t)width;
+                    GatherInflows(pFlows, width, height, z, &inflow[0]);
+                    float* pRow = pHeight + row;
+                    for (int x = 0; x < width; x++)
+                    {
+                        pRow[x] += inflow[x]
+                            - pFlows[DIR_WEST ][row + x]
+                            - pFlows[DIR_EAST ][row + x]
+                            - pFlows[DIR_SOUTH][row + x]
+                            - pFlows[DIR_NORTH][row + x];
+                    }
+                }
+            });
+    }
+
+    CopyFromBuffer(pHeight, heightMap);
+}
+
+void ThermalErosion::SetIterationCount(int iterationCount)
+{
+    if (iterationCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_iterationCount = iterationCount;
+}
+
+void ThermalErosion::SetRate(float rate)
+{
+    if (rate < 0.0f || rate > 0.5f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_rate = rate;
+}
+
+void ThermalErosion::SetTalus(float talus)
+{
+    if (talus < 0.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_talus = talus;
+}
+
+void ThermalErosion::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// HydraulicErosion class
+
+HydraulicErosion::HydraulicErosion():
+    m_capacity(DEFAULT_HYDRAULIC_CAPACITY),
+    m_depositionRate(DEFAULT_HYDRAULIC_DEPOSITION_RATE),
+    m_erosionRate(DEFAULT_HYDRAULIC_EROSION_RATE),
+    m_evaporationRate(DEFAULT_HYDRAULIC_EVAPORATION_RATE),
+    m_iterationCount(DEFAULT_EROSION_ITERATION_COUNT),
+    m_rainRate(DEFAULT_HYDRAULIC_RAIN_RATE),
+    m_threadCount(0)
+{
+}
+
+void HydraulicErosion::Erode(NoiseMap& heightMap) const
+{
+    int width  = heightMap.GetWidth ();
+    int height = heightMap.GetHeight();
+    if (width == 0 || height == 0 || m_iterationCount == 0)
+    {
+        return;
+    }
+
+    // Planes: heights, water and sediment (current and next), water surface
+    // level, and the water outflows per direction.
+    ErosionBuffers buffers(width, height, 5 + DIR_COUNT);
+    float* pHeight = buffers.GetPlane(0);
+    float* pWater = buffers.GetPlane(1);
+    float* pSediment = buffers.GetPlane(2);
+    float* pNextWater = buffers.GetPlane(3);
+    float* pNextSediment = buffers.GetPlane(4);
+    float* pFlows[DIR_COUNT];
+    for (int d = 0; d < DIR_COUNT; d++)
+    {
+        pFlows[d] = buffers.GetPlane(5 + d);
+    }
+    CopyToBuffer(heightMap, pHeight);
+
+    // The water surface level shares the plane of the next sediment amounts;
+    // it is only needed before they are written.
+    float* pLevel = pNextSediment;
+
+    for (int iteration = 0; iteration < m_iterationCount; iteration++)
+    {
+        // Pass 1: rain, and the level of the water surface.
+        ForEachBand(height, m_threadCount,
+            [&](int z0, int z1)
+            {
+                size_t begin = (size_t)z0 * (size_t)width;
+                size_t end   = (size_t)z1 * (size_t)width;
+                for (size_t i = begin; i < end; i++)
+                {
+                    pWater[i] += m_rainRate;
+                    pLevel[i] = pHeight[i] + pWater[i];
+                }
+            });
+
+        // Pass 2: water outflows.  A point never sends more water than it
+        // holds, nor more than half of the largest level difference, which
+        // would make the levels oscillate.
+        ForEachBand(height, m_threadCount,
+            [&](int z0, int z1)
+            {
+                for (int z = z0; z < z1; z++)
+                {
+                    size_t row = (size_t)z * (size_t)width;
+                    float* pRowFlows[DIR_COUNT];
+                    for (int d = 0; d < DIR_COUNT; d++)
+                    {
+                        pRowFlows[d] = pFlows[d] + row;
+                    }
+                    ComputeDrops(pLevel, width, height, z, pRowFlows);
+                    const float* pRowWater = pWater + row;
+                    for (int x = 0; x < width; x++)
+                    {
+                        float maxDrop = GetMax(
+                            GetMax(pRowFlows[DIR_WEST ][x], pRowFlows[DIR_EAST ][x]),
+                            GetMax(pRowFlows[DIR_SOUTH][x], pRowFlows[DIR_NORTH][x]));
+                        float totalDrop = pRowFlows[DIR_WEST ][x]
+                            + pRowFlows[DIR_EAST ][x] + pRowFlows[DIR_SOUTH][x]
+                            + pRowFlows[DIR_NORTH][x];
+                        float outflow = GetMin(pRowWater[x], 0.5f * maxDrop);
+                        float scale = (totalDrop > 0.0f) ? outflow / totalDrop : 0.0f;
+                        for (int d = 0; d < DIR_COUNT; d++)
+                        {
+                            pRowFlows[d][x] *= scale;
+                        }
+                    }
+                }
+            });
+
+        // Pass 3: move water and sediment, then erode or deposit.  Sediment
+        // leaves a point in proportion to the fraction of its water that
+        // leaves it.
+        ForEachBand(height, m_threadCount,
+            [&](int z0, int z1)
+            {
+                std::vector<float> waterIn((size_t)width);
+                std::vector<float> sedimentIn((size_t)width, 0.0f);
+                for (int z = z0; z < z1; z++)
+                {
+                    size_t row = (size_t)z * (size_t)width;
+                    GatherInflows(pFlows, width, height, z, &waterIn[0]);
+
+                    // Sediment arriving from each neighbour.
+                    for (int x = 0; x < width; x++)
+                    {
+                        sedimentIn[x] = 0.0f;
+                    }
+                    for (int d = 0; d < DIR_COUNT; d++)
+                    {
+                        int dx = (d == DIR_WEST) ? 1 : (d == DIR_EAST) ? -1 : 0;
+                        int dz = (d == DIR_SOUTH) ? 1 : (d == DIR_NORTH) ? -1 : 0;
+                        int zSource = z + dz;
+                        if (zSource < 0 || zSource >= height)
+                        {
+                            continue;
+                        }
+                        int xBegin = (dx < 0) ? 1 : 0;
+                        int xEnd   = (dx > 0) ? width - 1 : width;
+                        size_t source = (size_t)zSource * (size_t)width;
+                        for (int x = xBegin; x < xEnd; x++)
+                        {
+                            size_t i = source + (size_t)(x + dx);
+                            float water = pWater[i];
+                            if (water > 0.0f)
+                            {
+                                sedimentIn[x] += pSediment[i] * pFlows[d][i] / water;
+                            }
+                        }
+                    }
+
+                    for (int x = 0; x < width; x++)
+                    {
+                        size_t i = row + (size_t)x;
+                        float outflow = pFlows[DIR_WEST][i] + pFlows[DIR_EAST][i]
+                            + pFlows[DIR_SOUTH][i] + pFlows[DIR_NORTH][i];
+                        float water = pWater[i];
+                        float keptFraction = (water > 0.0f)
+                            ? 1.0f - outflow / water : 1.0f;
+                        float sediment = pSediment[i] * keptFraction + sedimentIn[x];
+                        float newWater = water - outflow + waterIn[x];
+
+                        float capacity = m_capacity * outflow;
+                        float change = (sediment > capacity)
+                            ? m_depositionRate * (sediment - capacity)
+                            : -m_erosionRate * (capacity - sediment);
+                        pHeight[i] += change;
+                        pNextSediment[i] = sediment - change;
+                        pNextWater[i] = newWater * (1.0f - m_evaporationRate);
+                    }
+                }
+            });
+
+        std::swap(pWater, pNextWater);
+        std::swap(pSediment, pNextSediment);
+        pLevel = pNextSediment;
+    }
+
+    // Drop the sediment that is still in suspension.
+    size_t pointCount = (size_t)width * (size_t)height;
+    for (size_t i = 0; i < pointCount; i++)
+    {
+        pHeight[i] += pSediment[i];
+    }
+
+    CopyFromBuffer(pHeight, heightMap);
+}
+
+void HydraulicErosion::SetCapacity(float capacity)
+{
+    if (capacity < 0.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_capacity = capacity;
+}
+
+void HydraulicErosion::SetDepositionRate(float depositionRate)
+{
+    if (depositionRate < 0.0f || depositionRate > 1.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_depositionRate = depositionRate;
+}
+
+void HydraulicErosion::SetErosionRate(float erosionRate)
+{
+    if (erosionRate < 0.0f || erosionRate > 1.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_erosionRate = erosionRate;
+}
+
+void HydraulicErosion::SetEvaporationRate(float evaporationRate)
+{
+    if (evaporationRate < 0.0f || evaporationRate > 1.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_evaporationRate = evaporationRate;
+}
+
+void HydraulicErosion::SetIterationCount(int iterationCount)
+{
+    if (iterationCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_iterationCount = iterationCount;
+}
+
+void HydraulicErosion::SetRainRate(float rainRate)
+{
+    if (rainRate < 0.0f)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_rainRate = rainRate;
+}
+
+void HydraulicErosion::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
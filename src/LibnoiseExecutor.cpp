@@ -0,0 +1,292 @@
+// LibnoiseExecutor.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <atomic>
+#include <exception>
+
+#include "LibnoiseExecutor.h"
+
+using namespace noise::utils;
+
+namespace
+{
+
+    // The executor installed with SetDefaultExecutor(), if any.
+    std::atomic<Executor*> s_pDefaultExecutor(nullptr);
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// WaitGroup class
+
+void WaitGroup::Add(int count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_count += count;
+}
+
+void WaitGroup::Done()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (--m_count == 0)
+    {
+        m_condition.notify_all();
+    }
+}
+
+bool WaitGroup::IsDone() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_count == 0;
+}
+
+void WaitGroup::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_count > 0)
+    {
+        m_condition.wait(lock);
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// ThreadPoolExecutor class
+
+ThreadPoolExecutor::ThreadPoolExecutor(int concurrency):
+    m_concurrency(concurrency > 0 ? concurrency : GetHardwareThreadCount()),
+    m_stop(false)
+{
+    try
+    {
+        for (int i = 1; i < m_concurrency; i++)
+        {
+            m_threads.emplace_back(&ThreadPoolExecutor::WorkerLoop, this);
+        }
+    }
+    catch (...)
+    {
+        // Could not start every thread; the pool runs with the ones that did
+        // start, plus the waiting threads.
+    }
+}
+
+ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+
+    // Without worker threads, run what is left on this thread.
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_queue.empty())
+    {
+        RunTask(lock);
+    }
+}
+
+void ThreadPoolExecutor::RunTask(std::unique_lock<std::mutex>& lock)
+{
+    std::function<void()> fTask;
+    fTask.swap(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+    fTask();
+    lock.lock();
+
+    // A group may have finished; wake the threads waiting in Wait().
+    m_condition.notify_all();
+}
+
+void ThreadPoolExecutor::Submit(const std::function<void()>& fTask)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(fTask);
+    }
+    m_condition.notify_all();
+}
+
+void ThreadPoolExecutor::Wait(WaitGroup& group)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!group.IsDone())
+    {
+        if (!m_queue.empty())
+        {
+            RunTask(lock);
+        }
+        else
+        {
+            m_condition.wait(lock);
+        }
+    }
+}
+
+void ThreadPoolExecutor::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (!m_queue.empty())
+        {
+            RunTask(lock);
+        }
+        else if (m_stop)
+        {
+            break;
+        }
+        else
+        {
+            m_condition.wait(lock);
+        }
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// Parallel helpers
+
+Executor& noise::utils::GetDefaultExecutor()
+{
+    Executor* pExecutor = s_pDefaultExecutor.load();
+    if (pExecutor != nullptr)
+    {
+        return *pExecutor;
+    }
+    static ThreadPoolExecutor builtInExecutor;
+    return builtInExecutor;
+}
+
+int noise::utils::GetHardwareThreadCount()
+{
+    unsigned int count = std::thread::hardware_concurrency();
+    return (count > 0) ? (int)count : 1;
+}
+
+void noise::utils::ParallelFor(int taskCount, int threadCount,
+    const std::function<void(int, int)>& fTask)
+{
+    ParallelFor(GetDefaultExecutor(), taskCount, threadCount, fTask);
+}
+
+void noise::utils::ParallelFor(Executor& executor, int taskCount,
+    int threadCount, const std::function<void(int, int)>& fTask)
+{
+    if (taskCount <= 0)
+    {
+        return;
+    }
+    if (threadCount <= 0)
+    {
+        threadCount = executor.GetConcurrency();
+    }
+    if (threadCount > taskCount)
+    {
+        threadCount = taskCount;
+    }
+
+    if (threadCount <= 1)
+    {
+        for (int i = 0; i < taskCount; i++)
+        {
+            fTask(i, 0);
+        }
+        return;
+    }
+
+    // Each worker pulls the next task index from a shared counter until all
+    // tasks are handed out.  The first exception stops the hand-out and is
+    // rethrown once every worker has finished.
+    std::atomic<int> nextTask(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr pError;
+    std::mutex errorMutex;
+
+    auto worker = [&](int workerIndex)
+    {
+        while (!failed.load(std::memory_order_relaxed))
+        {
+            int task = nextTask.fetch_add(1, std::memory_order_relaxed);
+            if (task >= taskCount)
+            {
+                break;
+            }
+            try
+            {
+                fTask(task, workerIndex);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!pError)
+                {
+                    pError = std::current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    // A worker that the executor starts late finds no task left and returns
+    // at once, so the calling thread never depends on the other workers to
+    // make progress.
+    WaitGroup group;
+    try
+    {
+        for (int i = 1; i < threadCount; i++)
+        {
+            group.Add(1);
+            executor.Submit(
+                [&worker, &group, i]()
+                {
+                    worker(i);
+                    group.Done();
+                });
+        }
+    }
+    catch (...)
+    {
+        // The executor refused a task; the workers already submitted, plus
+        // the calling thread, still process all of the tasks.
+        group.Done();
+    }
+    worker(0);
+    executor.Wait(group);
+
+    if (pError)
+    {
+        std::rethrow_exception(pError);
+    }
+}
+
+int noise::utils::ResolveThreadCount(int threadCount)
+{
+    return (threadCount > 0) ? threadCount : GetDefaultExecutor().GetConcurrency();
+}
+
+void noise::utils::SetDefaultExecutor(Executor* pExecutor)
+{
+    s_pDefaultExecutor.store(pExecutor);
+}
@@ -0,0 +1,228 @@
+// LibnoiseGraph.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <atomic>
+
+#include "LibnoiseGraph.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+
+//////////////////////////////////////////////////////////////////////////////
+// GraphSnapshot class
+
+GraphSnapshot::GraphSnapshot():
+    m_version(0)
+{
+}
+
+const noise::module::Module& GraphSnapshot::GetModule(int id) const
+{
+    if (!HasModule(id))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    return *m_nodes[id]->pModule;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// VersionedGraph class
+
+VersionedGraph::VersionedGraph():
+    m_isModified(false),
+    m_pSnapshot(new GraphSnapshot)
+{
+}
+
+int VersionedGraph::AddNode(const std::shared_ptr<GraphNode>& pNode)
+{
+    m_nodes.push_back(pNode);
+    m_isEdited.push_back(true);
+    m_isModified = true;
+    return (int)m_nodes.size() - 1;
+}
+
+std::shared_ptr<const GraphSnapshot> VersionedGraph::Commit()
+{
+    std::shared_ptr<const GraphSnapshot> pPrevious = GetSnapshot();
+    if (!m_isModified)
+    {
+        return pPrevious;
+    }
+
+    // Copy every node that depends on an edited node.  The links form a
+    // directed acyclic graph, so this converges after at most as many sweeps
+    // as the depth of the graph; most edits touch a short chain.
+    int nodeCount = (int)m_nodes.size();
+    bool hasCopied = true;
+    while (hasCopied)
+    {
+        hasCopied = false;
+        for (int id = 0; id < nodeCount; id++)
+        {
+            if (m_nodes[id] == NULL || m_isEdited[id])
+            {
+                continue;
+            }
+            const std::vector<int>& sourceIds = m_nodes[id]->sourceIds;
+            for (size_t i = 0; i < sourceIds.size(); i++)
+            {
+                if (sourceIds[i] != GRAPH_NO_MODULE && m_isEdited[sourceIds[i]])
+                {
+                    EditNode(id);
+                    hasCopied = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Connect the edited noise modules to the noise modules of the new
+    // version.  The noise modules shared with the previous snapshot are
+    // already connected to them, since none of their sources changed.
+    for (int id = 0; id < nodeCount; id++)
+    {
+        if (m_nodes[id] == NULL || !m_isEdited[id])
+        {
+            continue;
+        }
+        GraphNode& node = *m_nodes[id];
+        for (size_t i = 0; i < node.sourceIds.size(); i++)
+        {
+            if (node.sourceIds[i] != GRAPH_NO_MODULE)
+            {
+                node.pModule->SetSourceModule((int)i,
+                    *m_nodes[node.sourceIds[i]]->pModule);
+            }
+        }
+    }
+
+    std::shared_ptr<GraphSnapshot> pSnapshot(new GraphSnapshot);
+    pSnapshot->m_nodes.assign(m_nodes.begin(), m_nodes.end());
+    pSnapshot->m_version = pPrevious->m_version + 1;
+    std::shared_ptr<const GraphSnapshot> pPublished = pSnapshot;
+    std::atomic_store(&m_pSnapshot, pPublished);
+
+    // The nodes now belong to the snapshot; the next edit copies them.
+    m_isEdited.assign(m_isEdited.size(), false);
+    m_isModified = false;
+    return pPublished;
+}
+
+GraphNode& VersionedGraph::EditNode(int id)
+{
+    if (id < 0 || id >= (int)m_nodes.size() || m_nodes[id] == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    if (!m_isEdited[id])
+    {
+        // The node belongs to a snapshot that builds may be evaluating; edit a
+        // copy.  The copy stays connected to the old source modules until
+        // the commit connects it to the new ones.
+        const GraphNode& node = *m_nodes[id];
+        std::shared_ptr<GraphNode> pCopy(new GraphNode);
+        pCopy->pModule.reset(node.fClone(*node.pModule));
+        pCopy->fClone = node.fClone;
+        pCopy->sourceIds = node.sourceIds;
+        m_nodes[id] = pCopy;
+        m_isEdited[id] = true;
+    }
+    m_isModified = true;
+    return *m_nodes[id];
+}
+
+std::shared_ptr<const GraphSnapshot> VersionedGraph::GetSnapshot() const
+{
+    return std::atomic_load(&m_pSnapshot);
+}
+
+void VersionedGraph::Link(int id, int index, int sourceId)
+{
+    if (sourceId != GRAPH_NO_MODULE && (sourceId < 0
+        || sourceId >= (int)m_nodes.size() || m_nodes[sourceId] == NULL))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    if (id >= 0 && id < (int)m_nodes.size() && m_nodes[id] != NULL
+        && (index < 0 || index >= (int)m_nodes[id]->sourceIds.size()))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // A link that closes a cycle would make the noise modules recurse
+    // forever.
+    if (sourceId != GRAPH_NO_MODULE)
+    {
+        std::vector<int> stack(1, sourceId);
+        std::vector<bool> isVisited(m_nodes.size(), false);
+        while (!stack.empty())
+        {
+            int current = stack.back();
+            stack.pop_back();
+            if (current == id)
+            {
+                throw noise::ExceptionInvalidParam();
+            }
+            if (isVisited[current])
+            {
+                continue;
+            }
+            isVisited[current] = true;
+            const std::vector<int>& sourceIds = m_nodes[current]->sourceIds;
+            for (size_t i = 0; i < sourceIds.size(); i++)
+            {
+                if (sourceIds[i] != GRAPH_NO_MODULE)
+                {
+                    stack.push_back(sourceIds[i]);
+                }
+            }
+        }
+    }
+
+    EditNode(id).sourceIds[index] = sourceId;
+}
+
+void VersionedGraph::Remove(int id)
+{
+    if (id < 0 || id >= (int)m_nodes.size() || m_nodes[id] == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        if (m_nodes[i] == NULL)
+        {
+            continue;
+        }
+        const std::vector<int>& sourceIds = m_nodes[i]->sourceIds;
+        for (size_t j = 0; j < sourceIds.size(); j++)
+        {
+            if (sourceIds[j] == id)
+            {
+                throw noise::ExceptionInvalidParam();
+            }
+        }
+    }
+
+    m_nodes[id].reset();
+    m_isEdited[id] = false;
+    m_isModified = true;
+}
@@ -0,0 +1,1086 @@
+// LibnoiseHydrology.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include "LibnoiseHydrology.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    const float FLOW_INV_SQRT_2 = 0.70710678f;
+
+    // Angle between two neighbouring D8 directions.
+    const float FLOW_FACET_ANGLE = (float)(PI / 4.0);
+
+    // Pending count of a point that no water flows into.  Larger than any
+    // number of upstream neighbours, and never decremented.
+    const uint8 FLOW_SOURCE = 0x80;
+
+    // Point of a Priority-Flood.
+    struct FloodPoint
+    {
+        uint32 key;
+        int x;
+        int y;
+    };
+
+    // Maps a height to an unsigned key with the same order.
+    inline uint32 GetFloodKey(float height)
+    {
+        uint32 bits;
+        memcpy(&bits, &height, sizeof(bits));
+        return ((bits & 0x80000000u) != 0) ? ~bits : (bits | 0x80000000u);
+    }
+
+    // Returns the number of significant bits of a key.
+    inline int GetKeyBitCount(uint32 key)
+    {
+#if defined(__GNUC__)
+        return (key != 0) ? 32 - __builtin_clz(key) : 0;
+#else
+        int count = 0;
+        while (key != 0)
+        {
+            key >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    // Flood front of a Priority-Flood, as a radix heap.  The heights taken
+    // from the front never decrease, which lets a point wait in the bucket of
+    // the highest bit in which its key differs from the last key taken: each
+    // point moves down at most 32 buckets, instead of sifting through a
+    // binary heap.
+    class FloodFront
+    {
+
+        public:
+
+            FloodFront():
+                m_lastKey(0),
+                m_size(0)
+            {
+            }
+
+            bool IsEmpty() const
+            {
+                return m_size == 0;
+            }
+
+            FloodPoint Pop()
+            {
+                Refill();
+                FloodPoint point = m_buckets[0].back();
+                m_buckets[0].pop_back();
+                m_size--;
+                return point;
+            }
+
+            void Push(float height, int x, int y)
+            {
+                FloodPoint point;
+                point.key = GetFloodKey(height);
+                point.x = x;
+                point.y = y;
+                m_buckets[GetKeyBitCount(point.key ^ m_lastKey)].push_back(point);
+                m_size++;
+            }
+
+        private:
+
+            // Moves the lowest points to bucket 0.
+            void Refill()
+            {
+                if (!m_buckets[0].empty())
+                {
+                    return;
+                }
+                int bucket = 1;
+                while (m_buckets[bucket].empty())
+                {
+                    bucket++;
+                }
+                std::vector<FloodPoint>& points = m_buckets[bucket];
+                uint32 minKey = points[0].key;
+                for (size_t i = 1; i < points.size(); i++)
+                {
+                    minKey = GetMin(minKey, points[i].key);
+                }
+                m_lastKey = minKey;
+                for (size_t i = 0; i < points.size(); i++)
+                {
+                    m_buckets[GetKeyBitCount(points[i].key ^ m_lastKey)]
+                        .push_back(points[i]);
+                }
+                points.clear();
+            }
+
+            std::vector<FloodPoint> m_buckets[33];
+            uint32 m_lastKey;
+            size_t m_size;
+
+    };
+
+    // Fractions of the water closer than this to 0 or 1 are rounded, so that
+    // a D-infinity angle toward a neighbour sends all the water to it.
+    const float FLOW_FRACTION_EPSILON = 1.0e-5f;
+
+    // Point of a map.
+    struct GridPoint
+    {
+        int x;
+        int y;
+    };
+
+    // Returns the neighbours that a point sends water to, as D8 direction
+    // codes, and the fraction of the water that each one receives.  Only
+    // neighbours that receive a non-zero fraction are returned.  The
+    // accumulation decodes a direction with this function on both sides of
+    // every flow, so the counts of upstream neighbours always match.
+    inline int GetFlowTargets(float direction, FlowMethod method, int* pCode,
+        float* pFraction)
+    {
+        if (!(direction >= 0.0f))
+        {
+            return 0;
+        }
+        if (method == FLOW_METHOD_D8)
+        {
+            pCode[0] = (int)direction & (FLOW_DIRECTION_COUNT - 1);
+            pFraction[0] = 1.0f;
+            return 1;
+        }
+
+        float facet = direction / FLOW_FACET_ANGLE;
+        int code = (int)facet;
+        float fraction = facet - (float)code;
+        if (fraction < FLOW_FRACTION_EPSILON)
+        {
+            fraction = 0.0f;
+        }
+        else if (fraction > 1.0f - FLOW_FRACTION_EPSILON)
+        {
+            code++;
+            fraction = 0.0f;
+        }
+        int count = 0;
+        if (fraction < 1.0f)
+        {
+            pCode[count] = code & (FLOW_DIRECTION_COUNT - 1);
+            pFraction[count] = 1.0f - fraction;
+            count++;
+        }
+        if (fraction > 0.0f)
+        {
+            pCode[count] = (code + 1) & (FLOW_DIRECTION_COUNT - 1);
+            pFraction[count] = fraction;
+            count++;
+        }
+        return count;
+    }
+
+    // Bits of the byte that encodes the targets of a point: the low and high
+    // halves each hold a direction code and a flag that tells if it is used.
+    const uint8 FLOW_CODE_MASK = 0x07;
+    const uint8 FLOW_CODE_USED = 0x08;
+
+    // Encodes up to two target direction codes in a byte.
+    inline uint8 EncodeFlow(const int* pCode, int count)
+    {
+        uint8 flow = 0;
+        for (int i = 0; i < count; i++)
+        {
+            flow |= (uint8)((pCode[i] | FLOW_CODE_USED) << (4 * i));
+        }
+        return flow;
+    }
+
+    // Determines if an encoded point sends water in a direction.
+    inline bool IsFlowingToward(uint8 flow, int code)
+    {
+        return (flow & 0x0f) == (code | FLOW_CODE_USED)
+            || (flow >> 4) == (code | FLOW_CODE_USED);
+    }
+
+    // Returns the D8 direction code of the steepest downward slope from a
+    // point, or FLOW_DIRECTION_NONE.  pRows holds the rows above, at and
+    // below the point, NULL outside the height map.
+    float GetD8Direction(const float* const* pRows, int x, int width)
+    {
+        float height = pRows[1][x];
+        float bestSlope = 0.0f;
+        float bestCode = FLOW_DIRECTION_NONE;
+        for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+        {
+            int nx = x + FLOW_OFFSET_X[code];
+            const float* pRow = pRows[1 + FLOW_OFFSET_Y[code]];
+            if (nx < 0 || nx >= width || pRow == NULL)
+            {
+                continue;
+            }
+            float slope = height - pRow[nx];
+            if ((code & 1) != 0)
+            {
+                slope *= FLOW_INV_SQRT_2;
+            }
+            if (slope > bestSlope)
+            {
+                bestSlope = slope;
+                bestCode = (float)code;
+            }
+        }
+        return bestCode;
+    }
+
+    // Returns the D-infinity angle of the steepest downward slope from a
+    // point, or FLOW_DIRECTION_NONE.  Facet k lies between the directions k
+    // and k + 1; of these, the even one is a side neighbour and the odd one
+    // a diagonal neighbour.
+    float GetDinfDirection(const float* const* pRows, int x, int width)
+    {
+        float height = pRows[1][x];
+        float bestSlope = 0.0f;
+        int bestFacet = -1;
+        float bestS1 = 0.0f;
+        float bestS2 = 0.0f;
+        for (int facet = 0; facet < FLOW_DIRECTION_COUNT; facet++)
+        {
+            int sideCode = (facet + 1) & ~1;
+            int diagonalCode = facet | 1;
+            int sideX = x + FLOW_OFFSET_X[sideCode & (FLOW_DIRECTION_COUNT - 1)];
+            int diagonalX = x + FLOW_OFFSET_X[diagonalCode];
+            const float* pSideRow = pRows[1
+                + FLOW_OFFSET_Y[sideCode & (FLOW_DIRECTION_COUNT - 1)]];
+            const float* pDiagonalRow = pRows[1 + FLOW_OFFSET_Y[diagonalCode]];
+            if (sideX < 0 || sideX >= width || pSideRow == NULL
+                || diagonalX < 0 || diagonalX >= width || pDiagonalRow == NULL)
+            {
+                continue;
+            }
+
+            // s1 is the slope toward the side neighbour, s2 the slope from the
+            // side neighbour to the diagonal one.  The steepest slope of the
+            // facet is clamped to its two edges.
+            float s1 = height - pSideRow[sideX];
+            float s2 = pSideRow[sideX] - pDiagonalRow[diagonalX];
+            float slope;
+            if (s2 <= 0.0f)
+            {
+                slope = s1;
+            }
+            else if (s2 >= s1)
+            {
+                slope = (s1 + s2) * FLOW_INV_SQRT_2;
+            }
+            else
+            {
+                slope = sqrtf(s1 * s1 + s2 * s2);
+            }
+            if (slope > bestSlope)
+            {
+                bestSlope = slope;
+                bestFacet = facet;
+                bestS1 = s1;
+                bestS2 = s2;
+            }
+        }
+        if (bestFacet < 0)
+        {
+            return FLOW_DIRECTION_NONE;
+        }
+
+        // Angle from the side neighbour toward the diagonal one.
+        float r;
+        if (bestS2 <= 0.0f)
+        {
+            r = 0.0f;
+        }
+        else if (bestS2 >= bestS1)
+        {
+            r = FLOW_FACET_ANGLE;
+        }
+        else
+        {
+            r = GetMin((float)atan2(bestS2, bestS1), FLOW_FACET_ANGLE);
+        }
+        float angle = ((bestFacet & 1) == 0)
+            ? (float)bestFacet * FLOW_FACET_ANGLE + r
+            : (float)(bestFacet + 1) * FLOW_FACET_ANGLE - r;
+        if (angle >= (float)(2.0 * PI))
+        {
+            angle -= (float)(2.0 * PI);
+        }
+        return angle;
+    }
+
+    // Label of the points that drain directly out of the height map.
+    const uint16 FILL_LABEL_EDGE = 1;
+
+    // Label of a tile border point not taken from the flood front yet.
+    const uint16 FILL_LABEL_PENDING = 0xffff;
+
+    // Level at which the water of two watersheds meets.
+    struct SpillEdge
+    {
+        uint32 a;
+        uint32 b;
+        float height;
+    };
+
+    bool IsSpillEdgeLess(const SpillEdge& lhs, const SpillEdge& rhs)
+    {
+        if (lhs.a != rhs.a)
+        {
+            return lhs.a < rhs.a;
+        }
+        if (lhs.b != rhs.b)
+        {
+            return lhs.b < rhs.b;
+        }
+        return lhs.height < rhs.height;
+    }
+
+    // Sorts a list of spill edges and keeps the lowest edge between every
+    // pair of watersheds.
+    void MergeSpillEdges(std::vector<SpillEdge>& edges)
+    {
+        std::sort(edges.begin(), edges.end(), IsSpillEdgeLess);
+        size_t count = 0;
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            if (count == 0 || edges[i].a != edges[count - 1].a
+                || edges[i].b != edges[count - 1].b)
+            {
+                edges[count++] = edges[i];
+            }
+        }
+        edges.resize(count);
+    }
+
+    // Tile of a depression fill.
+    struct FillTile
+    {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+
+        // Number of watershed labels, edge label included.
+        int labelCount;
+
+        // First global label of the tile, minus 2; the edge label is 0.
+        uint32 labelBase;
+
+        // Spill edges between the labels of the tile (local labels), then,
+        // after the labels are made global, with the neighbouring tiles.
+        std::vector<SpillEdge> edges;
+
+        uint32 GetGlobalLabel(uint16 label) const
+        {
+            return (label == FILL_LABEL_EDGE) ? 0 : labelBase + label;
+        }
+    };
+
+    // Fills the depressions of a tile toward its border, and labels its
+    // points with the watershed of the border point they drain to.  Points
+    // on the border of the height map all get FILL_LABEL_EDGE.
+    void FloodTile(FillTile& tile, float* pHeight, size_t stride,
+        uint16* pLabel, int width, int height)
+    {
+        FloodFront front;
+        std::vector<FloodPoint> pit;
+        for (int y = tile.y0; y < tile.y1; y++)
+        {
+            bool isBorderRow = (y == tile.y0 || y == tile.y1 - 1);
+            int step = isBorderRow ? 1 : GetMax(tile.x1 - tile.x0 - 1, 1);
+            for (int x = tile.x0; x < tile.x1; x += step)
+            {
+                bool isEdge = (x == 0 || y == 0 || x == width - 1
+                    || y == height - 1);
+                pLabel[(size_t)y * (size_t)width + (size_t)x] = isEdge
+                    ? FILL_LABEL_EDGE : FILL_LABEL_PENDING;
+                front.Push(pHeight[(size_t)y * stride + (size_t)x], x, y);
+            }
+        }
+
+        // The pit queue holds the points of the depression being filled, all
+        // at the current level, so it is emptied before the flood front.
+        uint16 nextLabel = FILL_LABEL_EDGE + 1;
+        size_t pitHead = 0;
+        while (!front.IsEmpty() || pitHead < pit.size())
+        {
+            FloodPoint point;
+            if (pitHead < pit.size())
+            {
+                point = pit[pitHead++];
+                if (pitHead == pit.size())
+                {
+                    pit.clear();
+                    pitHead = 0;
+                }
+            }
+            else
+            {
+                point = front.Pop();
+            }
+
+            int x = point.x;
+            int y = point.y;
+            uint16& label = pLabel[(size_t)y * (size_t)width + (size_t)x];
+            if (label == FILL_LABEL_PENDING)
+            {
+                label = nextLabel++;
+            }
+            float level = pHeight[(size_t)y * stride + (size_t)x];
+            for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+            {
+                int nx = x + FLOW_OFFSET_X[code];
+                int ny = y + FLOW_OFFSET_Y[code];
+                if (nx < tile.x0 || nx >= tile.x1 || ny < tile.y0
+                    || ny >= tile.y1)
+                {
+                    continue;
+                }
+                uint16& neighbourLabel
+                    = pLabel[(size_t)ny * (size_t)width + (size_t)nx];
+                float& neighbourHeight = pHeight[(size_t)ny * stride + (size_t)nx];
+                if (neighbourLabel == 0)
+                {
+                    neighbourLabel = label;
+                    if (neighbourHeight <= level)
+                    {
+                        neighbourHeight = level;
+                        FloodPoint pitPoint;
+                        pitPoint.key = 0;
+                        pitPoint.x = nx;
+                        pitPoint.y = ny;
+                        pit.push_back(pitPoint);
+                    }
+                    else
+                    {
+                        front.Push(neighbourHeight, nx, ny);
+                    }
+                }
+                else if (neighbourLabel != label
+                    && neighbourLabel != FILL_LABEL_PENDING)
+                {
+                    // Watersheds meet along lines, so most edges repeat the
+                    // previous one.
+                    SpillEdge edge;
+                    edge.a = GetMin(label, neighbourLabel);
+                    edge.b = GetMax(label, neighbourLabel);
+                    edge.height = GetMax(level, neighbourHeight);
+                    if (!tile.edges.empty() && tile.edges.back().a == edge.a
+                        && tile.edges.back().b == edge.b)
+                    {
+                        tile.edges.back().height = GetMin(
+                            tile.edges.back().height, edge.height);
+                    }
+                    else
+                    {
+                        tile.edges.push_back(edge);
+                    }
+                }
+            }
+        }
+        tile.labelCount = nextLabel;
+        MergeSpillEdges(tile.edges);
+    }
+
+    // Adds the spill edges between the last column and row of a tile and the
+    // neighbouring tiles.  The points on tile borders keep their heights
+    // during the flood of their tile.
+    void LinkTile(FillTile& tile, const std::vector<FillTile>& tiles,
+        int tileColumnCount, const float* pHeight, size_t stride,
+        const uint16* pLabel, int width, int height)
+    {
+        auto link = [&](int x, int y, int nx, int ny)
+        {
+            if (nx < 0 || nx >= width || ny < 0 || ny >= height)
+            {
+                return;
+            }
+            const FillTile& neighbourTile = tiles[
+                (size_t)(ny / DEPRESSION_FILL_TILE_SIZE) * (size_t)tileColumnCount
+                + (size_t)(nx / DEPRESSION_FILL_TILE_SIZE)];
+            uint32 a = tile.GetGlobalLabel(
+                pLabel[(size_t)y * (size_t)width + (size_t)x]);
+            uint32 b = neighbourTile.GetGlobalLabel(
+                pLabel[(size_t)ny * (size_t)width + (size_t)nx]);
+            if (a != b)
+            {
+                SpillEdge edge;
+                edge.a = GetMin(a, b);
+                edge.b = GetMax(a, b);
+                edge.height = GetMax(pHeight[(size_t)y * stride + (size_t)x],
+                    pHeight[(size_t)ny * stride + (size_t)nx]);
+                tile.edges.push_back(edge);
+            }
+        };
+
+        for (size_t i = 0; i < tile.edges.size(); i++)
+        {
+            tile.edges[i].a = tile.GetGlobalLabel((uint16)tile.edges[i].a);
+            tile.edges[i].b = tile.GetGlobalLabel((uint16)tile.edges[i].b);
+        }
+        for (int y = tile.y0; y < tile.y1; y++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                link(tile.x1 - 1, y, tile.x1, y + dy);
+            }
+        }
+        for (int x = tile.x0; x < tile.x1; x++)
+        {
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                if (x + dx < tile.x1)
+                {
+                    link(x, tile.y1 - 1, x + dx, tile.y1);
+                }
+            }
+        }
+        MergeSpillEdges(tile.edges);
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// DepressionFiller class
+
+DepressionFiller::DepressionFiller():
+    m_threadCount(0)
+{
+}
+
+void DepressionFiller::Fill(NoiseMap& heightMap) const
+{
+    int width  = heightMap.GetWidth ();
+    int height = heightMap.GetHeight();
+    if (width == 0 || height == 0)
+    {
+        return;
+    }
+
+    size_t pointCount = (size_t)width * (size_t)height;
+    MemoryReservation reservation(MEMORY_SCRATCH, pointCount * sizeof(uint16));
+    int tileColumnCount = (width + DEPRESSION_FILL_TILE_SIZE - 1)
+        / DEPRESSION_FILL_TILE_SIZE;
+    int tileRowCount = (height + DEPRESSION_FILL_TILE_SIZE - 1)
+        / DEPRESSION_FILL_TILE_SIZE;
+    int tileCount = tileColumnCount * tileRowCount;
+    std::vector<uint16> labels;
+    std::vector<FillTile> tiles;
+    try
+    {
+        labels.assign(pointCount, 0);
+        tiles.resize((size_t)tileCount);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    for (int i = 0; i < tileCount; i++)
+    {
+        FillTile& tile = tiles[i];
+        tile.x0 = (i % tileColumnCount) * DEPRESSION_FILL_TILE_SIZE;
+        tile.y0 = (i / tileColumnCount) * DEPRESSION_FILL_TILE_SIZE;
+        tile.x1 = GetMin(tile.x0 + DEPRESSION_FILL_TILE_SIZE, width);
+        tile.y1 = GetMin(tile.y0 + DEPRESSION_FILL_TILE_SIZE, height);
+        tile.labelCount = 0;
+        tile.labelBase = 0;
+    }
+
+    float* pHeight = heightMap.GetSlabPtr();
+    size_t stride = (size_t)heightMap.GetStride();
+    uint16* pLabel = &labels[0];
+    int threadCount = ResolveThreadCount(m_threadCount);
+
+    // Pass 1: fill every tile toward its border.
+    ParallelFor(tileCount, threadCount,
+        [&](int i, int)
+        {
+            FloodTile(tiles[i], pHeight, stride, pLabel, width, height);
+        });
+
+    // Number the watersheds of all the tiles, then link them across the
+    // tile borders.
+    uint32 labelCount = 1;
+    for (int i = 0; i < tileCount; i++)
+    {
+        tiles[i].labelBase = labelCount - (FILL_LABEL_EDGE + 1);
+        labelCount += (uint32)(tiles[i].labelCount - (FILL_LABEL_EDGE + 1));
+    }
+    ParallelFor(tileCount, threadCount,
+        [&](int i, int)
+        {
+            LinkTile(tiles[i], tiles, tileColumnCount, pHeight, stride, pLabel,
+                width, height);
+        });
+
+    // Pass 2: find the level at which the water of every watershed leaves
+    // the height map, with a Priority-Flood over the graph of watersheds.
+    std::vector<float> levels;
+    try
+    {
+        std::vector<uint32> firstEdge((size_t)labelCount + 1, 0);
+        for (int i = 0; i < tileCount; i++)
+        {
+            const std::vector<SpillEdge>& edges = tiles[i].edges;
+            for (size_t j = 0; j < edges.size(); j++)
+            {
+                firstEdge[edges[j].a + 1]++;
+                firstEdge[edges[j].b + 1]++;
+            }
+        }
+        for (uint32 i = 0; i < labelCount; i++)
+        {
+            firstEdge[i + 1] += firstEdge[i];
+        }
+        std::vector<uint32> neighbours(firstEdge[labelCount]);
+        std::vector<float> spillHeights(firstEdge[labelCount]);
+        std::vector<uint32> next(firstEdge.begin(), firstEdge.end() - 1);
+        for (int i = 0; i < tileCount; i++)
+        {
+            std::vector<SpillEdge>& edges = tiles[i].edges;
+            for (size_t j = 0; j < edges.size(); j++)
+            {
+                neighbours  [next[edges[j].a]] = edges[j].b;
+                spillHeights[next[edges[j].a]++] = edges[j].height;
+                neighbours  [next[edges[j].b]] = edges[j].a;
+                spillHeights[next[edges[j].b]++] = edges[j].height;
+            }
+            std::vector<SpillEdge>().swap(edges);
+        }
+
+        levels.assign(labelCount, std::numeric_limits<float>::infinity());
+        std::vector<std::pair<float, uint32> > queue;
+        std::greater<std::pair<float, uint32> > higher;
+        levels[0] = -std::numeric_limits<float>::infinity();
+        queue.push_back(std::make_pair(levels[0], (uint32)0));
+        while (!queue.empty())
+        {
+            std::pop_heap(queue.begin(), queue.end(), higher);
+            float level = queue.back().first;
+            uint32 label = queue.back().second;
+            queue.pop_back();
+            if (level > levels[label])
+            {
+                continue;
+            }
+            for (uint32 j = firstEdge[label]; j < firstEdge[label + 1]; j++)
+            {
+                float neighbourLevel = GetMax(level, spillHeights[j]);
+                if (neighbourLevel < levels[neighbours[j]])
+                {
+                    levels[neighbours[j]] = neighbourLevel;
+                    queue.push_back(std::make_pair(neighbourLevel, neighbours[j]));
+                    std::push_heap(queue.begin(), queue.end(), higher);
+                }
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Pass 3: raise every point to the level of its watershed.
+    ParallelFor(tileCount, threadCount,
+        [&](int i, int)
+        {
+            const FillTile& tile = tiles[i];
+            for (int y = tile.y0; y < tile.y1; y++)
+            {
+                float* pRow = pHeight + (size_t)y * stride;
+                const uint16* pRowLabel = pLabel + (size_t)y * (size_t)width;
+                for (int x = tile.x0; x < tile.x1; x++)
+                {
+                    float level = levels[tile.GetGlobalLabel(pRowLabel[x])];
+                    if (pRow[x] < level)
+                    {
+                        pRow[x] = level;
+                    }
+                }
+            }
+        });
+}
+
+void DepressionFiller::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// FlowRouter class
+
+FlowRouter::FlowRouter():
+    m_method(FLOW_METHOD_D8),
+    m_threadCount(0)
+{
+}
+
+void FlowRouter::Accumulate(const NoiseMap& directionMap,
+    NoiseMap& accumulationMap, const NoiseMap* pRainMap) const
+{
+    int width  = directionMap.GetWidth ();
+    int height = directionMap.GetHeight();
+    if (width <= 0 || height <= 0 || &accumulationMap == &directionMap
+        || &accumulationMap == pRainMap)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    if (pRainMap != NULL && (pRainMap->GetWidth() != width
+        || pRainMap->GetHeight() != height))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    accumulationMap.SetSize(width, height);
+    size_t pointCount = (size_t)width * (size_t)height;
+    MemoryReservation reservation(MEMORY_SCRATCH, 2 * pointCount);
+    std::vector<uint8> flows;
+    std::vector<std::atomic<uint8> > pending;
+    try
+    {
+        flows.resize(pointCount);
+        std::vector<std::atomic<uint8> >(pointCount).swap(pending);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    FlowMethod method = m_method;
+    int threadCount = ResolveThreadCount(m_threadCount);
+    int bandCount = (height + FLOW_BAND_HEIGHT - 1) / FLOW_BAND_HEIGHT;
+    size_t accumulationStride = (size_t)accumulationMap.GetStride();
+    float* pAccumulation = accumulationMap.GetSlabPtr();
+    const uint8* pFlow = &flows[0];
+
+    // Pass 1: decode the directions.
+    ParallelFor(bandCount, threadCount,
+        [&](int band, int)
+        {
+            int y0 = band * FLOW_BAND_HEIGHT;
+            int y1 = GetMin(y0 + FLOW_BAND_HEIGHT, height);
+            for (int y = y0; y < y1; y++)
+            {
+                const float* pDirection = directionMap.GetConstSlabPtr(y);
+                uint8* pRowFlow = &flows[(size_t)y * (size_t)width];
+                for (int x = 0; x < width; x++)
+                {
+                    int targetCodes[2];
+                    float targetFractions[2];
+                    int targetCount = GetFlowTargets(pDirection[x], method,
+                        targetCodes, targetFractions);
+                    pRowFlow[x] = EncodeFlow(targetCodes, targetCount);
+                }
+            }
+        });
+
+    // Pass 2: count the upstream neighbours of every point.
+    ParallelFor(bandCount, threadCount,
+        [&](int band, int)
+        {
+            int y0 = band * FLOW_BAND_HEIGHT;
+            int y1 = GetMin(y0 + FLOW_BAND_HEIGHT, height);
+            for (int y = y0; y < y1; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    int donorCount = 0;
+                    for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+                    {
+                        int nx = x + FLOW_OFFSET_X[code];
+                        int ny = y + FLOW_OFFSET_Y[code];
+                        if (nx >= 0 && nx < width && ny >= 0 && ny < height
+                            && IsFlowingToward(
+                            pFlow[(size_t)ny * (size_t)width + (size_t)nx],
+                            code ^ (FLOW_DIRECTION_COUNT / 2)))
+                        {
+                            donorCount++;
+                        }
+                    }
+                    pending[(size_t)y * (size_t)width + (size_t)x].store(
+                        (donorCount == 0) ? FLOW_SOURCE : (uint8)donorCount,
+                        std::memory_order_relaxed);
+                    pAccumulation[(size_t)y * accumulationStride + (size_t)x]
+                        = 0.0f;
+                }
+            }
+        });
+
+    // Pass 3: follow the flow downstream from the sources of every band.  A
+    // point is computed by the task that completes its last upstream
+    // neighbour; the acquire-release decrement makes the accumulations of
+    // all the upstream neighbours visible to that task.
+    ParallelFor(bandCount, threadCount,
+        [&](int band, int)
+        {
+            std::vector<GridPoint> stack;
+            int y0 = band * FLOW_BAND_HEIGHT;
+            int y1 = GetMin(y0 + FLOW_BAND_HEIGHT, height);
+            for (int y = y0; y < y1; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    if (pending[(size_t)y * (size_t)width + (size_t)x].load(
+                        std::memory_order_relaxed) != FLOW_SOURCE)
+                    {
+                        continue;
+                    }
+
+                    GridPoint source;
+                    source.x = x;
+                    source.y = y;
+                    stack.push_back(source);
+                    while (!stack.empty())
+                    {
+                        int px = stack.back().x;
+                        int py = stack.back().y;
+                        stack.pop_back();
+
+                        float water = (pRainMap != NULL)
+                            ? pRainMap->GetConstSlabPtr(px, py)[0] : 1.0f;
+                        for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+                        {
+                            int nx = px + FLOW_OFFSET_X[code];
+                            int ny = py + FLOW_OFFSET_Y[code];
+                            int opposite = code ^ (FLOW_DIRECTION_COUNT / 2);
+                            if (nx < 0 || nx >= width || ny < 0 || ny >= height
+                                || !IsFlowingToward(pFlow[(size_t)ny
+                                * (size_t)width + (size_t)nx], opposite))
+                            {
+                                continue;
+                            }
+                            float fraction = 1.0f;
+                            if (method == FLOW_METHOD_DINF)
+                            {
+                                int targetCodes[2];
+                                float targetFractions[2];
+                                int targetCount = GetFlowTargets(
+                                    directionMap.GetConstSlabPtr(nx, ny)[0],
+                                    method, targetCodes, targetFractions);
+                                fraction = (targetCodes[0] == opposite)
+                                    ? targetFractions[0]
+                                    : targetFractions[targetCount - 1];
+                            }
+                            water += fraction * pAccumulation[
+                                (size_t)ny * accumulationStride + (size_t)nx];
+                        }
+                        pAccumulation[(size_t)py * accumulationStride
+                            + (size_t)px] = water;
+
+                        uint8 flow = pFlow[(size_t)py * (size_t)width
+                            + (size_t)px];
+                        for (int i = 0; i < 2; i++, flow >>= 4)
+                        {
+                            if ((flow & FLOW_CODE_USED) == 0)
+                            {
+                                continue;
+                            }
+                            GridPoint target;
+                            target.x = px + FLOW_OFFSET_X[flow & FLOW_CODE_MASK];
+                            target.y = py + FLOW_OFFSET_Y[flow & FLOW_CODE_MASK];
+                            if (target.x < 0 || target.x >= width || target.y < 0
+                                || target.y >= height)
+                            {
+                                continue;
+                            }
+                            if (pending[(size_t)target.y * (size_t)width
+                                + (size_t)target.x].fetch_sub(1,
+                                std::memory_order_acq_rel) == 1)
+                            {
+                                stack.push_back(target);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+}
+
+void FlowRouter::ComputeDirections(const NoiseMap& heightMap,
+    NoiseMap& directionMap) const
+{
+    int width  = heightMap.GetWidth ();
+    int height = heightMap.GetHeight();
+    if (width <= 0 || height <= 0 || &directionMap == &heightMap)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    directionMap.SetSize(width, height);
+    FlowMethod method = m_method;
+    int bandCount = (height + FLOW_BAND_HEIGHT - 1) / FLOW_BAND_HEIGHT;
+    std::vector<std::vector<GridPoint> > flats;
+    try
+    {
+        flats.resize((size_t)bandCount);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Steepest slopes.  Every band also lists its points without a downward
+    // slope, except those on the edges of the height map.
+    ParallelFor(bandCount, m_threadCount,
+        [&](int band, int)
+        {
+            int y0 = band * FLOW_BAND_HEIGHT;
+            int y1 = GetMin(y0 + FLOW_BAND_HEIGHT, height);
+            for (int y = y0; y < y1; y++)
+            {
+                const float* pRows[3];
+                pRows[0] = (y > 0) ? heightMap.GetConstSlabPtr(y - 1) : NULL;
+                pRows[1] = heightMap.GetConstSlabPtr(y);
+                pRows[2] = (y < height - 1) ? heightMap.GetConstSlabPtr(y + 1)
+                    : NULL;
+                float* pDest = directionMap.GetSlabPtr(y);
+                if (method == FLOW_METHOD_D8)
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        pDest[x] = GetD8Direction(pRows, x, width);
+                    }
+                }
+                else
+                {
+                    for (int x = 0; x < width; x++)
+                    {
+                        pDest[x] = GetDinfDirection(pRows, x, width);
+                    }
+                }
+                if (y == 0 || y == height - 1)
+                {
+                    continue;
+                }
+                for (int x = 1; x < width - 1; x++)
+                {
+                    if (pDest[x] == FLOW_DIRECTION_NONE)
+                    {
+                        GridPoint point;
+                        point.x = x;
+                        point.y = y;
+                        flats[band].push_back(point);
+                    }
+                }
+            }
+        });
+
+    // Flats.  A breadth-first search from the points that drain a flat
+    // directs every point of the flat toward the neighbour from which the
+    // search reached it, so water crosses the flat along the shortest path
+    // to its outlet.  Points on the edges of the height map drain out of it.
+    // Points lower than all their neighbours stay without a direction.
+    try
+    {
+        auto drains = [&](int x, int y)
+        {
+            return x == 0 || y == 0 || x == width - 1 || y == height - 1
+                || directionMap.GetConstSlabPtr(x, y)[0] != FLOW_DIRECTION_NONE;
+        };
+        auto setDirection = [&](const GridPoint& point, int code)
+        {
+            directionMap.GetSlabPtr(point.x, point.y)[0]
+                = (method == FLOW_METHOD_D8) ? (float)code
+                : (float)code * FLOW_FACET_ANGLE;
+        };
+
+        std::vector<GridPoint> queue;
+        std::vector<int> codes;
+        for (int band = 0; band < bandCount; band++)
+        {
+            for (size_t i = 0; i < flats[band].size(); i++)
+            {
+                const GridPoint& point = flats[band][i];
+                float level = heightMap.GetConstSlabPtr(point.x, point.y)[0];
+                for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+                {
+                    int nx = point.x + FLOW_OFFSET_X[code];
+                    int ny = point.y + FLOW_OFFSET_Y[code];
+                    if (heightMap.GetConstSlabPtr(nx, ny)[0] == level
+                        && drains(nx, ny))
+                    {
+                        queue.push_back(point);
+                        codes.push_back(code);
+                        break;
+                    }
+                }
+            }
+            std::vector<GridPoint>().swap(flats[band]);
+        }
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            setDirection(queue[i], codes[i]);
+        }
+        std::vector<int>().swap(codes);
+
+        for (size_t head = 0; head < queue.size(); head++)
+        {
+            GridPoint point = queue[head];
+            float level = heightMap.GetConstSlabPtr(point.x, point.y)[0];
+            for (int code = 0; code < FLOW_DIRECTION_COUNT; code++)
+            {
+                GridPoint neighbour;
+                neighbour.x = point.x + FLOW_OFFSET_X[code];
+                neighbour.y = point.y + FLOW_OFFSET_Y[code];
+                if (drains(neighbour.x, neighbour.y)
+                    || heightMap.GetConstSlabPtr(neighbour.x, neighbour.y)[0]
+                    != level)
+                {
+                    continue;
+                }
+                setDirection(neighbour,
+                    (code + FLOW_DIRECTION_COUNT / 2) & (FLOW_DIRECTION_COUNT - 1));
+                queue.push_back(neighbour);
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+}
+
+void FlowRouter::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
@@ -0,0 +1,205 @@
+// LibnoiseMemory.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include <exception.h>
+
+#include "LibnoiseMemory.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // The library-wide memory account.  Function-local statics make the
+    // account usable from the constructors of other static objects.
+    struct MemoryAccount
+    {
+        std::atomic<size_t> usage[MEMORY_CATEGORY_COUNT];
+        std::atomic<size_t> totalUsage;
+        std::atomic<size_t> peakUsage;
+        std::atomic<size_t> budget;
+
+        // Protects the reclaimer list and serializes calls to the reclaimers.
+        std::mutex reclaimMutex;
+        std::vector<MemoryReclaimer*> reclaimers;
+
+        MemoryAccount():
+            totalUsage(0),
+            peakUsage(0),
+            budget(0)
+        {
+            for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+            {
+                usage[i] = 0;
+            }
+        }
+    };
+
+    MemoryAccount& GetAccount()
+    {
+        static MemoryAccount account;
+        return account;
+    }
+
+    // Adds the specified number of bytes to the total usage if the budget
+    // allows it.
+    bool TryAddUsage(MemoryAccount& account, size_t bytes)
+    {
+        size_t current = account.totalUsage.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t budget = account.budget.load(std::memory_order_relaxed);
+            if (budget != 0 && (bytes > budget || current > budget - bytes))
+            {
+                return false;
+            }
+            if (account.totalUsage.compare_exchange_weak(current,
+                current + bytes, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+
+        // Record the new peak.
+        size_t newUsage = current + bytes;
+        size_t peak = account.peakUsage.load(std::memory_order_relaxed);
+        while (newUsage > peak
+            && !account.peakUsage.compare_exchange_weak(peak, newUsage,
+                std::memory_order_relaxed))
+        {
+        }
+        return true;
+    }
+
+}
+
+size_t noise::utils::GetAvailableMemory()
+{
+    MemoryAccount& account = GetAccount();
+    size_t budget = account.budget.load(std::memory_order_relaxed);
+    if (budget == 0)
+    {
+        return std::numeric_limits<size_t>::max();
+    }
+    size_t usage = account.totalUsage.load(std::memory_order_relaxed);
+    return (usage < budget) ? budget - usage : 0;
+}
+
+size_t noise::utils::GetMemoryBudget()
+{
+    return GetAccount().budget.load(std::memory_order_relaxed);
+}
+
+MemoryStats noise::utils::GetMemoryStats()
+{
+    MemoryAccount& account = GetAccount();
+    MemoryStats stats;
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+    {
+        stats.usage[i] = account.usage[i].load(std::memory_order_relaxed);
+    }
+    stats.totalUsage = account.totalUsage.load(std::memory_order_relaxed);
+    stats.peakUsage  = account.peakUsage .load(std::memory_order_relaxed);
+    stats.budget     = account.budget    .load(std::memory_order_relaxed);
+    return stats;
+}
+
+size_t noise::utils::GetMemoryUsage(MemoryCategory category)
+{
+    return GetAccount().usage[category].load(std::memory_order_relaxed);
+}
+
+size_t noise::utils::ReclaimMemory(size_t bytes)
+{
+    MemoryAccount& account = GetAccount();
+    std::lock_guard<std::mutex> lock(account.reclaimMutex);
+    size_t released = 0;
+    for (size_t i = 0; i < account.reclaimers.size() && released < bytes; i++)
+    {
+        released += account.reclaimers[i]->ReclaimMemory(bytes - released);
+    }
+    return released;
+}
+
+void noise::utils::RegisterMemoryReclaimer(MemoryReclaimer* pReclaimer)
+{
+    MemoryAccount& account = GetAccount();
+    std::lock_guard<std::mutex> lock(account.reclaimMutex);
+    account.reclaimers.push_back(pReclaimer);
+}
+
+void noise::utils::ReleaseMemory(MemoryCategory category, size_t bytes)
+{
+    MemoryAccount& account = GetAccount();
+    account.usage[category].fetch_sub(bytes, std::memory_order_relaxed);
+    account.totalUsage.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void noise::utils::ReserveMemory(MemoryCategory category, size_t bytes)
+{
+    if (!TryReserveMemory(category, bytes))
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+}
+
+void noise::utils::ResetPeakMemoryUsage()
+{
+    MemoryAccount& account = GetAccount();
+    account.peakUsage = account.totalUsage.load(std::memory_order_relaxed);
+}
+
+void noise::utils::SetMemoryBudget(size_t bytes)
+{
+    GetAccount().budget = bytes;
+}
+
+bool noise::utils::TryReserveMemory(MemoryCategory category, size_t bytes)
+{
+    MemoryAccount& account = GetAccount();
+    if (!TryAddUsage(account, bytes))
+    {
+        // Over budget.  Ask the reclaimers for the shortfall, then try once
+        // more; another thread may have taken the released memory meanwhile,
+        // in which case the reservation fails.
+        size_t budget = account.budget.load(std::memory_order_relaxed);
+        size_t usage = account.totalUsage.load(std::memory_order_relaxed);
+        size_t shortfall = (usage + bytes > budget) ? usage + bytes - budget : 0;
+        ReclaimMemory(std::max(shortfall, (size_t)1));
+        if (!TryAddUsage(account, bytes))
+        {
+            return false;
+        }
+    }
+    account.usage[category].fetch_add(bytes, std::memory_order_relaxed);
+    return true;
+}
+
+void noise::utils::UnregisterMemoryReclaimer(MemoryReclaimer* pReclaimer)
+{
+    MemoryAccount& account = GetAccount();
+    std::lock_guard<std::mutex> lock(account.reclaimMutex);
+    account.reclaimers.erase(std::remove(account.reclaimers.begin(),
+        account.reclaimers.end(), pReclaimer), account.reclaimers.end());
+}
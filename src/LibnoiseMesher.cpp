@@ -0,0 +1,837 @@
+// LibnoiseMesher.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <math.h>
+#include <vector>
+
+#include "LibnoiseMesher.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // A point of the height map, in global coordinates.
+    struct GridPoint
+    {
+        int x;
+        int z;
+    };
+
+    // A square block or a rectangle of cells, from ( x0, z0 ) to ( x1, z1 ).
+    struct Block
+    {
+        int x0;
+        int z0;
+        int x1;
+        int z1;
+    };
+
+    // Meshes one tile.  All coordinates are global height-map coordinates;
+    // the tile covers the points from ( m_x0, m_z0 ) to ( m_x1, m_z1 ).
+    class TileMesher
+    {
+
+        public:
+
+            TileMesher(const HeightMapMesher& mesher, const NoiseMap& heightMap,
+                int tileX, int tileZ, MeshBuffer& buffer);
+
+            void MeshGrid();
+            void MeshGreedy();
+            void MeshQuadtree();
+
+        private:
+
+            // Emits a triangle, facing +y.  Degenerate triangles are dropped.
+            void AddTriangle(int a, int b, int c);
+
+            // Returns the index of the vertex at a point, creating it if
+            // needed.
+            int AddVertex(int x, int z);
+
+            // Creates a vertex at the center of a block, on the diagonal shared
+            // by the two triangles of the block.
+            int AddCenterVertex(const Block& block);
+
+            // Returns true if every point of a block lies within the tolerance
+            // of the two triangles of the block.
+            bool FitsBlock(const Block& block) const;
+
+            // Returns true if every point of a segment of the height map lies
+            // within the tolerance of the line between its ends.  The segment
+            // runs from (x, z) along the x axis, or along the z axis.
+            bool FitsSegment(int x, int z, int length, bool alongX) const;
+
+            // Returns the value of the height map at a point.
+            float GetHeight(int x, int z) const
+            {
+                return m_heightMap.GetConstSlabPtr(z)[x];
+            }
+
+            // Returns the simplified vertices along an edge of the tile.
+            std::vector<GridPoint> GetEdgePolyline(int x, int z, int length,
+                bool alongX) const;
+
+            // Returns the active points on a line of the tile, from a to b.
+            std::vector<GridPoint> GetActivePoints(GridPoint a, GridPoint b) const;
+
+            bool IsActive(int x, int z) const
+            {
+                return m_active[LocalIndex(x, z)] != 0;
+            }
+
+            int LocalIndex(int x, int z) const
+            {
+                return (z - m_z0) * (m_x1 - m_x0 + 1) + (x - m_x0);
+            }
+
+            void MarkCorners(const Block& block);
+
+            // Triangulates a block using its corners and every active point
+            // on its edges.
+            void MeshBlock(const Block& block);
+
+            // Returns true if a quadtree block must be split: it reaches past
+            // the height map or does not fit.
+            bool NeedsSplit(int x0, int z0, int size) const;
+
+            // Subdivides a quadtree block and records its leaves.
+            void SplitQuadtree(int x0, int z0, int size, std::vector<Block>& leaves);
+
+            // Triangulates the strip between two parallel chains of points.
+            // The chains are sorted along the axis of the strip.
+            void Stitch(const std::vector<GridPoint>& outer,
+                const std::vector<GridPoint>& inner, bool alongX);
+
+            // Returns true if a block touches a tile border shared with
+            // another tile.
+            bool TouchesSharedBorder(const Block& block) const;
+
+            const HeightMapMesher& m_mesher;
+            const NoiseMap& m_heightMap;
+            MeshBuffer& m_buffer;
+            int m_mapWidth;
+            int m_mapHeight;
+            int m_x0;
+            int m_z0;
+            int m_x1;
+            int m_z1;
+            float m_tolerance;
+            MemoryReservation m_reservation;
+            std::vector<int> m_vertexIndex;
+            std::vector<unsigned char> m_active;
+
+    };
+
+    TileMesher::TileMesher(const HeightMapMesher& mesher,
+        const NoiseMap& heightMap, int tileX, int tileZ, MeshBuffer& buffer):
+        m_mesher(mesher),
+        m_heightMap(heightMap),
+        m_buffer(buffer),
+        m_mapWidth(heightMap.GetWidth()),
+        m_mapHeight(heightMap.GetHeight()),
+        m_x0(tileX * mesher.GetTileSize()),
+        m_z0(tileZ * mesher.GetTileSize()),
+        m_x1(GetMin(m_x0 + mesher.GetTileSize(), m_mapWidth  - 1)),
+        m_z1(GetMin(m_z0 + mesher.GetTileSize(), m_mapHeight - 1)),
+        m_tolerance((float)mesher.GetTolerance()),
+        m_reservation(MEMORY_SCRATCH, (size_t)(m_x1 - m_x0 + 1)
+            * (size_t)(m_z1 - m_z0 + 1) * (sizeof(int) + 2 * sizeof(unsigned char)
+            + sizeof(Block)))
+    {
+        size_t pointCount = (size_t)(m_x1 - m_x0 + 1) * (size_t)(m_z1 - m_z0 + 1);
+        try
+        {
+            m_vertexIndex.assign(pointCount, -1);
+            m_active.assign(pointCount, 0);
+        }
+        catch (...)
+        {
+            throw noise::ExceptionOutOfMemory();
+        }
+
+        m_buffer.vertexCount = 0;
+        m_buffer.indexCount = 0;
+    }
+
+    void TileMesher::AddTriangle(int a, int b, int c)
+    {
+        const float* pA = m_buffer.pVertices + 3 * a;
+        const float* pB = m_buffer.pVertices + 3 * b;
+        const float* pC = m_buffer.pVertices + 3 * c;
+
+        // y component of (B - A) x (C - A); positive for a triangle facing +y.
+        float cross = (pB[2] - pA[2]) * (pC[0] - pA[0])
+            - (pB[0] - pA[0]) * (pC[2] - pA[2]);
+        if (cross == 0.0f)
+        {
+            return;
+        }
+        if (cross < 0.0f)
+        {
+            int swap = b;
+            b = c;
+            c = swap;
+        }
+        uint32* pIndices = m_buffer.pIndices + m_buffer.indexCount;
+        pIndices[0] = (uint32)a;
+        pIndices[1] = (uint32)b;
+        pIndices[2] = (uint32)c;
+        m_buffer.indexCount += 3;
+    }
+
+    int TileMesher::AddVertex(int x, int z)
+    {
+        int& index = m_vertexIndex[LocalIndex(x, z)];
+        if (index < 0)
+        {
+            index = m_buffer.vertexCount++;
+            float* pVertex = m_buffer.pVertices + 3 * index;
+            pVertex[0] = (float)(x * m_mesher.GetSpacing());
+            pVertex[1] = (float)(GetHeight(x, z) * m_mesher.GetHeightScale());
+            pVertex[2] = (float)(z * m_mesher.GetSpacing());
+        }
+        return index;
+    }
+
+    int TileMesher::AddCenterVertex(const Block& block)
+    {
+        int index = m_buffer.vertexCount++;
+        float* pVertex = m_buffer.pVertices + 3 * index;
+        NOISE_REAL height = 0.5 * ((NOISE_REAL)GetHeight(block.x0, block.z1)
+            + (NOISE_REAL)GetHeight(block.x1, block.z0));
+        pVertex[0] = (float)(0.5 * (block.x0 + block.x1) * m_mesher.GetSpacing());
+        pVertex[1] = (float)(height * m_mesher.GetHeightScale());
+        pVertex[2] = (float)(0.5 * (block.z0 + block.z1) * m_mesher.GetSpacing());
+        return index;
+    }
+
+    bool TileMesher::FitsBlock(const Block& block) const
+    {
+        // The block is split along the diagonal from ( x0, z1 ) to ( x1, z0 ),
+        // the diagonal used by MeshBlock().  When MeshBlock() fans the block
+        // instead, the vertices added on its edges move the surface by up to
+        // their own error, so blocks are tested against half the tolerance.
+        float tolerance = 0.5f * m_tolerance;
+        float h00 = GetHeight(block.x0, block.z0);
+        float h10 = GetHeight(block.x1, block.z0);
+        float h01 = GetHeight(block.x0, block.z1);
+        float h11 = GetHeight(block.x1, block.z1);
+        float invWidth  = 1.0f / (float)(block.x1 - block.x0);
+        float invHeight = 1.0f / (float)(block.z1 - block.z0);
+        for (int z = block.z0; z <= block.z1; z++)
+        {
+            const float* pRow = m_heightMap.GetConstSlabPtr(z);
+            float v = (float)(z - block.z0) * invHeight;
+            for (int x = block.x0; x <= block.x1; x++)
+            {
+                float u = (float)(x - block.x0) * invWidth;
+                float predicted = (u + v <= 1.0f)
+                    ? h00 + u * (h10 - h00) + v * (h01 - h00)
+                    : h11 + (1.0f - u) * (h01 - h11) + (1.0f - v) * (h10 - h11);
+                if (fabs(pRow[x] - predicted) > tolerance)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool TileMesher::FitsSegment(int x, int z, int length, bool alongX) const
+    {
+        int dx = alongX ? 1 : 0;
+        int dz = alongX ? 0 : 1;
+        float h0 = GetHeight(x, z);
+        float h1 = GetHeight(x + dx * length, z + dz * length);
+        for (int i = 1; i < length; i++)
+        {
+            float t = (float)i / (float)length;
+            float predicted = h0 + t * (h1 - h0);
+            if (fabs(GetHeight(x + dx * i, z + dz * i) - predicted) > m_tolerance)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::vector<GridPoint> TileMesher::GetEdgePolyline(int x, int z, int length,
+        bool alongX) const
+    {
+        // Greedy: each segment is extended as far as it fits.  The result only
+        // depends on the points of the edge, so the tile on the other side of
+        // the edge finds the same vertices.
+        int dx = alongX ? 1 : 0;
+        int dz = alongX ? 0 : 1;
+        std::vector<GridPoint> polyline;
+        GridPoint start = {x, z};
+        polyline.push_back(start);
+        int a = 0;
+        while (a < length)
+        {
+            int b = a + 1;
+            while (b < length && FitsSegment(x + dx * a, z + dz * a, b + 1 - a, alongX))
+            {
+                b++;
+            }
+            GridPoint point = {x + dx * b, z + dz * b};
+            polyline.push_back(point);
+            a = b;
+        }
+        return polyline;
+    }
+
+    std::vector<GridPoint> TileMesher::GetActivePoints(GridPoint a,
+        GridPoint b) const
+    {
+        std::vector<GridPoint> points;
+        int dx = (b.x > a.x) ? 1 : 0;
+        int dz = (b.z > a.z) ? 1 : 0;
+        int length = GetMax(b.x - a.x, b.z - a.z);
+        for (int i = 0; i <= length; i++)
+        {
+            GridPoint point = {a.x + dx * i, a.z + dz * i};
+            if (IsActive(point.x, point.z))
+            {
+                points.push_back(point);
+            }
+        }
+        return points;
+    }
+
+    void TileMesher::MarkCorners(const Block& block)
+    {
+        m_active[LocalIndex(block.x0, block.z0)] = 1;
+        m_active[LocalIndex(block.x1, block.z0)] = 1;
+        m_active[LocalIndex(block.x0, block.z1)] = 1;
+        m_active[LocalIndex(block.x1, block.z1)] = 1;
+    }
+
+    void TileMesher::MeshBlock(const Block& block)
+    {
+        // Collect the boundary of the block, walking around it.
+        std::vector<int> boundary;
+        for (int z = block.z0; z < block.z1; z++)
+        {
+            if (IsActive(block.x0, z))
+            {
+                boundary.push_back(AddVertex(block.x0, z));
+            }
+        }
+        for (int x = block.x0; x < block.x1; x++)
+        {
+            if (IsActive(x, block.z1))
+            {
+                boundary.push_back(AddVertex(x, block.z1));
+            }
+        }
+        for (int z = block.z1; z > block.z0; z--)
+        {
+            if (IsActive(block.x1, z))
+            {
+                boundary.push_back(AddVertex(block.x1, z));
+            }
+        }
+        for (int x = block.x1; x > block.x0; x--)
+        {
+            if (IsActive(x, block.z0))
+            {
+                boundary.push_back(AddVertex(x, block.z0));
+            }
+        }
+
+        if (boundary.size() == 4)
+        {
+            int v00 = AddVertex(block.x0, block.z0);
+            int v10 = AddVertex(block.x1, block.z0);
+            int v01 = AddVertex(block.x0, block.z1);
+            int v11 = AddVertex(block.x1, block.z1);
+            AddTriangle(v00, v01, v10);
+            AddTriangle(v10, v01, v11);
+            return;
+        }
+
+        // A neighbour is finer: fan around the center so that every vertex
+        // on the edges is used, which avoids T-junctions.
+        int center = AddCenterVertex(block);
+        for (size_t i = 0; i < boundary.size(); i++)
+        {
+            AddTriangle(center, boundary[i], boundary[(i + 1) % boundary.size()]);
+        }
+    }
+
+    void TileMesher::MeshGrid()
+    {
+        for (int z = m_z0; z < m_z1; z++)
+        {
+            for (int x = m_x0; x < m_x1; x++)
+            {
+                int v00 = AddVertex(x    , z    );
+                int v10 = AddVertex(x + 1, z    );
+                int v01 = AddVertex(x    , z + 1);
+                int v11 = AddVertex(x + 1, z + 1);
+                AddTriangle(v00, v01, v10);
+                AddTriangle(v10, v01, v11);
+            }
+        }
+    }
+
+    bool TileMesher::NeedsSplit(int x0, int z0, int size) const
+    {
+        if (size <= 1)
+        {
+            return false;
+        }
+        if (x0 + size > m_mapWidth - 1 || z0 + size > m_mapHeight - 1)
+        {
+            return true;
+        }
+        Block block = {x0, z0, x0 + size, z0 + size};
+        return !FitsBlock(block);
+    }
+
+    void TileMesher::SplitQuadtree(int x0, int z0, int size,
+        std::vector<Block>& leaves)
+    {
+        if (x0 >= m_mapWidth - 1 || z0 >= m_mapHeight - 1)
+        {
+            return;
+        }
+
+        // A block on a shared tile border is split whenever the block of the
+        // same size on the other side is, so that both tiles end up with the
+        // same vertices along the border.  The four blocks that meet at a tile
+        // corner all decide together.
+        int tileSize = m_mesher.GetTileSize();
+        int mirrorX = 0;
+        int mirrorZ = 0;
+        if (x0 == m_x0 && m_x0 > 0)
+        {
+            mirrorX = -size;
+        }
+        else if (x0 + size == m_x0 + tileSize && m_x1 < m_mapWidth - 1)
+        {
+            mirrorX = size;
+        }
+        if (z0 == m_z0 && m_z0 > 0)
+        {
+            mirrorZ = -size;
+        }
+        else if (z0 + size == m_z0 + tileSize && m_z1 < m_mapHeight - 1)
+        {
+            mirrorZ = size;
+        }
+        bool split = NeedsSplit(x0, z0, size)
+            || (mirrorX != 0 && NeedsSplit(x0 + mirrorX, z0, size))
+            || (mirrorZ != 0 && NeedsSplit(x0, z0 + mirrorZ, size))
+            || (mirrorX != 0 && mirrorZ != 0
+                && NeedsSplit(x0 + mirrorX, z0 + mirrorZ, size));
+
+        // The root block may touch shared borders on opposite sides, which the
+        // rule above cannot mirror consistently; split it.
+        if (size == tileSize && (mirrorX != 0 || mirrorZ != 0))
+        {
+            split = size > 1;
+        }
+
+        if (split)
+        {
+            int half = size / 2;
+            SplitQuadtree(x0       , z0       , half, leaves);
+            SplitQuadtree(x0 + half, z0       , half, leaves);
+            SplitQuadtree(x0       , z0 + half, half, leaves);
+            SplitQuadtree(x0 + half, z0 + half, half, leaves);
+        }
+        else
+        {
+            Block leaf = {x0, z0, x0 + size, z0 + size};
+            leaves.push_back(leaf);
+        }
+    }
+
+    bool TileMesher::TouchesSharedBorder(const Block& block) const
+    {
+        return (block.x0 == m_x0 && m_x0 > 0)
+            || (block.x1 == m_x1 && m_x1 < m_mapWidth - 1)
+            || (block.z0 == m_z0 && m_z0 > 0)
+            || (block.z1 == m_z1 && m_z1 < m_mapHeight - 1);
+    }
+
+    void TileMesher::MeshQuadtree()
+    {
+        std::vector<Block> leaves;
+        SplitQuadtree(m_x0, m_z0, m_mesher.GetTileSize(), leaves);
+
+        // Size of the leaf covering each cell of the tile.
+        int cellWidth = m_x1 - m_x0;
+        int cellHeight = m_z1 - m_z0;
+        std::vector<int> leafSize((size_t)cellWidth * (size_t)cellHeight);
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            const Block& leaf = leaves[i];
+            for (int z = leaf.z0; z < leaf.z1; z++)
+            {
+                for (int x = leaf.x0; x < leaf.x1; x++)
+                {
+                    leafSize[(z - m_z0) * cellWidth + (x - m_x0)] = leaf.x1 - leaf.x0;
+                }
+            }
+        }
+
+        // Restrict the quadtree: a leaf next to a leaf less than half its size
+        // is split.  Leaves on a shared border are left alone, since splitting
+        // them would add a vertex that the neighbouring tile does not have;
+        // MeshBlock() fans them instead.
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = 0; i < leaves.size(); i++)
+            {
+                Block leaf = leaves[i];
+                int size = leaf.x1 - leaf.x0;
+                if (size < 4 || TouchesSharedBorder(leaf))
+                {
+                    continue;
+                }
+                int minNeighbour = size;
+                for (int t = 0; t < size; t++)
+                {
+                    if (leaf.x0 > m_x0)
+                    {
+                        minNeighbour = GetMin(minNeighbour, leafSize[(leaf.z0 + t - m_z0)
+                            * cellWidth + (leaf.x0 - 1 - m_x0)]);
+                    }
+                    if (leaf.x1 < m_x1)
+                    {
+                        minNeighbour = GetMin(minNeighbour, leafSize[(leaf.z0 + t - m_z0)
+                            * cellWidth + (leaf.x1 - m_x0)]);
+                    }
+                    if (leaf.z0 > m_z0)
+                    {
+                        minNeighbour = GetMin(minNeighbour, leafSize[(leaf.z0 - 1 - m_z0)
+                            * cellWidth + (leaf.x0 + t - m_x0)]);
+                    }
+                    if (leaf.z1 < m_z1)
+                    {
+                        minNeighbour = GetMin(minNeighbour, leafSize[(leaf.z1 - m_z0)
+                            * cellWidth + (leaf.x0 + t - m_x0)]);
+                    }
+                }
+                if (minNeighbour * 2 >= size)
+                {
+                    continue;
+                }
+
+                int half = size / 2;
+                for (int z = leaf.z0; z < leaf.z1; z++)
+                {
+                    for (int x = leaf.x0; x < leaf.x1; x++)
+                    {
+                        leafSize[(z - m_z0) * cellWidth + (x - m_x0)] = half;
+                    }
+                }
+                Block children[4] = {
+                    {leaf.x0, leaf.z0, leaf.x0 + half, leaf.z0 + half},
+                    {leaf.x0 + half, leaf.z0, leaf.x1, leaf.z0 + half},
+                    {leaf.x0, leaf.z0 + half, leaf.x0 + half, leaf.z1},
+                    {leaf.x0 + half, leaf.z0 + half, leaf.x1, leaf.z1}};
+                leaves[i] = children[0];
+                leaves.push_back(children[1]);
+                leaves.push_back(children[2]);
+                leaves.push_back(children[3]);
+                changed = true;
+            }
+        }
+
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            MarkCorners(leaves[i]);
+        }
+        for (size_t i = 0; i < leaves.size(); i++)
+        {
+            MeshBlock(leaves[i]);
+        }
+    }
+
+    void TileMesher::Stitch(const std::vector<GridPoint>& outer,
+        const std::vector<GridPoint>& inner, bool alongX)
+    {
+        size_t i = 0;
+        size_t j = 0;
+        while (i + 1 < outer.size() || j + 1 < inner.size())
+        {
+            bool advanceOuter;
+            if (j + 1 >= inner.size())
+            {
+                advanceOuter = true;
+            }
+            else if (i + 1 >= outer.size())
+            {
+                advanceOuter = false;
+            }
+            else
+            {
+                advanceOuter = alongX
+                    ? outer[i + 1].x <= inner[j + 1].x
+                    : outer[i + 1].z <= inner[j + 1].z;
+            }
+
+            int a = AddVertex(outer[i].x, outer[i].z);
+            int b = AddVertex(inner[j].x, inner[j].z);
+            if (advanceOuter)
+            {
+                i++;
+                AddTriangle(a, AddVertex(outer[i].x, outer[i].z), b);
+            }
+            else
+            {
+                j++;
+                AddTriangle(a, AddVertex(inner[j].x, inner[j].z), b);
+            }
+        }
+    }
+
+    void TileMesher::MeshGreedy()
+    {
+        int width  = m_x1 - m_x0;
+        int height = m_z1 - m_z0;
+        std::vector<GridPoint> bottom = GetEdgePolyline(m_x0, m_z0, width , true );
+        std::vector<GridPoint> top    = GetEdgePolyline(m_x0, m_z1, width , true );
+        std::vector<GridPoint> left   = GetEdgePolyline(m_x0, m_z0, height, false);
+        std::vector<GridPoint> right  = GetEdgePolyline(m_x1, m_z0, height, false);
+
+        // A tile one cell thick has no interior: join its two long edges.
+        if (height == 1)
+        {
+            Stitch(bottom, top, true);
+            return;
+        }
+        if (width == 1)
+        {
+            Stitch(left, right, false);
+            return;
+        }
+
+        // The interior of the tile, one cell inside the tile edges, is covered
+        // by greedily grown rectangles.  The ring of cells around it joins the
+        // interior to the simplified tile edges.
+        int ix0 = m_x0 + 1;
+        int iz0 = m_z0 + 1;
+        int ix1 = m_x1 - 1;
+        int iz1 = m_z1 - 1;
+        std::vector<Block> rectangles;
+        if (ix1 > ix0 && iz1 > iz0)
+        {
+            std::vector<unsigned char> claimed((size_t)(ix1 - ix0) * (size_t)(iz1 - iz0), 0);
+            for (int cz = iz0; cz < iz1; cz++)
+            {
+                for (int cx = ix0; cx < ix1; cx++)
+                {
+                    if (claimed[(cz - iz0) * (ix1 - ix0) + (cx - ix0)])
+                    {
+                        continue;
+                    }
+
+                    // Grow along x, then along z, while the rectangle still fits.
+                    Block rect = {cx, cz, cx + 1, cz + 1};
+                    while (rect.x1 < ix1
+                        && !claimed[(cz - iz0) * (ix1 - ix0) + (rect.x1 - ix0)])
+                    {
+                        Block grown = rect;
+                        grown.x1++;
+                        if (!FitsBlock(grown))
+                        {
+                            break;
+                        }
+                        rect = grown;
+                    }
+                    while (rect.z1 < iz1)
+                    {
+                        bool free = true;
+                        for (int x = rect.x0; x < rect.x1 && free; x++)
+                        {
+                            free = !claimed[(rect.z1 - iz0) * (ix1 - ix0) + (x - ix0)];
+                        }
+                        Block grown = rect;
+                        grown.z1++;
+                        if (!free || !FitsBlock(grown))
+                        {
+                            break;
+                        }
+                        rect = grown;
+                    }
+
+                    for (int z = rect.z0; z < rect.z1; z++)
+                    {
+                        for (int x = rect.x0; x < rect.x1; x++)
+                        {
+                            claimed[(z - iz0) * (ix1 - ix0) + (x - ix0)] = 1;
+                        }
+                    }
+                    rectangles.push_back(rect);
+                    MarkCorners(rect);
+                }
+            }
+        }
+        else
+        {
+            // The interior is a single line or point: keep all of it.
+            for (int z = iz0; z <= iz1; z++)
+            {
+                for (int x = ix0; x <= ix1; x++)
+                {
+                    m_active[LocalIndex(x, z)] = 1;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < rectangles.size(); i++)
+        {
+            MeshBlock(rectangles[i]);
+        }
+
+        GridPoint c00 = {ix0, iz0};
+        GridPoint c10 = {ix1, iz0};
+        GridPoint c01 = {ix0, iz1};
+        GridPoint c11 = {ix1, iz1};
+        Stitch(bottom, GetActivePoints(c00, c10), true );
+        Stitch(top   , GetActivePoints(c01, c11), true );
+        Stitch(left  , GetActivePoints(c00, c01), false);
+        Stitch(right , GetActivePoints(c10, c11), false);
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// HeightMapMesher class
+
+HeightMapMesher::HeightMapMesher():
+    m_heightScale(1.0),
+    m_mode(MESH_QUADTREE),
+    m_spacing(1.0),
+    m_threadCount(0),
+    m_tileSize(DEFAULT_MESHER_TILE_SIZE),
+    m_tolerance(DEFAULT_MESHER_TOLERANCE)
+{
+}
+
+int HeightMapMesher::GetMaxIndexCount(const NoiseMap& heightMap, int tileX,
+    int tileZ) const
+{
+    // A triangulation of a rectangle with V vertices has fewer than 2 V
+    // triangles.
+    int width  = GetMin((tileX + 1) * m_tileSize, heightMap.GetWidth () - 1)
+        - tileX * m_tileSize;
+    int height = GetMin((tileZ + 1) * m_tileSize, heightMap.GetHeight() - 1)
+        - tileZ * m_tileSize;
+    if (m_mode == MESH_GRID)
+    {
+        return 6 * width * height;
+    }
+    return 6 * GetMaxVertexCount(heightMap, tileX, tileZ);
+}
+
+int HeightMapMesher::GetMaxVertexCount(const NoiseMap& heightMap, int tileX,
+    int tileZ) const
+{
+    int width  = GetMin((tileX + 1) * m_tileSize, heightMap.GetWidth () - 1)
+        - tileX * m_tileSize;
+    int height = GetMin((tileZ + 1) * m_tileSize, heightMap.GetHeight() - 1)
+        - tileZ * m_tileSize;
+    int pointCount = (width + 1) * (height + 1);
+    switch (m_mode)
+    {
+        case MESH_GREEDY:
+        case MESH_QUADTREE:
+            // Plus at most one center per block; blocks cover at least one
+            // cell.
+            return pointCount + width * height;
+        default:
+            return pointCount;
+    }
+}
+
+void HeightMapMesher::GetTileCount(const NoiseMap& heightMap, int& tileCountX,
+    int& tileCountZ) const
+{
+    int cellWidth  = GetMax(heightMap.GetWidth () - 1, 0);
+    int cellHeight = GetMax(heightMap.GetHeight() - 1, 0);
+    tileCountX = (cellWidth  + m_tileSize - 1) / m_tileSize;
+    tileCountZ = (cellHeight + m_tileSize - 1) / m_tileSize;
+    if (tileCountX == 0 || tileCountZ == 0)
+    {
+        tileCountX = 0;
+        tileCountZ = 0;
+    }
+}
+
+void HeightMapMesher::MeshTile(const NoiseMap& heightMap, int tileX, int tileZ,
+    MeshBuffer& buffer) const
+{
+    int tileCountX;
+    int tileCountZ;
+    GetTileCount(heightMap, tileCountX, tileCountZ);
+    if (tileX < 0 || tileX >= tileCountX || tileZ < 0 || tileZ >= tileCountZ
+        || buffer.pVertices == NULL || buffer.pIndices == NULL
+        || buffer.vertexCapacity < GetMaxVertexCount(heightMap, tileX, tileZ)
+        || buffer.indexCapacity < GetMaxIndexCount(heightMap, tileX, tileZ))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    TileMesher mesher(*this, heightMap, tileX, tileZ, buffer);
+    switch (m_mode)
+    {
+        case MESH_GREEDY:
+            mesher.MeshGreedy();
+            break;
+        case MESH_QUADTREE:
+            mesher.MeshQuadtree();
+            break;
+        default:
+            mesher.MeshGrid();
+            break;
+    }
+}
+
+void HeightMapMesher::MeshTiles(const NoiseMap& heightMap,
+    MeshBuffer* pBuffers) const
+{
+    int tileCountX;
+    int tileCountZ;
+    GetTileCount(heightMap, tileCountX, tileCountZ);
+    if (tileCountX == 0)
+    {
+        return;
+    }
+    if (pBuffers == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    ParallelFor(tileCountX * tileCountZ, m_threadCount,
+        [&](int tile, int)
+        {
+            MeshTile(heightMap, tile % tileCountX, tile / tileCountX,
+                pBuffers[tile]);
+        });
+}
@@ -0,0 +1,497 @@
+// LibnoisePipeline.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <string.h>
+
+#include "LibnoisePipeline.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // A tile of a stage, ready to run.
+    struct PipelineTask
+    {
+        int depth;
+        int tile;
+        int stage;
+    };
+
+    // Orders the ready tasks: deepest stage first, then row-major order.
+    struct PipelineTaskOrder
+    {
+        bool operator() (const PipelineTask& a, const PipelineTask& b) const
+        {
+            if (a.depth != b.depth)
+            {
+                return a.depth < b.depth;
+            }
+            if (a.tile != b.tile)
+            {
+                return a.tile > b.tile;
+            }
+            return a.stage > b.stage;
+        }
+    };
+
+    // A stage that reads the raster of another stage.
+    struct PipelineReader
+    {
+        int stage;
+        int halo;
+    };
+
+    // Returns the number of tiles a halo reaches on each side of a tile.
+    int GetReach(int halo, int tileSize)
+    {
+        return (halo + tileSize - 1) / tileSize;
+    }
+
+    // Copies a rectangle of a tiled raster.  Points outside the raster get
+    // the value of the nearest point on its edge.
+    void GatherWindow(float* const* ppTiles, int tileCountX, int tileSize,
+        int width, int height, int x0, int z0, int windowWidth,
+        int windowHeight, float* pDest)
+    {
+        for (int j = 0; j < windowHeight; j++)
+        {
+            int z = ClampValue(z0 + j, 0, height - 1);
+            int tileZ = z / tileSize;
+            int tileRow = z - tileZ * tileSize;
+            float* pLine = pDest + (size_t)j * (size_t)windowWidth;
+            int x = x0;
+            int xEnd = x0 + windowWidth;
+            while (x < xEnd)
+            {
+                int xClamped = ClampValue(x, 0, width - 1);
+                int tileX = xClamped / tileSize;
+                int tileX0 = tileX * tileSize;
+                int tileWidth = GetMin(tileSize, width - tileX0);
+                const float* pRow = ppTiles[tileZ * tileCountX + tileX]
+                    + (size_t)tileRow * (size_t)tileWidth;
+                if (x != xClamped)
+                {
+                    pLine[x - x0] = pRow[xClamped - tileX0];
+                    x++;
+                    continue;
+                }
+                int spanEnd = GetMin(xEnd, tileX0 + tileWidth);
+                memcpy(pLine + (x - x0), pRow + (x - tileX0),
+                    (size_t)(spanEnd - x) * sizeof(float));
+                x = spanEnd;
+            }
+        }
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// TilePipeline class
+
+TilePipeline::TilePipeline(int width, int height):
+    m_height(height),
+    m_maxHeldTiles(0),
+    m_peakHeldTileCount(0),
+    m_threadCount(0),
+    m_tileSize(DEFAULT_PIPELINE_TILE_SIZE),
+    m_width(width)
+{
+    if (width <= 0 || height <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+}
+
+void TilePipeline::AddInput(int stage, int sourceStage, int halo)
+{
+    CheckStage(stage);
+    CheckStage(sourceStage);
+    if (sourceStage >= stage || halo < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    Input input;
+    input.sourceStage = sourceStage;
+    input.halo = halo;
+    m_stages[stage].inputs.push_back(input);
+}
+
+int TilePipeline::AddStage(const std::function<void(PipelineTile&)>& fRun)
+{
+    Stage stage;
+    stage.fRun = fRun;
+    stage.pOutputNoiseMap = NULL;
+    m_stages.push_back(stage);
+    return (int)m_stages.size() - 1;
+}
+
+void TilePipeline::CheckStage(int stage) const
+{
+    if (stage < 0 || stage >= (int)m_stages.size())
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+}
+
+void TilePipeline::Run()
+{
+    int stageCount = (int)m_stages.size();
+    if (stageCount == 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int width = m_width;
+    int height = m_height;
+    int tileSize = m_tileSize;
+    int tileCountX = (width + tileSize - 1) / tileSize;
+    int tileCountZ = (height + tileSize - 1) / tileSize;
+    int tileCount = tileCountX * tileCountZ;
+    int threadCount = ResolveThreadCount(m_threadCount);
+    for (int s = 0; s < stageCount; s++)
+    {
+        if (m_stages[s].pOutputNoiseMap != NULL)
+        {
+            m_stages[s].pOutputNoiseMap->SetSize(width, height);
+        }
+    }
+
+    // Calls a function for every tile within a reach of a tile.
+    auto forEachNeighbour = [&](int tile, int reach,
+        const std::function<void(int)>& fVisit)
+    {
+        int tileX = tile % tileCountX;
+        int tileZ = tile / tileCountX;
+        int xEnd = GetMin(tileX + reach, tileCountX - 1);
+        int zEnd = GetMin(tileZ + reach, tileCountZ - 1);
+        for (int z = GetMax(tileZ - reach, 0); z <= zEnd; z++)
+        {
+            for (int x = GetMax(tileX - reach, 0); x <= xEnd; x++)
+            {
+                fVisit(z * tileCountX + x);
+            }
+        }
+    };
+
+    // The dependency counts.  pending counts, for every tile of every stage,
+    // the input tiles that are not done; users counts the tiles that will
+    // read a tile.
+    std::vector<int> depth((size_t)stageCount, 0);
+    std::vector<std::vector<PipelineReader> > readers((size_t)stageCount);
+    std::vector<int> pending((size_t)stageCount * (size_t)tileCount, 0);
+    std::vector<int> users((size_t)stageCount * (size_t)tileCount, 0);
+    std::vector<PipelineTask> sources;
+    size_t maxWindowSize = 0;
+    int totalReach = 0;
+    for (int s = 0; s < stageCount; s++)
+    {
+        const std::vector<Input>& inputs = m_stages[s].inputs;
+        size_t windowSize = 0;
+        for (size_t i = 0; i < inputs.size(); i++)
+        {
+            int p = inputs[i].sourceStage;
+            int reach = GetReach(inputs[i].halo, tileSize);
+            depth[s] = GetMax(depth[s], depth[p] + 1);
+            totalReach += reach;
+            PipelineReader reader;
+            reader.stage = s;
+            reader.halo = inputs[i].halo;
+            readers[p].push_back(reader);
+            size_t side = (size_t)tileSize + 2 * (size_t)inputs[i].halo;
+            windowSize += side * side;
+            for (int t = 0; t < tileCount; t++)
+            {
+                forEachNeighbour(t, reach,
+                    [&](int neighbour)
+                    {
+                        pending[(size_t)s * tileCount + t]++;
+                        users[(size_t)p * tileCount + neighbour]++;
+                    });
+            }
+        }
+        maxWindowSize = GetMax(maxWindowSize, windowSize);
+    }
+    for (int t = 0; t < tileCount; t++)
+    {
+        for (int s = 0; s < stageCount; s++)
+        {
+            if (m_stages[s].inputs.empty())
+            {
+                PipelineTask task;
+                task.depth = 0;
+                task.tile = t;
+                task.stage = s;
+                sources.push_back(task);
+            }
+        }
+    }
+    int maxHeldTiles = m_maxHeldTiles;
+    if (maxHeldTiles == 0)
+    {
+        maxHeldTiles = stageCount * tileCountX * (totalReach + 2) + threadCount;
+    }
+
+    MemoryReservation reservation(MEMORY_SCRATCH,
+        (size_t)threadCount * maxWindowSize * sizeof(float));
+    std::vector<std::vector<float> > windows((size_t)threadCount);
+    std::vector<std::vector<float> > tiles((size_t)stageCount * tileCount);
+    std::vector<float*> tilePtrs((size_t)stageCount * tileCount, NULL);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            windows[i].resize(maxWindowSize);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // The scheduler state, protected by the mutex.
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::priority_queue<PipelineTask, std::vector<PipelineTask>,
+        PipelineTaskOrder> ready;
+    size_t nextSource = 0;
+    int runningCount = 0;
+    int heldCount = 0;
+    int peakCount = 0;
+    size_t heldBytes = 0;
+    size_t completedCount = 0;
+    size_t taskCount = (size_t)stageCount * (size_t)tileCount;
+    bool isFailed = false;
+    std::exception_ptr pError;
+
+    auto worker = [&](int, int workerIndex)
+    {
+        PipelineTile tile;
+        tile.m_worker = workerIndex;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            // Start the next source tiles while the pipeline holds few tiles,
+            // or when nothing else can run.
+            while (nextSource < sources.size()
+                && (heldCount + runningCount < maxHeldTiles
+                    || (ready.empty() && runningCount == 0)))
+            {
+                ready.push(sources[nextSource++]);
+            }
+            if (isFailed || completedCount == taskCount)
+            {
+                return;
+            }
+            if (ready.empty())
+            {
+                condition.wait(lock);
+                continue;
+            }
+
+            PipelineTask task = ready.top();
+            ready.pop();
+            runningCount++;
+            peakCount = GetMax(peakCount, heldCount + runningCount);
+            lock.unlock();
+
+            // The input tiles cannot be freed before this task is done, so
+            // they are read without the lock.
+            const Stage& stage = m_stages[task.stage];
+            int tileX = task.tile % tileCountX;
+            int tileZ = task.tile / tileCountX;
+            tile.m_x0 = tileX * tileSize;
+            tile.m_z0 = tileZ * tileSize;
+            tile.m_width = GetMin(tileSize, width - tile.m_x0);
+            tile.m_height = GetMin(tileSize, height - tile.m_z0);
+            size_t tileBytes = (size_t)tile.m_width * (size_t)tile.m_height
+                * sizeof(float);
+            std::vector<float> output;
+            bool isReserved = false;
+            try
+            {
+                ReserveMemory(MEMORY_SCRATCH, tileBytes);
+                isReserved = true;
+                try
+                {
+                    output.resize((size_t)tile.m_width * (size_t)tile.m_height);
+                }
+                catch (...)
+                {
+                    throw noise::ExceptionOutOfMemory();
+                }
+                tile.m_pOutput = &output[0];
+
+                tile.m_inputs.resize(stage.inputs.size());
+                float* pWindow = &windows[workerIndex][0];
+                for (size_t i = 0; i < stage.inputs.size(); i++)
+                {
+                    int halo = stage.inputs[i].halo;
+                    PipelineTile::Window& window = tile.m_inputs[i];
+                    window.x0 = tile.m_x0 - halo;
+                    window.z0 = tile.m_z0 - halo;
+                    window.stride = tile.m_width + 2 * halo;
+                    window.pData = pWindow;
+                    GatherWindow(&tilePtrs[(size_t)stage.inputs[i].sourceStage
+                        * tileCount], tileCountX, tileSize, width, height,
+                        window.x0, window.z0, window.stride,
+                        tile.m_height + 2 * halo, pWindow);
+                    pWindow += (size_t)window.stride
+                        * (size_t)(tile.m_height + 2 * halo);
+                }
+
+                stage.fRun(tile);
+
+                if (stage.pOutputNoiseMap != NULL)
+                {
+                    for (int j = 0; j < tile.m_height; j++)
+                    {
+                        memcpy(stage.pOutputNoiseMap->GetSlabPtr(tile.m_x0,
+                            tile.m_z0 + j),
+                            &output[(size_t)j * (size_t)tile.m_width],
+                            (size_t)tile.m_width * sizeof(float));
+                    }
+                }
+            }
+            catch (...)
+            {
+                if (isReserved)
+                {
+                    ReleaseMemory(MEMORY_SCRATCH, tileBytes);
+                }
+                lock.lock();
+                runningCount--;
+                if (!isFailed)
+                {
+                    isFailed = true;
+                    pError = std::current_exception();
+                }
+                condition.notify_all();
+                return;
+            }
+
+            lock.lock();
+            runningCount--;
+            completedCount++;
+            size_t index = (size_t)task.stage * tileCount + task.tile;
+            if (users[index] > 0)
+            {
+                tiles[index].swap(output);
+                tilePtrs[index] = &tiles[index][0];
+                heldCount++;
+                heldBytes += tileBytes;
+            }
+            else
+            {
+                ReleaseMemory(MEMORY_SCRATCH, tileBytes);
+            }
+
+            // Wake the tiles that read this one, then free the input tiles
+            // that no other tile reads.
+            const std::vector<PipelineReader>& taskReaders = readers[task.stage];
+            for (size_t i = 0; i < taskReaders.size(); i++)
+            {
+                int c = taskReaders[i].stage;
+                forEachNeighbour(task.tile,
+                    GetReach(taskReaders[i].halo, tileSize),
+                    [&](int neighbour)
+                    {
+                        if (--pending[(size_t)c * tileCount + neighbour] == 0)
+                        {
+                            PipelineTask next;
+                            next.depth = depth[c];
+                            next.tile = neighbour;
+                            next.stage = c;
+                            ready.push(next);
+                        }
+                    });
+            }
+            for (size_t i = 0; i < stage.inputs.size(); i++)
+            {
+                int p = stage.inputs[i].sourceStage;
+                forEachNeighbour(task.tile,
+                    GetReach(stage.inputs[i].halo, tileSize),
+                    [&](int neighbour)
+                    {
+                        size_t source = (size_t)p * tileCount + neighbour;
+                        if (--users[source] == 0)
+                        {
+                            size_t bytes = tiles[source].size() * sizeof(float);
+                            std::vector<float>().swap(tiles[source]);
+                            tilePtrs[source] = NULL;
+                            heldCount--;
+                            heldBytes -= bytes;
+                            ReleaseMemory(MEMORY_SCRATCH, bytes);
+                        }
+                    });
+            }
+            condition.notify_all();
+        }
+    };
+
+    ParallelFor(threadCount, threadCount, worker);
+
+    // After a failure, some tiles are still held.
+    if (heldBytes > 0)
+    {
+        ReleaseMemory(MEMORY_SCRATCH, heldBytes);
+    }
+    m_peakHeldTileCount = peakCount;
+    if (pError)
+    {
+        std::rethrow_exception(pError);
+    }
+}
+
+void TilePipeline::SetMaxHeldTiles(int maxHeldTiles)
+{
+    if (maxHeldTiles < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_maxHeldTiles = maxHeldTiles;
+}
+
+void TilePipeline::SetOutputNoiseMap(int stage, NoiseMap* pNoiseMap)
+{
+    CheckStage(stage);
+    m_stages[stage].pOutputNoiseMap = pNoiseMap;
+}
+
+void TilePipeline::SetThreadCount(int threadCount)
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_threadCount = threadCount;
+}
+
+void TilePipeline::SetTileSize(int tileSize)
+{
+    if (tileSize <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_tileSize = tileSize;
+}
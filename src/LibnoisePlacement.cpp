@@ -0,0 +1,543 @@
+// LibnoisePlacement.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+#include "LibnoisePlacement.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // The round number that salts the random numbers of the thinning, out of
+    // the range of the attempt count.
+    const uint32 THINNING_ROUND = 0xffffffff;
+
+    // The smallest size of the tiles, in cells.
+    const int PLACEMENT_TILE_SIZE = 32;
+
+    // The cell number that salts the shuffling of the steps, out of the
+    // range of the cell indices.
+    const uint64 STEP_ORDER_CELL = 0xffffffffffffffffULL;
+
+    // A cell of the grid.  The radius of an empty cell is zero, and the
+    // radius of a cell covered by the disk of a placed point, where no point
+    // can be placed anymore, is negative.
+    struct PlacementCell
+    {
+        NOISE_REAL x;
+        NOISE_REAL z;
+        NOISE_REAL radius;
+    };
+
+    // The grid of cells and the points placed in them.  A cell holds at most
+    // one point.  The grid is surrounded by a border of empty cells as wide
+    // as the reach, so that the neighbours of a cell need no bounds checks.
+    struct PlacementGrid
+    {
+        int cellCountX;
+        int cellCountZ;
+        NOISE_REAL cellWidth;
+        NOISE_REAL cellHeight;
+        NOISE_REAL lowerXBound;
+        NOISE_REAL lowerZBound;
+
+        // The number of cells, on each side of a cell, that may hold a point
+        // closer than the largest radius.
+        int reachX;
+        int reachZ;
+
+        // The number of cells in a row, including the border.
+        int stride;
+
+        // The offsets of the neighbours that may hold a point closer than
+        // the largest radius, nearest first.
+        std::vector<ptrdiff_t> neighbourOffsets;
+
+        std::vector<PlacementCell> cells;
+
+        // Returns the index of a cell.
+        size_t GetIndex(int cellX, int cellZ) const
+        {
+            return (size_t)(cellZ + reachZ) * (size_t)stride
+                + (size_t)(cellX + reachX);
+        }
+    };
+
+    // The scratch space of a worker: a batch of coordinates, the values the
+    // modules return for them, and their cells.
+    struct PlacementScratch
+    {
+        std::vector<NOISE_REAL> x;
+        std::vector<NOISE_REAL> z;
+        std::vector<NOISE_REAL> values;
+        std::vector<size_t> cells;
+    };
+
+    // Scrambles the bits of a 64-bit value (the finalizer of SplitMix64).
+    inline uint64 MixBits(uint64 value)
+    {
+        value ^= value >> 30;
+        value *= 0xbf58476d1ce4e5b9ULL;
+        value ^= value >> 27;
+        value *= 0x94d049bb133111ebULL;
+        value ^= value >> 31;
+        return value;
+    }
+
+    // Returns the random bits of a cell in a round.
+    inline uint64 HashCell(int seed, uint64 cell, uint32 round)
+    {
+        return MixBits(MixBits(cell + ((uint64)round << 40))
+            ^ ((uint64)(uint32)seed * 0x9e3779b97f4a7c15ULL));
+    }
+
+    // Converts 32 random bits to a value from 0 to 1, excluded.
+    inline NOISE_REAL ToUnit(uint64 bits)
+    {
+        return (NOISE_REAL)(uint32)bits * (1.0 / 4294967296.0);
+    }
+
+    // Returns the first neighbour of a cell whose point is closer to (x, z)
+    // than the larger of its radius and the given radius, or a null pointer.
+    // With a radius of zero, only the radii of the placed points count.
+    const PlacementCell* FindTooClose(const PlacementGrid& grid, size_t index,
+        NOISE_REAL x, NOISE_REAL z, NOISE_REAL radius)
+    {
+        const PlacementCell* pCell = &grid.cells[index];
+        const ptrdiff_t* pOffsets = &grid.neighbourOffsets[0];
+        size_t offsetCount = grid.neighbourOffsets.size();
+        for (size_t i = 0; i < offsetCount; i++)
+        {
+            const PlacementCell& neighbour = pCell[pOffsets[i]];
+            if (neighbour.radius <= 0.0)
+            {
+                continue;
+            }
+            NOISE_REAL dx = neighbour.x - x;
+            NOISE_REAL dz = neighbour.z - z;
+            NOISE_REAL minDistance = GetMax(radius, neighbour.radius);
+            if (dx * dx + dz * dz < minDistance * minDistance)
+            {
+                return &neighbour;
+            }
+        }
+        return NULL;
+    }
+
+    // Determines if the disk of a placed point covers the whole of a cell,
+    // whose lower corner is (x0, z0), so that no point can be placed in the
+    // cell anymore.
+    bool IsCovered(const PlacementGrid& grid, const PlacementCell& point,
+        NOISE_REAL x0, NOISE_REAL z0)
+    {
+        NOISE_REAL dx = GetMax(fabs(point.x - x0),
+            fabs(point.x - x0 - grid.cellWidth));
+        NOISE_REAL dz = GetMax(fabs(point.z - z0),
+            fabs(point.z - z0 - grid.cellHeight));
+        return dx * dx + dz * dz < point.radius * point.radius;
+    }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PoissonDiskPlacer class
+
+PoissonDiskPlacer::PoissonDiskPlacer():
+    m_attemptCount(DEFAULT_PLACEMENT_ATTEMPT_COUNT),
+    m_hasBounds(false),
+    m_lowerXBound(0.0),
+    m_lowerZBound(0.0),
+    m_upperXBound(0.0),
+    m_upperZBound(0.0),
+    m_maxRadius(1.0),
+    m_minRadius(1.0),
+    m_pDensityModule(NULL),
+    m_pRadiusModule(NULL),
+    m_seed(0),
+    m_threadCount(0)
+{
+}
+
+void PoissonDiskPlacer::Place(std::vector<NOISE_REAL>& points) const
+{
+    if (!m_hasBounds)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    points.clear();
+
+    // Size the cells so that their diagonal does not exceed the smallest
+    // radius.
+    NOISE_REAL width = m_upperXBound - m_lowerXBound;
+    NOISE_REAL height = m_upperZBound - m_lowerZBound;
+    NOISE_REAL cellSize = m_minRadius / sqrt(2.0);
+    NOISE_REAL cellCountX = ceil(width / cellSize);
+    NOISE_REAL cellCountZ = ceil(height / cellSize);
+    if (cellCountX * cellCountZ > 1099511627776.0
+        || cellCountX > 2147483647.0 || cellCountZ > 2147483647.0)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    PlacementGrid grid;
+    grid.cellCountX = GetMax((int)cellCountX, 1);
+    grid.cellCountZ = GetMax((int)cellCountZ, 1);
+    grid.cellWidth = width / grid.cellCountX;
+    grid.cellHeight = height / grid.cellCountZ;
+    grid.lowerXBound = m_lowerXBound;
+    grid.lowerZBound = m_lowerZBound;
+    grid.reachX = (int)GetMin(ceil(m_maxRadius / grid.cellWidth),
+        (NOISE_REAL)grid.cellCountX);
+    grid.reachZ = (int)GetMin(ceil(m_maxRadius / grid.cellHeight),
+        (NOISE_REAL)grid.cellCountZ);
+    grid.stride = grid.cellCountX + 2 * grid.reachX;
+
+    // The tiles must be at least as wide as the reach, so that two tiles of
+    // the same phase are too far apart for their points to interact.
+    int tileSize = GetMax(PLACEMENT_TILE_SIZE,
+        GetMax(grid.reachX, grid.reachZ));
+    int tileCountX = (grid.cellCountX + tileSize - 1) / tileSize;
+    int tileCountZ = (grid.cellCountZ + tileSize - 1) / tileSize;
+
+    int threadCount = ResolveThreadCount(m_threadCount);
+    std::vector<PlacementScratch> scratch((size_t)threadCount);
+    std::vector<size_t> rowOffsets;
+    try
+    {
+        PlacementCell emptyCell = {0.0, 0.0, 0.0};
+        grid.cells.assign((size_t)grid.stride
+            * (size_t)(grid.cellCountZ + 2 * grid.reachZ), emptyCell);
+
+        // List the neighbours by their smallest distance, and leave out the
+        // ones farther than the largest radius.  The points of two cells
+        // @a d cells apart are more than @a d - 1 cells apart.
+        std::vector<std::pair<NOISE_REAL, ptrdiff_t> > neighbours;
+        for (int dz = -grid.reachZ; dz <= grid.reachZ; dz++)
+        {
+            for (int dx = -grid.reachX; dx <= grid.reachX; dx++)
+            {
+                NOISE_REAL gapX = GetMax(abs(dx) - 1, 0) * grid.cellWidth;
+                NOISE_REAL gapZ = GetMax(abs(dz) - 1, 0) * grid.cellHeight;
+                NOISE_REAL gap = gapX * gapX + gapZ * gapZ;
+                if ((dx != 0 || dz != 0) && gap < m_maxRadius * m_maxRadius)
+                {
+                    neighbours.push_back(std::make_pair(gap,
+                        (ptrdiff_t)dz * grid.stride + dx));
+                }
+            }
+        }
+        std::sort(neighbours.begin(), neighbours.end());
+        for (size_t i = 0; i < neighbours.size(); i++)
+        {
+            grid.neighbourOffsets.push_back(neighbours[i].second);
+        }
+
+        size_t batchSize = GetMax((size_t)tileSize * (size_t)tileSize,
+            (size_t)grid.cellCountX);
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].x.resize(batchSize);
+            scratch[i].z.resize(batchSize);
+            scratch[i].values.resize(batchSize);
+            scratch[i].cells.resize(batchSize);
+        }
+        rowOffsets.resize((size_t)grid.cellCountZ + 1);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Place the points tile by tile, in four phases: the tiles of a phase
+    // have coordinates of the same parities, and are processed in parallel.
+    // A tile only reads the cells within the reach of its own, which no
+    // other tile of the phase writes.  All rounds of a tile run at once,
+    // while its cells are in the cache.
+    //
+    // Inside a tile, the cells are processed in steps: the cells of a step
+    // have the same remainders modulo the step strides, which exceed the
+    // reach, so the candidates of a step do not interact.  The steps run in
+    // a random order that changes every round, so that no cell is always
+    // filled first.
+    int stepStrideX = grid.reachX + 1;
+    int stepStrideZ = grid.reachZ + 1;
+    int stepCount = stepStrideX * stepStrideZ;
+    std::vector<int> stepOrders;
+    try
+    {
+        stepOrders.resize((size_t)stepCount * (size_t)m_attemptCount);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    for (int round = 0; round < m_attemptCount; round++)
+    {
+        int* pOrder = &stepOrders[(size_t)round * stepCount];
+        for (int i = 0; i < stepCount; i++)
+        {
+            pOrder[i] = i;
+        }
+        uint64 bits = HashCell(m_seed, STEP_ORDER_CELL, (uint32)round);
+        for (int i = stepCount - 1; i > 0; i--)
+        {
+            bits = MixBits(bits + (uint64)i);
+            int j = (int)(bits % (uint64)(i + 1));
+            SwapValues(pOrder[i], pOrder[j]);
+        }
+    }
+
+    const module::Module* pRadiusModule = m_pRadiusModule;
+    NOISE_REAL minRadius = m_minRadius;
+    NOISE_REAL maxRadius = m_maxRadius;
+    int attemptCount = m_attemptCount;
+    int seed = m_seed;
+    for (int phase = 0; phase < 4; phase++)
+    {
+        int phaseX = phase & 1;
+        int phaseZ = phase >> 1;
+        int phaseTileCountX = (tileCountX - phaseX + 1) / 2;
+        int phaseTileCountZ = (tileCountZ - phaseZ + 1) / 2;
+        if (phaseTileCountX <= 0 || phaseTileCountZ <= 0)
+        {
+            continue;
+        }
+
+        ParallelFor(phaseTileCountX * phaseTileCountZ, threadCount,
+            [&](int tile, int worker)
+            {
+                PlacementScratch& s = scratch[worker];
+                int cellX0 = (phaseX + 2 * (tile % phaseTileCountX)) * tileSize;
+                int cellZ0 = (phaseZ + 2 * (tile / phaseTileCountX)) * tileSize;
+                int cellX1 = GetMin(cellX0 + tileSize, grid.cellCountX);
+                int cellZ1 = GetMin(cellZ0 + tileSize, grid.cellCountZ);
+
+                for (int i = 0; i < attemptCount * stepCount; i++)
+                {
+                    int round = i / stepCount;
+                    int step = stepOrders[i];
+                    int stepX = step % stepStrideX;
+                    int stepZ = step / stepStrideX;
+
+                    // Draw a candidate in every empty cell of the step, and
+                    // keep the ones far enough from the placed points.  A cell
+                    // covered by the disk of a point is retired.
+                    int candidateCount = 0;
+                    int firstX = cellX0 + (stepX - cellX0 % stepStrideX
+                        + stepStrideX) % stepStrideX;
+                    int firstZ = cellZ0 + (stepZ - cellZ0 % stepStrideZ
+                        + stepStrideZ) % stepStrideZ;
+                    for (int cellZ = firstZ; cellZ < cellZ1;
+                        cellZ += stepStrideZ)
+                    {
+                        NOISE_REAL z0 = grid.lowerZBound
+                            + cellZ * grid.cellHeight;
+                        size_t rowIndex = grid.GetIndex(0, cellZ);
+                        for (int cellX = firstX; cellX < cellX1;
+                            cellX += stepStrideX)
+                        {
+                            size_t index = rowIndex + (size_t)cellX;
+                            PlacementCell& cell = grid.cells[index];
+                            if (cell.radius != 0.0)
+                            {
+                                continue;
+                            }
+                            uint64 bits = HashCell(seed, (uint64)cellZ
+                                * (uint64)grid.cellCountX + (uint64)cellX,
+                                (uint32)round);
+                            NOISE_REAL x0 = grid.lowerXBound
+                                + cellX * grid.cellWidth;
+                            NOISE_REAL x = x0 + ToUnit(bits) * grid.cellWidth;
+                            NOISE_REAL z = z0 + ToUnit(bits >> 32)
+                                * grid.cellHeight;
+                            const PlacementCell* pNeighbour = FindTooClose(
+                                grid, index, x, z, 0.0);
+                            if (pNeighbour != NULL)
+                            {
+                                if (IsCovered(grid, *pNeighbour, x0, z0))
+                                {
+                                    cell.radius = -1.0;
+                                }
+                                continue;
+                            }
+                            if (pRadiusModule == NULL)
+                            {
+                                cell.x = x;
+                                cell.z = z;
+                                cell.radius = minRadius;
+                                continue;
+                            }
+                            s.x[candidateCount] = x;
+                            s.z[candidateCount] = z;
+                            s.cells[candidateCount] = index;
+                            candidateCount++;
+                        }
+                    }
+
+                    // Check the remaining candidates against their own radius.
+                    if (candidateCount > 0)
+                    {
+                        pRadiusModule->GetValues(&s.x[0], &s.z[0],
+                            &s.values[0], candidateCount);
+                    }
+                    for (int j = 0; j < candidateCount; j++)
+                    {
+                        NOISE_REAL radius = s.values[j];
+                        radius = radius > minRadius
+                            ? GetMin(radius, maxRadius) : minRadius;
+                        size_t index = s.cells[j];
+                        if (FindTooClose(grid, index, s.x[j], s.z[j], radius)
+                            != NULL)
+                        {
+                            continue;
+                        }
+                        PlacementCell& cell = grid.cells[index];
+                        cell.x = s.x[j];
+                        cell.z = s.z[j];
+                        cell.radius = radius;
+                    }
+                }
+            });
+    }
+
+    // Thin the points by the density, and count the remaining points of each
+    // row.
+    const module::Module* pDensityModule = m_pDensityModule;
+    ParallelFor(grid.cellCountZ, threadCount,
+        [&](int cellZ, int worker)
+        {
+            PlacementScratch& s = scratch[worker];
+            size_t rowIndex = grid.GetIndex(0, cellZ);
+            int pointCount = 0;
+            for (int cellX = 0; cellX < grid.cellCountX; cellX++)
+            {
+                const PlacementCell& cell = grid.cells[rowIndex + cellX];
+                if (cell.radius > 0.0)
+                {
+                    s.x[pointCount] = cell.x;
+                    s.z[pointCount] = cell.z;
+                    s.cells[pointCount] = (size_t)cellX;
+                    pointCount++;
+                }
+            }
+            if (pDensityModule != NULL && pointCount > 0)
+            {
+                pDensityModule->GetValues(&s.x[0], &s.z[0], &s.values[0],
+                    pointCount);
+                int keptCount = 0;
+                for (int j = 0; j < pointCount; j++)
+                {
+                    size_t cellX = s.cells[j];
+                    NOISE_REAL threshold = ToUnit(HashCell(seed, (uint64)cellZ
+                        * (uint64)grid.cellCountX + cellX, THINNING_ROUND));
+                    if (threshold < s.values[j])
+                    {
+                        keptCount++;
+                    }
+                    else
+                    {
+                        grid.cells[rowIndex + cellX].radius = 0.0;
+                    }
+                }
+                pointCount = keptCount;
+            }
+            rowOffsets[cellZ + 1] = (size_t)pointCount;
+        });
+
+    rowOffsets[0] = 0;
+    for (int cellZ = 0; cellZ < grid.cellCountZ; cellZ++)
+    {
+        rowOffsets[cellZ + 1] += rowOffsets[cellZ];
+    }
+    try
+    {
+        points.resize(2 * rowOffsets[grid.cellCountZ]);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    if (points.empty())
+    {
+        return;
+    }
+
+    NOISE_REAL* pPoints = &points[0];
+    ParallelFor(grid.cellCountZ, threadCount,
+        [&](int cellZ, int)
+        {
+            const PlacementCell* pCells = &grid.cells[grid.GetIndex(0, cellZ)];
+            NOISE_REAL* pDest = pPoints + 2 * rowOffsets[cellZ];
+            for (int cellX = 0; cellX < grid.cellCountX; cellX++)
+            {
+                if (pCells[cellX].radius > 0.0)
+                {
+                    *pDest++ = pCells[cellX].x;
+                    *pDest++ = pCells[cellX].z;
+                }
+            }
+        });
+}
+
+void PoissonDiskPlacer::SetBounds(NOISE_REAL lowerXBound,
+    NOISE_REAL upperXBound, NOISE_REAL lowerZBound, NOISE_REAL upperZBound)
+{
+    if (!(lowerXBound < upperXBound) || !(lowerZBound < upperZBound))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_lowerXBound = lowerXBound;
+    m_upperXBound = upperXBound;
+    m_lowerZBound = lowerZBound;
+    m_upperZBound = upperZBound;
+    m_hasBounds = true;
+}
+
+void PoissonDiskPlacer::SetRadius(NOISE_REAL radius)
+{
+    if (!(radius > 0.0))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_minRadius = radius;
+    m_maxRadius = radius;
+    m_pRadiusModule = NULL;
+}
+
+void PoissonDiskPlacer::SetRadiusModule(
+    const noise::module::Module& radiusModule, NOISE_REAL minRadius,
+    NOISE_REAL maxRadius)
+{
+    if (!(minRadius > 0.0) || !(minRadius <= maxRadius))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_minRadius = minRadius;
+    m_maxRadius = maxRadius;
+    m_pRadiusModule = &radiusModule;
+}
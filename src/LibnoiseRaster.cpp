@@ -0,0 +1,635 @@
+// LibnoiseRaster.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <map>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#include <interp.h>
+
+#include "LibnoiseRaster.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // Operations of the nodes.
+    enum RasterOp
+    {
+        RASTER_OP_CONST,
+        RASTER_OP_LAYER,
+        RASTER_OP_ABS,
+        RASTER_OP_CLAMP,
+        RASTER_OP_REMAP,
+        RASTER_OP_SCALE_BIAS,
+        RASTER_OP_ADD,
+        RASTER_OP_SUBTRACT,
+        RASTER_OP_MULTIPLY,
+        RASTER_OP_MIN,
+        RASTER_OP_MAX,
+        RASTER_OP_LERP,
+        RASTER_OP_SELECT
+    };
+
+}
+
+struct RasterExpression::Node
+{
+    // The operation.
+    RasterOp op;
+
+    // The constant value, the clamping bounds, the scale and the bias, or
+    // the selection threshold.
+    float params[2];
+
+    // The noise map of a layer.
+    const NoiseMap* pLayer;
+
+    // The control points of a remapping.
+    std::vector<noise::module::ControlPoint> controlPoints;
+
+    // The operands.
+    int argCount;
+    std::shared_ptr<const Node> pArgs[3];
+};
+
+namespace
+{
+
+    typedef RasterExpression::Node RasterNode;
+
+    // Kinds of operands of an instruction.
+    enum OperandKind
+    {
+        OPERAND_LAYER,
+        OPERAND_CONST,
+        OPERAND_TEMP
+    };
+
+    // An operand: a noise map, a constant or a block of intermediate
+    // results.
+    struct RasterOperand
+    {
+        OperandKind kind;
+        int index;
+    };
+
+    // An operation of a compiled expression.  A negative destination is the
+    // destination noise map.
+    struct RasterInstruction
+    {
+        const RasterNode* pNode;
+        RasterOperand args[3];
+        int dest;
+    };
+
+    // A compiled expression.
+    struct RasterProgram
+    {
+        std::vector<const NoiseMap*> layers;
+        std::vector<float> constants;
+        std::vector<RasterInstruction> instructions;
+        int tempCount;
+        RasterOperand result;
+    };
+
+    // Maps a value through the control points of a curve, as
+    // noise::module::Curve does.
+    float RemapValue(const std::vector<noise::module::ControlPoint>& points,
+        float value)
+    {
+        int count = (int)points.size();
+        int indexPos;
+        for (indexPos = 0; indexPos < count; indexPos++)
+        {
+            if (value < points[indexPos].inputValue)
+            {
+                break;
+            }
+        }
+
+        int index0 = ClampValue(indexPos - 2, 0, count - 1);
+        int index1 = ClampValue(indexPos - 1, 0, count - 1);
+        int index2 = ClampValue(indexPos    , 0, count - 1);
+        int index3 = ClampValue(indexPos + 1, 0, count - 1);
+        if (index1 == index2)
+        {
+            return (float)points[index1].outputValue;
+        }
+
+        NOISE_REAL input0 = points[index1].inputValue;
+        NOISE_REAL input1 = points[index2].inputValue;
+        NOISE_REAL alpha = (value - input0) / (input1 - input0);
+        return (float)CubicInterp(points[index0].outputValue,
+            points[index1].outputValue, points[index2].outputValue,
+            points[index3].outputValue, alpha);
+    }
+
+    // Runs the operation of a node over a block of points.  The output may
+    // be one of the operands: every loop reads a point before it writes it.
+    // The loops are kept simple so that the compiler vectorizes them.
+    void RunNode(const RasterNode& node, const float* pA, const float* pB,
+        const float* pC, float* pOut, int count)
+    {
+        switch (node.op)
+        {
+            case RASTER_OP_ABS:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = fabsf(pA[i]);
+                }
+                break;
+            case RASTER_OP_CLAMP:
+            {
+                float lowerBound = node.params[0];
+                float upperBound = node.params[1];
+                for (int i = 0; i < count; i++)
+                {
+                    float value = pA[i] < upperBound ? pA[i] : upperBound;
+                    pOut[i] = value > lowerBound ? value : lowerBound;
+                }
+                break;
+            }
+            case RASTER_OP_REMAP:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = RemapValue(node.controlPoints, pA[i]);
+                }
+                break;
+            case RASTER_OP_SCALE_BIAS:
+            {
+                float scale = node.params[0];
+                float bias = node.params[1];
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] * scale + bias;
+                }
+                break;
+            }
+            case RASTER_OP_ADD:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] + pB[i];
+                }
+                break;
+            case RASTER_OP_SUBTRACT:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] - pB[i];
+                }
+                break;
+            case RASTER_OP_MULTIPLY:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] * pB[i];
+                }
+                break;
+            case RASTER_OP_MIN:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] < pB[i] ? pA[i] : pB[i];
+                }
+                break;
+            case RASTER_OP_MAX:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] > pB[i] ? pA[i] : pB[i];
+                }
+                break;
+            case RASTER_OP_LERP:
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pA[i] + (pB[i] - pA[i]) * pC[i];
+                }
+                break;
+            case RASTER_OP_SELECT:
+            {
+                float threshold = node.params[0];
+                for (int i = 0; i < count; i++)
+                {
+                    pOut[i] = pC[i] >= threshold ? pB[i] : pA[i];
+                }
+                break;
+            }
+            default:
+                throw noise::ExceptionUnknown();
+        }
+    }
+
+    // Counts, for every node of the expression, the operations that use it.
+    void CountUses(const RasterNode* pNode,
+        std::map<const RasterNode*, int>& useCounts)
+    {
+        for (int i = 0; i < pNode->argCount; i++)
+        {
+            const RasterNode* pArg = pNode->pArgs[i].get();
+            if (useCounts[pArg]++ == 0)
+            {
+                CountUses(pArg, useCounts);
+            }
+        }
+    }
+
+    // Compiles the instructions that compute a node and the nodes it uses,
+    // and returns the operand that holds its value.  A block of
+    // intermediate results is freed after its last use, so the number of
+    // blocks is the largest number of values alive at once.
+    class RasterCompiler
+    {
+
+        public:
+
+            RasterCompiler(RasterProgram& program,
+                std::map<const RasterNode*, int>& useCounts):
+                m_program(program),
+                m_useCounts(useCounts)
+            {
+                m_program.tempCount = 0;
+            }
+
+            RasterOperand Compile(const RasterNode* pNode)
+            {
+                std::map<const RasterNode*, RasterOperand>::const_iterator it
+                    = m_operands.find(pNode);
+                if (it != m_operands.end())
+                {
+                    return it->second;
+                }
+
+                RasterOperand operand;
+                if (pNode->op == RASTER_OP_CONST)
+                {
+                    operand = AddConstant(pNode->params[0]);
+                }
+                else if (pNode->op == RASTER_OP_LAYER)
+                {
+                    operand.kind = OPERAND_LAYER;
+                    operand.index = 0;
+                    while (operand.index < (int)m_program.layers.size()
+                        && m_program.layers[operand.index] != pNode->pLayer)
+                    {
+                        operand.index++;
+                    }
+                    if (operand.index == (int)m_program.layers.size())
+                    {
+                        m_program.layers.push_back(pNode->pLayer);
+                    }
+                }
+                else
+                {
+                    RasterInstruction instruction = RasterInstruction();
+                    instruction.pNode = pNode;
+                    bool isConstant = true;
+                    for (int i = 0; i < pNode->argCount; i++)
+                    {
+                        instruction.args[i] = Compile(pNode->pArgs[i].get());
+                        isConstant = isConstant
+                            && instruction.args[i].kind == OPERAND_CONST;
+                    }
+                    for (int i = pNode->argCount; i < 3; i++)
+                    {
+                        instruction.args[i] = instruction.args[0];
+                    }
+
+                    if (isConstant)
+                    {
+                        // Fold the operation.
+                        float value;
+                        RunNode(*pNode,
+                            &m_program.constants[instruction.args[0].index],
+                            &m_program.constants[instruction.args[1].index],
+                            &m_program.constants[instruction.args[2].index],
+                            &value, 1);
+                        operand = AddConstant(value);
+                    }
+                    else
+                    {
+                        // The blocks of the operands used for the last time
+                        // can receive the result.
+                        for (int i = 0; i < pNode->argCount; i++)
+                        {
+                            const RasterNode* pArg = pNode->pArgs[i].get();
+                            if (--m_useCounts[pArg] == 0
+                                && m_operands[pArg].kind == OPERAND_TEMP)
+                            {
+                                m_freeTemps.push_back(m_operands[pArg].index);
+                            }
+                        }
+                        operand.kind = OPERAND_TEMP;
+                        if (m_freeTemps.empty())
+                        {
+                            operand.index = m_program.tempCount++;
+                        }
+                        else
+                        {
+                            operand.index = m_freeTemps.back();
+                            m_freeTemps.pop_back();
+                        }
+                        instruction.dest = operand.index;
+                        m_program.instructions.push_back(instruction);
+                    }
+                }
+
+                m_operands[pNode] = operand;
+                return operand;
+            }
+
+        private:
+
+            RasterOperand AddConstant(float value)
+            {
+                RasterOperand operand;
+                operand.kind = OPERAND_CONST;
+                operand.index = (int)m_program.constants.size();
+                m_program.constants.push_back(value);
+                return operand;
+            }
+
+            std::vector<int> m_freeTemps;
+            std::map<const RasterNode*, RasterOperand> m_operands;
+            RasterProgram& m_program;
+            std::map<const RasterNode*, int>& m_useCounts;
+
+    };
+
+    // Creates the node of an operation.
+    std::shared_ptr<RasterNode> MakeNode(RasterOp op,
+        const std::shared_ptr<const RasterNode>& pArg0,
+        const std::shared_ptr<const RasterNode>& pArg1
+            = std::shared_ptr<const RasterNode>(),
+        const std::shared_ptr<const RasterNode>& pArg2
+            = std::shared_ptr<const RasterNode>())
+    {
+        std::shared_ptr<RasterNode> pNode(new RasterNode);
+        pNode->op = op;
+        pNode->params[0] = 0.0f;
+        pNode->params[1] = 0.0f;
+        pNode->pLayer = NULL;
+        pNode->pArgs[0] = pArg0;
+        pNode->pArgs[1] = pArg1;
+        pNode->pArgs[2] = pArg2;
+        pNode->argCount = (pArg2 != NULL) ? 3 : (pArg1 != NULL) ? 2 : 1;
+        return pNode;
+    }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// RasterExpression class
+
+RasterExpression::RasterExpression(float value)
+{
+    std::shared_ptr<Node> pNode(new Node);
+    pNode->op = RASTER_OP_CONST;
+    pNode->params[0] = value;
+    pNode->params[1] = 0.0f;
+    pNode->pLayer = NULL;
+    pNode->argCount = 0;
+    m_pNode = pNode;
+}
+
+RasterExpression::RasterExpression(const NoiseMap& layer)
+{
+    std::shared_ptr<Node> pNode(new Node);
+    pNode->op = RASTER_OP_LAYER;
+    pNode->params[0] = 0.0f;
+    pNode->params[1] = 0.0f;
+    pNode->pLayer = &layer;
+    pNode->argCount = 0;
+    m_pNode = pNode;
+}
+
+RasterExpression::RasterExpression(const std::shared_ptr<const Node>& pNode):
+    m_pNode(pNode)
+{
+}
+
+RasterExpression RasterExpression::Abs() const
+{
+    return RasterExpression(MakeNode(RASTER_OP_ABS, m_pNode));
+}
+
+RasterExpression RasterExpression::Clamp(float lowerBound,
+    float upperBound) const
+{
+    if (lowerBound > upperBound)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    std::shared_ptr<Node> pNode = MakeNode(RASTER_OP_CLAMP, m_pNode);
+    pNode->params[0] = lowerBound;
+    pNode->params[1] = upperBound;
+    return RasterExpression(pNode);
+}
+
+void RasterExpression::Evaluate(NoiseMap& destNoiseMap, int threadCount) const
+{
+    if (threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // Compile the expression.
+    RasterProgram program;
+    std::map<const Node*, int> useCounts;
+    CountUses(m_pNode.get(), useCounts);
+    RasterCompiler compiler(program, useCounts);
+    program.result = compiler.Compile(m_pNode.get());
+
+    int width = destNoiseMap.GetWidth();
+    int height = destNoiseMap.GetHeight();
+    if (!program.layers.empty())
+    {
+        width = program.layers[0]->GetWidth();
+        height = program.layers[0]->GetHeight();
+        for (size_t i = 1; i < program.layers.size(); i++)
+        {
+            if (program.layers[i]->GetWidth() != width
+                || program.layers[i]->GetHeight() != height)
+            {
+                throw noise::ExceptionInvalidParam();
+            }
+        }
+    }
+    if (width <= 0 || height <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    destNoiseMap.SetSize(width, height);
+
+    // The result is written by the last instruction, straight into the
+    // destination noise map.
+    if (program.result.kind == OPERAND_TEMP)
+    {
+        program.instructions.back().dest = -1;
+    }
+
+    // Each worker keeps a block for every constant and every intermediate
+    // result.
+    threadCount = ResolveThreadCount(threadCount);
+    size_t constantCount = program.constants.size();
+    size_t blockCount = constantCount + (size_t)program.tempCount;
+    std::vector<std::vector<float> > blocks((size_t)threadCount);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            blocks[i].resize(blockCount * RASTER_ALGEBRA_BLOCK_WIDTH);
+            for (size_t j = 0; j < constantCount; j++)
+            {
+                float* pBlock = &blocks[i][j * RASTER_ALGEBRA_BLOCK_WIDTH];
+                for (int k = 0; k < RASTER_ALGEBRA_BLOCK_WIDTH; k++)
+                {
+                    pBlock[k] = program.constants[j];
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    ParallelFor(height, threadCount,
+        [&](int z, int worker)
+        {
+            float* pBlocks = blocks[worker].empty() ? NULL : &blocks[worker][0];
+            float* pTemps = pBlocks + constantCount * RASTER_ALGEBRA_BLOCK_WIDTH;
+            for (int x0 = 0; x0 < width; x0 += RASTER_ALGEBRA_BLOCK_WIDTH)
+            {
+                int count = GetMin(RASTER_ALGEBRA_BLOCK_WIDTH, width - x0);
+                float* pDest = destNoiseMap.GetSlabPtr(x0, z);
+
+                // Operands are read in place: the rows of the noise maps, the
+                // constant blocks and the blocks of intermediate results.
+                auto fGetOperand = [&](const RasterOperand& operand)
+                {
+                    switch (operand.kind)
+                    {
+                        case OPERAND_LAYER:
+                            return program.layers[operand.index]
+                                ->GetConstSlabPtr(x0, z);
+                        case OPERAND_CONST:
+                            return (const float*)pBlocks + (size_t)operand.index
+                                * RASTER_ALGEBRA_BLOCK_WIDTH;
+                        default:
+                            return (const float*)pTemps + (size_t)operand.index
+                                * RASTER_ALGEBRA_BLOCK_WIDTH;
+                    }
+                };
+
+                if (program.instructions.empty())
+                {
+                    const float* pResult = fGetOperand(program.result);
+                    if (pResult != pDest)
+                    {
+                        memcpy(pDest, pResult, (size_t)count * sizeof(float));
+                    }
+                    continue;
+                }
+
+                for (size_t i = 0; i < program.instructions.size(); i++)
+                {
+                    const RasterInstruction& instruction
+                        = program.instructions[i];
+                    float* pOut = (instruction.dest < 0) ? pDest : pTemps
+                        + (size_t)instruction.dest * RASTER_ALGEBRA_BLOCK_WIDTH;
+                    RunNode(*instruction.pNode,
+                        fGetOperand(instruction.args[0]),
+                        fGetOperand(instruction.args[1]),
+                        fGetOperand(instruction.args[2]),
+                        pOut, count);
+                }
+            }
+        });
+}
+
+RasterExpression RasterExpression::Lerp(const RasterExpression& other,
+    const RasterExpression& mask) const
+{
+    return RasterExpression(MakeNode(RASTER_OP_LERP, m_pNode, other.m_pNode,
+        mask.m_pNode));
+}
+
+RasterExpression RasterExpression::Max(const RasterExpression& other) const
+{
+    return RasterExpression(MakeNode(RASTER_OP_MAX, m_pNode, other.m_pNode));
+}
+
+RasterExpression RasterExpression::Min(const RasterExpression& other) const
+{
+    return RasterExpression(MakeNode(RASTER_OP_MIN, m_pNode, other.m_pNode));
+}
+
+RasterExpression RasterExpression::Remap(
+    const noise::module::Curve& curve) const
+{
+    int count = curve.GetControlPointCount();
+    if (count < 4)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    std::shared_ptr<Node> pNode = MakeNode(RASTER_OP_REMAP, m_pNode);
+    const noise::module::ControlPoint* pPoints = curve.GetControlPointArray();
+    pNode->controlPoints.assign(pPoints,
+        pPoints + count);
+    return RasterExpression(pNode);
+}
+
+RasterExpression RasterExpression::ScaleBias(float scale, float bias) const
+{
+    std::shared_ptr<Node> pNode = MakeNode(RASTER_OP_SCALE_BIAS,
+        m_pNode);
+    pNode->params[0] = scale;
+    pNode->params[1] = bias;
+    return RasterExpression(pNode);
+}
+
+RasterExpression RasterExpression::Select(const RasterExpression& other,
+    const RasterExpression& mask, float threshold) const
+{
+    std::shared_ptr<Node> pNode = MakeNode(RASTER_OP_SELECT, m_pNode,
+        other.m_pNode, mask.m_pNode);
+    pNode->params[0] = threshold;
+    return RasterExpression(pNode);
+}
+
+RasterExpression noise::utils::operator+ (const RasterExpression& lhs,
+    const RasterExpression& rhs)
+{
+    return RasterExpression(MakeNode(RASTER_OP_ADD, lhs.m_pNode,
+        rhs.m_pNode));
+}
+
+RasterExpression noise::utils::operator- (const RasterExpression& lhs,
+    const RasterExpression& rhs)
+{
+    return RasterExpression(MakeNode(RASTER_OP_SUBTRACT, lhs.m_pNode,
+        rhs.m_pNode));
+}
+
+RasterExpression noise::utils::operator* (const RasterExpression& lhs,
+    const RasterExpression& rhs)
+{
+    return RasterExpression(MakeNode(RASTER_OP_MULTIPLY, lhs.m_pNode,
+        rhs.m_pNode));
+}
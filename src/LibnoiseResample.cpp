@@ -0,0 +1,566 @@
+// LibnoiseResample.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <math.h>
+#include <vector>
+
+#include <mathconsts.h>
+
+#include "LibnoiseResample.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // The directions of the cube faces: the center of the face, then the
+    // directions of its columns and rows, as in OpenGL cube maps with the
+    // rows counted from the bottom.
+    const double CUBE_FACE_AXES[6][3][3] =
+    {
+        {{ 1.0,  0.0,  0.0}, { 0.0,  0.0, -1.0}, { 0.0,  1.0,  0.0}},
+        {{-1.0,  0.0,  0.0}, { 0.0,  0.0,  1.0}, { 0.0,  1.0,  0.0}},
+        {{ 0.0,  1.0,  0.0}, { 1.0,  0.0,  0.0}, { 0.0,  0.0, -1.0}},
+        {{ 0.0, -1.0,  0.0}, { 1.0,  0.0,  0.0}, { 0.0,  0.0,  1.0}},
+        {{ 0.0,  0.0,  1.0}, { 1.0,  0.0,  0.0}, { 0.0,  1.0,  0.0}},
+        {{ 0.0,  0.0, -1.0}, {-1.0,  0.0,  0.0}, { 0.0,  1.0,  0.0}}
+    };
+
+    // Returns the radius of a filter, in source points.
+    double GetFilterRadius(ResampleFilter filter)
+    {
+        switch (filter)
+        {
+            case RESAMPLE_FILTER_BICUBIC:
+                return 2.0;
+            case RESAMPLE_FILTER_LANCZOS:
+                return 3.0;
+            default:
+                return 1.0;
+        }
+    }
+
+    // Returns the weight of a filter at a distance, in source points.
+    double GetFilterWeight(ResampleFilter filter, double distance)
+    {
+        double t = fabs(distance);
+        switch (filter)
+        {
+            case RESAMPLE_FILTER_BICUBIC:
+                // Keys cubic convolution with a = -0.5 (Catmull-Rom).
+                if (t < 1.0)
+                {
+                    return (1.5 * t - 2.5) * t * t + 1.0;
+                }
+                else if (t < 2.0)
+                {
+                    return ((-0.5 * t + 2.5) * t - 4.0) * t + 2.0;
+                }
+                return 0.0;
+            case RESAMPLE_FILTER_LANCZOS:
+                if (t < 1.0e-8)
+                {
+                    return 1.0;
+                }
+                else if (t < 3.0)
+                {
+                    double a = PI * t;
+                    return 3.0 * sin(a) * sin(a / 3.0) / (a * a);
+                }
+                return 0.0;
+            default:
+                return (t < 1.0) ? 1.0 - t : 0.0;
+        }
+    }
+
+    // Returns the number of source points weighed along an axis.
+    int GetTapCount(ResampleFilter filter, double scale)
+    {
+        return 2 * (int)ceil(GetFilterRadius(filter) * scale - 1.0e-9);
+    }
+
+    // Splits a source coordinate into its integer part and its phase.
+    void SplitPosition(double position, int& integer, int& phase)
+    {
+        double floorPosition = floor(position);
+        integer = (int)floorPosition;
+        phase = (int)((position - floorPosition) * RESAMPLE_PHASE_COUNT
+            + 0.5);
+        if (phase == RESAMPLE_PHASE_COUNT)
+        {
+            integer++;
+            phase = 0;
+        }
+    }
+
+    // Fills the weights of the taps along an axis, for every phase.  The
+    // weights of each phase sum to one.
+    void FillWeights(ResampleFilter filter, double scale, int tapCount,
+        std::vector<float>& weights)
+    {
+        weights.resize((size_t)RESAMPLE_PHASE_COUNT * (size_t)tapCount);
+        std::vector<double> phaseWeights((size_t)tapCount);
+        for (int phase = 0; phase < RESAMPLE_PHASE_COUNT; phase++)
+        {
+            double fraction = (double)phase / RESAMPLE_PHASE_COUNT;
+            double sum = 0.0;
+            for (int i = 0; i < tapCount; i++)
+            {
+                double distance = fraction + (tapCount / 2 - 1) - i;
+                phaseWeights[i] = GetFilterWeight(filter, distance / scale);
+                sum += phaseWeights[i];
+            }
+            float* pWeights = &weights[(size_t)phase * (size_t)tapCount];
+            for (int i = 0; i < tapCount; i++)
+            {
+                pWeights[i] = (float)(phaseWeights[i] / sum);
+            }
+        }
+    }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// RasterResampler class
+
+RasterResampler::RasterResampler():
+    m_destHeight(0),
+    m_destWidth(0),
+    m_edgeModeX(EDGE_CLAMP),
+    m_edgeModeY(EDGE_CLAMP),
+    m_filter(RESAMPLE_FILTER_BILINEAR),
+    m_mappingKind(MAPPING_NONE),
+    m_scaleX(1.0),
+    m_scaleY(1.0),
+    m_sourceHeight(0),
+    m_sourceWidth(0),
+    m_tapCountX(0),
+    m_tapCountY(0),
+    m_threadCount(0)
+{
+}
+
+void RasterResampler::BuildTable(int sourceWidth, int sourceHeight,
+    int destWidth, int destHeight, double scaleX, double scaleY,
+    const std::function<void(int, int, double&, double&)>& fGetPosition)
+{
+    if (sourceWidth <= 0 || sourceHeight <= 0 || destWidth <= 0
+        || destHeight <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_mappingKind = MAPPING_NONE;
+    try
+    {
+        m_positions.resize((size_t)destWidth * (size_t)destHeight);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    ParallelFor(destHeight, m_threadCount,
+        [&](int y, int)
+        {
+            SourcePosition* pRow = &m_positions[(size_t)y * (size_t)destWidth];
+            for (int x = 0; x < destWidth; x++)
+            {
+                double sourceX;
+                double sourceY;
+                fGetPosition(x, y, sourceX, sourceY);
+                SplitPosition(sourceX, pRow[x].x, pRow[x].phaseX);
+                SplitPosition(sourceY, pRow[x].y, pRow[x].phaseY);
+            }
+        });
+
+    m_sourceWidth = sourceWidth;
+    m_sourceHeight = sourceHeight;
+    m_destWidth = destWidth;
+    m_destHeight = destHeight;
+    m_scaleX = GetMax(scaleX, 1.0);
+    m_scaleY = GetMax(scaleY, 1.0);
+    m_mappingKind = MAPPING_TABLE;
+    BuildWeights();
+}
+
+void RasterResampler::BuildWeights()
+{
+    double scaleX = m_scaleX;
+    double scaleY = m_scaleY;
+    if (m_mappingKind == MAPPING_TABLE)
+    {
+        // Every destination point weighs its own square of source points, so
+        // the width of the filter is bounded.
+        double maxScale = RESAMPLE_MAX_TAP_COUNT
+            / (2.0 * GetFilterRadius(m_filter));
+        scaleX = GetMin(scaleX, maxScale);
+        scaleY = GetMin(scaleY, maxScale);
+    }
+
+    m_tapCountX = GetTapCount(m_filter, scaleX);
+    m_tapCountY = GetTapCount(m_filter, scaleY);
+    try
+    {
+        FillWeights(m_filter, scaleX, m_tapCountX, m_weightsX);
+        FillWeights(m_filter, scaleY, m_tapCountY, m_weightsY);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+}
+
+void RasterResampler::Resample(const NoiseMap& sourceNoiseMap,
+    NoiseMap& destNoiseMap) const
+{
+    if (m_mappingKind == MAPPING_NONE || &sourceNoiseMap == &destNoiseMap
+        || sourceNoiseMap.GetWidth() != m_sourceWidth
+        || sourceNoiseMap.GetHeight() != m_sourceHeight)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    destNoiseMap.SetSize(m_destWidth, m_destHeight);
+    int sourceWidth = m_sourceWidth;
+    int sourceHeight = m_sourceHeight;
+    int destWidth = m_destWidth;
+    int tapCountX = m_tapCountX;
+    int tapCountY = m_tapCountY;
+    const float* pWeightsX = &m_weightsX[0];
+    const float* pWeightsY = &m_weightsY[0];
+
+    if (m_mappingKind == MAPPING_RESIZE)
+    {
+        // Row pass: filter every source row to the destination width.
+        MemoryReservation reservation(MEMORY_SCRATCH,
+            (size_t)destWidth * (size_t)sourceHeight * sizeof(float));
+        std::vector<float> rows;
+        try
+        {
+            rows.resize((size_t)destWidth * (size_t)sourceHeight);
+        }
+        catch (...)
+        {
+            throw noise::ExceptionOutOfMemory();
+        }
+        ParallelFor(sourceHeight, m_threadCount,
+            [&](int y, int)
+            {
+                const float* pSource = sourceNoiseMap.GetConstSlabPtr(y);
+                float* pRow = &rows[(size_t)y * (size_t)destWidth];
+                for (int x = 0; x < destWidth; x++)
+                {
+                    const SourcePosition& position = m_resizeColumns[x];
+                    const float* pWeights = pWeightsX
+                        + (size_t)position.phaseX * (size_t)tapCountX;
+                    int first = position.x - tapCountX / 2 + 1;
+                    float value = 0.0f;
+                    if (first >= 0 && first + tapCountX <= sourceWidth)
+                    {
+                        const float* pTaps = pSource + first;
+                        for (int i = 0; i < tapCountX; i++)
+                        {
+                            value += pWeights[i] * pTaps[i];
+                        }
+                    }
+                    else
+                    {
+                        for (int i = 0; i < tapCountX; i++)
+                        {
+                            int tapX = ClampValue(first + i, 0,
+                                sourceWidth - 1);
+                            value += pWeights[i] * pSource[tapX];
+                        }
+                    }
+                    pRow[x] = value;
+                }
+            });
+
+        // Column pass: blend the filtered rows.  Each step is a
+        // multiply-add over a whole row.
+        ParallelFor(m_destHeight, m_threadCount,
+            [&](int y, int)
+            {
+                const SourcePosition& position = m_resizeRows[y];
+                const float* pWeights = pWeightsY
+                    + (size_t)position.phaseY * (size_t)tapCountY;
+                int first = position.y - tapCountY / 2 + 1;
+                float* pDest = destNoiseMap.GetSlabPtr(y);
+                for (int x = 0; x < destWidth; x++)
+                {
+                    pDest[x] = 0.0f;
+                }
+                for (int i = 0; i < tapCountY; i++)
+                {
+                    int tapY = ClampValue(first + i, 0, sourceHeight - 1);
+                    const float* pRow = &rows[(size_t)tapY * (size_t)destWidth];
+                    float weight = pWeights[i];
+                    for (int x = 0; x < destWidth; x++)
+                    {
+                        pDest[x] += weight * pRow[x];
+                    }
+                }
+            });
+        return;
+    }
+
+    // Returns the coordinate of a source point past an edge, or -1 if it
+    // takes the border value.
+    auto fResolveEdge = [](int coord, int size, EdgeMode edgeMode)
+    {
+        if (coord >= 0 && coord < size)
+        {
+            return coord;
+        }
+        switch (edgeMode)
+        {
+            case EDGE_CLAMP:
+                return (coord < 0) ? 0 : size - 1;
+            case EDGE_WRAP:
+                coord %= size;
+                return (coord < 0) ? coord + size : coord;
+            default:
+                return -1;
+        }
+    };
+
+    EdgeMode edgeModeX = m_edgeModeX;
+    EdgeMode edgeModeY = m_edgeModeY;
+    float borderValue = sourceNoiseMap.GetBorderValue();
+    ParallelFor(m_destHeight, m_threadCount,
+        [&](int y, int)
+        {
+            const SourcePosition* pPositions
+                = &m_positions[(size_t)y * (size_t)destWidth];
+            float* pDest = destNoiseMap.GetSlabPtr(y);
+            for (int x = 0; x < destWidth; x++)
+            {
+                const SourcePosition& position = pPositions[x];
+                const float* pWeightsOfX = pWeightsX
+                    + (size_t)position.phaseX * (size_t)tapCountX;
+                const float* pWeightsOfY = pWeightsY
+                    + (size_t)position.phaseY * (size_t)tapCountY;
+                int firstX = position.x - tapCountX / 2 + 1;
+                int firstY = position.y - tapCountY / 2 + 1;
+                float value = 0.0f;
+
+                if (firstX >= 0 && firstX + tapCountX <= sourceWidth
+                    && firstY >= 0 && firstY + tapCountY <= sourceHeight)
+                {
+                    // The usual case: every tap is inside the source noise
+                    // map.
+                    for (int j = 0; j < tapCountY; j++)
+                    {
+                        const float* pTaps = sourceNoiseMap.GetConstSlabPtr(
+                            firstX, firstY + j);
+                        float rowValue = 0.0f;
+                        for (int i = 0; i < tapCountX; i++)
+                        {
+                            rowValue += pWeightsOfX[i] * pTaps[i];
+                        }
+                        value += pWeightsOfY[j] * rowValue;
+                    }
+                    pDest[x] = value;
+                    continue;
+                }
+
+                for (int j = 0; j < tapCountY; j++)
+                {
+                    int tapY = firstY + j;
+                    int shiftX = 0;
+                    if (edgeModeY == EDGE_POLE
+                        && (tapY < 0 || tapY >= sourceHeight))
+                    {
+                        // Cross the pole: the point at the same distance
+                        // from the pole, half a turn away.
+                        tapY = (tapY < 0) ? -1 - tapY
+                            : 2 * sourceHeight - 1 - tapY;
+                        tapY = ClampValue(tapY, 0, sourceHeight - 1);
+                        shiftX = sourceWidth / 2;
+                    }
+                    else
+                    {
+                        tapY = fResolveEdge(tapY, sourceHeight, edgeModeY);
+                    }
+
+                    float rowValue = 0.0f;
+                    for (int i = 0; i < tapCountX; i++)
+                    {
+                        int tapX = fResolveEdge(firstX + i + shiftX,
+                            sourceWidth, edgeModeX);
+                        rowValue += pWeightsOfX[i] * ((tapX < 0 || tapY < 0)
+                            ? borderValue
+                            : *sourceNoiseMap.GetConstSlabPtr(tapX, tapY));
+                    }
+                    value += pWeightsOfY[j] * rowValue;
+                }
+                pDest[x] = value;
+            }
+        });
+}
+
+void RasterResampler::SetAffineMapping(int sourceWidth, int sourceHeight,
+    int destWidth, int destHeight, const double* pMatrix)
+{
+    if (pMatrix == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    double m[6];
+    for (int i = 0; i < 6; i++)
+    {
+        m[i] = pMatrix[i];
+    }
+    m_edgeModeX = EDGE_BORDER;
+    m_edgeModeY = EDGE_BORDER;
+    BuildTable(sourceWidth, sourceHeight, destWidth, destHeight,
+        sqrt(m[0] * m[0] + m[1] * m[1]), sqrt(m[3] * m[3] + m[4] * m[4]),
+        [&](int x, int y, double& sourceX, double& sourceY)
+        {
+            sourceX = m[0] * x + m[1] * y + m[2];
+            sourceY = m[3] * x + m[4] * y + m[5];
+        });
+}
+
+void RasterResampler::SetCubeFaceMapping(int sourceWidth, int sourceHeight,
+    CubeFace face, int faceSize)
+{
+    if (face < CUBE_FACE_POSITIVE_X || face > CUBE_FACE_NEGATIVE_Z
+        || faceSize <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // At the center of the face, a destination point spans 2 / faceSize
+    // radians.
+    const double (*axes)[3] = CUBE_FACE_AXES[face];
+    double scaleX = sourceWidth / (PI * faceSize);
+    double scaleY = 2.0 * sourceHeight / (PI * faceSize);
+    m_edgeModeX = EDGE_WRAP;
+    m_edgeModeY = EDGE_POLE;
+    BuildTable(sourceWidth, sourceHeight, faceSize, faceSize, scaleX, scaleY,
+        [&](int x, int y, double& sourceX, double& sourceY)
+        {
+            double u = 2.0 * (x + 0.5) / faceSize - 1.0;
+            double v = 2.0 * (y + 0.5) / faceSize - 1.0;
+            double direction[3];
+            for (int i = 0; i < 3; i++)
+            {
+                direction[i] = axes[0][i] + u * axes[1][i] + v * axes[2][i];
+            }
+            double length = sqrt(direction[0] * direction[0]
+                + direction[1] * direction[1] + direction[2] * direction[2]);
+            double lat = RAD_TO_DEG * asin(direction[1] / length);
+            double lon = RAD_TO_DEG * atan2(direction[2], direction[0]);
+            sourceX = (lon + 180.0) / 360.0 * sourceWidth - 0.5;
+            sourceY = (lat + 90.0) / 180.0 * sourceHeight - 0.5;
+        });
+}
+
+void RasterResampler::SetFilter(ResampleFilter filter)
+{
+    if (filter < RESAMPLE_FILTER_BILINEAR || filter > RESAMPLE_FILTER_LANCZOS)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_filter = filter;
+    if (m_mappingKind != MAPPING_NONE)
+    {
+        BuildWeights();
+    }
+}
+
+void RasterResampler::SetPolarMapping(int sourceWidth, int sourceHeight,
+    int destSize, bool isNorth, double boundLatitude)
+{
+    if (destSize <= 0 || (isNorth && (boundLatitude <= 0.0
+        || boundLatitude >= 90.0)) || (!isNorth && (boundLatitude >= 0.0
+        || boundLatitude <= -90.0)))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // The stereographic projection puts a point at the angle c from the pole
+    // at the distance 2 tan (c / 2) from the center, so near the pole a
+    // destination point spans 2 * radius / destSize radians.
+    double radius = 2.0 * tan(DEG_TO_RAD * (90.0 - fabs(boundLatitude)) / 2.0);
+    double span = 2.0 * radius / destSize;
+    double scaleX = span * sourceWidth / (2.0 * PI);
+    double scaleY = span * sourceHeight / PI;
+    double sign = isNorth ? 1.0 : -1.0;
+    m_edgeModeX = EDGE_WRAP;
+    m_edgeModeY = EDGE_POLE;
+    BuildTable(sourceWidth, sourceHeight, destSize, destSize, scaleX, scaleY,
+        [&](int x, int y, double& sourceX, double& sourceY)
+        {
+            double px = (2.0 * (x + 0.5) / destSize - 1.0) * radius;
+            double py = (2.0 * (y + 0.5) / destSize - 1.0) * radius;
+            double c = 2.0 * atan(sqrt(px * px + py * py) / 2.0);
+            double lat = sign * (90.0 - RAD_TO_DEG * c);
+            double lon = RAD_TO_DEG * atan2(sign * py, px);
+            sourceX = (lon + 180.0) / 360.0 * sourceWidth - 0.5;
+            sourceY = (lat + 90.0) / 180.0 * sourceHeight - 0.5;
+        });
+}
+
+void RasterResampler::SetResizeMapping(int sourceWidth, int sourceHeight,
+    int destWidth, int destHeight)
+{
+    if (sourceWidth <= 0 || sourceHeight <= 0 || destWidth <= 0
+        || destHeight <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_mappingKind = MAPPING_NONE;
+    double ratioX = (double)sourceWidth / destWidth;
+    double ratioY = (double)sourceHeight / destHeight;
+    try
+    {
+        m_resizeColumns.resize((size_t)destWidth);
+        m_resizeRows.resize((size_t)destHeight);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    for (int x = 0; x < destWidth; x++)
+    {
+        SplitPosition((x + 0.5) * ratioX - 0.5, m_resizeColumns[x].x,
+            m_resizeColumns[x].phaseX);
+    }
+    for (int y = 0; y < destHeight; y++)
+    {
+        SplitPosition((y + 0.5) * ratioY - 0.5, m_resizeRows[y].y,
+            m_resizeRows[y].phaseY);
+    }
+
+    m_sourceWidth = sourceWidth;
+    m_sourceHeight = sourceHeight;
+    m_destWidth = destWidth;
+    m_destHeight = destHeight;
+    m_edgeModeX = EDGE_CLAMP;
+    m_edgeModeY = EDGE_CLAMP;
+    m_scaleX = GetMax(ratioX, 1.0);
+    m_scaleY = GetMax(ratioY, 1.0);
+    m_mappingKind = MAPPING_RESIZE;
+    BuildWeights();
+}
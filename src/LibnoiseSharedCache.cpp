@@ -0,0 +1,814 @@
+// LibnoiseSharedCache.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <atomic>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "LibnoiseSharedCache.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // "NSTC", written last when a segment is initialized.
+    const uint32 SEGMENT_MAGIC = 0x4e535443;
+
+    // Layout version of the segment.
+    const uint32 SEGMENT_VERSION = 1;
+
+    // Number of mutexes protecting the buckets of the index.
+    const int STRIPE_COUNT = 64;
+
+    // Alignment of the sections of the segment and of the tiles.
+    const size_t SEGMENT_ALIGNMENT = 64;
+
+    // Slot index meaning "no slot".
+    const uint32 NO_SLOT = 0xffffffff;
+
+    // Process ID of an entry whose dead process is being reclaimed.
+    const int32 RECLAIMING_PID = -1;
+
+    // States of a slot.  A free slot is in the free list.  A claimed slot is
+    // owned by one cache object, which writes a tile into it or evicts it.
+    // A ready slot is in the index.
+    enum SlotState
+    {
+        SLOT_FREE = 0,
+        SLOT_CLAIMED = 1,
+        SLOT_READY = 2
+    };
+
+    struct SegmentHeader
+    {
+        std::atomic<uint32> magic;
+        std::atomic<int32> initPid;
+        uint32 version;
+        int32 tileWidth;
+        int32 tileHeight;
+        int32 slotCount;
+        uint32 bucketCount;
+
+        // Protects the free list and the clock hand.
+        pthread_mutex_t allocMutex;
+        uint32 freeHead;
+        uint32 clockHand;
+
+        // Stripe i protects the buckets whose index modulo STRIPE_COUNT is i,
+        // and the links of their slots.
+        pthread_mutex_t stripeMutex[STRIPE_COUNT];
+    };
+
+    struct ProcessEntry
+    {
+        std::atomic<int32> pid;
+
+        // The held slots plus one, or zero for an unused hold.
+        std::atomic<uint32> holds[SHARED_TILE_CACHE_MAX_HELD_TILES];
+    };
+
+    struct SlotEntry
+    {
+        uint64 key;
+        std::atomic<uint32> state;
+        int32 owner;
+        uint32 next;
+        uint32 freeNext;
+
+        // Number of live holds, possibly too high after a crash.
+        std::atomic<uint32> holdCount;
+
+        // Set when the tile is read or written; cleared by the clock sweep.
+        std::atomic<uint32> isReferenced;
+    };
+
+    size_t AlignSize(size_t size)
+    {
+        return (size + SEGMENT_ALIGNMENT - 1) & ~(SEGMENT_ALIGNMENT - 1);
+    }
+
+    uint32 GetBucketCount(int slotCount)
+    {
+        uint32 bucketCount = 1;
+        while (bucketCount < (uint32)slotCount)
+        {
+            bucketCount <<= 1;
+        }
+        return bucketCount;
+    }
+
+    // Offsets of the sections of a segment.
+    struct SegmentLayout
+    {
+        size_t processOffset;
+        size_t bucketOffset;
+        size_t slotOffset;
+        size_t dataOffset;
+        size_t tileStride;
+        size_t size;
+
+        SegmentLayout(int tileWidth, int tileHeight, int slotCount)
+        {
+            processOffset = AlignSize(sizeof(SegmentHeader));
+            bucketOffset = processOffset + AlignSize(
+                SHARED_TILE_CACHE_MAX_PROCESSES * sizeof(ProcessEntry));
+            slotOffset = bucketOffset
+                + AlignSize(GetBucketCount(slotCount) * sizeof(uint32));
+            dataOffset = slotOffset + AlignSize(slotCount * sizeof(SlotEntry));
+            tileStride = AlignSize(
+                (size_t)tileWidth * (size_t)tileHeight * sizeof(float));
+            size = dataOffset + tileStride * (size_t)slotCount;
+        }
+    };
+
+    SegmentHeader& GetHeader(unsigned char* pSegment)
+    {
+        return *(SegmentHeader*)pSegment;
+    }
+
+    ProcessEntry* GetProcesses(unsigned char* pSegment)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SegmentLayout layout(header.tileWidth, header.tileHeight,
+            header.slotCount);
+        return (ProcessEntry*)(pSegment + layout.processOffset);
+    }
+
+    uint32* GetBuckets(unsigned char* pSegment)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SegmentLayout layout(header.tileWidth, header.tileHeight,
+            header.slotCount);
+        return (uint32*)(pSegment + layout.bucketOffset);
+    }
+
+    SlotEntry* GetSlots(unsigned char* pSegment)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SegmentLayout layout(header.tileWidth, header.tileHeight,
+            header.slotCount);
+        return (SlotEntry*)(pSegment + layout.slotOffset);
+    }
+
+    float* GetTileData(unsigned char* pSegment, uint32 slot)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SegmentLayout layout(header.tileWidth, header.tileHeight,
+            header.slotCount);
+        return (float*)(pSegment + layout.dataOffset
+            + layout.tileStride * (size_t)slot);
+    }
+
+    uint32 GetBucket(const SegmentHeader& header, uint64 key)
+    {
+        // Finalizer of MurmurHash3: the keys are often packed coordinates.
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return (uint32)key & (header.bucketCount - 1);
+    }
+
+    bool IsProcessDead(int32 pid)
+    {
+        return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+    }
+
+    // Locks a robust mutex for the lifetime of the object, and tells if its
+    // previous owner died while holding it.
+    class RobustLock
+    {
+
+        public:
+
+            explicit RobustLock(pthread_mutex_t* pMutex):
+                m_pMutex(pMutex),
+                m_isAbandoned(false)
+            {
+                int result = pthread_mutex_lock(pMutex);
+                if (result == EOWNERDEAD)
+                {
+                    pthread_mutex_consistent(pMutex);
+                    m_isAbandoned = true;
+                }
+                else if (result != 0)
+                {
+                    throw noise::ExceptionUnknown();
+                }
+            }
+
+            ~RobustLock()
+            {
+                pthread_mutex_unlock(m_pMutex);
+            }
+
+            bool IsAbandoned() const
+            {
+                return m_isAbandoned;
+            }
+
+        private:
+
+            RobustLock(const RobustLock&);
+            RobustLock& operator= (const RobustLock&);
+
+            pthread_mutex_t* m_pMutex;
+            bool m_isAbandoned;
+
+    };
+
+    // Rebuilds the free list from the slot states, after a process died
+    // while holding the allocation mutex.
+    void RepairFreeList(unsigned char* pSegment)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SlotEntry* pSlots = GetSlots(pSegment);
+        header.freeHead = NO_SLOT;
+        for (int slot = header.slotCount - 1; slot >= 0; slot--)
+        {
+            if (pSlots[slot].state.load() == SLOT_FREE)
+            {
+                pSlots[slot].freeNext = header.freeHead;
+                header.freeHead = (uint32)slot;
+            }
+        }
+        header.clockHand %= (uint32)header.slotCount;
+    }
+
+    // Rebuilds the buckets of a stripe from the slot states, after a process
+    // died while holding the mutex of the stripe.
+    void RepairStripe(unsigned char* pSegment, int stripe)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        uint32* pBuckets = GetBuckets(pSegment);
+        SlotEntry* pSlots = GetSlots(pSegment);
+        for (uint32 bucket = (uint32)stripe; bucket < header.bucketCount;
+            bucket += STRIPE_COUNT)
+        {
+            pBuckets[bucket] = NO_SLOT;
+        }
+        for (int slot = 0; slot < header.slotCount; slot++)
+        {
+            SlotEntry& entry = pSlots[slot];
+            if (entry.state.load() != SLOT_READY)
+            {
+                continue;
+            }
+            uint32 bucket = GetBucket(header, entry.key);
+            if ((int)(bucket % STRIPE_COUNT) == stripe)
+            {
+                entry.next = pBuckets[bucket];
+                pBuckets[bucket] = (uint32)slot;
+            }
+        }
+    }
+
+    // Locks the mutex of the stripe of a bucket, repairing the stripe if
+    // needed.
+    class StripeLock: public RobustLock
+    {
+
+        public:
+
+            StripeLock(unsigned char* pSegment, uint32 bucket):
+                RobustLock(
+                    &GetHeader(pSegment).stripeMutex[bucket % STRIPE_COUNT])
+            {
+                if (IsAbandoned())
+                {
+                    RepairStripe(pSegment, (int)(bucket % STRIPE_COUNT));
+                }
+            }
+
+    };
+
+    // Locks the allocation mutex, repairing the free list if needed.
+    class AllocLock: public RobustLock
+    {
+
+        public:
+
+            explicit AllocLock(unsigned char* pSegment):
+                RobustLock(&GetHeader(pSegment).allocMutex)
+            {
+                if (IsAbandoned())
+                {
+                    RepairFreeList(pSegment);
+                }
+            }
+
+    };
+
+    // Returns a claimed slot to the free list.  The allocation mutex must be
+    // held.
+    void PushFreeSlot(unsigned char* pSegment, uint32 slot)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        SlotEntry& entry = GetSlots(pSegment)[slot];
+        entry.freeNext = header.freeHead;
+        entry.state.store(SLOT_FREE);
+        header.freeHead = slot;
+    }
+
+    // Returns the ready slot of a key, or NO_SLOT.  The mutex of the stripe
+    // of the bucket must be held.
+    uint32 FindSlot(unsigned char* pSegment, uint32 bucket, uint64 key)
+    {
+        SlotEntry* pSlots = GetSlots(pSegment);
+        uint32 slot = GetBuckets(pSegment)[bucket];
+        while (slot != NO_SLOT)
+        {
+            if (pSlots[slot].key == key)
+            {
+                return slot;
+            }
+            slot = pSlots[slot].next;
+        }
+        return NO_SLOT;
+    }
+
+    // Determines if any attached cache object holds a slot.  The hold count
+    // is exact unless a holder died; if it claims holds that no entry
+    // records, it is reset.
+    bool IsSlotHeld(unsigned char* pSegment, uint32 slot)
+    {
+        SlotEntry& entry = GetSlots(pSegment)[slot];
+        if (entry.holdCount.load() == 0)
+        {
+            return false;
+        }
+        ProcessEntry* pProcesses = GetProcesses(pSegment);
+        for (int i = 0; i < SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+        {
+            if (pProcesses[i].pid.load() == 0)
+            {
+                continue;
+            }
+            for (int j = 0; j < SHARED_TILE_CACHE_MAX_HELD_TILES; j++)
+            {
+                if (pProcesses[i].holds[j].load() == slot + 1)
+                {
+                    return true;
+                }
+            }
+        }
+        entry.holdCount.store(0);
+        return false;
+    }
+
+    // Reclaims the entries of dead processes.  The allocation mutex must be
+    // held.
+    //
+    // Returns true if an entry was reclaimed.
+    bool ReclaimDeadProcesses(unsigned char* pSegment)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        ProcessEntry* pProcesses = GetProcesses(pSegment);
+        SlotEntry* pSlots = GetSlots(pSegment);
+        bool hasReclaimed = false;
+        for (int i = 0; i < SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+        {
+            ProcessEntry& process = pProcesses[i];
+            int32 pid = process.pid.load();
+            if (pid == RECLAIMING_PID)
+            {
+                // The reclaimer died in turn; the allocation mutex it held
+                // has been repaired, so finish its work.
+                pid = RECLAIMING_PID;
+            }
+            else if (!IsProcessDead(pid)
+                || !process.pid.compare_exchange_strong(pid, RECLAIMING_PID))
+            {
+                continue;
+            }
+
+            for (int j = 0; j < SHARED_TILE_CACHE_MAX_HELD_TILES; j++)
+            {
+                process.holds[j].store(0);
+            }
+            for (int slot = 0; slot < header.slotCount; slot++)
+            {
+                if (pSlots[slot].state.load() == SLOT_CLAIMED
+                    && pSlots[slot].owner == i)
+                {
+                    PushFreeSlot(pSegment, (uint32)slot);
+                }
+            }
+            process.pid.store(0);
+            hasReclaimed = true;
+        }
+        return hasReclaimed;
+    }
+
+    // Initializes a new segment.
+    void InitializeSegment(unsigned char* pSegment, int tileWidth,
+        int tileHeight, int slotCount)
+    {
+        SegmentHeader& header = GetHeader(pSegment);
+        header.version = SEGMENT_VERSION;
+        header.tileWidth = tileWidth;
+        header.tileHeight = tileHeight;
+        header.slotCount = slotCount;
+        header.bucketCount = GetBucketCount(slotCount);
+
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&header.allocMutex, &attributes);
+        for (int i = 0; i < STRIPE_COUNT; i++)
+        {
+            pthread_mutex_init(&header.stripeMutex[i], &attributes);
+        }
+        pthread_mutexattr_destroy(&attributes);
+
+        ProcessEntry* pProcesses = GetProcesses(pSegment);
+        for (int i = 0; i < SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+        {
+            pProcesses[i].pid.store(0);
+            for (int j = 0; j < SHARED_TILE_CACHE_MAX_HELD_TILES; j++)
+            {
+                pProcesses[i].holds[j].store(0);
+            }
+        }
+
+        uint32* pBuckets = GetBuckets(pSegment);
+        for (uint32 bucket = 0; bucket < header.bucketCount; bucket++)
+        {
+            pBuckets[bucket] = NO_SLOT;
+        }
+
+        SlotEntry* pSlots = GetSlots(pSegment);
+        header.freeHead = NO_SLOT;
+        header.clockHand = 0;
+        for (int slot = slotCount - 1; slot >= 0; slot--)
+        {
+            pSlots[slot].key = 0;
+            pSlots[slot].owner = -1;
+            pSlots[slot].next = NO_SLOT;
+            pSlots[slot].holdCount.store(0);
+            pSlots[slot].isReferenced.store(0);
+            PushFreeSlot(pSegment, (uint32)slot);
+        }
+
+        header.magic.store(SEGMENT_MAGIC);
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SharedTile class
+
+SharedTile::SharedTile():
+    m_pCache(NULL),
+    m_pData(NULL),
+    m_height(0),
+    m_holdIndex(-1),
+    m_key(0),
+    m_width(0)
+{
+}
+
+void SharedTile::Release()
+{
+    if (m_pCache != NULL)
+    {
+        m_pCache->ReleaseHold(m_holdIndex);
+        m_pCache = NULL;
+        m_pData = NULL;
+        m_holdIndex = -1;
+    }
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// SharedTileCache class
+
+SharedTileCache::SharedTileCache(const char* name, int tileWidth,
+    int tileHeight, int slotCount):
+    m_pSegment(NULL),
+    m_segmentSize(0),
+    m_processIndex(-1),
+    m_slotCount(slotCount),
+    m_tileHeight(tileHeight),
+    m_tileWidth(tileWidth)
+{
+    if (name == NULL || name[0] != '/' || tileWidth <= 0 || tileHeight <= 0
+        || slotCount <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    SegmentLayout layout(tileWidth, tileHeight, slotCount);
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        throw noise::ExceptionUnknown();
+    }
+
+    // The first process sizes the segment; the others find it sized, or
+    // size it to the same value.  A segment of another size was created
+    // with other parameters.
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw noise::ExceptionUnknown();
+    }
+    if (status.st_size == 0 && ftruncate(fd, (off_t)layout.size) != 0)
+    {
+        close(fd);
+        throw noise::ExceptionUnknown();
+    }
+    if (status.st_size != 0 && (size_t)status.st_size != layout.size)
+    {
+        close(fd);
+        throw noise::ExceptionInvalidParam();
+    }
+
+    void* pMapping = mmap(NULL, layout.size, PROT_READ | PROT_WRITE,
+        MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMapping == MAP_FAILED)
+    {
+        throw noise::ExceptionUnknown();
+    }
+    m_pSegment = (unsigned char*)pMapping;
+    m_segmentSize = layout.size;
+
+    // One process initializes the segment.  If it dies before it is done,
+    // another one starts over.
+    SegmentHeader& header = GetHeader(m_pSegment);
+    int32 pid = (int32)getpid();
+    while (header.magic.load() != SEGMENT_MAGIC)
+    {
+        int32 initPid = header.initPid.load();
+        if ((initPid == 0 || IsProcessDead(initPid))
+            && header.initPid.compare_exchange_strong(initPid, pid))
+        {
+            InitializeSegment(m_pSegment, tileWidth, tileHeight, slotCount);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (header.version != SEGMENT_VERSION || header.tileWidth != tileWidth
+        || header.tileHeight != tileHeight || header.slotCount != slotCount)
+    {
+        munmap(m_pSegment, m_segmentSize);
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // Reclaim what dead processes left behind, then take an entry.
+    {
+        AllocLock lock(m_pSegment);
+        ReclaimDeadProcesses(m_pSegment);
+    }
+    ProcessEntry* pProcesses = GetProcesses(m_pSegment);
+    for (int i = 0; i < SHARED_TILE_CACHE_MAX_PROCESSES; i++)
+    {
+        int32 expected = 0;
+        if (pProcesses[i].pid.compare_exchange_strong(expected, pid))
+        {
+            m_processIndex = i;
+            break;
+        }
+    }
+    if (m_processIndex < 0)
+    {
+        munmap(m_pSegment, m_segmentSize);
+        throw noise::ExceptionOutOfMemory();
+    }
+}
+
+SharedTileCache::~SharedTileCache()
+{
+    ProcessEntry& process = GetProcesses(m_pSegment)[m_processIndex];
+    for (int j = 0; j < SHARED_TILE_CACHE_MAX_HELD_TILES; j++)
+    {
+        if (process.holds[j].load() != 0)
+        {
+            ReleaseHold(j);
+        }
+    }
+    process.pid.store(0);
+    munmap(m_pSegment, m_segmentSize);
+}
+
+int SharedTileCache::ClaimSlot()
+{
+    SegmentHeader& header = GetHeader(m_pSegment);
+    SlotEntry* pSlots = GetSlots(m_pSegment);
+    AllocLock lock(m_pSegment);
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (header.freeHead != NO_SLOT)
+        {
+            uint32 slot = header.freeHead;
+            header.freeHead = pSlots[slot].freeNext;
+            pSlots[slot].owner = m_processIndex;
+            pSlots[slot].state.store(SLOT_CLAIMED);
+            return (int)slot;
+        }
+
+        // Clock sweep.  Two turns give every referenced tile a chance to
+        // have its flag cleared and be evicted.
+        for (int step = 0; step < 2 * m_slotCount; step++)
+        {
+            uint32 slot = header.clockHand;
+            header.clockHand = (slot + 1) % (uint32)m_slotCount;
+            SlotEntry& entry = pSlots[slot];
+            if (entry.state.load() != SLOT_READY
+                || entry.isReferenced.exchange(0) != 0)
+            {
+                continue;
+            }
+
+            uint32 bucket = GetBucket(header, entry.key);
+            StripeLock stripeLock(m_pSegment, bucket);
+            if (entry.state.load() != SLOT_READY
+                || IsSlotHeld(m_pSegment, slot))
+            {
+                continue;
+            }
+
+            uint32* pLink = &GetBuckets(m_pSegment)[bucket];
+            while (*pLink != slot)
+            {
+                pLink = &pSlots[*pLink].next;
+            }
+            *pLink = entry.next;
+            entry.owner = m_processIndex;
+            entry.state.store(SLOT_CLAIMED);
+            return (int)slot;
+        }
+
+        // Every tile is held; some holders may be dead.
+        if (!ReclaimDeadProcesses(m_pSegment))
+        {
+            break;
+        }
+    }
+    return -1;
+}
+
+bool SharedTileCache::Find(uint64 key, SharedTile& tile)
+{
+    tile.Release();
+
+    SegmentHeader& header = GetHeader(m_pSegment);
+    ProcessEntry& process = GetProcesses(m_pSegment)[m_processIndex];
+    uint32 bucket = GetBucket(header, key);
+    StripeLock lock(m_pSegment, bucket);
+    uint32 slot = FindSlot(m_pSegment, bucket, key);
+    if (slot == NO_SLOT)
+    {
+        return false;
+    }
+
+    // Record the hold before counting it, so that the count never exceeds
+    // the recorded holds of live processes.
+    int holdIndex = -1;
+    for (int j = 0; j < SHARED_TILE_CACHE_MAX_HELD_TILES; j++)
+    {
+        uint32 expected = 0;
+        if (process.holds[j].compare_exchange_strong(expected, slot + 1))
+        {
+            holdIndex = j;
+            break;
+        }
+    }
+    if (holdIndex < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    SlotEntry& entry = GetSlots(m_pSegment)[slot];
+    entry.holdCount.fetch_add(1);
+    entry.isReferenced.store(1);
+
+    tile.m_pCache = this;
+    tile.m_pData = GetTileData(m_pSegment, slot);
+    tile.m_height = m_tileHeight;
+    tile.m_holdIndex = holdIndex;
+    tile.m_key = key;
+    tile.m_width = m_tileWidth;
+    return true;
+}
+
+bool SharedTileCache::Insert(uint64 key,
+    const std::function<void(float*)>& fFill)
+{
+    SegmentHeader& header = GetHeader(m_pSegment);
+    uint32 bucket = GetBucket(header, key);
+    {
+        StripeLock lock(m_pSegment, bucket);
+        if (FindSlot(m_pSegment, bucket, key) != NO_SLOT)
+        {
+            return false;
+        }
+    }
+
+    int slot = ClaimSlot();
+    if (slot < 0)
+    {
+        return false;
+    }
+
+    // The slot is not in the index: no other process reads it.
+    try
+    {
+        fFill(GetTileData(m_pSegment, (uint32)slot));
+    }
+    catch (...)
+    {
+        AllocLock lock(m_pSegment);
+        PushFreeSlot(m_pSegment, (uint32)slot);
+        throw;
+    }
+
+    {
+        StripeLock lock(m_pSegment, bucket);
+        if (FindSlot(m_pSegment, bucket, key) == NO_SLOT)
+        {
+            SlotEntry& entry = GetSlots(m_pSegment)[slot];
+            uint32* pBuckets = GetBuckets(m_pSegment);
+            entry.key = key;
+            entry.next = pBuckets[bucket];
+            entry.holdCount.store(0);
+            entry.isReferenced.store(1);
+            pBuckets[bucket] = (uint32)slot;
+            entry.state.store(SLOT_READY);
+            return true;
+        }
+    }
+
+    // Another process added the same tile meanwhile.
+    AllocLock lock(m_pSegment);
+    PushFreeSlot(m_pSegment, (uint32)slot);
+    return false;
+}
+
+bool SharedTileCache::Insert(uint64 key, const NoiseMap& tileMap)
+{
+    if (tileMap.GetWidth() != m_tileWidth
+        || tileMap.GetHeight() != m_tileHeight)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int width = m_tileWidth;
+    int height = m_tileHeight;
+    return Insert(key,
+        [&](float* pDest)
+        {
+            for (int z = 0; z < height; z++)
+            {
+                memcpy(pDest + (size_t)z * (size_t)width,
+                    tileMap.GetConstSlabPtr(z), (size_t)width * sizeof(float));
+            }
+        });
+}
+
+void SharedTileCache::ReleaseHold(int holdIndex)
+{
+    ProcessEntry& process = GetProcesses(m_pSegment)[m_processIndex];
+    uint32 slot = process.holds[holdIndex].load() - 1;
+
+    // Uncount the hold before clearing it; see Find().
+    GetSlots(m_pSegment)[slot].holdCount.fetch_sub(1);
+    process.holds[holdIndex].store(0);
+}
+
+void SharedTileCache::Unlink(const char* name)
+{
+    if (name != NULL)
+    {
+        shm_unlink(name);
+    }
+}
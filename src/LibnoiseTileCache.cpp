@@ -0,0 +1,767 @@
+// LibnoiseTileCache.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <string.h>
+
+#include "LibnoiseTileCache.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // Forms of a stored tile, in the first byte of a compressed tile.
+    const uint8 PACK_RAW = 0;
+    const uint8 PACK_LZ = 1;
+
+    // Matches are at least this long.
+    const int LZ_MIN_MATCH = 4;
+
+    // The last bytes of the input are always literals, so the matcher can
+    // read four bytes past any match candidate.
+    const int LZ_LAST_LITERALS = 8;
+
+    // Matches reach at most this far back.
+    const size_t LZ_MAX_OFFSET = 65535;
+
+    // Number of bits of the hash of four bytes.
+    const int LZ_HASH_BITS = 14;
+
+    // Number of groups of eight values in a block of bit planes.
+    const size_t BIT_PLANE_BLOCK_GROUPS = 128;
+
+    uint32 ReadUint32(const uint8* p)
+    {
+        uint32 value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // Maps the bits of a float to an integer that sorts like the float, so
+    // that nearby values give nearby integers across the sign.
+    uint32 FloatToOrdered(float value)
+    {
+        uint32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    float OrderedToFloat(uint32 ordered)
+    {
+        uint32 bits = (ordered & 0x80000000u) ? ordered & 0x7fffffffu
+            : ~ordered;
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Writes a length that did not fit in its token nibble.
+    void WriteLzLength(uint8*& pOut, size_t length)
+    {
+        while (length >= 255)
+        {
+            *pOut++ = 255;
+            length -= 255;
+        }
+        *pOut++ = (uint8)length;
+    }
+
+    // Reads a length whose token nibble is 15.
+    size_t ReadLzLength(const uint8*& pIn)
+    {
+        size_t length = 0;
+        uint8 byte;
+        do
+        {
+            byte = *pIn++;
+            length += byte;
+        } while (byte == 255);
+        return length;
+    }
+
+    // Writes a sequence: literals, then a match unless @a matchLength is
+    // zero.
+    void WriteLzSequence(uint8*& pOut, const uint8* pLiterals,
+        size_t literalCount, size_t offset, size_t matchLength)
+    {
+        uint8* pToken = pOut++;
+        size_t matchCode = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+        *pToken = (uint8)(((literalCount < 15 ? literalCount : 15) << 4)
+            | (matchCode < 15 ? matchCode : 15));
+        if (literalCount >= 15)
+        {
+            WriteLzLength(pOut, literalCount - 15);
+        }
+        memcpy(pOut, pLiterals, literalCount);
+        pOut += literalCount;
+        if (matchLength > 0)
+        {
+            *pOut++ = (uint8)(offset & 0xff);
+            *pOut++ = (uint8)(offset >> 8);
+            if (matchCode >= 15)
+            {
+                WriteLzLength(pOut, matchCode - 15);
+            }
+        }
+    }
+
+    // Returns the largest size of the LZ encoding of @a size bytes.
+    size_t GetLzBound(size_t size)
+    {
+        return size + size / 255 + 16;
+    }
+
+    // Compresses bytes with a greedy LZ77 coder in the format of LZ4 blocks:
+    // each sequence is a token holding the literal count and the match
+    // length, the literals, and a two-byte offset.  Returns the size of the
+    // output, which has room for GetLzBound() bytes.
+    size_t LzCompress(const uint8* pIn, size_t size, uint8* pOut,
+        std::vector<uint32>& hashTable)
+    {
+        uint8* pStart = pOut;
+        hashTable.assign((size_t)1 << LZ_HASH_BITS, 0);
+        size_t anchor = 0;
+        size_t pos = 1;
+        if (size > (size_t)LZ_LAST_LITERALS + LZ_MIN_MATCH)
+        {
+            size_t matchLimit = size - LZ_LAST_LITERALS;
+            while (pos + LZ_MIN_MATCH <= matchLimit)
+            {
+                uint32 sequence = ReadUint32(pIn + pos);
+                uint32 hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+                size_t candidate = hashTable[hash];
+                hashTable[hash] = (uint32)pos;
+                if (candidate >= pos || pos - candidate > LZ_MAX_OFFSET
+                    || ReadUint32(pIn + candidate) != sequence)
+                {
+                    // Skip faster through data that does not match, such as
+                    // the low bytes of the residuals.
+                    pos += 1 + ((pos - anchor) >> 6);
+                    continue;
+                }
+
+                size_t length = LZ_MIN_MATCH;
+                while (pos + length < matchLimit
+                    && pIn[candidate + length] == pIn[pos + length])
+                {
+                    length++;
+                }
+                WriteLzSequence(pOut, pIn + anchor, pos - anchor,
+                    pos - candidate, length);
+                pos += length;
+                anchor = pos;
+            }
+        }
+        WriteLzSequence(pOut, pIn + anchor, size - anchor, 0, 0);
+        return (size_t)(pOut - pStart);
+    }
+
+    // Decompresses the output of LzCompress() into exactly @a size bytes.
+    void LzDecompress(const uint8* pIn, uint8* pOut, size_t size)
+    {
+        uint8* pEnd = pOut + size;
+        for (;;)
+        {
+            uint8 token = *pIn++;
+            size_t literalCount = token >> 4;
+            if (literalCount == 15)
+            {
+                literalCount += ReadLzLength(pIn);
+            }
+            memcpy(pOut, pIn, literalCount);
+            pIn += literalCount;
+            pOut += literalCount;
+            if (pOut >= pEnd)
+            {
+                break;
+            }
+
+            size_t offset = (size_t)pIn[0] | ((size_t)pIn[1] << 8);
+            pIn += 2;
+            size_t length = (token & 15);
+            if (length == 15)
+            {
+                length += ReadLzLength(pIn);
+            }
+            length += LZ_MIN_MATCH;
+
+            // An overlapping match repeats the last @a offset bytes; the
+            // repeated span doubles with every copy.
+            const uint8* pMatch = pOut - offset;
+            while (length > 0)
+            {
+                size_t chunk = (size_t)(pOut - pMatch);
+                if (chunk > length)
+                {
+                    chunk = length;
+                }
+                memcpy(pOut, pMatch, chunk);
+                pOut += chunk;
+                length -= chunk;
+            }
+        }
+    }
+
+    // Transposes the 8x8 bit matrix whose rows are the bytes of @a x: bit j
+    // of byte i becomes bit i of byte j.  The transpose is its own inverse.
+    uint64 TransposeBits(uint64 x)
+    {
+        uint64 t;
+        t = (x ^ (x >> 7)) & 0x00aa00aa00aa00aaULL;
+        x = x ^ t ^ (t << 7);
+        t = (x ^ (x >> 14)) & 0x0000cccc0000ccccULL;
+        x = x ^ t ^ (t << 14);
+        t = (x ^ (x >> 28)) & 0x00000000f0f0f0f0ULL;
+        x = x ^ t ^ (t << 28);
+        return x;
+    }
+
+    // Returns the position of the byte of the first bit plane that holds a
+    // group of eight values, and the distance between the planes.  The
+    // planes are split into blocks of BIT_PLANE_BLOCK_GROUPS groups, so
+    // that the bytes of a group are close in memory; the zero planes of a
+    // block stay contiguous.
+    size_t GetPlaneOffset(size_t group, size_t groupCount,
+        size_t& planeStride)
+    {
+        size_t blockStart = group - group % BIT_PLANE_BLOCK_GROUPS;
+        planeStride = groupCount - blockStart;
+        if (planeStride > BIT_PLANE_BLOCK_GROUPS)
+        {
+            planeStride = BIT_PLANE_BLOCK_GROUPS;
+        }
+        return blockStart * 32 + (group - blockStart);
+    }
+
+    // Returns the prediction of a value from its left, upper and upper-left
+    // neighbours (the Lorenzo predictor, exact on planes).
+    uint32 PredictOrdered(const uint32* pRow, const uint32* pUp, int x, int z)
+    {
+        if (z == 0)
+        {
+            return x > 0 ? pRow[x - 1] : 0;
+        }
+        else if (x == 0)
+        {
+            return pUp[0];
+        }
+        return pRow[x - 1] + pUp[x] - pUp[x - 1];
+    }
+
+    // Compresses a tile.  The prediction residuals are zigzag-coded, so
+    // small residuals of either sign have their high bits clear, and split
+    // into 32 bit planes of one bit per value, least significant plane
+    // first, block by block.  The planes above the size of the residuals
+    // are all zero, and LzCompress() turns them into long matches.
+    void PackTile(const float* pValues, int stride, int width, int height,
+        std::vector<uint8>& packed)
+    {
+        size_t count = (size_t)width * (size_t)height;
+        size_t groupCount = (count + 7) / 8;
+        size_t planesSize = groupCount * 8 * sizeof(uint32);
+        MemoryReservation reservation(MEMORY_SCRATCH,
+            groupCount * 8 * sizeof(uint32) + (size_t)width * sizeof(uint32)
+            + planesSize + 1 + GetLzBound(planesSize)
+            + ((size_t)sizeof(uint32) << LZ_HASH_BITS));
+
+        // Residuals, padded with zeros to whole groups of eight.
+        std::vector<uint32> residuals(groupCount * 8, 0);
+        std::vector<uint32> ordered(2 * (size_t)width);
+        for (int z = 0; z < height; z++)
+        {
+            const float* pIn = pValues + (size_t)z * (size_t)stride;
+            uint32* pRow = &ordered[(size_t)(z & 1) * (size_t)width];
+            const uint32* pUp = &ordered[(size_t)((z + 1) & 1) * (size_t)width];
+            uint32* pResidual = &residuals[(size_t)z * (size_t)width];
+            for (int x = 0; x < width; x++)
+            {
+                pRow[x] = FloatToOrdered(pIn[x]);
+                uint32 residual = pRow[x] - PredictOrdered(pRow, pUp, x, z);
+                pResidual[x] = (residual << 1)
+                    ^ (uint32)((int32)residual >> 31);
+            }
+        }
+
+        std::vector<uint8> planes(planesSize);
+        for (size_t group = 0; group < groupCount; group++)
+        {
+            size_t planeStride;
+            uint8* pPlanes = &planes[GetPlaneOffset(group, groupCount,
+                planeStride)];
+            const uint32* pGroup = &residuals[group * 8];
+            for (int byte = 0; byte < 4; byte++)
+            {
+                uint64 rows = 0;
+                for (int i = 0; i < 8; i++)
+                {
+                    rows |= (uint64)((pGroup[i] >> (8 * byte)) & 0xff)
+                        << (8 * i);
+                }
+                uint64 columns = TransposeBits(rows);
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    pPlanes[(size_t)(8 * byte + bit) * planeStride]
+                        = (uint8)(columns >> (8 * bit));
+                }
+            }
+        }
+
+        std::vector<uint8> buffer(1 + GetLzBound(planesSize));
+        std::vector<uint32> hashTable;
+        size_t size = LzCompress(&planes[0], planesSize, &buffer[1],
+            hashTable);
+        if (size < count * sizeof(float))
+        {
+            buffer[0] = PACK_LZ;
+            packed.assign(buffer.begin(), buffer.begin() + 1 + size);
+        }
+        else
+        {
+            packed.resize(1 + count * sizeof(float));
+            packed[0] = PACK_RAW;
+            for (int z = 0; z < height; z++)
+            {
+                memcpy(&packed[1 + (size_t)z * (size_t)width * sizeof(float)],
+                    pValues + (size_t)z * (size_t)stride,
+                    (size_t)width * sizeof(float));
+            }
+        }
+    }
+
+    // Decompresses a tile compressed by PackTile().
+    void UnpackTile(const std::vector<uint8>& packed, int width, int height,
+        float* pDest, int destStride)
+    {
+        size_t count = (size_t)width * (size_t)height;
+        if (packed[0] == PACK_RAW)
+        {
+            for (int z = 0; z < height; z++)
+            {
+                memcpy(pDest + (size_t)z * (size_t)destStride,
+                    &packed[1 + (size_t)z * (size_t)width * sizeof(float)],
+                    (size_t)width * sizeof(float));
+            }
+            return;
+        }
+
+        size_t groupCount = (count + 7) / 8;
+        size_t planesSize = groupCount * 8 * sizeof(uint32);
+        MemoryReservation reservation(MEMORY_SCRATCH, planesSize
+            + groupCount * 8 * sizeof(uint32) + 2 * (size_t)width
+            * sizeof(uint32));
+        std::vector<uint8> planes(planesSize);
+        LzDecompress(&packed[1], &planes[0], planesSize);
+
+        std::vector<uint32> residuals(groupCount * 8);
+        for (size_t group = 0; group < groupCount; group++)
+        {
+            size_t planeStride;
+            const uint8* pPlanes = &planes[GetPlaneOffset(group, groupCount,
+                planeStride)];
+            uint32* pGroup = &residuals[group * 8];
+            for (int i = 0; i < 8; i++)
+            {
+                pGroup[i] = 0;
+            }
+            for (int byte = 0; byte < 4; byte++)
+            {
+                uint64 columns = 0;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    columns |= (uint64)pPlanes[(size_t)(8 * byte + bit)
+                        * planeStride] << (8 * bit);
+                }
+                uint64 rows = TransposeBits(columns);
+                for (int i = 0; i < 8; i++)
+                {
+                    pGroup[i] |= (uint32)((rows >> (8 * i)) & 0xff)
+                        << (8 * byte);
+                }
+            }
+        }
+
+        // Two rows of the integers are kept, for the prediction.
+        std::vector<uint32> ordered(2 * (size_t)width);
+        for (int z = 0; z < height; z++)
+        {
+            uint32* pRow = &ordered[(size_t)(z & 1) * (size_t)width];
+            const uint32* pUp = &ordered[(size_t)((z + 1) & 1) * (size_t)width];
+            const uint32* pResidual = &residuals[(size_t)z * (size_t)width];
+            float* pOut = pDest + (size_t)z * (size_t)destStride;
+            for (int x = 0; x < width; x++)
+            {
+                uint32 zigzag = pResidual[x];
+                uint32 residual = (zigzag >> 1) ^ (0u - (zigzag & 1));
+                pRow[x] = PredictOrdered(pRow, pUp, x, z) + residual;
+                pOut[x] = OrderedToFloat(pRow[x]);
+            }
+        }
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// TileCache class
+
+TileCache::TileCache(int tileWidth, int tileHeight, size_t capacity):
+    m_capacity(capacity),
+    m_hitCount(0),
+    m_hotBytes(0),
+    m_hotHitCount(0),
+    m_hotTileCount(DEFAULT_TILE_CACHE_HOT_TILE_COUNT),
+    m_isCompressionEnabled(false),
+    m_missCount(0),
+    m_storedBytes(0),
+    m_tileHeight(tileHeight),
+    m_tileWidth(tileWidth)
+{
+    if (tileWidth <= 0 || tileHeight <= 0 || capacity == 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    RegisterMemoryReclaimer(this);
+}
+
+TileCache::~TileCache()
+{
+    UnregisterMemoryReclaimer(this);
+    Clear();
+}
+
+void TileCache::Clear()
+{
+    size_t released;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        released = m_storedBytes + m_hotBytes;
+        m_entries.clear();
+        m_hotKeys.clear();
+        m_recentKeys.clear();
+        m_hotBytes = 0;
+        m_storedBytes = 0;
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+}
+
+size_t TileCache::DropHotTile()
+{
+    Entry& entry = m_entries[m_hotKeys.back()];
+    size_t bytes = entry.pValues->size() * sizeof(float);
+    entry.pValues.reset();
+    m_hotKeys.pop_back();
+    m_hotBytes -= bytes;
+    return bytes;
+}
+
+size_t TileCache::Evict(size_t bytes)
+{
+    size_t released = 0;
+    while (!m_hotKeys.empty() && m_storedBytes + m_hotBytes + bytes > m_capacity)
+    {
+        released += DropHotTile();
+    }
+    while (!m_recentKeys.empty()
+        && m_storedBytes + m_hotBytes + bytes > m_capacity)
+    {
+        released += EvictTile();
+    }
+    return released;
+}
+
+size_t TileCache::EvictTile()
+{
+    std::unordered_map<uint64, Entry>::iterator it
+        = m_entries.find(m_recentKeys.back());
+    Entry& entry = it->second;
+    size_t storedBytes = entry.pPacked != NULL ? entry.pPacked->size()
+        : entry.pValues->size() * sizeof(float);
+    size_t released = storedBytes;
+    if (entry.pPacked != NULL && entry.pValues != NULL)
+    {
+        size_t hotBytes = entry.pValues->size() * sizeof(float);
+        m_hotKeys.erase(entry.hotPos);
+        m_hotBytes -= hotBytes;
+        released += hotBytes;
+    }
+    m_storedBytes -= storedBytes;
+    m_recentKeys.pop_back();
+    m_entries.erase(it);
+    return released;
+}
+
+bool TileCache::Find(uint64 key, float* pDest, int destStride)
+{
+    if (destStride < m_tileWidth)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // Take references to the data of the tile; the tile may be evicted
+    // while it is copied or decompressed.
+    std::shared_ptr<const std::vector<float> > pValues;
+    std::shared_ptr<const std::vector<uint8> > pPacked;
+    bool isHot;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<uint64, Entry>::iterator it = m_entries.find(key);
+        if (it == m_entries.end())
+        {
+            m_missCount++;
+            return false;
+        }
+        Entry& entry = it->second;
+        m_recentKeys.splice(m_recentKeys.begin(), m_recentKeys,
+            entry.recentPos);
+        m_hitCount++;
+        pValues = entry.pValues;
+        pPacked = entry.pPacked;
+        isHot = pPacked != NULL && pValues != NULL;
+        if (isHot)
+        {
+            m_hotKeys.splice(m_hotKeys.begin(), m_hotKeys, entry.hotPos);
+            m_hotHitCount++;
+        }
+    }
+
+    if (pValues != NULL)
+    {
+        for (int z = 0; z < m_tileHeight; z++)
+        {
+            memcpy(pDest + (size_t)z * (size_t)destStride,
+                &(*pValues)[(size_t)z * (size_t)m_tileWidth],
+                (size_t)m_tileWidth * sizeof(float));
+        }
+        return true;
+    }
+
+    UnpackTile(*pPacked, m_tileWidth, m_tileHeight, pDest, destStride);
+
+    // Keep a decompressed copy.  The memory is reserved before the lock is
+    // taken, since a reservation may call ReclaimMemory().
+    if (m_hotTileCount == 0)
+    {
+        return true;
+    }
+    size_t count = (size_t)m_tileWidth * (size_t)m_tileHeight;
+    size_t hotBytes = count * sizeof(float);
+    if (hotBytes + pPacked->size() > m_capacity
+        || !TryReserveMemory(MEMORY_CACHE, hotBytes))
+    {
+        return true;
+    }
+    std::shared_ptr<std::vector<float> > pCopy;
+    try
+    {
+        pCopy.reset(new std::vector<float>(count));
+    }
+    catch (std::bad_alloc&)
+    {
+        ReleaseMemory(MEMORY_CACHE, hotBytes);
+        return true;
+    }
+    for (int z = 0; z < m_tileHeight; z++)
+    {
+        memcpy(&(*pCopy)[(size_t)z * (size_t)m_tileWidth],
+            pDest + (size_t)z * (size_t)destStride,
+            (size_t)m_tileWidth * sizeof(float));
+    }
+
+    size_t released = hotBytes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::unordered_map<uint64, Entry>::iterator it = m_entries.find(key);
+        if (it != m_entries.end() && it->second.pPacked == pPacked
+            && it->second.pValues == NULL && m_hotTileCount > 0)
+        {
+            released = 0;
+            while ((int)m_hotKeys.size() >= m_hotTileCount)
+            {
+                released += DropHotTile();
+            }
+            Entry& entry = it->second;
+            entry.pValues = pCopy;
+            m_hotKeys.push_front(key);
+            entry.hotPos = m_hotKeys.begin();
+            m_hotBytes += hotBytes;
+            released += Evict(0);
+        }
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+    return true;
+}
+
+bool TileCache::Find(uint64 key, NoiseMap& tileMap)
+{
+    tileMap.SetSize(m_tileWidth, m_tileHeight);
+    return Find(key, tileMap.GetSlabPtr(), tileMap.GetStride());
+}
+
+TileCacheStats TileCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TileCacheStats stats;
+    stats.hitCount = m_hitCount;
+    stats.hotHitCount = m_hotHitCount;
+    stats.missCount = m_missCount;
+    stats.tileCount = (int)m_entries.size();
+    stats.hotTileCount = (int)m_hotKeys.size();
+    stats.storedBytes = m_storedBytes;
+    stats.hotBytes = m_hotBytes;
+    return stats;
+}
+
+bool TileCache::Insert(uint64 key, const float* pValues, int stride)
+{
+    if (stride < m_tileWidth)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // The tile is prepared, and its memory reserved, before the lock is
+    // taken, since a reservation may call ReclaimMemory().
+    size_t count = (size_t)m_tileWidth * (size_t)m_tileHeight;
+    Entry entry;
+    size_t bytes;
+    if (m_isCompressionEnabled)
+    {
+        std::vector<uint8> packed;
+        PackTile(pValues, stride, m_tileWidth, m_tileHeight, packed);
+        bytes = packed.size();
+        if (bytes > m_capacity || !TryReserveMemory(MEMORY_CACHE, bytes))
+        {
+            return false;
+        }
+        try
+        {
+            entry.pPacked.reset(new std::vector<uint8>(packed));
+        }
+        catch (std::bad_alloc&)
+        {
+            ReleaseMemory(MEMORY_CACHE, bytes);
+            throw noise::ExceptionOutOfMemory();
+        }
+    }
+    else
+    {
+        bytes = count * sizeof(float);
+        if (bytes > m_capacity || !TryReserveMemory(MEMORY_CACHE, bytes))
+        {
+            return false;
+        }
+        std::vector<float>* pCopy;
+        try
+        {
+            pCopy = new std::vector<float>(count);
+        }
+        catch (std::bad_alloc&)
+        {
+            ReleaseMemory(MEMORY_CACHE, bytes);
+            throw noise::ExceptionOutOfMemory();
+        }
+        for (int z = 0; z < m_tileHeight; z++)
+        {
+            memcpy(&(*pCopy)[(size_t)z * (size_t)m_tileWidth],
+                pValues + (size_t)z * (size_t)stride,
+                (size_t)m_tileWidth * sizeof(float));
+        }
+        entry.pValues.reset(pCopy);
+    }
+
+    size_t released;
+    bool isInserted = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.find(key) != m_entries.end())
+        {
+            released = bytes;
+        }
+        else
+        {
+            released = Evict(bytes);
+            m_recentKeys.push_front(key);
+            entry.recentPos = m_recentKeys.begin();
+            m_entries[key] = entry;
+            m_storedBytes += bytes;
+            isInserted = true;
+        }
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+    return isInserted;
+}
+
+bool TileCache::Insert(uint64 key, const NoiseMap& tileMap)
+{
+    if (tileMap.GetWidth() != m_tileWidth
+        || tileMap.GetHeight() != m_tileHeight)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    return Insert(key, tileMap.GetConstSlabPtr(), tileMap.GetStride());
+}
+
+size_t TileCache::ReclaimMemory(size_t bytes)
+{
+    size_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_hotKeys.empty() && released < bytes)
+        {
+            released += DropHotTile();
+        }
+        while (!m_recentKeys.empty() && released < bytes)
+        {
+            released += EvictTile();
+        }
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+    return released;
+}
+
+void TileCache::SetCapacity(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    size_t released;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = capacity;
+        released = Evict(0);
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+}
+
+void TileCache::SetHotTileCount(int hotTileCount)
+{
+    if (hotTileCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    size_t released = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_hotTileCount = hotTileCount;
+        while ((int)m_hotKeys.size() > hotTileCount)
+        {
+            released += DropHotTile();
+        }
+    }
+    ReleaseMemory(MEMORY_CACHE, released);
+}
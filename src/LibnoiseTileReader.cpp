@@ -0,0 +1,1192 @@
+// LibnoiseTileReader.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <condition_variable>
+#include <deque>
+#include <errno.h>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "LibnoiseTileReader.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace noise
+{
+
+    namespace utils
+    {
+
+        // A queue of reads.  Submit() and Flush() may be called while
+        // another thread is inside Wait(); Wait() is called by one thread at
+        // a time.
+        class TileReadQueue
+        {
+
+            public:
+
+                virtual ~TileReadQueue() {}
+
+                // Starts the reads queued since the last call.
+                virtual void Flush() = 0;
+
+                // Queues a read.  Its result is the number of bytes read, or
+                // a negative errno value.
+                virtual void Submit(int fd, uint8* pBuffer, size_t size,
+                    uint64 offset, uint64 tag) = 0;
+
+                // Waits for a read to finish.
+                virtual void Wait(uint64& tag, long long& result) = 0;
+
+        };
+
+    }
+
+}
+
+namespace
+{
+
+    // Alignment of the offsets, sizes and buffers of direct I/O.
+    const size_t DIRECT_IO_ALIGNMENT = 4096;
+
+    // Number of bytes Open() reads first, which usually hold the whole
+    // index.
+    const size_t INDEX_READ_SIZE = 65536;
+
+    // Maximum number of threads of the fallback queue.
+    const int MAX_READ_THREAD_COUNT = 64;
+
+    // Number of bytes the decoder may read past the end of a tile.
+    const size_t TILE_PADDING = 8;
+
+    // Returns the size of a buffer that holds a read of a range of this size,
+    // aligned or not, and the bytes the decoder may read past its end.
+    size_t GetReadCapacity(uint64 size)
+    {
+        return (size_t)((size + 2 * (DIRECT_IO_ALIGNMENT - 1) + TILE_PADDING
+            + DIRECT_IO_ALIGNMENT - 1) & ~(uint64)(DIRECT_IO_ALIGNMENT - 1));
+    }
+
+    // Opens a file for reading.  If direct I/O is requested but not supported
+    // by the file system, opens the file without it and clears the flag.
+    int OpenFile(const char* pFileName, bool& isDirectIO)
+    {
+#ifdef O_DIRECT
+        if (isDirectIO)
+        {
+            int fd = open(pFileName, O_RDONLY | O_CLOEXEC | O_DIRECT);
+            if (fd >= 0 || errno != EINVAL)
+            {
+                return fd;
+            }
+        }
+#endif
+        isDirectIO = false;
+        return open(pFileName, O_RDONLY | O_CLOEXEC);
+    }
+
+    // A queue of blocking reads run by a pool of threads.
+    class ThreadPoolQueue: public TileReadQueue
+    {
+
+        public:
+
+            explicit ThreadPoolQueue(int threadCount);
+
+            ~ThreadPoolQueue();
+
+            void Flush()
+            {
+            }
+
+            void Submit(int fd, uint8* pBuffer, size_t size, uint64 offset,
+                uint64 tag);
+
+            void Wait(uint64& tag, long long& result);
+
+        private:
+
+            struct Request
+            {
+                int fd;
+                uint8* pBuffer;
+                size_t size;
+                uint64 offset;
+                uint64 tag;
+            };
+
+            void WorkerLoop();
+
+            // Signaled when a read finishes.
+            std::condition_variable m_completionCondition;
+
+            // The finished reads: their tags and their results.
+            std::deque<std::pair<uint64, long long> > m_completions;
+
+            // Protects the requests and the completions.
+            std::mutex m_mutex;
+
+            // Signaled when a read is queued, and when the threads stop.
+            std::condition_variable m_requestCondition;
+
+            // The queued reads.
+            std::deque<Request> m_requests;
+
+            // Determines if the threads stop once the queue is empty.
+            bool m_stop;
+
+            std::vector<std::thread> m_threads;
+
+    };
+
+    ThreadPoolQueue::ThreadPoolQueue(int threadCount):
+        m_stop(false)
+    {
+        try
+        {
+            for (int i = 0; i < threadCount; i++)
+            {
+                m_threads.emplace_back(&ThreadPoolQueue::WorkerLoop, this);
+            }
+        }
+        catch (...)
+        {
+            // Could not start every thread; the queue runs with the ones
+            // that did start.
+        }
+        if (m_threads.empty())
+        {
+            throw noise::ExceptionUnknown();
+        }
+    }
+
+    ThreadPoolQueue::~ThreadPoolQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_requestCondition.notify_all();
+        for (size_t i = 0; i < m_threads.size(); i++)
+        {
+            m_threads[i].join();
+        }
+    }
+
+    void ThreadPoolQueue::Submit(int fd, uint8* pBuffer, size_t size,
+        uint64 offset, uint64 tag)
+    {
+        Request request = {fd, pBuffer, size, offset, tag};
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requests.push_back(request);
+        }
+        m_requestCondition.notify_one();
+    }
+
+    void ThreadPoolQueue::Wait(uint64& tag, long long& result)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (m_completions.empty())
+        {
+            m_completionCondition.wait(lock);
+        }
+        tag = m_completions.front().first;
+        result = m_completions.front().second;
+        m_completions.pop_front();
+    }
+
+    void ThreadPoolQueue::WorkerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            while (m_requests.empty() && !m_stop)
+            {
+                m_requestCondition.wait(lock);
+            }
+            if (m_requests.empty())
+            {
+                return;
+            }
+            Request request = m_requests.front();
+            m_requests.pop_front();
+            lock.unlock();
+
+            ssize_t readSize = pread(request.fd, request.pBuffer, request.size,
+                (off_t)request.offset);
+            long long result = readSize >= 0 ? (long long)readSize
+                : -(long long)errno;
+
+            lock.lock();
+            m_completions.push_back(std::make_pair(request.tag, result));
+            m_completionCondition.notify_one();
+        }
+    }
+
+#ifdef __linux__
+
+    // A queue of reads submitted to the kernel through an io_uring instance.
+    // The rings are shared with the kernel: this process writes the tail of
+    // the submission ring and the head of the completion ring, the kernel
+    // writes the other two.
+    class IoUringQueue: public TileReadQueue
+    {
+
+        public:
+
+            IoUringQueue();
+
+            ~IoUringQueue();
+
+            void Flush()
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                FlushLocked();
+            }
+
+            // Sets up the rings.  Returns false if io_uring is not available.
+            bool Initialize(int entryCount);
+
+            void Submit(int fd, uint8* pBuffer, size_t size, uint64 offset,
+                uint64 tag);
+
+            void Wait(uint64& tag, long long& result);
+
+        private:
+
+            void FlushLocked();
+
+            // The completion ring.
+            uint32* m_pCqHead;
+            uint32* m_pCqTail;
+            uint32* m_pCqMask;
+            io_uring_cqe* m_pCqes;
+            void* m_pCqRing;
+            size_t m_cqRingSize;
+
+            // The reads the kernel refused to queue, with their results.
+            std::deque<std::pair<uint64, long long> > m_failures;
+
+            // Protects the rings, the refused reads and the count of reads
+            // in the kernel.
+            std::mutex m_mutex;
+
+            // The file descriptor of the instance, or -1.
+            int m_ringFd;
+
+            // The submission ring.
+            uint32* m_pSqHead;
+            uint32* m_pSqTail;
+            uint32* m_pSqMask;
+            uint32* m_pSqArray;
+            uint32 m_sqEntryCount;
+            uint32 m_submittedCount;
+            io_uring_sqe* m_pSqes;
+            size_t m_sqesSize;
+            void* m_pSqRing;
+            size_t m_sqRingSize;
+
+    };
+
+    IoUringQueue::IoUringQueue():
+        m_pCqHead(NULL),
+        m_pCqTail(NULL),
+        m_pCqMask(NULL),
+        m_pCqes(NULL),
+        m_pCqRing(NULL),
+        m_cqRingSize(0),
+        m_ringFd(-1),
+        m_pSqHead(NULL),
+        m_pSqTail(NULL),
+        m_pSqMask(NULL),
+        m_pSqArray(NULL),
+        m_sqEntryCount(0),
+        m_submittedCount(0),
+        m_pSqes(NULL),
+        m_sqesSize(0),
+        m_pSqRing(NULL),
+        m_sqRingSize(0)
+    {
+    }
+
+    IoUringQueue::~IoUringQueue()
+    {
+        if (m_pSqes != NULL)
+        {
+            munmap(m_pSqes, m_sqesSize);
+        }
+        if (m_pCqRing != NULL && m_pCqRing != m_pSqRing)
+        {
+            munmap(m_pCqRing, m_cqRingSize);
+        }
+        if (m_pSqRing != NULL)
+        {
+            munmap(m_pSqRing, m_sqRingSize);
+        }
+        if (m_ringFd >= 0)
+        {
+            close(m_ringFd);
+        }
+    }
+
+    void IoUringQueue::FlushLocked()
+    {
+        for (;;)
+        {
+            uint32 head = __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE);
+            uint32 tail = *m_pSqTail;
+            if (head == tail)
+            {
+                return;
+            }
+            long submitted = syscall(__NR_io_uring_enter, m_ringFd,
+                tail - head, 0, 0, NULL, 0);
+            if (submitted >= 0)
+            {
+                m_submittedCount += (uint32)submitted;
+                continue;
+            }
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if ((errno == EAGAIN || errno == EBUSY) && m_submittedCount > 0)
+            {
+                // The kernel is full until completions are drained; Wait()
+                // submits the rest.
+                return;
+            }
+            if (errno == EAGAIN || errno == EBUSY)
+            {
+                continue;
+            }
+
+            // The kernel refuses the reads; report them as failed, so that
+            // the reader does not wait for them.
+            long long result = -(long long)errno;
+            for (uint32 i = head; i != tail; i++)
+            {
+                const io_uring_sqe& sqe = m_pSqes[m_pSqArray[i & *m_pSqMask]];
+                m_failures.push_back(std::make_pair((uint64)sqe.user_data,
+                    result));
+            }
+            __atomic_store_n(m_pSqTail, head, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+    bool IoUringQueue::Initialize(int entryCount)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        long ringFd = syscall(__NR_io_uring_setup, (unsigned)entryCount,
+            &params);
+        if (ringFd < 0)
+        {
+            return false;
+        }
+        m_ringFd = (int)ringFd;
+
+        // Map the rings; recent kernels map both rings at once.
+        m_sqRingSize = params.sq_off.array
+            + params.sq_entries * sizeof(uint32);
+        m_cqRingSize = params.cq_off.cqes
+            + params.cq_entries * sizeof(io_uring_cqe);
+        bool isSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMap)
+        {
+            m_sqRingSize = GetMax(m_sqRingSize, m_cqRingSize);
+            m_cqRingSize = m_sqRingSize;
+        }
+        void* pRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+        if (pRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_pSqRing = pRing;
+        if (isSingleMap)
+        {
+            m_pCqRing = m_pSqRing;
+        }
+        else
+        {
+            pRing = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+            if (pRing == MAP_FAILED)
+            {
+                return false;
+            }
+            m_pCqRing = pRing;
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        pRing = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+        if (pRing == MAP_FAILED)
+        {
+            return false;
+        }
+        m_pSqes = (io_uring_sqe*)pRing;
+
+        uint8* pSqRing = (uint8*)m_pSqRing;
+        m_pSqHead = (uint32*)(pSqRing + params.sq_off.head);
+        m_pSqTail = (uint32*)(pSqRing + params.sq_off.tail);
+        m_pSqMask = (uint32*)(pSqRing + params.sq_off.ring_mask);
+        m_pSqArray = (uint32*)(pSqRing + params.sq_off.array);
+        m_sqEntryCount = params.sq_entries;
+        uint8* pCqRing = (uint8*)m_pCqRing;
+        m_pCqHead = (uint32*)(pCqRing + params.cq_off.head);
+        m_pCqTail = (uint32*)(pCqRing + params.cq_off.tail);
+        m_pCqMask = (uint32*)(pCqRing + params.cq_off.ring_mask);
+        m_pCqes = (io_uring_cqe*)(pCqRing + params.cq_off.cqes);
+        return true;
+    }
+
+    void IoUringQueue::Submit(int fd, uint8* pBuffer, size_t size,
+        uint64 offset, uint64 tag)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (*m_pSqTail - __atomic_load_n(m_pSqHead, __ATOMIC_ACQUIRE)
+            >= m_sqEntryCount)
+        {
+            FlushLocked();
+        }
+
+        uint32 tail = *m_pSqTail;
+        uint32 index = tail & *m_pSqMask;
+        io_uring_sqe& sqe = m_pSqes[index];
+        memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = (uint64)(uintptr_t)pBuffer;
+        sqe.len = (uint32)size;
+        sqe.off = offset;
+        sqe.user_data = tag;
+        m_pSqArray[index] = index;
+        __atomic_store_n(m_pSqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    void IoUringQueue::Wait(uint64& tag, long long& result)
+    {
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_failures.empty())
+                {
+                    tag = m_failures.front().first;
+                    result = m_failures.front().second;
+                    m_failures.pop_front();
+                    return;
+                }
+
+                uint32 head = *m_pCqHead;
+                if (head != __atomic_load_n(m_pCqTail, __ATOMIC_ACQUIRE))
+                {
+                    const io_uring_cqe& cqe = m_pCqes[head & *m_pCqMask];
+                    tag = cqe.user_data;
+                    result = cqe.res;
+                    __atomic_store_n(m_pCqHead, head + 1, __ATOMIC_RELEASE);
+                    m_submittedCount--;
+                    return;
+                }
+
+                // Submit the reads left in the ring by a full kernel before
+                // waiting for them.
+                FlushLocked();
+                if (!m_failures.empty())
+                {
+                    continue;
+                }
+            }
+
+            if (syscall(__NR_io_uring_enter, m_ringFd, 0, 1,
+                IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR
+                && errno != EAGAIN && errno != EBUSY)
+            {
+                throw noise::ExceptionUnknown();
+            }
+        }
+    }
+
+#endif
+
+    // Creates a queue of reads.  Falls back to a pool of threads if io_uring
+    // is requested but not available, and updates the method.
+    TileReadQueue* CreateQueue(TileReadMethod& method, int queueDepth)
+    {
+        try
+        {
+#ifdef __linux__
+            if (method == TILE_READ_IO_URING)
+            {
+                IoUringQueue* pQueue = new IoUringQueue();
+                if (pQueue->Initialize(queueDepth))
+                {
+                    return pQueue;
+                }
+                delete pQueue;
+            }
+#endif
+            method = TILE_READ_THREAD_POOL;
+            return new ThreadPoolQueue(GetMin(queueDepth,
+                MAX_READ_THREAD_COUNT));
+        }
+        catch (std::bad_alloc&)
+        {
+            throw noise::ExceptionOutOfMemory();
+        }
+    }
+
+}
+
+
+//////////////////////////////////////////////////////////////////////////////
+// TileFileReader class
+
+TileFileReader::TileFileReader():
+    m_fd(-1),
+    m_isDirectIO(false),
+    m_isDirectIORequested(false),
+    m_lastTileIndex(-1),
+    m_lastTileStep(0),
+    m_maxReadCapacity(0),
+    m_method(TILE_READ_IO_URING),
+    m_openQueueDepth(0),
+    m_pDecoder(NULL),
+    m_pQueue(NULL),
+    m_predictedTileStep(1),
+    m_prefetchCount(DEFAULT_TILE_READ_PREFETCH_COUNT),
+    m_queueDepth(DEFAULT_TILE_READ_QUEUE_DEPTH),
+    m_requestCount(0),
+    m_streamSize(0),
+    m_threadCount(0)
+{
+}
+
+TileFileReader::~TileFileReader()
+{
+    Close();
+}
+
+void TileFileReader::AllocateRead(TileRead& read, size_t capacity)
+{
+    if (read.capacity >= capacity)
+    {
+        return;
+    }
+    free(read.pBuffer);
+    read.pBuffer = NULL;
+    read.capacity = 0;
+    void* pBuffer;
+    if (posix_memalign(&pBuffer, DIRECT_IO_ALIGNMENT, capacity) != 0)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    read.pBuffer = (uint8*)pBuffer;
+    read.capacity = capacity;
+}
+
+void TileFileReader::Close()
+{
+    if (m_pQueue != NULL)
+    {
+        try
+        {
+            FinishPrefetches();
+        }
+        catch (...)
+        {
+            // The queue is broken; its destructor drops the reads.
+            DropPendingReads(m_prefetches);
+        }
+        delete m_pQueue;
+        m_pQueue = NULL;
+    }
+    FreeReads(m_prefetches);
+    m_prefetches.clear();
+    delete m_pDecoder;
+    m_pDecoder = NULL;
+    m_index.clear();
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+    m_isDirectIO = false;
+    m_lastTileIndex = -1;
+    m_lastTileStep = 0;
+    m_maxReadCapacity = 0;
+    m_openQueueDepth = 0;
+    m_predictedTileStep = 1;
+    m_requestCount = 0;
+    m_streamSize = 0;
+}
+
+bool TileFileReader::CompleteRead(TileRead& read, uint64 tag,
+    long long result)
+{
+    if (result < 0 && result != -EINTR && result != -EAGAIN)
+    {
+        read.error = (int)result;
+        read.isPending = false;
+        return true;
+    }
+    if (result > 0)
+    {
+        read.doneSize += (size_t)result;
+    }
+    if (read.doneSize >= read.requiredSize)
+    {
+        read.isPending = false;
+        return true;
+    }
+    if (result == 0 || read.doneSize >= read.readSize)
+    {
+        // The file ends before the tile.
+        read.error = -EIO;
+        read.isPending = false;
+        return true;
+    }
+
+    // Short read: queue the rest.
+    m_pQueue->Submit(m_fd, read.pBuffer + read.doneSize,
+        read.readSize - read.doneSize, read.fileOffset + read.doneSize, tag);
+    m_pQueue->Flush();
+    return false;
+}
+
+void TileFileReader::DropPendingReads(std::vector<TileRead>& reads)
+{
+    // The kernel may still write into the buffer of a read in flight after
+    // its queue is gone, so the buffer is leaked rather than freed.
+    for (size_t i = 0; i < reads.size(); i++)
+    {
+        if (reads[i].isPending)
+        {
+            reads[i].pBuffer = NULL;
+            reads[i].capacity = 0;
+            reads[i].isPending = false;
+        }
+    }
+}
+
+void TileFileReader::FinishPrefetches()
+{
+    for (size_t i = 0; i < m_prefetches.size(); i++)
+    {
+        WaitRead(m_prefetches, (int)i);
+    }
+}
+
+void TileFileReader::FreeReads(std::vector<TileRead>& reads)
+{
+    for (size_t i = 0; i < reads.size(); i++)
+    {
+        free(reads[i].pBuffer);
+        reads[i].pBuffer = NULL;
+        reads[i].capacity = 0;
+    }
+}
+
+void TileFileReader::Open(const char* pFileName)
+{
+    if (pFileName == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    Close();
+
+    std::vector<TileRead> header(1);
+    try
+    {
+        m_isDirectIO = m_isDirectIORequested;
+        m_fd = OpenFile(pFileName, m_isDirectIO);
+        struct stat status;
+        if (m_fd < 0 || fstat(m_fd, &status) != 0)
+        {
+            throw noise::ExceptionUnknown();
+        }
+        m_streamSize = (uint64)status.st_size;
+        m_openQueueDepth = m_queueDepth;
+        m_pQueue = CreateQueue(m_method, m_openQueueDepth);
+
+        // The first read also checks that the queue and direct I/O work on
+        // this file: kernels without reads through io_uring, and file
+        // systems without direct I/O, fail it with EINVAL.
+        size_t headerSize = (size_t)GetMin(m_streamSize,
+            (uint64)INDEX_READ_SIZE);
+        int error;
+        for (;;)
+        {
+            error = ReadRange(0, headerSize, header[0]);
+            if (error == -EINVAL && m_method == TILE_READ_IO_URING)
+            {
+                delete m_pQueue;
+                m_pQueue = NULL;
+                m_method = TILE_READ_THREAD_POOL;
+                m_pQueue = CreateQueue(m_method, m_openQueueDepth);
+                continue;
+            }
+            if (error == -EINVAL && m_isDirectIO)
+            {
+                close(m_fd);
+                m_isDirectIO = false;
+                m_fd = OpenFile(pFileName, m_isDirectIO);
+                if (m_fd < 0)
+                {
+                    throw noise::ExceptionUnknown();
+                }
+                continue;
+            }
+            break;
+        }
+        if (error != 0)
+        {
+            throw noise::ExceptionUnknown();
+        }
+
+        size_t indexSize = HeightMapDecoder::GetIndexSize(
+            header[0].pBuffer + header[0].dataOffset, headerSize);
+        if (indexSize == 0 || indexSize > m_streamSize)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+        if (indexSize > headerSize && ReadRange(0, indexSize, header[0]) != 0)
+        {
+            throw noise::ExceptionUnknown();
+        }
+        const uint8* pIndex = header[0].pBuffer + header[0].dataOffset;
+        try
+        {
+            m_index.assign(pIndex, pIndex + indexSize);
+            m_pDecoder = new HeightMapDecoder(&m_index[0], indexSize,
+                m_streamSize);
+        }
+        catch (std::bad_alloc&)
+        {
+            throw noise::ExceptionOutOfMemory();
+        }
+
+        // Size the buffers for the largest tile.
+        uint64 maxTileSize = 0;
+        for (int tileZ = 0; tileZ < m_pDecoder->GetTileCountZ(); tileZ++)
+        {
+            for (int tileX = 0; tileX < m_pDecoder->GetTileCountX(); tileX++)
+            {
+                uint64 offset;
+                uint64 size;
+                m_pDecoder->GetTileRange(tileX, tileZ, offset, size);
+                maxTileSize = GetMax(maxTileSize, size);
+            }
+        }
+        m_maxReadCapacity = GetReadCapacity(maxTileSize);
+    }
+    catch (...)
+    {
+        DropPendingReads(header);
+        FreeReads(header);
+        Close();
+        throw;
+    }
+    FreeReads(header);
+}
+
+void TileFileReader::Read(NoiseMap& heightMap)
+{
+    if (m_pDecoder == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    FinishPrefetches();
+
+    const HeightMapDecoder& decoder = *m_pDecoder;
+    heightMap.SetSize(decoder.GetWidth(), decoder.GetHeight());
+
+    int tileCountX = decoder.GetTileCountX();
+    int tileCount = tileCountX * decoder.GetTileCountZ();
+    int tileSize = decoder.GetTileSize();
+    int slotCount = GetMin(m_openQueueDepth, tileCount);
+    int workerCount = GetMin(ResolveThreadCount(m_threadCount), tileCount);
+    MemoryReservation reservation(MEMORY_SCRATCH,
+        (size_t)slotCount * m_maxReadCapacity);
+    std::vector<TileRead> slots;
+    try
+    {
+        slots.resize((size_t)slotCount);
+        for (int i = 0; i < slotCount; i++)
+        {
+            AllocateRead(slots[i], m_maxReadCapacity);
+        }
+    }
+    catch (...)
+    {
+        FreeReads(slots);
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // The tiles are read in the order of the file, one per slot.  The
+    // workers take turns waiting for the queue, and decode the tiles that
+    // arrived; once a tile is decoded, its slot reads the next tile.
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<int> readySlots;
+    std::exception_ptr pError;
+    int decodingCount = 0;
+    int inFlightCount = 0;
+    bool isQueueBroken = false;
+    bool isWaiting = false;
+    int nextTile = 0;
+    for (int i = 0; i < slotCount; i++)
+    {
+        SubmitTile(slots[i], nextTile++, (uint64)i);
+        inFlightCount++;
+    }
+    m_pQueue->Flush();
+
+    try
+    {
+        ParallelFor(workerCount, workerCount,
+            [&](int, int)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                for (;;)
+                {
+                    if (!readySlots.empty())
+                    {
+                        int slot = readySlots.front();
+                        readySlots.pop_front();
+                        TileRead& read = slots[slot];
+                        if (!pError)
+                        {
+                            decodingCount++;
+                            lock.unlock();
+                            std::exception_ptr pDecodeError;
+                            try
+                            {
+                                int tileX = read.tileIndex % tileCountX;
+                                int tileZ = read.tileIndex / tileCountX;
+                                decoder.DecodeTile(tileX, tileZ,
+                                    read.pBuffer + read.dataOffset,
+                                    heightMap.GetSlabPtr(tileX * tileSize,
+                                    tileZ * tileSize), heightMap.GetStride());
+                            }
+                            catch (...)
+                            {
+                                pDecodeError = std::current_exception();
+                            }
+                            lock.lock();
+                            decodingCount--;
+                            if (pDecodeError && !pError)
+                            {
+                                pError = pDecodeError;
+                            }
+                        }
+                        if (!pError && nextTile < tileCount)
+                        {
+                            SubmitTile(read, nextTile++, (uint64)slot);
+                            m_pQueue->Flush();
+                            inFlightCount++;
+                        }
+                        condition.notify_all();
+                        continue;
+                    }
+
+                    if (inFlightCount == 0)
+                    {
+                        if (decodingCount == 0)
+                        {
+                            return;
+                        }
+                        condition.wait(lock);
+                        continue;
+                    }
+                    if (isWaiting)
+                    {
+                        condition.wait(lock);
+                        continue;
+                    }
+
+                    // Wait for the queue on behalf of the other workers.
+                    isWaiting = true;
+                    lock.unlock();
+                    uint64 tag;
+                    long long result;
+                    try
+                    {
+                        m_pQueue->Wait(tag, result);
+                    }
+                    catch (...)
+                    {
+                        lock.lock();
+                        isWaiting = false;
+                        if (!pError)
+                        {
+                            pError = std::current_exception();
+                        }
+                        inFlightCount = 0;
+                        isQueueBroken = true;
+                        condition.notify_all();
+                        return;
+                    }
+                    lock.lock();
+                    isWaiting = false;
+                    inFlightCount--;
+                    TileRead& read = slots[tag];
+                    if (!CompleteRead(read, tag, result))
+                    {
+                        inFlightCount++;
+                    }
+                    else if (read.error != 0)
+                    {
+                        if (!pError)
+                        {
+                            pError = std::make_exception_ptr(
+                                noise::ExceptionUnknown());
+                        }
+                    }
+                    else
+                    {
+                        readySlots.push_back((int)tag);
+                    }
+                    condition.notify_all();
+                }
+            });
+    }
+    catch (...)
+    {
+        pError = std::current_exception();
+        isQueueBroken = true;
+    }
+    if (isQueueBroken)
+    {
+        // Reads may still be in flight: close the file, which tears down the
+        // queue, before the buffers are released.
+        DropPendingReads(slots);
+        Close();
+    }
+    FreeReads(slots);
+    if (pError)
+    {
+        std::rethrow_exception(pError);
+    }
+}
+
+int TileFileReader::ReadRange(uint64 offset, size_t size, TileRead& read)
+{
+    AllocateRead(read, GetReadCapacity(size));
+    SubmitRange(read, offset, size, 0);
+    m_pQueue->Flush();
+    while (read.isPending)
+    {
+        uint64 tag;
+        long long result;
+        m_pQueue->Wait(tag, result);
+        CompleteRead(read, tag, result);
+    }
+    return read.error;
+}
+
+void TileFileReader::ReadTile(int tileX, int tileZ, float* pDest,
+    int destStride)
+{
+    if (m_pDecoder == NULL || tileX < 0
+        || tileX >= m_pDecoder->GetTileCountX() || tileZ < 0
+        || tileZ >= m_pDecoder->GetTileCountZ() || pDest == NULL
+        || destStride < m_pDecoder->GetTileWidth(tileX))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    // Follow the access pattern: a step seen twice in a row becomes the
+    // predicted step.
+    int tileCount = m_pDecoder->GetTileCountX() * m_pDecoder->GetTileCountZ();
+    int tileIndex = tileZ * m_pDecoder->GetTileCountX() + tileX;
+    if (m_lastTileIndex >= 0)
+    {
+        int step = tileIndex - m_lastTileIndex;
+        if (step != 0 && step == m_lastTileStep)
+        {
+            m_predictedTileStep = step;
+        }
+        m_lastTileStep = step;
+    }
+    m_lastTileIndex = tileIndex;
+    m_requestCount++;
+
+    // The reads in flight must fit in the queue created by Open(), even if
+    // the prefetch count was raised since.
+    int prefetchCount = GetMin(m_prefetchCount, m_openQueueDepth - 1);
+    try
+    {
+        if (m_prefetches.size() < (size_t)prefetchCount + 1)
+        {
+            m_prefetches.resize((size_t)prefetchCount + 1);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Find the tile among the tiles read ahead, or read it, along with the
+    // tiles predicted to come next.  Tiles used by this request are never
+    // evicted by it; the others are evicted least recently used first.
+    int readIndex = -1;
+    for (int i = 0; i <= prefetchCount; i++)
+    {
+        int tile = tileIndex + i * m_predictedTileStep;
+        if (i > 0 && (tile < 0 || tile >= tileCount))
+        {
+            break;
+        }
+        int index = -1;
+        int victim = -1;
+        for (size_t j = 0; j < m_prefetches.size(); j++)
+        {
+            const TileRead& read = m_prefetches[j];
+            if (read.tileIndex == tile)
+            {
+                index = (int)j;
+                break;
+            }
+            if (!read.isPending && read.useStamp < m_requestCount
+                && (victim < 0
+                || read.useStamp < m_prefetches[victim].useStamp))
+            {
+                victim = (int)j;
+            }
+        }
+        if (index < 0)
+        {
+            if (victim < 0)
+            {
+                if (i > 0)
+                {
+                    break;
+                }
+
+                // Every buffer holds a read in flight; start over once they
+                // finish.
+                FinishPrefetches();
+                i = -1;
+                continue;
+            }
+            index = victim;
+            m_prefetches[index].tileIndex = -1;
+            AllocateRead(m_prefetches[index], m_maxReadCapacity);
+            SubmitTile(m_prefetches[index], tile, (uint64)index);
+        }
+        m_prefetches[index].useStamp = m_requestCount;
+        if (i == 0)
+        {
+            readIndex = index;
+        }
+    }
+    m_pQueue->Flush();
+
+    WaitRead(m_prefetches, readIndex);
+    TileRead& read = m_prefetches[readIndex];
+    if (read.error != 0)
+    {
+        read.tileIndex = -1;
+        throw noise::ExceptionUnknown();
+    }
+    m_pDecoder->DecodeTile(tileX, tileZ, read.pBuffer + read.dataOffset,
+        pDest, destStride);
+}
+
+void TileFileReader::SetPrefetchCount(int prefetchCount)
+{
+    if (prefetchCount < 0 || prefetchCount >= m_queueDepth)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_prefetchCount = prefetchCount;
+}
+
+void TileFileReader::SetQueueDepth(int queueDepth)
+{
+    if (queueDepth <= 0 || queueDepth > TILE_READ_MAX_QUEUE_DEPTH
+        || queueDepth <= m_prefetchCount)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    m_queueDepth = queueDepth;
+}
+
+void TileFileReader::SubmitRange(TileRead& read, uint64 offset, uint64 size,
+    uint64 tag)
+{
+    // Direct I/O reads whole aligned blocks around the range.
+    uint64 start = offset;
+    uint64 end = offset + size;
+    if (m_isDirectIO)
+    {
+        start &= ~(uint64)(DIRECT_IO_ALIGNMENT - 1);
+        end = (end + DIRECT_IO_ALIGNMENT - 1)
+            & ~(uint64)(DIRECT_IO_ALIGNMENT - 1);
+    }
+    read.dataOffset = (size_t)(offset - start);
+    read.doneSize = 0;
+    read.error = 0;
+    read.fileOffset = start;
+    read.isPending = true;
+    read.readSize = (size_t)(end - start);
+    read.requiredSize = read.dataOffset + (size_t)size;
+    m_pQueue->Submit(m_fd, read.pBuffer, read.readSize, start, tag);
+}
+
+void TileFileReader::SubmitTile(TileRead& read, int tileIndex, uint64 tag)
+{
+    int tileCountX = m_pDecoder->GetTileCountX();
+    uint64 offset;
+    uint64 size;
+    m_pDecoder->GetTileRange(tileIndex % tileCountX, tileIndex / tileCountX,
+        offset, size);
+    read.tileIndex = tileIndex;
+    SubmitRange(read, offset, size, tag);
+}
+
+void TileFileReader::WaitRead(std::vector<TileRead>& reads, int index)
+{
+    while (reads[index].isPending)
+    {
+        uint64 tag;
+        long long result;
+        m_pQueue->Wait(tag, result);
+        CompleteRead(reads[tag], tag, result);
+    }
+}
@@ -0,0 +1,506 @@
+// LibnoiseTuner.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <typeinfo>
+
+#include "LibnoiseTuner.h"
+
+using namespace noise;
+using namespace noise::module;
+using namespace noise::utils;
+
+namespace
+{
+
+    // FNV-1a parameters.
+    const uint64 FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    const uint64 FNV_PRIME = 1099511628211ULL;
+
+    void HashBytes(uint64& hash, const void* pData, size_t size)
+    {
+        const unsigned char* pBytes = (const unsigned char*)pData;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= pBytes[i];
+            hash *= FNV_PRIME;
+        }
+    }
+
+    void HashString(uint64& hash, const char* pString)
+    {
+        HashBytes(hash, pString, strlen(pString) + 1);
+    }
+
+    // Hashes the types and connections of every noise module reachable from
+    // the specified module.  A module that was already visited is hashed by
+    // its visit index only, so shared subgraphs are walked once.
+    void HashModule(uint64& hash, const Module& sourceModule,
+        std::map<const Module*, int>& visited)
+    {
+        std::map<const Module*, int>::const_iterator it
+            = visited.find(&sourceModule);
+        if (it != visited.end())
+        {
+            HashBytes(hash, &it->second, sizeof(it->second));
+            return;
+        }
+        int index = (int)visited.size();
+        visited[&sourceModule] = index;
+
+        HashString(hash, typeid(sourceModule).name());
+        int sourceModuleCount = sourceModule.GetSourceModuleCount();
+        HashBytes(hash, &sourceModuleCount, sizeof(sourceModuleCount));
+        for (int i = 0; i < sourceModuleCount; i++)
+        {
+            const Module* pChild = NULL;
+            try
+            {
+                pChild = &sourceModule.GetSourceModule(i);
+            }
+            catch (noise::ExceptionNoModule&)
+            {
+                pChild = NULL;
+            }
+            if (pChild != NULL)
+            {
+                HashModule(hash, *pChild, visited);
+            }
+            else
+            {
+                HashString(hash, "<none>");
+            }
+        }
+    }
+
+    // Fixed positions at which the root module is sampled to distinguish
+    // graphs that differ only in their parameters.
+    const NOISE_REAL PROBE_POSITIONS[][2] = {
+        {  0.1234,   0.5678},
+        {  1.7071,  -2.3183},
+        { -3.1416,   2.7183},
+        { 10.5000,  11.2500},
+        {-17.3333, -42.6667},
+        {123.4560,  -7.8900},
+        {  0.0078,  99.0030},
+        {-64.2500,  31.1250}
+    };
+
+}
+
+BuildTuner::BuildTuner():
+    m_calibrationHeight(DEFAULT_TUNER_CALIBRATION_SIZE),
+    m_calibrationWidth(DEFAULT_TUNER_CALIBRATION_SIZE),
+    m_cpuModel(GetCpuModel()),
+    m_repeatCount(DEFAULT_TUNER_REPEAT_COUNT)
+{
+    int concurrency = GetDefaultExecutor().GetConcurrency();
+    m_tileSizes.push_back(16);
+    m_tileSizes.push_back(32);
+    m_tileSizes.push_back(64);
+    m_tileSizes.push_back(128);
+    m_batchWidths.push_back(16);
+    m_batchWidths.push_back(64);
+    m_batchWidths.push_back(256);
+    m_threadCounts.push_back(1);
+    if (concurrency >= 4)
+    {
+        m_threadCounts.push_back(concurrency / 2);
+    }
+    if (concurrency > 1)
+    {
+        m_threadCounts.push_back(concurrency);
+    }
+}
+
+BuildTuner::BuildTuner(const std::string& cacheFilename):
+    BuildTuner()
+{
+    SetCacheFile(cacheFilename);
+}
+
+BuildConfig BuildTuner::Calibrate(const NoiseMapBuilder& builder)
+{
+    const Module* pSourceModule = builder.GetSourceModule();
+    if (pSourceModule == NULL
+        || builder.GetUpperXBound() <= builder.GetLowerXBound()
+        || builder.GetUpperZBound() <= builder.GetLowerZBound())
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    std::vector<int> tileSizes, batchWidths, threadCounts;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        tileSizes = m_tileSizes;
+        batchWidths = m_batchWidths;
+        threadCounts = m_threadCounts;
+    }
+
+    // Search one parameter at a time, starting from the builder's own
+    // configuration.  The thread count is searched first because it affects
+    // the build time the most.
+    BuildConfig best = builder.GetBuildConfig();
+    double bestTime = TimeConfig(builder, best);
+    for (size_t i = 0; i < threadCounts.size(); i++)
+    {
+        BuildConfig candidate = best;
+        candidate.threadCount = threadCounts[i];
+        double time = TimeConfig(builder, candidate);
+        if (time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+    for (size_t i = 0; i < tileSizes.size(); i++)
+    {
+        BuildConfig candidate = best;
+        candidate.tileWidth  = tileSizes[i];
+        candidate.tileHeight = tileSizes[i];
+        double time = TimeConfig(builder, candidate);
+        if (time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+    for (size_t i = 0; i < batchWidths.size(); i++)
+    {
+        BuildConfig candidate = best;
+        candidate.batchWidth = batchWidths[i];
+        double time = TimeConfig(builder, candidate);
+        if (time < bestTime)
+        {
+            best = candidate;
+            bestTime = time;
+        }
+    }
+
+    std::string key = MakeKey(builder.GetSourceModuleHash());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_configs[key] = best;
+    SaveLocked();
+    return best;
+}
+
+std::string BuildTuner::GetCacheFile() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_cacheFilename;
+}
+
+BuildConfig BuildTuner::GetConfig(const NoiseMapBuilder& builder)
+{
+    // The builder keeps the hash of its graph, so a stored configuration is
+    // found without walking the graph again.
+    if (builder.GetSourceModule() != NULL)
+    {
+        std::string key = MakeKey(builder.GetSourceModuleHash());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::map<std::string, BuildConfig>::const_iterator it
+            = m_configs.find(key);
+        if (it != m_configs.end())
+        {
+            return it->second;
+        }
+    }
+    return Calibrate(builder);
+}
+
+std::string BuildTuner::GetCpuModel()
+{
+    std::string model;
+    std::ifstream cpuInfo("/proc/cpuinfo");
+    std::string line;
+    while (model.empty() && std::getline(cpuInfo, line))
+    {
+        if (line.compare(0, 10, "model name") == 0)
+        {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos)
+            {
+                size_t first = line.find_first_not_of(" \t", colon + 1);
+                if (first != std::string::npos)
+                {
+                    model = line.substr(first);
+                }
+            }
+        }
+    }
+    if (model.empty())
+    {
+        model = "unknown-cpu";
+    }
+
+    // Containers may expose only part of a machine, so the thread count is
+    // part of the model name.
+    std::ostringstream out;
+    out << model << " x" << GetHardwareThreadCount();
+    std::string result = out.str();
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        if (result[i] == '\t')
+        {
+            result[i] = ' ';
+        }
+    }
+    return result;
+}
+
+uint64 BuildTuner::HashGraph(const Module& sourceModule)
+{
+    uint64 hash = FNV_OFFSET_BASIS;
+    std::map<const Module*, int> visited;
+    HashModule(hash, sourceModule, visited);
+
+    int probeCount = (int)(sizeof(PROBE_POSITIONS) / sizeof(PROBE_POSITIONS[0]));
+    for (int i = 0; i < probeCount; i++)
+    {
+        NOISE_REAL value = sourceModule.GetValue(PROBE_POSITIONS[i][0],
+            PROBE_POSITIONS[i][1]);
+        HashBytes(hash, &value, sizeof(value));
+    }
+    return hash;
+}
+
+void BuildTuner::Load()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cacheFilename.empty())
+    {
+        return;
+    }
+
+    // Each line holds a CPU model, a graph hash and a configuration, separated
+    // by tabs.
+    std::ifstream in(m_cacheFilename.c_str());
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t lastTab = line.rfind('\t');
+        if (lastTab == std::string::npos || lastTab == 0)
+        {
+            continue;
+        }
+        std::istringstream values(line.substr(lastTab + 1));
+        BuildConfig config;
+        if (!(values >> config.tileWidth >> config.tileHeight
+            >> config.batchWidth >> config.threadCount)
+            || config.tileWidth < 1 || config.tileHeight < 1
+            || config.batchWidth < 1
+            || config.batchWidth > BUILDER_MAX_BATCH_WIDTH
+            || config.threadCount < 0)
+        {
+            continue;
+        }
+        m_configs[line.substr(0, lastTab)] = config;
+    }
+}
+
+bool BuildTuner::Lookup(const Module& sourceModule, BuildConfig& config) const
+{
+    std::string key = MakeKey(HashGraph(sourceModule));
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::map<std::string, BuildConfig>::const_iterator it = m_configs.find(key);
+    if (it == m_configs.end())
+    {
+        return false;
+    }
+    config = it->second;
+    return true;
+}
+
+std::string BuildTuner::MakeKey(uint64 graphHash) const
+{
+    std::ostringstream key;
+    key << m_cpuModel << '\t' << std::hex << graphHash;
+    return key.str();
+}
+
+void BuildTuner::Save() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    SaveLocked();
+}
+
+void BuildTuner::SaveLocked() const
+{
+    if (m_cacheFilename.empty())
+    {
+        return;
+    }
+
+    // Write to a temporary file first so that another process never reads a
+    // partially written cache file.
+    std::string tempFilename = m_cacheFilename + ".tmp";
+    {
+        std::ofstream out(tempFilename.c_str(), std::ios::trunc);
+        if (!out)
+        {
+            return;
+        }
+        std::map<std::string, BuildConfig>::const_iterator it;
+        for (it = m_configs.begin(); it != m_configs.end(); ++it)
+        {
+            out << it->first << '\t'
+                << it->second.tileWidth  << ' '
+                << it->second.tileHeight << ' '
+                << it->second.batchWidth << ' '
+                << it->second.threadCount << '\n';
+        }
+        if (!out)
+        {
+            return;
+        }
+    }
+    std::rename(tempFilename.c_str(), m_cacheFilename.c_str());
+}
+
+void BuildTuner::SetCacheFile(const std::string& cacheFilename)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cacheFilename = cacheFilename;
+    }
+    Load();
+}
+
+void BuildTuner::SetCalibrationSize(int width, int height)
+{
+    if (width < 1 || height < 1)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_calibrationWidth  = width ;
+    m_calibrationHeight = height;
+}
+
+void BuildTuner::SetCandidates(const std::vector<int>& tileSizes,
+    const std::vector<int>& batchWidths, const std::vector<int>& threadCounts)
+{
+    if (tileSizes.empty() || batchWidths.empty() || threadCounts.empty())
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+    for (size_t i = 0; i < tileSizes.size(); i++)
+    {
+        if (tileSizes[i] < 1)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+    }
+    for (size_t i = 0; i < batchWidths.size(); i++)
+    {
+        if (batchWidths[i] < 1 || batchWidths[i] > BUILDER_MAX_BATCH_WIDTH)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+    }
+    for (size_t i = 0; i < threadCounts.size(); i++)
+    {
+        if (threadCounts[i] < 0)
+        {
+            throw noise::ExceptionInvalidParam();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tileSizes = tileSizes;
+    m_batchWidths = batchWidths;
+    m_threadCounts = threadCounts;
+}
+
+void BuildTuner::SetRepeatCount(int repeatCount)
+{
+    if (repeatCount < 1)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_repeatCount = repeatCount;
+}
+
+double BuildTuner::TimeConfig(const NoiseMapBuilder& builder,
+    const BuildConfig& config) const
+{
+    int calibrationWidth, calibrationHeight, repeatCount;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        calibrationWidth  = m_calibrationWidth ;
+        calibrationHeight = m_calibrationHeight;
+        repeatCount = m_repeatCount;
+    }
+
+    // Build the lower-left corner of the builder's noise map at the same point
+    // spacing as the real build, so that the calibration sees the same
+    // coherence between neighbouring points.
+    NOISE_REAL lowerXBound = builder.GetLowerXBound();
+    NOISE_REAL upperXBound = builder.GetUpperXBound();
+    NOISE_REAL lowerZBound = builder.GetLowerZBound();
+    NOISE_REAL upperZBound = builder.GetUpperZBound();
+    int destWidth  = (int)builder.GetDestWidth ();
+    int destHeight = (int)builder.GetDestHeight();
+    if (destWidth > calibrationWidth)
+    {
+        upperXBound = lowerXBound + (upperXBound - lowerXBound)
+            * (NOISE_REAL)calibrationWidth / (NOISE_REAL)destWidth;
+    }
+    if (destHeight > calibrationHeight)
+    {
+        upperZBound = lowerZBound + (upperZBound - lowerZBound)
+            * (NOISE_REAL)calibrationHeight / (NOISE_REAL)destHeight;
+    }
+    if (destWidth > 0 && destWidth < calibrationWidth)
+    {
+        calibrationWidth = destWidth;
+    }
+    if (destHeight > 0 && destHeight < calibrationHeight)
+    {
+        calibrationHeight = destHeight;
+    }
+
+    NoiseMap scratchMap;
+    NoiseMapBuilder calibrationBuilder(builder);
+    calibrationBuilder.SetTuner(NULL);
+    calibrationBuilder.SetBuildConfig(config);
+    calibrationBuilder.SetDestNoiseMap(scratchMap);
+    calibrationBuilder.SetDestSize(calibrationWidth, calibrationHeight);
+    calibrationBuilder.SetBounds(lowerXBound, upperXBound,
+        lowerZBound, upperZBound);
+
+    double bestTime = 0.0;
+    for (int i = 0; i < repeatCount; i++)
+    {
+        std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+        calibrationBuilder.Build();
+        double time = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || time < bestTime)
+        {
+            bestTime = time;
+        }
+    }
+    return bestTime;
+}
@@ -20,12 +20,18 @@
 // off every 'zig'.)
 //
 
+#include <atomic>
+#include <exception>
 #include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <interp.h>
 #include <mathconsts.h>
 
 #include "LibnoiseUtils.h"
+#include "LibnoiseTuner.h"
 
 using namespace noise;
 using namespace noise::model;
@@ -59,7 +65,52 @@ NoiseMap::NoiseMap(const NoiseMap& rhs)
 
 NoiseMap::~NoiseMap()
 {
-    delete[] m_pNoiseMap;
+    FreeBuffer(m_pNoiseMap, m_memUsed);
+}
+
+float* NoiseMap::AllocateBuffer(size_t count)
+{
+    size_t bytes = count * sizeof(float);
+    ReserveMemory(MEMORY_RASTER, bytes);
+
+    // The reservation may succeed while the allocation still fails (the
+    // budget is not the only limit.)  Let the reclaimers give memory back
+    // before giving up.
+    float* pBuffer = NULL;
+    try
+    {
+        pBuffer = new float[count];
+    }
+    catch (...)
+    {
+        pBuffer = NULL;
+    }
+    if (pBuffer == NULL && ReclaimMemory(bytes) > 0)
+    {
+        try
+        {
+            pBuffer = new float[count];
+        }
+        catch (...)
+        {
+            pBuffer = NULL;
+        }
+    }
+    if (pBuffer == NULL)
+    {
+        ReleaseMemory(MEMORY_RASTER, bytes);
+        throw noise::ExceptionOutOfMemory();
+    }
+    return pBuffer;
+}
+
+void NoiseMap::FreeBuffer(float* pBuffer, size_t count)
+{
+    if (pBuffer != NULL)
+    {
+        delete[] pBuffer;
+        ReleaseMemory(MEMORY_RASTER, count * sizeof(float));
+    }
 }
 
 NoiseMap& NoiseMap::operator= (const NoiseMap& rhs)
@@ -102,7 +153,7 @@ void NoiseMap::CopyNoiseMap(const NoiseMap& source)
 
 void NoiseMap::DeleteNoiseMapAndReset()
 {
-    delete[] m_pNoiseMap;
+    FreeBuffer(m_pNoiseMap, m_memUsed);
     InitObj();
 }
 
@@ -137,17 +188,9 @@ void NoiseMap::ReclaimMem()
     {
         // There is wasted memory.  Create the smallest buffer that can fit the
         // data and copy the data to it.
-        float* pNewNoiseMap = NULL;
-        try
-        {
-            pNewNoiseMap = new float[newMemUsage];
-        }
-        catch (...)
-        {
-            throw noise::ExceptionOutOfMemory();
-        }
+        float* pNewNoiseMap = AllocateBuffer(newMemUsage);
         memcpy(pNewNoiseMap, m_pNoiseMap, newMemUsage * sizeof(float));
-        delete[] m_pNoiseMap;
+        FreeBuffer(m_pNoiseMap, m_memUsed);
         m_pNoiseMap = pNewNoiseMap;
         m_memUsed = newMemUsage;
     }
@@ -178,14 +221,7 @@ void NoiseMap::SetSize(int width, int height)
             // The new size is too big for the current noise map buffer.  We need to
             // NOISE_REALlocate.
             DeleteNoiseMapAndReset();
-            try
-            {
-                m_pNoiseMap = new float[newMemUsage];
-            }
-            catch (...)
-            {
-                throw noise::ExceptionOutOfMemory();
-            }
+            m_pNoiseMap = AllocateBuffer(newMemUsage);
             m_memUsed = newMemUsage;
         }
         m_stride = (int)CalcStride(width);
@@ -209,7 +245,7 @@ void NoiseMap::TakeOwnership(NoiseMap& source)
 {
     // Copy the values and the noise map buffer from the source noise map to
     // this noise map.  Now this noise map pwnz the source buffer.
-    delete[] m_pNoiseMap;
+    FreeBuffer(m_pNoiseMap, m_memUsed);
     m_memUsed   = source.m_memUsed;
     m_height    = source.m_height;
     m_pNoiseMap = source.m_pNoiseMap;
@@ -222,6 +258,46 @@ void NoiseMap::TakeOwnership(NoiseMap& source)
 }
 
 
+//////////////////////////////////////////////////////////////////////////////
+// NoiseMapBuilder class
+
+NoiseMapBuilder::NoiseMapBuilder(const NoiseMapBuilder& rhs)
+{
+    *this = rhs;
+}
+
+NoiseMapBuilder& NoiseMapBuilder::operator= (const NoiseMapBuilder& rhs)
+{
+    m_buildConfig = rhs.m_buildConfig;
+    m_pLatency = rhs.m_pLatency;
+    m_pTuner = rhs.m_pTuner;
+    m_destHeight = rhs.m_destHeight;
+    m_destWidth = rhs.m_destWidth;
+    m_pDestNoiseMap = rhs.m_pDestNoiseMap;
+    m_pSourceModule = rhs.m_pSourceModule;
+    m_sourceModuleHash.store(rhs.m_sourceModuleHash.load(
+        std::memory_order_relaxed), std::memory_order_relaxed);
+    m_isSeamlessEnabled = rhs.m_isSeamlessEnabled;
+    m_lowerXBound = rhs.m_lowerXBound;
+    m_lowerZBound = rhs.m_lowerZBound;
+    m_upperXBound = rhs.m_upperXBound;
+    m_upperZBound = rhs.m_upperZBound;
+
+    return *this;
+}
+
+void NoiseMapBuilder::SetBuildConfig(const BuildConfig& config)
+{
+    if (config.tileWidth < 1 || config.tileHeight < 1
+        || config.batchWidth < 1 || config.batchWidth > BUILDER_MAX_BATCH_WIDTH
+        || config.threadCount < 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_buildConfig = config;
+}
+
 void NoiseMapBuilder::Build()
 {
     if (m_upperXBound <= m_lowerXBound
@@ -238,106 +314,300 @@ void NoiseMapBuilder::Build()
     // values from the source model.
     m_pDestNoiseMap->SetSize(m_destWidth, m_destHeight);
 
-    // Create the plane model.
-    model::Plane planeModel;
-    planeModel.SetModule(*m_pSourceModule);
+    BuildBand(*m_pDestNoiseMap, 0, m_destHeight, GetEffectiveConfig());
+}
+
+void NoiseMapBuilder::BuildRows(std::function<void(int, const float*)> fRowCallback)
+{
+    if (m_upperXBound <= m_lowerXBound
+        || m_upperZBound <= m_lowerZBound
+        || m_destWidth <= 0
+        || m_destHeight <= 0
+        || m_pSourceModule == NULL)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    BuildConfig config = GetEffectiveConfig();
+
+    // A band as tall as one row of tiles keeps every worker thread busy.  Use
+    // at most half of the available memory for it, so that the scratch space
+    // and the caller still have room, but always build at least one row.
+    size_t rowBytes = (size_t)(m_destWidth + RASTER_STRIDE_BOUNDARY)
+        * sizeof(float);
+    size_t availableRows = GetAvailableMemory() / 2 / rowBytes;
+    int bandHeight = GetMin(config.tileHeight, m_destHeight);
+    if (availableRows < (size_t)bandHeight)
+    {
+        bandHeight = GetMax((int)availableRows, 1);
+        config.tileHeight = bandHeight;
+    }
+
+    NoiseMap band(m_destWidth, bandHeight);
+    for (int rowOffset = 0; rowOffset < m_destHeight; rowOffset += bandHeight)
+    {
+        int rowCount = GetMin(bandHeight, m_destHeight - rowOffset);
+        BuildBand(band, rowOffset, rowCount, config);
+        for (int z = 0; z < rowCount; z++)
+        {
+            fRowCallback(rowOffset + z, band.GetConstSlabPtr(z));
+        }
+    }
+}
+
+void NoiseMapBuilder::BuildVariants(NoiseMap* pDestNoiseMaps,
+    const module::ModuleVariant* pVariants, int variantCount)
+{
+    if (m_upperXBound <= m_lowerXBound
+        || m_upperZBound <= m_lowerZBound
+        || m_destWidth <= 0
+        || m_destHeight <= 0
+        || m_pSourceModule == NULL
+        || pDestNoiseMaps == NULL
+        || pVariants == NULL
+        || variantCount <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    for (int i = 0; i < variantCount; i++)
+    {
+        pDestNoiseMaps[i].SetSize(m_destWidth, m_destHeight);
+    }
 
     NOISE_REAL xExtent = m_upperXBound - m_lowerXBound;
     NOISE_REAL zExtent = m_upperZBound - m_lowerZBound;
     NOISE_REAL xDelta  = xExtent / (NOISE_REAL)m_destWidth ;
     NOISE_REAL zDelta  = zExtent / (NOISE_REAL)m_destHeight;
-    NOISE_REAL xCur    = m_lowerXBound;
-    NOISE_REAL zCur    = m_lowerZBound;
 
-    // Fill every point in the noise map with the output values from the model.
-    for (int z = 0; z < m_destHeight; z++)
+    // Each row evaluates its points for up to MODULE_MAX_VARIANT_COUNT
+    // variants at a time, and scatters the lanes to the noise maps.
+    ParallelFor(m_destHeight, m_buildConfig.threadCount,
+        [&](int z, int)
+        {
+            NOISE_REAL sw[module::MODULE_MAX_VARIANT_COUNT];
+            NOISE_REAL se[module::MODULE_MAX_VARIANT_COUNT];
+            NOISE_REAL nw[module::MODULE_MAX_VARIANT_COUNT];
+            NOISE_REAL ne[module::MODULE_MAX_VARIANT_COUNT];
+            NOISE_REAL zCur = m_lowerZBound + (NOISE_REAL)z * zDelta;
+            NOISE_REAL zBlend = 1.0f - ((zCur - m_lowerZBound) / zExtent);
+            for (int first = 0; first < variantCount;
+                first += module::MODULE_MAX_VARIANT_COUNT)
+            {
+                int count = GetMin(module::MODULE_MAX_VARIANT_COUNT,
+                    variantCount - first);
+                const module::ModuleVariant* pVariant = pVariants + first;
+                for (int x = 0; x < m_destWidth; x++)
+                {
+                    NOISE_REAL xCur = m_lowerXBound + (NOISE_REAL)x * xDelta;
+                    m_pSourceModule->GetVariantValues(xCur, zCur, pVariant,
+                        count, sw);
+                    if (m_isSeamlessEnabled)
+                    {
+                        m_pSourceModule->GetVariantValues(xCur + xExtent, zCur,
+                            pVariant, count, se);
+                        m_pSourceModule->GetVariantValues(xCur, zCur + zExtent,
+                            pVariant, count, nw);
+                        m_pSourceModule->GetVariantValues(xCur + xExtent,
+                            zCur + zExtent, pVariant, count, ne);
+                        NOISE_REAL xBlend = 1.0f - ((xCur - m_lowerXBound) / xExtent);
+                        for (int i = 0; i < count; i++)
+                        {
+                            NOISE_REAL z0Value = LinearInterp(sw[i], se[i], xBlend);
+                            NOISE_REAL z1Value = LinearInterp(nw[i], ne[i], xBlend);
+                            sw[i] = LinearInterp(z0Value, z1Value, zBlend);
+                        }
+                    }
+                    for (int i = 0; i < count; i++)
+                    {
+                        *pDestNoiseMaps[first + i].GetSlabPtr(x, z) = (float)sw[i];
+                    }
+                }
+            }
+        });
+}
+
+void NoiseMapBuilder::BuildBand(NoiseMap& destNoiseMap, int rowOffset,
+    int rowCount, const BuildConfig& config) const
+{
+    int tileCountX = (m_destWidth + config.tileWidth  - 1) / config.tileWidth ;
+    int tileCountZ = (rowCount    + config.tileHeight - 1) / config.tileHeight;
+    int threadCount = ResolveThreadCount(config.threadCount);
+    threadCount = GetMin(threadCount, tileCountX * tileCountZ);
+
+    // Each worker thread owns a scratch buffer of eight batches.  When the
+    // memory budget cannot hold them, use narrower batches first, then fewer
+    // threads; only fail when a single point per thread does not fit.
+    int batchWidth = config.batchWidth;
+    MemoryReservation reservation;
+    while (!reservation.TryReserve(MEMORY_SCRATCH, (size_t)threadCount
+        * (size_t)batchWidth * 8 * sizeof(NOISE_REAL)))
     {
-        float* pDest = m_pDestNoiseMap->GetSlabPtr(z);
-        xCur = m_lowerXBound;
-        for (int x = 0; x < m_destWidth; x++)
+        if (batchWidth > 1)
+        {
+            batchWidth /= 2;
+        }
+        else if (threadCount > 1)
+        {
+            threadCount /= 2;
+        }
+        else
         {
-            float finalValue;
+            throw noise::ExceptionOutOfMemory();
+        }
+    }
+
+    std::vector<std::vector<NOISE_REAL> > scratch((size_t)threadCount);
+    try
+    {
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].resize((size_t)batchWidth * 8);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Fill every tile in the band with the output values from the source
+    // module.
+    ParallelFor(tileCountX * tileCountZ, threadCount,
+        [&](int tile, int worker)
+        {
+            int x0 = (tile % tileCountX) * config.tileWidth;
+            int z0 = (tile / tileCountX) * config.tileHeight;
+            LatencyScope latencyScope(m_pLatency != NULL
+                ? &m_pLatency->GetHistogram(LATENCY_TILE_BUILD) : NULL);
+            BuildTile(destNoiseMap, rowOffset, x0, rowOffset + z0,
+                GetMin(config.tileWidth , m_destWidth - x0),
+                GetMin(config.tileHeight, rowCount    - z0),
+                batchWidth, &scratch[worker][0]);
+        });
+}
+
+uint64 NoiseMapBuilder::GetSourceModuleHash() const
+{
+    if (m_pSourceModule == NULL)
+    {
+        return 0;
+    }
+
+    // Concurrent builds may both compute the hash; they store the same value.
+    uint64 hash = m_sourceModuleHash.load(std::memory_order_relaxed);
+    if (hash == 0)
+    {
+        hash = GetMax(BuildTuner::HashGraph(*m_pSourceModule), (uint64)1);
+        m_sourceModuleHash.store(hash, std::memory_order_relaxed);
+    }
+    return hash;
+}
+
+BuildConfig NoiseMapBuilder::GetEffectiveConfig() const
+{
+    // Let the tuner pick the fastest configuration for this source module.
+    if (m_pTuner != NULL)
+    {
+        return m_pTuner->GetConfig(*this);
+    }
+    return m_buildConfig;
+}
+
+NOISE_REAL NoiseMapBuilder::GetPointValue(NOISE_REAL x, NOISE_REAL z) const
+{
+    NOISE_REAL xExtent = m_upperXBound - m_lowerXBound;
+    NOISE_REAL zExtent = m_upperZBound - m_lowerZBound;
+    NOISE_REAL xDelta  = xExtent / (NOISE_REAL)m_destWidth ;
+    NOISE_REAL zDelta  = zExtent / (NOISE_REAL)m_destHeight;
+    NOISE_REAL xCur = m_lowerXBound + x * xDelta;
+    NOISE_REAL zCur = m_lowerZBound + z * zDelta;
+    if (!m_isSeamlessEnabled)
+    {
+        return m_pSourceModule->GetValue(xCur, zCur);
+    }
+
+    NOISE_REAL swValue, seValue, nwValue, neValue;
+    swValue = m_pSourceModule->GetValue(xCur          , zCur          );
+    seValue = m_pSourceModule->GetValue(xCur + xExtent, zCur          );
+    nwValue = m_pSourceModule->GetValue(xCur          , zCur + zExtent);
+    neValue = m_pSourceModule->GetValue(xCur + xExtent, zCur + zExtent);
+    NOISE_REAL xBlend = 1.0f - ((xCur - m_lowerXBound) / xExtent);
+    NOISE_REAL zBlend = 1.0f - ((zCur - m_lowerZBound) / zExtent);
+    NOISE_REAL z0 = LinearInterp(swValue, seValue, xBlend);
+    NOISE_REAL z1 = LinearInterp(nwValue, neValue, xBlend);
+    return LinearInterp(z0, z1, zBlend);
+}
+
+void NoiseMapBuilder::BuildTile(NoiseMap& destNoiseMap, int rowOffset, int x0,
+    int z0, int width, int height, int batchWidth, NOISE_REAL* pScratch) const
+{
+    NOISE_REAL xExtent = m_upperXBound - m_lowerXBound;
+    NOISE_REAL zExtent = m_upperZBound - m_lowerZBound;
+    NOISE_REAL xDelta  = xExtent / (NOISE_REAL)m_destWidth ;
+    NOISE_REAL zDelta  = zExtent / (NOISE_REAL)m_destHeight;
+
+    NOISE_REAL* pX  = pScratch;
+    NOISE_REAL* pZ  = pX  + batchWidth;
+    NOISE_REAL* pX2 = pZ  + batchWidth;
+    NOISE_REAL* pZ2 = pX2 + batchWidth;
+    NOISE_REAL* pSW = pZ2 + batchWidth;
+    NOISE_REAL* pSE = pSW + batchWidth;
+    NOISE_REAL* pNW = pSE + batchWidth;
+    NOISE_REAL* pNE = pNW + batchWidth;
+
+    for (int z = z0; z < z0 + height; z++)
+    {
+        float* pDest = destNoiseMap.GetSlabPtr(x0, z - rowOffset);
+        NOISE_REAL zCur = m_lowerZBound + (NOISE_REAL)z * zDelta;
+        for (int xBatch = x0; xBatch < x0 + width; xBatch += batchWidth)
+        {
+            int count = GetMin(batchWidth, x0 + width - xBatch);
+            for (int i = 0; i < count; i++)
+            {
+                pX[i] = m_lowerXBound + (NOISE_REAL)(xBatch + i) * xDelta;
+                pZ[i] = zCur;
+            }
+
             if (!m_isSeamlessEnabled)
             {
-                finalValue = (float)planeModel.GetValue(xCur, zCur);
+                m_pSourceModule->GetValues(pX, pZ, pSW, count);
+                for (int i = 0; i < count; i++)
+                {
+                    *pDest++ = (float)pSW[i];
+                }
             }
             else
             {
-                NOISE_REAL swValue, seValue, nwValue, neValue;
-                swValue = planeModel.GetValue(xCur          , zCur);
-                seValue = planeModel.GetValue(xCur + xExtent, zCur);
-                nwValue = planeModel.GetValue(xCur          , zCur + zExtent);
-                neValue = planeModel.GetValue(xCur + xExtent, zCur + zExtent);
-                NOISE_REAL xBlend = 1.0f - ((xCur - m_lowerXBound) / xExtent);
+                for (int i = 0; i < count; i++)
+                {
+                    pX2[i] = pX[i] + xExtent;
+                    pZ2[i] = zCur + zExtent;
+                }
+                m_pSourceModule->GetValues(pX , pZ , pSW, count);
+                m_pSourceModule->GetValues(pX2, pZ , pSE, count);
+                m_pSourceModule->GetValues(pX , pZ2, pNW, count);
+                m_pSourceModule->GetValues(pX2, pZ2, pNE, count);
                 NOISE_REAL zBlend = 1.0f - ((zCur - m_lowerZBound) / zExtent);
-                NOISE_REAL z0 = LinearInterp(swValue, seValue, xBlend);
-                NOISE_REAL z1 = LinearInterp(nwValue, neValue, xBlend);
-                finalValue = (float)LinearInterp(z0, z1, zBlend);
+                for (int i = 0; i < count; i++)
+                {
+                    NOISE_REAL xBlend = 1.0f - ((pX[i] - m_lowerXBound) / xExtent);
+                    NOISE_REAL z0Value = LinearInterp(pSW[i], pSE[i], xBlend);
+                    NOISE_REAL z1Value = LinearInterp(pNW[i], pNE[i], xBlend);
+                    *pDest++ = (float)LinearInterp(z0Value, z1Value, zBlend);
+                }
             }
-            *pDest++ = finalValue;
-            xCur += xDelta;
         }
-        zCur += zDelta;
-        
     }
 }
 
 
 void NoiseMapBuilder::Build(std::function<void(int, int, float)> fCallback)
 {
-	if (m_upperXBound <= m_lowerXBound
-		|| m_upperZBound <= m_lowerZBound
-		|| m_destWidth <= 0
-		|| m_destHeight <= 0
-		|| m_pSourceModule == NULL)
-	{
-		throw noise::ExceptionInvalidParam();
-	}
-
-	//m_pDestNoiseMap->SetSize(m_destWidth, m_destHeight);
-
-	// Create the plane model.
-	model::Plane planeModel;
-	planeModel.SetModule(*m_pSourceModule);
-
-	NOISE_REAL xExtent = m_upperXBound - m_lowerXBound;
-	NOISE_REAL zExtent = m_upperZBound - m_lowerZBound;
-	NOISE_REAL xDelta = xExtent / (NOISE_REAL)m_destWidth;
-	NOISE_REAL zDelta = zExtent / (NOISE_REAL)m_destHeight;
-	NOISE_REAL xCur = m_lowerXBound;
-	NOISE_REAL zCur = m_lowerZBound;
-
-	// Fill every point in the noise map with the output values from the model.
-	for (int z = 0; z < m_destHeight; z++)
-	{
-		xCur = m_lowerXBound;
-		for (int x = 0; x < m_destWidth; x++)
+	BuildRows([&](int z, const float* pValues)
 		{
-			float finalValue;
-			if (!m_isSeamlessEnabled)
+			for (int x = 0; x < m_destWidth; x++)
 			{
-				finalValue = (float)planeModel.GetValue(xCur, zCur);
+				fCallback(x, z, pValues[x]);
 			}
-			else
-			{
-				NOISE_REAL swValue, seValue, nwValue, neValue;
-				swValue = planeModel.GetValue(xCur, zCur);
-				seValue = planeModel.GetValue(xCur + xExtent, zCur);
-				nwValue = planeModel.GetValue(xCur, zCur + zExtent);
-				neValue = planeModel.GetValue(xCur + xExtent, zCur + zExtent);
-				NOISE_REAL xBlend = 1.0f - ((xCur - m_lowerXBound) / xExtent);
-				NOISE_REAL zBlend = 1.0f - ((zCur - m_lowerZBound) / zExtent);
-				NOISE_REAL z0 = LinearInterp(swValue, seValue, xBlend);
-				NOISE_REAL z1 = LinearInterp(nwValue, neValue, xBlend);
-				finalValue = (float)LinearInterp(z0, z1, zBlend);
-			}
-			// callback
-			fCallback(x, z, finalValue);
-
-			xCur += xDelta;
-		}
-		zCur += zDelta;
-
-	}
+		});
 }
-
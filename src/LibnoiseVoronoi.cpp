@@ -0,0 +1,445 @@
+// LibnoiseVoronoi.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include "LibnoiseVoronoi.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // The size of the tiles, in points, when a cell spans at least one
+    // point.
+    const int VORONOI_TILE_SIZE = 64;
+
+    // The cells and the borders found in a tile.  The cells are numbered in
+    // the order they were found (their slots); a border joins two slots, the
+    // smaller one first.
+    struct VoronoiTile
+    {
+        std::vector<VoronoiCell> cells;
+        std::vector<uint64> borders;
+        std::vector<uint32> borderLengths;
+
+        // The index, in the merged cells, of each slot.
+        std::vector<uint32> cellIndices;
+    };
+
+    // The scratch space of a worker: the seed points of the neighbourhood of
+    // a tile, the slot of each seed point, and the labels of the tile.
+    struct VoronoiScratch
+    {
+        std::vector<NOISE_REAL> seedX;
+        std::vector<NOISE_REAL> seedZ;
+        std::vector<int> slots;
+        std::vector<uint32> labels;
+        std::vector<uint64> borders;
+    };
+
+    // A border between two merged cells.
+    struct VoronoiBorder
+    {
+        uint32 cell;
+        uint32 neighbour;
+        uint32 length;
+    };
+
+    bool CompareBorders(const VoronoiBorder& a, const VoronoiBorder& b)
+    {
+        return a.cell < b.cell || (a.cell == b.cell && a.neighbour < b.neighbour);
+    }
+
+    bool CompareCells(const VoronoiCell& a, const VoronoiCell& b)
+    {
+        return a.latticeZ < b.latticeZ
+            || (a.latticeZ == b.latticeZ && a.latticeX < b.latticeX);
+    }
+
+    // Returns the coordinate of the unit square of a coordinate, the way
+    // noise::module::Voronoi rounds it.
+    inline int GetLatticeCoord(NOISE_REAL value)
+    {
+        return value > 0.0 ? (int)value : (int)value - 1;
+    }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// VoronoiRegionBuilder class
+
+VoronoiRegionBuilder::VoronoiRegionBuilder():
+    m_destHeight(0),
+    m_destWidth(0),
+    m_hasBounds(false),
+    m_lowerXBound(0.0),
+    m_lowerZBound(0.0),
+    m_upperXBound(0.0),
+    m_upperZBound(0.0),
+    m_pSourceModule(NULL),
+    m_threadCount(0)
+{
+}
+
+void VoronoiRegionBuilder::Build(VoronoiRegions& regions) const
+{
+    if (!m_hasBounds
+        || m_pSourceModule == NULL
+        || m_destWidth <= 0
+        || m_destHeight <= 0)
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    int width = m_destWidth;
+    int height = m_destHeight;
+    NOISE_REAL frequency = m_pSourceModule->GetFrequency();
+    int seed = m_pSourceModule->GetSeed();
+    NOISE_REAL xDelta = (m_upperXBound - m_lowerXBound) / (NOISE_REAL)width;
+    NOISE_REAL zDelta = (m_upperZBound - m_lowerZBound) / (NOISE_REAL)height;
+
+    // Shrink the tiles when a cell spans less than a point, so that the seed
+    // points of a tile stay few.
+    NOISE_REAL cellsPerPoint = GetMax(fabs(xDelta * frequency),
+        fabs(zDelta * frequency));
+    int tileSize = VORONOI_TILE_SIZE;
+    if (cellsPerPoint > 1.0)
+    {
+        tileSize = GetMax((int)(VORONOI_TILE_SIZE / cellsPerPoint), 1);
+    }
+    int tileCountX = (width + tileSize - 1) / tileSize;
+    int tileCountZ = (height + tileSize - 1) / tileSize;
+    int tileCount = tileCountX * tileCountZ;
+    int threadCount = ResolveThreadCount(m_threadCount);
+
+    regions.width = width;
+    regions.height = height;
+    regions.cells.clear();
+    regions.neighbourOffsets.clear();
+    regions.neighbours.clear();
+    regions.borderLengths.clear();
+
+    // Compute the coordinates of the columns and the rows, and their unit
+    // squares, exactly as noise::utils::NoiseMapBuilder and
+    // noise::module::Voronoi do.
+    std::vector<NOISE_REAL> scaledX, scaledZ;
+    std::vector<int> latticeX, latticeZ;
+    std::vector<VoronoiTile> tiles;
+    std::vector<VoronoiScratch> scratch((size_t)threadCount);
+    try
+    {
+        regions.labels.resize((size_t)width * (size_t)height);
+        scaledX.resize((size_t)width);
+        latticeX.resize((size_t)width);
+        scaledZ.resize((size_t)height);
+        latticeZ.resize((size_t)height);
+        tiles.resize((size_t)tileCount);
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+    for (int x = 0; x < width; x++)
+    {
+        scaledX[x] = (m_lowerXBound + (NOISE_REAL)x * xDelta) * frequency;
+        latticeX[x] = GetLatticeCoord(scaledX[x]);
+    }
+    for (int z = 0; z < height; z++)
+    {
+        scaledZ[z] = (m_lowerZBound + (NOISE_REAL)z * zDelta) * frequency;
+        latticeZ[z] = GetLatticeCoord(scaledZ[z]);
+    }
+
+    // The neighbourhood of a tile covers the unit squares of its points, and
+    // of the next column and row, two squares beyond on every side.  The
+    // unit squares are monotonic across the columns and the rows.
+    int maxWindowX = 0;
+    for (int x0 = 0; x0 < width; x0 += tileSize)
+    {
+        int x1 = GetMin(x0 + tileSize, width - 1);
+        maxWindowX = GetMax(maxWindowX, abs(latticeX[x1] - latticeX[x0]) + 5);
+    }
+    int maxWindowZ = 0;
+    for (int z0 = 0; z0 < height; z0 += tileSize)
+    {
+        int z1 = GetMin(z0 + tileSize, height - 1);
+        maxWindowZ = GetMax(maxWindowZ, abs(latticeZ[z1] - latticeZ[z0]) + 5);
+    }
+    try
+    {
+        size_t windowSize = (size_t)maxWindowX * (size_t)maxWindowZ;
+        size_t tileLabelCount = (size_t)(tileSize + 1) * (size_t)(tileSize + 1);
+        for (int i = 0; i < threadCount; i++)
+        {
+            scratch[i].seedX.resize(windowSize);
+            scratch[i].seedZ.resize(windowSize);
+            scratch[i].slots.assign(windowSize, -1);
+            scratch[i].labels.resize(tileLabelCount);
+        }
+    }
+    catch (...)
+    {
+        throw noise::ExceptionOutOfMemory();
+    }
+
+    // Label every tile, and find its cells and its borders.  Each tile also
+    // labels the column to its right and the row above it, to count the
+    // borders it shares with the next tiles.
+    ParallelFor(tileCount, threadCount,
+        [&](int tile, int worker)
+        {
+            VoronoiScratch& s = scratch[worker];
+            VoronoiTile& output = tiles[tile];
+            int x0 = (tile % tileCountX) * tileSize;
+            int z0 = (tile / tileCountX) * tileSize;
+            int x1 = GetMin(x0 + tileSize, width);
+            int z1 = GetMin(z0 + tileSize, height);
+            int haloX1 = GetMin(x1 + 1, width);
+            int haloZ1 = GetMin(z1 + 1, height);
+            int labelStride = haloX1 - x0;
+
+            // Compute the seed points of the neighbourhood once.
+            int windowX0 = GetMin(latticeX[x0], latticeX[haloX1 - 1]) - 2;
+            int windowZ0 = GetMin(latticeZ[z0], latticeZ[haloZ1 - 1]) - 2;
+            int windowWidth = abs(latticeX[haloX1 - 1] - latticeX[x0]) + 5;
+            int windowHeight = abs(latticeZ[haloZ1 - 1] - latticeZ[z0]) + 5;
+            for (int j = 0; j < windowHeight; j++)
+            {
+                int zCur = windowZ0 + j;
+                NOISE_REAL* pSeedX = &s.seedX[(size_t)j * windowWidth];
+                NOISE_REAL* pSeedZ = &s.seedZ[(size_t)j * windowWidth];
+                for (int i = 0; i < windowWidth; i++)
+                {
+                    int xCur = windowX0 + i;
+                    pSeedX[i] = xCur + ValueNoise2D(xCur, zCur, seed);
+                    pSeedZ[i] = zCur + ValueNoise2D(xCur, zCur, seed + 1);
+                }
+            }
+
+            // Find the nearest seed point of every point, in the same order
+            // as noise::module::Voronoi so that ties resolve the same way.
+            for (int z = z0; z < haloZ1; z++)
+            {
+                NOISE_REAL zValue = scaledZ[z];
+                int zBase = latticeZ[z] - 2 - windowZ0;
+                uint32* pLabels = &s.labels[(size_t)(z - z0) * labelStride];
+                for (int x = x0; x < haloX1; x++)
+                {
+                    NOISE_REAL xValue = scaledX[x];
+                    int xBase = latticeX[x] - 2 - windowX0;
+                    NOISE_REAL minDist = 2147483647.0f;
+                    int nearest = 0;
+                    for (int j = zBase; j <= zBase + 4; j++)
+                    {
+                        int rowIndex = j * windowWidth;
+                        for (int i = xBase; i <= xBase + 4; i++)
+                        {
+                            NOISE_REAL xDist = s.seedX[rowIndex + i] - xValue;
+                            NOISE_REAL zDist = s.seedZ[rowIndex + i] - zValue;
+                            NOISE_REAL dist = xDist * xDist + zDist * zDist;
+                            if (dist < minDist)
+                            {
+                                minDist = dist;
+                                nearest = rowIndex + i;
+                            }
+                        }
+                    }
+                    pLabels[x - x0] = (uint32)nearest;
+                }
+            }
+
+            // Give a slot to every seed point found, and count the points of
+            // the tile in each cell.
+            for (int z = z0; z < haloZ1; z++)
+            {
+                uint32* pLabels = &s.labels[(size_t)(z - z0) * labelStride];
+                for (int x = x0; x < haloX1; x++)
+                {
+                    int nearest = (int)pLabels[x - x0];
+                    int slot = s.slots[nearest];
+                    if (slot < 0)
+                    {
+                        slot = (int)output.cells.size();
+                        s.slots[nearest] = slot;
+                        VoronoiCell cell;
+                        cell.latticeX = windowX0 + nearest % windowWidth;
+                        cell.latticeZ = windowZ0 + nearest / windowWidth;
+                        cell.x = s.seedX[nearest] / frequency;
+                        cell.z = s.seedZ[nearest] / frequency;
+                        cell.pointCount = 0;
+                        output.cells.push_back(cell);
+                    }
+                    if (x < x1 && z < z1)
+                    {
+                        output.cells[slot].pointCount++;
+                    }
+                    pLabels[x - x0] = (uint32)slot;
+                }
+            }
+            for (size_t i = 0; i < output.cells.size(); i++)
+            {
+                const VoronoiCell& cell = output.cells[i];
+                s.slots[(cell.latticeZ - windowZ0) * windowWidth
+                    + (cell.latticeX - windowX0)] = -1;
+            }
+
+            // Count the borders with the point to the right and the point
+            // above, and copy the labels of the tile to the label map.
+            s.borders.clear();
+            for (int z = z0; z < z1; z++)
+            {
+                const uint32* pLabels
+                    = &s.labels[(size_t)(z - z0) * labelStride];
+                const uint32* pAbove = z + 1 < haloZ1
+                    ? pLabels + labelStride : NULL;
+                uint32* pDest = &regions.labels[(size_t)z * width + x0];
+                for (int x = 0; x < x1 - x0; x++)
+                {
+                    uint32 label = pLabels[x];
+                    pDest[x] = label;
+                    if (x0 + x + 1 < haloX1 && pLabels[x + 1] != label)
+                    {
+                        uint32 other = pLabels[x + 1];
+                        s.borders.push_back(((uint64)GetMin(label, other) << 32)
+                            | GetMax(label, other));
+                    }
+                    if (pAbove != NULL && pAbove[x] != label)
+                    {
+                        uint32 other = pAbove[x];
+                        s.borders.push_back(((uint64)GetMin(label, other) << 32)
+                            | GetMax(label, other));
+                    }
+                }
+            }
+            std::sort(s.borders.begin(), s.borders.end());
+            for (size_t i = 0; i < s.borders.size(); )
+            {
+                size_t j = i + 1;
+                while (j < s.borders.size() && s.borders[j] == s.borders[i])
+                {
+                    j++;
+                }
+                output.borders.push_back(s.borders[i]);
+                output.borderLengths.push_back((uint32)(j - i));
+                i = j;
+            }
+        });
+
+    // Merge the cells of the tiles, sorted by their unit squares.
+    std::vector<VoronoiCell>& cells = regions.cells;
+    for (int i = 0; i < tileCount; i++)
+    {
+        cells.insert(cells.end(), tiles[i].cells.begin(), tiles[i].cells.end());
+    }
+    std::sort(cells.begin(), cells.end(), CompareCells);
+    size_t cellCount = 0;
+    for (size_t i = 0; i < cells.size(); i++)
+    {
+        if (cellCount > 0 && !CompareCells(cells[cellCount - 1], cells[i]))
+        {
+            cells[cellCount - 1].pointCount += cells[i].pointCount;
+        }
+        else
+        {
+            cells[cellCount++] = cells[i];
+        }
+    }
+    cells.resize(cellCount);
+
+    // Number the cells of every tile, and relabel its points.
+    ParallelFor(tileCount, threadCount,
+        [&](int tile, int)
+        {
+            VoronoiTile& input = tiles[tile];
+            input.cellIndices.resize(input.cells.size());
+            for (size_t i = 0; i < input.cells.size(); i++)
+            {
+                input.cellIndices[i] = (uint32)(std::lower_bound(cells.begin(),
+                    cells.end(), input.cells[i], CompareCells) - cells.begin());
+            }
+            int x0 = (tile % tileCountX) * tileSize;
+            int z0 = (tile / tileCountX) * tileSize;
+            int x1 = GetMin(x0 + tileSize, width);
+            int z1 = GetMin(z0 + tileSize, height);
+            for (int z = z0; z < z1; z++)
+            {
+                uint32* pDest = &regions.labels[(size_t)z * width];
+                for (int x = x0; x < x1; x++)
+                {
+                    pDest[x] = input.cellIndices[pDest[x]];
+                }
+            }
+        });
+
+    // Merge the borders of the tiles, in both directions, and store them as
+    // the neighbour lists of the cells.
+    std::vector<VoronoiBorder> borders;
+    for (int i = 0; i < tileCount; i++)
+    {
+        const VoronoiTile& input = tiles[i];
+        for (size_t j = 0; j < input.borders.size(); j++)
+        {
+            VoronoiBorder border;
+            border.cell = input.cellIndices[(uint32)(input.borders[j] >> 32)];
+            border.neighbour = input.cellIndices[(uint32)input.borders[j]];
+            border.length = input.borderLengths[j];
+            borders.push_back(border);
+            SwapValues(border.cell, border.neighbour);
+            borders.push_back(border);
+        }
+    }
+    std::sort(borders.begin(), borders.end(), CompareBorders);
+
+    regions.neighbourOffsets.assign(cellCount + 1, 0);
+    for (size_t i = 0; i < borders.size(); )
+    {
+        size_t j = i + 1;
+        uint32 length = borders[i].length;
+        while (j < borders.size() && !CompareBorders(borders[i], borders[j]))
+        {
+            length += borders[j].length;
+            j++;
+        }
+        regions.neighbours.push_back(borders[i].neighbour);
+        regions.borderLengths.push_back(length);
+        regions.neighbourOffsets[borders[i].cell + 1]++;
+        i = j;
+    }
+    for (size_t i = 0; i < cellCount; i++)
+    {
+        regions.neighbourOffsets[i + 1] += regions.neighbourOffsets[i];
+    }
+}
+
+void VoronoiRegionBuilder::SetBounds(NOISE_REAL lowerXBound,
+    NOISE_REAL upperXBound, NOISE_REAL lowerZBound, NOISE_REAL upperZBound)
+{
+    if (!(lowerXBound < upperXBound) || !(lowerZBound < upperZBound))
+    {
+        throw noise::ExceptionInvalidParam();
+    }
+
+    m_lowerXBound = lowerXBound;
+    m_upperXBound = upperXBound;
+    m_lowerZBound = lowerZBound;
+    m_upperZBound = upperZBound;
+    m_hasBounds = true;
+}
@@ -0,0 +1,270 @@
+// latency.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include <algorithm>
+#include <math.h>
+#include <mutex>
+
+#include "latency.h"
+
+using namespace noise;
+
+std::atomic<bool> noise::g_latencyRecordingEnabled (false);
+
+namespace
+{
+
+  // Number of buckets per power-of-two range, above the linear range.
+  const int SUB_BUCKET_COUNT = 1 << (LATENCY_PRECISION_BITS - 1);
+
+  // The names of the operations, as they appear in the report.
+  const char* const OPERATION_NAMES[LATENCY_OPERATION_COUNT] = {
+    "point_query",
+    "batch_query",
+    "tile_build"
+  };
+
+  // The registered graphs.  Function-local statics, so that graphs may be
+  // registered by other static objects.
+  std::mutex& GetRegistryMutex ()
+  {
+    static std::mutex registryMutex;
+    return registryMutex;
+  }
+
+  std::vector<GraphLatency*>& GetRegistry ()
+  {
+    static std::vector<GraphLatency*> registry;
+    return registry;
+  }
+
+  // Escapes a label value for the Prometheus text format.
+  std::string EscapeLabelValue (const std::string& value)
+  {
+    std::string escaped;
+    for (size_t i = 0; i < value.size (); i++) {
+      if (value[i] == '\\') {
+        escaped += "\\\\";
+      } else if (value[i] == '"') {
+        escaped += "\\\"";
+      } else if (value[i] == '\n') {
+        escaped += "\\n";
+      } else {
+        escaped += value[i];
+      }
+    }
+    return escaped;
+  }
+
+  // Returns the position of the most significant bit of a non-zero value.
+  int GetMostSignificantBit (uint64 value)
+  {
+#if defined(__GNUC__)
+    return 63 - __builtin_clzll (value);
+#else
+    int bit = 0;
+    while (value >>= 1) {
+      bit++;
+    }
+    return bit;
+#endif
+  }
+
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// LatencySnapshot class
+
+LatencySnapshot::LatencySnapshot ():
+  m_buckets (LATENCY_BUCKET_COUNT, 0),
+  m_count (0),
+  m_sum (0)
+{
+}
+
+uint64 LatencySnapshot::GetMax () const
+{
+  for (int i = LATENCY_BUCKET_COUNT - 1; i >= 0; i--) {
+    if (m_buckets[i] > 0) {
+      return LatencyHistogram::GetBucketUpperBound (i);
+    }
+  }
+  return 0;
+}
+
+uint64 LatencySnapshot::GetPercentile (double percentile) const
+{
+  if (m_count == 0) {
+    return 0;
+  }
+
+  // The rank of the value at the percentile, from 1 to the count.
+  double rank = ceil (percentile / 100.0 * (double)m_count);
+  uint64 target = (uint64)std::max (rank, 1.0);
+  uint64 seen = 0;
+  for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    seen += m_buckets[i];
+    if (seen >= target) {
+      return LatencyHistogram::GetBucketUpperBound (i);
+    }
+  }
+  return GetMax ();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// LatencyHistogram class
+
+LatencyHistogram::LatencyHistogram ()
+{
+  Reset ();
+}
+
+int LatencyHistogram::GetBucketIndex (uint64 value)
+{
+  // Values below 2 * SUB_BUCKET_COUNT have a bucket each.  Above, the value
+  // is shifted right until it has LATENCY_PRECISION_BITS bits, and the shift
+  // selects the power-of-two range.
+  if (value < (uint64)(2 * SUB_BUCKET_COUNT)) {
+    return (int)value;
+  }
+  int shift = GetMostSignificantBit (value) - (LATENCY_PRECISION_BITS - 1);
+  return shift * SUB_BUCKET_COUNT + (int)(value >> shift);
+}
+
+uint64 LatencyHistogram::GetBucketUpperBound (int index)
+{
+  if (index < 2 * SUB_BUCKET_COUNT) {
+    return (uint64)index;
+  }
+  int shift = index / SUB_BUCKET_COUNT - 1;
+  uint64 mantissa = (uint64)(index - shift * SUB_BUCKET_COUNT);
+  return ((mantissa + 1) << shift) - 1;
+}
+
+LatencySnapshot LatencyHistogram::GetSnapshot (bool reset)
+{
+  LatencySnapshot snapshot;
+  for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    uint64 count = reset
+      ? m_buckets[i].exchange (0, std::memory_order_relaxed)
+      : m_buckets[i].load (std::memory_order_relaxed);
+    snapshot.m_buckets[i] = count;
+    snapshot.m_count += count;
+  }
+  snapshot.m_sum = reset ? m_sum.exchange (0, std::memory_order_relaxed)
+    : m_sum.load (std::memory_order_relaxed);
+  return snapshot;
+}
+
+void LatencyHistogram::Reset ()
+{
+  for (int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    m_buckets[i].store (0, std::memory_order_relaxed);
+  }
+  m_sum.store (0, std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// GraphLatency class
+
+GraphLatency::GraphLatency (const std::string& name):
+  m_name (name)
+{
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  GetRegistry ().push_back (this);
+}
+
+GraphLatency::~GraphLatency ()
+{
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  std::vector<GraphLatency*>& registry = GetRegistry ();
+  registry.erase (std::remove (registry.begin (), registry.end (), this),
+    registry.end ());
+}
+
+std::string GraphLatency::GetName () const
+{
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  return m_name;
+}
+
+void GraphLatency::SetName (const std::string& name)
+{
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  m_name = name;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Functions
+
+void noise::ResetLatencyHistograms ()
+{
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  std::vector<GraphLatency*>& registry = GetRegistry ();
+  for (size_t i = 0; i < registry.size (); i++) {
+    for (int op = 0; op < LATENCY_OPERATION_COUNT; op++) {
+      registry[i]->GetHistogram ((LatencyOperation)op).Reset ();
+    }
+  }
+}
+
+void noise::SetLatencyRecordingEnabled (bool enabled)
+{
+  g_latencyRecordingEnabled.store (enabled);
+}
+
+void noise::WriteLatencyReport (std::ostream& out, bool reset)
+{
+  static const double QUANTILES[] = {0.5, 0.99, 0.999};
+
+  // Take every snapshot once, since a reset snapshot cannot be taken again
+  // for the gauge family.
+  std::lock_guard<std::mutex> lock (GetRegistryMutex ());
+  std::vector<GraphLatency*>& registry = GetRegistry ();
+  std::vector<std::string> labels;
+  std::vector<LatencySnapshot> snapshots;
+  for (size_t i = 0; i < registry.size (); i++) {
+    for (int op = 0; op < LATENCY_OPERATION_COUNT; op++) {
+      LatencySnapshot snapshot = registry[i]->GetHistogram (
+        (LatencyOperation)op).GetSnapshot (reset);
+      if (snapshot.GetCount () == 0) {
+        continue;
+      }
+      labels.push_back ("graph=\"" + EscapeLabelValue (registry[i]->m_name)
+        + "\",op=\"" + OPERATION_NAMES[op] + "\"");
+      snapshots.push_back (snapshot);
+    }
+  }
+
+  out << "# TYPE noise_latency_ns summary\n";
+  for (size_t i = 0; i < snapshots.size (); i++) {
+    for (size_t q = 0; q < sizeof (QUANTILES) / sizeof (QUANTILES[0]); q++) {
+      out << "noise_latency_ns{" << labels[i] << ",quantile=\"" << QUANTILES[q]
+        << "\"} " << snapshots[i].GetPercentile (QUANTILES[q] * 100.0)
+        << "\n";
+    }
+    out << "noise_latency_ns_sum{" << labels[i] << "} "
+      << snapshots[i].GetSum () << "\n";
+    out << "noise_latency_ns_count{" << labels[i] << "} "
+      << snapshots[i].GetCount () << "\n";
+  }
+  out << "# TYPE noise_latency_ns_max gauge\n";
+  for (size_t i = 0; i < snapshots.size (); i++) {
+    out << "noise_latency_ns_max{" << labels[i] << "} "
+      << snapshots[i].GetMax () << "\n";
+  }
+}
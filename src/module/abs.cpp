@@ -35,3 +35,14 @@ NOISE_REAL Abs::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return std::abs (m_pSourceModule[0]->GetValue (x, y));
 }
+
+void Abs::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  for (int i = 0; i < variantCount; i++) {
+    out[i] = std::abs (out[i]);
+  }
+}
@@ -43,8 +43,16 @@ NOISE_REAL Billow::GetValue (NOISE_REAL x, NOISE_REAL y) const
   NOISE_REAL nx, ny;
   int seed;
 
-  x *= m_frequency;
-  y *= m_frequency;
+  NOISE_REAL frequency = m_frequency;
+  int baseSeed = m_seed;
+  const ModuleVariant* pVariant = g_pActiveVariant;
+  if (pVariant != NULL) {
+    frequency *= pVariant->frequencyScale;
+    baseSeed += pVariant->seedOffset;
+  }
+
+  x *= frequency;
+  y *= frequency;
 
   for (int curOctave = 0; curOctave < m_octaveCount; curOctave++) {
 
@@ -55,7 +63,7 @@ NOISE_REAL Billow::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
     // Get the coherent-noise value from the input value and add it to the
     // final result.
-    seed = (m_seed + curOctave) & 0xffffffff;
+    seed = (baseSeed + curOctave) & 0xffffffff;
     signal = GradientCoherentNoise2D (nx, ny, seed, m_noiseQuality);
     signal = 2.0f * std::abs (signal) - 1.0f;
     value += signal * curPersistence;
@@ -69,3 +77,48 @@ NOISE_REAL Billow::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return value;
 }
+
+void Billow::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  int seed[MODULE_MAX_VARIANT_COUNT];
+  NOISE_REAL signal[MODULE_MAX_VARIANT_COUNT];
+
+  // The variants of a group sample the same lattice cells, so each octave
+  // walks the lattice once for the whole group.
+  for (int first = 0; first < variantCount; ) {
+    int laneCount = GetVariantGroupSize (pVariant + first,
+      variantCount - first);
+    NOISE_REAL* pValue = out + first;
+    NOISE_REAL frequency = m_frequency * pVariant[first].frequencyScale;
+    NOISE_REAL curPersistence = 1.0;
+    NOISE_REAL xCur = x * frequency;
+    NOISE_REAL yCur = y * frequency;
+
+    for (int i = 0; i < laneCount; i++) {
+      pValue[i] = 0.0;
+    }
+    for (int curOctave = 0; curOctave < m_octaveCount; curOctave++) {
+      NOISE_REAL nx = MakeInt32Range (xCur);
+      NOISE_REAL ny = MakeInt32Range (yCur);
+      for (int i = 0; i < laneCount; i++) {
+        seed[i] = (m_seed + pVariant[first + i].seedOffset + curOctave)
+          & 0xffffffff;
+      }
+      GradientCoherentNoise2DMultiSeed (nx, ny, seed, laneCount, signal,
+        m_noiseQuality);
+      for (int i = 0; i < laneCount; i++) {
+        pValue[i] += (2.0f * std::abs (signal[i]) - 1.0f) * curPersistence;
+      }
+
+      // Prepare the next octave.
+      xCur *= m_lacunarity;
+      yCur *= m_lacunarity;
+      curPersistence *= m_persistence;
+    }
+    for (int i = 0; i < laneCount; i++) {
+      pValue[i] += 0.5;
+    }
+    first += laneCount;
+  }
+}
@@ -41,3 +41,22 @@ NOISE_REAL Blend::GetValue (NOISE_REAL x, NOISE_REAL y) const
   NOISE_REAL alpha = (m_pSourceModule[2]->GetValue (x, y) + 1.0f) / 2.0f;
   return LinearInterp (v0, v1, alpha);
 }
+
+void Blend::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+  assert (m_pSourceModule[1] != NULL);
+  assert (m_pSourceModule[2] != NULL);
+
+  NOISE_REAL v1[MODULE_MAX_VARIANT_COUNT];
+  NOISE_REAL control[MODULE_MAX_VARIANT_COUNT];
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  m_pSourceModule[1]->GetVariantValues (x, y, pVariant, variantCount, v1);
+  m_pSourceModule[2]->GetVariantValues (x, y, pVariant, variantCount,
+    control);
+  for (int i = 0; i < variantCount; i++) {
+    NOISE_REAL alpha = (control[i] + 1.0f) / 2.0f;
+    out[i] = LinearInterp (out[i], v1[i], alpha);
+  }
+}
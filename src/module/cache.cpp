@@ -20,13 +20,41 @@
 // off every 'zig'.)
 //
 
+#include <atomic>
+
 #include "module/cache.h"
 
+using namespace noise;
 using namespace noise::module;
 
+namespace
+{
+
+  // Number of cached values each thread keeps, one per cache module (the
+  // identifiers of the cache modules select the slots).
+  const int CACHE_SLOT_COUNT = 64;
+
+  // A cached value of a cache module.  An identifier of zero marks an empty
+  // slot.
+  struct CacheSlot
+  {
+    uint64 cacheId;
+    NOISE_REAL x;
+    NOISE_REAL y;
+    NOISE_REAL value;
+  };
+
+  // The cached values of the calling thread.
+  thread_local CacheSlot s_cacheSlots[CACHE_SLOT_COUNT];
+
+  // The next identifier of a cache module.
+  std::atomic<uint64> s_nextCacheId (1);
+
+}
+
 Cache::Cache ():
   Module (GetSourceModuleCount ()),
-  m_isCached (false)
+  m_cacheId (s_nextCacheId++)
 {
 }
 
@@ -34,11 +62,39 @@ NOISE_REAL Cache::GetValue (NOISE_REAL x, NOISE_REAL y) const
 {
   assert (m_pSourceModule[0] != NULL);
 
-  if (!(m_isCached && x == m_xCache && y == m_yCache)) {
-    m_cachedValue = m_pSourceModule[0]->GetValue (x, y);
-    m_xCache = x;
-    m_yCache = y;
+  // While a variant is evaluated, the cache only holds values of the graph
+  // itself; bypass it.
+  if (g_pActiveVariant != NULL) {
+    return m_pSourceModule[0]->GetValue (x, y);
+  }
+
+  uint64 cacheId = m_cacheId;
+  CacheSlot& slot = s_cacheSlots[cacheId % CACHE_SLOT_COUNT];
+  if (slot.cacheId == cacheId && x == slot.x && y == slot.y) {
+    return slot.value;
   }
-  m_isCached = true;
-  return m_cachedValue;
+
+  // The source module may use the same slot; fill it once the value is
+  // known.
+  NOISE_REAL value = m_pSourceModule[0]->GetValue (x, y);
+  slot.cacheId = cacheId;
+  slot.x = x;
+  slot.y = y;
+  slot.value = value;
+  return value;
+}
+
+void Cache::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  // The cache only holds values of the graph itself.
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+}
+
+void Cache::SetSourceModule (int index, const Module& sourceModule)
+{
+  Module::SetSourceModule (index, sourceModule);
+  m_cacheId = s_nextCacheId++;
 }
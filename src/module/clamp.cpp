@@ -52,3 +52,18 @@ void Clamp::SetBounds (NOISE_REAL lowerBound, NOISE_REAL upperBound)
   m_lowerBound = lowerBound;
   m_upperBound = upperBound;
 }
+
+void Clamp::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  for (int i = 0; i < variantCount; i++) {
+    if (out[i] < m_lowerBound) {
+      out[i] = m_lowerBound;
+    } else if (out[i] > m_upperBound) {
+      out[i] = m_upperBound;
+    }
+  }
+}
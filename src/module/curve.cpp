@@ -33,6 +33,19 @@ Curve::Curve ():
   m_controlPointCount = 0;
 }
 
+Curve::Curve (const Curve& m):
+  Module (m),
+  m_pControlPoints (NULL)
+{
+  m_controlPointCount = m.m_controlPointCount;
+  if (m_controlPointCount > 0) {
+    m_pControlPoints = new ControlPoint[m_controlPointCount];
+    for (int i = 0; i < m_controlPointCount; i++) {
+      m_pControlPoints[i] = m.m_pControlPoints[i];
+    }
+  }
+}
+
 Curve::~Curve ()
 {
   delete[] m_pControlPoints;
@@ -36,9 +36,22 @@ NOISE_REAL Displace::GetValue (NOISE_REAL x, NOISE_REAL y) const
   assert (m_pSourceModule[2] != NULL);
 
   // Get the output values from the three displacement modules.  Add each
-  // value to the corresponding coordinate in the input value.
-  NOISE_REAL xDisplace = x + (m_pSourceModule[1]->GetValue (x, y));
-  NOISE_REAL yDisplace = y + (m_pSourceModule[2]->GetValue (x, y));
+  // value to the corresponding coordinate in the input value.  A module that
+  // displaces both coordinates is only queried once.
+  NOISE_REAL xDisplace, yDisplace;
+  if (m_pSourceModule[1] != m_pSourceModule[2]) {
+    xDisplace = x + (m_pSourceModule[1]->GetValue (x, y));
+    yDisplace = y + (m_pSourceModule[2]->GetValue (x, y));
+  } else if (m_pSourceModule[1]->GetChannelCount () >= 2) {
+    NOISE_REAL channel[MODULE_MAX_CHANNEL_COUNT];
+    m_pSourceModule[1]->GetChannelValues (x, y, channel);
+    xDisplace = x + channel[0];
+    yDisplace = y + channel[1];
+  } else {
+    NOISE_REAL displace = m_pSourceModule[1]->GetValue (x, y);
+    xDisplace = x + displace;
+    yDisplace = y + displace;
+  }
 
   // Retrieve the output value using the offsetted input value instead of
   // the original input value.
@@ -37,3 +37,15 @@ NOISE_REAL Exponent::GetValue (NOISE_REAL x, NOISE_REAL y) const
   NOISE_REAL value = m_pSourceModule[0]->GetValue (x, y);
   return (std::pow (std::abs ((value + 1.0f) / 2.0f), m_exponent) * 2.0f - 1.0f);
 }
+
+void Exponent::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  for (int i = 0; i < variantCount; i++) {
+    out[i] = (std::pow (std::abs ((out[i] + 1.0f) / 2.0f), m_exponent)
+      * 2.0f - 1.0f);
+  }
+}
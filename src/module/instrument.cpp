@@ -0,0 +1,52 @@
+// instrument.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "module/instrument.h"
+
+using namespace noise::module;
+
+Instrument::Instrument (const std::string& name):
+  Module (GetSourceModuleCount ()),
+  m_latency (name)
+{
+}
+
+NOISE_REAL Instrument::GetValue (NOISE_REAL x, NOISE_REAL y) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  LatencyScope scope (&m_latency.GetHistogram (LATENCY_POINT_QUERY));
+  return m_pSourceModule[0]->GetValue (x, y);
+}
+
+void Instrument::GetValues (const NOISE_REAL* x, const NOISE_REAL* y,
+  NOISE_REAL* out, int count) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  LatencyScope scope (&m_latency.GetHistogram (LATENCY_BATCH_QUERY));
+  m_pSourceModule[0]->GetValues (x, y, out, count);
+}
+
+void Instrument::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  LatencyScope scope (&m_latency.GetHistogram (LATENCY_BATCH_QUERY));
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+}
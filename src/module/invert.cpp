@@ -35,3 +35,14 @@ NOISE_REAL Invert::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return -(m_pSourceModule[0]->GetValue (x, y));
 }
+
+void Invert::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  for (int i = 0; i < variantCount; i++) {
+    out[i] = -(out[i]);
+  }
+}
@@ -39,3 +39,17 @@ NOISE_REAL Min::GetValue (NOISE_REAL x, NOISE_REAL y) const
   NOISE_REAL v1 = m_pSourceModule[1]->GetValue (x, y);
   return GetMin (v0, v1);
 }
+
+void Min::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+  assert (m_pSourceModule[1] != NULL);
+
+  NOISE_REAL v1[MODULE_MAX_VARIANT_COUNT];
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  m_pSourceModule[1]->GetVariantValues (x, y, pVariant, variantCount, v1);
+  for (int i = 0; i < variantCount; i++) {
+    out[i] = GetMin (out[i], v1[i]);
+  }
+}
@@ -24,23 +24,65 @@
 
 using namespace noise::module;
 
+thread_local const ModuleVariant* noise::module::g_pActiveVariant = NULL;
+
 Module::Module (int sourceModuleCount)
 {
   m_pSourceModule = NULL;
 
   // Create an array of pointers to all source modules required by this
-  // noise module.  Set these pointers to NULL.
-  if (sourceModuleCount > 0) {
+  // noise module.  Set these pointers to NULL.  Small arrays live inside the
+  // noise module.
+  if (sourceModuleCount > MODULE_INLINE_SOURCE_COUNT) {
     m_pSourceModule = new const Module*[sourceModuleCount];
-    for (int i = 0; i < sourceModuleCount; i++) {
-      m_pSourceModule[i] = NULL;
-    }
+  } else if (sourceModuleCount > 0) {
+    m_pSourceModule = m_inlineSourceModule;
   } else {
     m_pSourceModule = NULL;
   }
+  for (int i = 0; i < sourceModuleCount; i++) {
+    m_pSourceModule[i] = NULL;
+  }
+}
+
+Module::Module (const Module& m)
+{
+  // The source modules of the original are counted through its virtual
+  // methods, which are fully available.
+  int sourceModuleCount = m.GetSourceModuleCount ();
+  if (sourceModuleCount > MODULE_INLINE_SOURCE_COUNT) {
+    m_pSourceModule = new const Module*[sourceModuleCount];
+  } else if (sourceModuleCount > 0) {
+    m_pSourceModule = m_inlineSourceModule;
+  } else {
+    m_pSourceModule = NULL;
+  }
+  for (int i = 0; i < sourceModuleCount; i++) {
+    m_pSourceModule[i] = m.m_pSourceModule[i];
+  }
 }
 
 Module::~Module ()
 {
-  delete[] m_pSourceModule;
+  if (m_pSourceModule != m_inlineSourceModule) {
+    delete[] m_pSourceModule;
+  }
+}
+
+void Module::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  // Evaluate the whole graph once per variant.  The generator modules read
+  // the active variant in their GetValue() method.
+  const ModuleVariant* pPreviousVariant = g_pActiveVariant;
+  try {
+    for (int i = 0; i < variantCount; i++) {
+      g_pActiveVariant = &pVariant[i];
+      out[i] = GetValue (x, y);
+    }
+  } catch (...) {
+    g_pActiveVariant = pPreviousVariant;
+    throw;
+  }
+  g_pActiveVariant = pPreviousVariant;
 }
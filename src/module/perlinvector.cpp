@@ -0,0 +1,71 @@
+// perlinvector.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "module/perlinvector.h"
+
+using namespace noise::module;
+
+PerlinVector::PerlinVector ():
+  Perlin (),
+  m_channelCount (DEFAULT_PERLIN_VECTOR_CHANNEL_COUNT)
+{
+}
+
+void PerlinVector::GetChannelValues (NOISE_REAL x, NOISE_REAL y,
+  NOISE_REAL* out) const
+{
+  NOISE_REAL signal[PERLIN_VECTOR_MAX_CHANNEL_COUNT];
+  int seed[PERLIN_VECTOR_MAX_CHANNEL_COUNT];
+  NOISE_REAL curPersistence = 1.0;
+  NOISE_REAL nx, ny;
+
+  for (int i = 0; i < m_channelCount; i++) {
+    out[i] = 0.0;
+  }
+
+  NOISE_REAL frequency = m_frequency;
+  int baseSeed = m_seed;
+  const ModuleVariant* pVariant = g_pActiveVariant;
+  if (pVariant != NULL) {
+    frequency *= pVariant->frequencyScale;
+    baseSeed += pVariant->seedOffset;
+  }
+
+  x *= frequency;
+  y *= frequency;
+
+  for (int curOctave = 0; curOctave < m_octaveCount; curOctave++) {
+
+    // Same octave loop as Perlin::GetValue(), with one seed per channel.
+    nx = MakeInt32Range (x);
+    ny = MakeInt32Range (y);
+
+    for (int i = 0; i < m_channelCount; i++) {
+      seed[i] = (baseSeed + i + curOctave) & 0xffffffff;
+    }
+    GradientCoherentNoise2DMultiSeed (nx, ny, seed, m_channelCount, signal,
+      m_noiseQuality);
+    for (int i = 0; i < m_channelCount; i++) {
+      out[i] += signal[i] * curPersistence;
+    }
+
+    // Prepare the next octave.
+    x *= m_lacunarity;
+    y *= m_lacunarity;
+    curPersistence *= m_persistence;
+  }
+}
@@ -54,8 +54,16 @@ void RidgedMulti::CalcSpectralWeights ()
 // 1998.  Modified by jas for use with libnoise.
 NOISE_REAL RidgedMulti::GetValue (NOISE_REAL x, NOISE_REAL y) const
 {
-  x *= m_frequency;
-  y *= m_frequency;
+  NOISE_REAL frequency = m_frequency;
+  int baseSeed = m_seed;
+  const ModuleVariant* pVariant = g_pActiveVariant;
+  if (pVariant != NULL) {
+    frequency *= pVariant->frequencyScale;
+    baseSeed += pVariant->seedOffset;
+  }
+
+  x *= frequency;
+  y *= frequency;
 
   NOISE_REAL signal = 0.0;
   NOISE_REAL value  = 0.0;
@@ -75,7 +83,7 @@ NOISE_REAL RidgedMulti::GetValue (NOISE_REAL x, NOISE_REAL y) const
     ny = MakeInt32Range (y);
 
     // Get the coherent-noise value.
-    int seed = (m_seed + curOctave) & 0x7fffffff;
+    int seed = (baseSeed + curOctave) & 0x7fffffff;
     signal = GradientCoherentNoise2D (nx, ny, seed, m_noiseQuality);
 
     // Make the ridges.
@@ -109,3 +117,62 @@ NOISE_REAL RidgedMulti::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return (value * 1.25f) - 1.0f;
 }
+
+void RidgedMulti::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  int seed[MODULE_MAX_VARIANT_COUNT];
+  NOISE_REAL signal[MODULE_MAX_VARIANT_COUNT];
+  NOISE_REAL weight[MODULE_MAX_VARIANT_COUNT];
+
+  // Same parameters as GetValue().
+  NOISE_REAL offset = 1.0;
+  NOISE_REAL gain = 2.0;
+
+  // The variants of a group sample the same lattice cells, so each octave
+  // walks the lattice once for the whole group.
+  for (int first = 0; first < variantCount; ) {
+    int laneCount = GetVariantGroupSize (pVariant + first,
+      variantCount - first);
+    NOISE_REAL* pValue = out + first;
+    NOISE_REAL frequency = m_frequency * pVariant[first].frequencyScale;
+    NOISE_REAL xCur = x * frequency;
+    NOISE_REAL yCur = y * frequency;
+
+    for (int i = 0; i < laneCount; i++) {
+      pValue[i] = 0.0;
+      weight[i] = 1.0;
+    }
+    for (int curOctave = 0; curOctave < m_octaveCount; curOctave++) {
+      NOISE_REAL nx = MakeInt32Range (xCur);
+      NOISE_REAL ny = MakeInt32Range (yCur);
+      for (int i = 0; i < laneCount; i++) {
+        seed[i] = (m_seed + pVariant[first + i].seedOffset + curOctave)
+          & 0x7fffffff;
+      }
+      GradientCoherentNoise2DMultiSeed (nx, ny, seed, laneCount, signal,
+        m_noiseQuality);
+      for (int i = 0; i < laneCount; i++) {
+        NOISE_REAL laneSignal = offset - fabs (signal[i]);
+        laneSignal *= laneSignal;
+        laneSignal *= weight[i];
+        weight[i] = laneSignal * gain;
+        if (weight[i] > 1.0) {
+          weight[i] = 1.0;
+        }
+        if (weight[i] < 0.0) {
+          weight[i] = 0.0;
+        }
+        pValue[i] += (laneSignal * m_pSpectralWeights[curOctave]);
+      }
+
+      // Go to the next octave.
+      xCur *= m_lacunarity;
+      yCur *= m_lacunarity;
+    }
+    for (int i = 0; i < laneCount; i++) {
+      pValue[i] = (pValue[i] * 1.25f) - 1.0f;
+    }
+    first += laneCount;
+  }
+}
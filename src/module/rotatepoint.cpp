@@ -66,3 +66,13 @@ void RotatePoint::SetAngles (NOISE_REAL xAngle, NOISE_REAL yAngle,
   m_yAngle = yAngle;
   m_zAngle = zAngle;
 }
+
+void RotatePoint::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  NOISE_REAL nx = (m_x1Matrix * x) + (m_y1Matrix * y);
+  NOISE_REAL ny = (m_x2Matrix * x) + (m_y2Matrix * y);
+  m_pSourceModule[0]->GetVariantValues (nx, ny, pVariant, variantCount, out);
+}
@@ -37,3 +37,14 @@ NOISE_REAL ScaleBias::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return m_pSourceModule[0]->GetValue (x, y) * m_scale + m_bias;
 }
+
+void ScaleBias::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x, y, pVariant, variantCount, out);
+  for (int i = 0; i < variantCount; i++) {
+    out[i] = out[i] * m_scale + m_bias;
+  }
+}
@@ -38,3 +38,12 @@ NOISE_REAL ScalePoint::GetValue (NOISE_REAL x, NOISE_REAL y) const
 
   return m_pSourceModule[0]->GetValue (x * m_xScale, y * m_yScale);
 }
+
+void ScalePoint::GetVariantValues (NOISE_REAL x, NOISE_REAL y,
+  const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+  assert (m_pSourceModule[0] != NULL);
+
+  m_pSourceModule[0]->GetVariantValues (x * m_xScale, y * m_yScale, pVariant,
+    variantCount, out);
+}
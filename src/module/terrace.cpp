@@ -36,6 +36,20 @@ Terrace::Terrace ():
 {
 }
 
+Terrace::Terrace (const Terrace& m):
+  Module (m),
+  m_controlPointCount (m.m_controlPointCount),
+  m_invertTerraces (m.m_invertTerraces),
+  m_pControlPoints (NULL)
+{
+  if (m_controlPointCount > 0) {
+    m_pControlPoints = new NOISE_REAL[m_controlPointCount];
+    for (int i = 0; i < m_controlPointCount; i++) {
+      m_pControlPoints[i] = m.m_pControlPoints[i];
+    }
+  }
+}
+
 Terrace::~Terrace ()
 {
   delete[] m_pControlPoints;
@@ -26,6 +26,7 @@ using namespace noise::module;
 
 Turbulence::Turbulence ():
   Module (GetSourceModuleCount ()),
+  m_jointDistortion (false),
   m_power (DEFAULT_TURBULENCE_POWER)
 {
   SetSeed (DEFAULT_TURBULENCE_SEED);
@@ -58,17 +59,21 @@ NOISE_REAL Turbulence::GetValue (NOISE_REAL x, NOISE_REAL y) const
   // integer boundaries.
   NOISE_REAL x0, y0;
   NOISE_REAL x1, y1;
-  NOISE_REAL x2, y2;
   x0 = x + (12414.0f / 65536.0f);
   y0 = y + (65124.0f / 65536.0f);
-  x1 = x + (26519.0f / 65536.0f);
-  y1 = y + (18128.0f / 65536.0f);
-  x2 = x + (53820.0f / 65536.0f);
-  y2 = y + (11213.0f / 65536.0f);
-  NOISE_REAL xDistort = x + (m_xDistortModule.GetValue (x0, y0)
-    * m_power);
-  NOISE_REAL yDistort = y + (m_yDistortModule.GetValue (x1, y1)
-    * m_power);
+  NOISE_REAL xDistort, yDistort;
+  if (m_jointDistortion) {
+    // Both displacements are sampled at the first offset, in one pass.
+    NOISE_REAL distort[2];
+    m_distortVectorModule.GetChannelValues (x0, y0, distort);
+    xDistort = x + (distort[0] * m_power);
+    yDistort = y + (distort[1] * m_power);
+  } else {
+    x1 = x + (26519.0f / 65536.0f);
+    y1 = y + (18128.0f / 65536.0f);
+    xDistort = x + (m_xDistortModule.GetValue (x0, y0) * m_power);
+    yDistort = y + (m_yDistortModule.GetValue (x1, y1) * m_power);
+  }
 
   // Retrieve the output value at the offsetted input value instead of the
   // original input value.
@@ -83,4 +88,8 @@ void Turbulence::SetSeed (int seed)
   m_xDistortModule.SetSeed (seed    );
   m_yDistortModule.SetSeed (seed + 1);
   m_zDistortModule.SetSeed (seed + 2);
+
+  // Channels 0 and 1 of the joint module use the seeds of the x and y
+  // modules.
+  m_distortVectorModule.SetSeed (seed);
 }
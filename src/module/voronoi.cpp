@@ -39,8 +39,16 @@ NOISE_REAL Voronoi::GetValue(NOISE_REAL x, NOISE_REAL y) const
 	// This method could be more efficient by caching the seed values.  Fix
 	// later.
 
-	x *= m_frequency;
-	y *= m_frequency;
+	NOISE_REAL frequency = m_frequency;
+	int seed = m_seed;
+	const ModuleVariant* pVariant = g_pActiveVariant;
+	if (pVariant != NULL) {
+		frequency *= pVariant->frequencyScale;
+		seed += pVariant->seedOffset;
+	}
+
+	x *= frequency;
+	y *= frequency;
 
 	int xInt = (x > 0.0 ? (int)x : (int)x - 1);
 	int yInt = (y > 0.0 ? (int)y : (int)y - 1);
@@ -57,8 +65,8 @@ NOISE_REAL Voronoi::GetValue(NOISE_REAL x, NOISE_REAL y) const
 
 			// Calculate the position and distance to the seed point inside of
 			// this unit cube.
-			NOISE_REAL xPos = xCur + ValueNoise2D(xCur, yCur, m_seed);
-			NOISE_REAL yPos = yCur + ValueNoise2D(xCur, yCur, m_seed + 1);
+			NOISE_REAL xPos = xCur + ValueNoise2D(xCur, yCur, seed);
+			NOISE_REAL yPos = yCur + ValueNoise2D(xCur, yCur, seed + 1);
 			NOISE_REAL xDist = xPos - x;
 			NOISE_REAL yDist = yPos - y;
 			NOISE_REAL dist = xDist * xDist + yDist * yDist;
@@ -91,3 +99,65 @@ NOISE_REAL Voronoi::GetValue(NOISE_REAL x, NOISE_REAL y) const
 		(int)(floor(xCandidate)),
 		(int)(floor(yCandidate))));
 }
+
+void Voronoi::GetVariantValues(NOISE_REAL x, NOISE_REAL y,
+	const ModuleVariant* pVariant, int variantCount, NOISE_REAL* out) const
+{
+	NOISE_REAL minDist[MODULE_MAX_VARIANT_COUNT];
+	NOISE_REAL xCandidate[MODULE_MAX_VARIANT_COUNT];
+	NOISE_REAL yCandidate[MODULE_MAX_VARIANT_COUNT];
+
+	// The variants of a group share the same neighbourhood of unit cubes;
+	// walk it once, testing the seed point of every lane in each cube.
+	for (int first = 0; first < variantCount; ) {
+		int laneCount = GetVariantGroupSize(pVariant + first,
+			variantCount - first);
+		const ModuleVariant* pLane = pVariant + first;
+		NOISE_REAL frequency = m_frequency * pLane[0].frequencyScale;
+		NOISE_REAL xScaled = x * frequency;
+		NOISE_REAL yScaled = y * frequency;
+
+		int xInt = (xScaled > 0.0 ? (int)xScaled : (int)xScaled - 1);
+		int yInt = (yScaled > 0.0 ? (int)yScaled : (int)yScaled - 1);
+
+		for (int i = 0; i < laneCount; i++) {
+			minDist[i] = 2147483647.0f;
+			xCandidate[i] = 0;
+			yCandidate[i] = 0;
+		}
+		for (int yCur = yInt - 2; yCur <= yInt + 2; yCur++) {
+			for (int xCur = xInt - 2; xCur <= xInt + 2; xCur++) {
+				for (int i = 0; i < laneCount; i++) {
+					int seed = m_seed + pLane[i].seedOffset;
+					NOISE_REAL xPos = xCur + ValueNoise2D(xCur, yCur, seed);
+					NOISE_REAL yPos = yCur + ValueNoise2D(xCur, yCur, seed + 1);
+					NOISE_REAL xDist = xPos - xScaled;
+					NOISE_REAL yDist = yPos - yScaled;
+					NOISE_REAL dist = xDist * xDist + yDist * yDist;
+					if (dist < minDist[i]) {
+						minDist[i] = dist;
+						xCandidate[i] = xPos;
+						yCandidate[i] = yPos;
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < laneCount; i++) {
+			NOISE_REAL value;
+			if (m_enableDistance) {
+				NOISE_REAL xDist = xCandidate[i] - xScaled;
+				NOISE_REAL yDist = yCandidate[i] - yScaled;
+				value = (sqrt(xDist * xDist + yDist * yDist)
+					) * SQRT_3 - 1.0f;
+			}
+			else {
+				value = 0.0;
+			}
+			out[first + i] = value + (m_displacement * (NOISE_REAL)ValueNoise2D(
+				(int)(floor(xCandidate[i])),
+				(int)(floor(yCandidate[i]))));
+		}
+		first += laneCount;
+	}
+}
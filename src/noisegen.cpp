@@ -55,6 +55,21 @@ const int SEED_NOISE_GEN = 1013;
 const int SHIFT_NOISE_GEN = 8;
 #endif
 
+namespace
+{
+
+	// Returns the normalized gradient vector selected by a lattice hash, as
+	// GradientNoise2D() does.
+	inline const NOISE_REAL* GetRandomVector(int hash)
+	{
+		int vectorIndex = hash & 0xffffffff;
+		vectorIndex ^= (vectorIndex >> SHIFT_NOISE_GEN);
+		vectorIndex &= 0xff;
+		return &g_randomVectors[vectorIndex << 1];
+	}
+
+}
+
 NOISE_REAL noise::GradientCoherentNoise2D(NOISE_REAL x, NOISE_REAL z, int seed,
 	NoiseQuality noiseQuality)
 {
@@ -122,6 +137,64 @@ NOISE_REAL noise::GradientCoherentNoise2D(NOISE_REAL x, NOISE_REAL z, int seed,
 	return LinearInterp(ix0, ix1, zs);
 }
 
+void noise::GradientCoherentNoise2DMultiSeed(NOISE_REAL x, NOISE_REAL z,
+	const int* pSeed, int seedCount, NOISE_REAL* pValue,
+	NoiseQuality noiseQuality)
+{
+	// Same lattice cell and S-curve as GradientCoherentNoise2D().
+	int x0 = (x > 0.0 ? (int)x : (int)x - 1);
+	int x1 = x0 + 1;
+	int z0 = (z > 0.0 ? (int)z : (int)z - 1);
+	int z1 = z0 + 1;
+
+	NOISE_REAL xs = 0, zs = 0;
+	switch (noiseQuality) {
+	case QUALITY_FAST:
+		xs = (x - (NOISE_REAL)x0);
+		zs = (z - (NOISE_REAL)z0);
+		break;
+	case QUALITY_STD:
+		xs = SCurve3(x - (NOISE_REAL)x0);
+		zs = SCurve3(z - (NOISE_REAL)z0);
+		break;
+	case QUALITY_BEST:
+		xs = SCurve5(x - (NOISE_REAL)x0);
+		zs = SCurve5(z - (NOISE_REAL)z0);
+		break;
+	}
+
+	// The distance vectors to the four corners, and the part of the gradient
+	// hash that does not depend on the seed, are shared by every seed.
+	NOISE_REAL xv0 = (x - (NOISE_REAL)x0);
+	NOISE_REAL xv1 = (x - (NOISE_REAL)x1);
+	NOISE_REAL zv0 = (z - (NOISE_REAL)z0);
+	NOISE_REAL zv1 = (z - (NOISE_REAL)z1);
+	int h00 = X_NOISE_GEN * x0 + Z_NOISE_GEN * z0;
+	int h10 = X_NOISE_GEN * x1 + Z_NOISE_GEN * z0;
+	int h01 = X_NOISE_GEN * x0 + Z_NOISE_GEN * z1;
+	int h11 = X_NOISE_GEN * x1 + Z_NOISE_GEN * z1;
+
+	for (int i = 0; i < seedCount; i++) {
+		int seedHash = SEED_NOISE_GEN * pSeed[i];
+		const NOISE_REAL* pGradient;
+		NOISE_REAL n0, n1, ix0, ix1;
+
+		pGradient = GetRandomVector(h00 + seedHash);
+		n0 = ((pGradient[0] * xv0) + (pGradient[1] * zv0)) * 2.12f;
+		pGradient = GetRandomVector(h10 + seedHash);
+		n1 = ((pGradient[0] * xv1) + (pGradient[1] * zv0)) * 2.12f;
+		ix0 = LinearInterp(n0, n1, xs);
+
+		pGradient = GetRandomVector(h01 + seedHash);
+		n0 = ((pGradient[0] * xv0) + (pGradient[1] * zv1)) * 2.12f;
+		pGradient = GetRandomVector(h11 + seedHash);
+		n1 = ((pGradient[0] * xv1) + (pGradient[1] * zv1)) * 2.12f;
+		ix1 = LinearInterp(n0, n1, xs);
+
+		pValue[i] = LinearInterp(ix0, ix1, zs);
+	}
+}
+
 inline NOISE_REAL noise::GradientNoise2D(NOISE_REAL fx, NOISE_REAL fz, int ix, int iz, int seed)
 {
 	// Randomly generate a gradient vector given the integer coordinates of the
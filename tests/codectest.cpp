@@ -0,0 +1,212 @@
+// codectest.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Checks the error bound of noise::utils::HeightMapEncoder: every decoded
+// value is within the maximum error of the original value, with every way
+// of decoding, including on tiles holding infinities, NaNs and huge values,
+// and on edge tiles narrower and shorter than the tile size.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <noise.h>
+
+#include "LibnoiseCodec.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+namespace
+{
+
+    // Returns true if a decoded value is within the maximum error of the
+    // original value.  Values that are not finite must be decoded exactly.
+    bool IsWithinError(float original, float decoded, double maxError)
+    {
+        if (std::isnan(original))
+        {
+            return std::isnan(decoded);
+        }
+        if (std::isinf(original))
+        {
+            return decoded == original;
+        }
+        return fabs((double)decoded - (double)original) <= maxError;
+    }
+
+    // Counts the points of a decoded height map outside the error bound.
+    int CountErrors(const NoiseMap& original, const NoiseMap& decoded,
+        double maxError, const char* pName)
+    {
+        if (decoded.GetWidth() != original.GetWidth()
+            || decoded.GetHeight() != original.GetHeight())
+        {
+            printf("%s: the decoded height map is %dx%d instead of %dx%d\n",
+                pName, decoded.GetWidth(), decoded.GetHeight(),
+                original.GetWidth(), original.GetHeight());
+            return 1;
+        }
+        int errorCount = 0;
+        for (int z = 0; z < original.GetHeight(); z++)
+        {
+            for (int x = 0; x < original.GetWidth(); x++)
+            {
+                float value = original.GetValue(x, z);
+                float decodedValue = decoded.GetValue(x, z);
+                if (!IsWithinError(value, decodedValue, maxError))
+                {
+                    if (errorCount < 5)
+                    {
+                        printf("%s: (%d, %d): %.9g decoded as %.9g, maximum "
+                            "error %g\n", pName, x, z, value, decodedValue,
+                            maxError);
+                    }
+                    errorCount++;
+                }
+            }
+        }
+        return errorCount;
+    }
+
+    // Encodes a height map and checks every way of decoding it.
+    int CheckRoundTrip(const NoiseMap& heightMap, int tileSize,
+        double maxError)
+    {
+        HeightMapEncoder encoder;
+        encoder.SetTileSize(tileSize);
+        encoder.SetMaxError(maxError);
+        std::vector<uint8> stream;
+        encoder.Encode(heightMap, stream);
+
+        int errorCount = 0;
+        HeightMapDecoder decoder(&stream[0], stream.size());
+        for (int threadCount = 1; threadCount <= 4; threadCount += 3)
+        {
+            decoder.SetThreadCount(threadCount);
+            NoiseMap decoded;
+            decoder.Decode(decoded);
+            errorCount += CountErrors(heightMap, decoded, maxError,
+                "Decode()");
+        }
+
+        // Decode every tile from the stream, then from copies of its bytes
+        // with a decoder that only has the index.
+        NoiseMap streamTiles(heightMap.GetWidth(), heightMap.GetHeight());
+        NoiseMap copiedTiles(heightMap.GetWidth(), heightMap.GetHeight());
+        size_t indexSize = HeightMapDecoder::GetIndexSize(&stream[0],
+            stream.size());
+        HeightMapDecoder indexDecoder(&stream[0], indexSize, stream.size());
+        for (int tileZ = 0; tileZ < decoder.GetTileCountZ(); tileZ++)
+        {
+            for (int tileX = 0; tileX < decoder.GetTileCountX(); tileX++)
+            {
+                int x0 = tileX * tileSize;
+                int z0 = tileZ * tileSize;
+                decoder.DecodeTile(tileX, tileZ,
+                    streamTiles.GetSlabPtr(x0, z0), streamTiles.GetStride());
+
+                uint64 offset;
+                uint64 size;
+                indexDecoder.GetTileRange(tileX, tileZ, offset, size);
+                std::vector<uint8> tileData(stream.begin() + (size_t)offset,
+                    stream.begin() + (size_t)(offset + size));
+                tileData.resize(tileData.size() + 8, 0xcd);
+                indexDecoder.DecodeTile(tileX, tileZ, &tileData[0],
+                    copiedTiles.GetSlabPtr(x0, z0), copiedTiles.GetStride());
+            }
+        }
+        errorCount += CountErrors(heightMap, streamTiles, maxError,
+            "DecodeTile()");
+        errorCount += CountErrors(heightMap, copiedTiles, maxError,
+            "DecodeTile() with an index-only decoder");
+        return errorCount;
+    }
+
+}
+
+int main()
+{
+    // Smooth terrain, with edge tiles narrower and shorter than the tiles.
+    module::Perlin perlin;
+    perlin.SetOctaveCount(6);
+    NoiseMap terrain(301, 170);
+    for (int z = 0; z < terrain.GetHeight(); z++)
+    {
+        for (int x = 0; x < terrain.GetWidth(); x++)
+        {
+            terrain.SetValue(x, z, (float)perlin.GetValue(x * 0.013,
+                z * 0.013));
+        }
+    }
+
+    // The same terrain with tiles holding values that cannot be quantized.
+    NoiseMap special(terrain);
+    const float INF = std::numeric_limits<float>::infinity();
+    const float NAN_VALUE = std::numeric_limits<float>::quiet_NaN();
+    special.SetValue(3, 5, NAN_VALUE);
+    special.SetValue(70, 2, INF);
+    special.SetValue(71, 2, -INF);
+    special.SetValue(140, 40, 1.0e30f);
+    special.SetValue(141, 41, -3.0e38f);
+    special.SetValue(300, 169, std::numeric_limits<float>::max());
+    special.SetValue(200, 100, 1.0e7f);
+    special.SetValue(10, 160, std::numeric_limits<float>::denorm_min());
+
+    // A tile of huge values only.
+    NoiseMap huge(terrain);
+    for (int z = 64; z < 128; z++)
+    {
+        for (int x = 64; x < 128; x++)
+        {
+            huge.SetValue(x, z, terrain.GetValue(x, z) * 1.0e12f);
+        }
+    }
+
+    const NoiseMap* const HEIGHT_MAPS[] = {&terrain, &special, &huge};
+    const char* const HEIGHT_MAP_NAMES[] = {"terrain", "special values",
+        "huge values"};
+    const int TILE_SIZES[] = {8, 37, 64};
+    const double MAX_ERRORS[] = {1.0e-6, 0.001, 0.01, 0.25, 4.0};
+    int failureCount = 0;
+    for (int map = 0; map < 3; map++)
+    {
+        for (int tile = 0; tile < 3; tile++)
+        {
+            for (int error = 0; error < 5; error++)
+            {
+                int errorCount = CheckRoundTrip(*HEIGHT_MAPS[map],
+                    TILE_SIZES[tile], MAX_ERRORS[error]);
+                if (errorCount != 0)
+                {
+                    printf("%s, tile size %d, maximum error %g: %d errors\n",
+                        HEIGHT_MAP_NAMES[map], TILE_SIZES[tile],
+                        MAX_ERRORS[error], errorCount);
+                    failureCount++;
+                }
+            }
+        }
+    }
+
+    if (failureCount != 0)
+    {
+        printf("%d failures\n", failureCount);
+        return 1;
+    }
+    return 0;
+}
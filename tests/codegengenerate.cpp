@@ -0,0 +1,86 @@
+// codegengenerate.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Writes the source code generated for the test graph of codegengraph.h,
+// which the codegen test compiles.  The source code is generated under a
+// locale with a decimal comma, which must not leak into the literals.
+
+#include <clocale>
+#include <cstdio>
+#include <locale>
+#include <string>
+
+#include "LibnoiseCodegen.h"
+#include "codegengraph.h"
+
+using namespace noise::utils;
+
+namespace
+{
+
+    // Numbers with a decimal comma.
+    class CommaNumpunct: public std::numpunct<char>
+    {
+
+        protected:
+
+            char do_decimal_point() const
+            {
+                return ',';
+            }
+
+    };
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: codegengenerate <output file>\n");
+        return 1;
+    }
+
+    const char* const COMMA_LOCALES[] = {"de_DE.UTF-8", "fr_FR.UTF-8",
+        "de_DE", "fr_FR"};
+    for (size_t i = 0; i < sizeof(COMMA_LOCALES) / sizeof(COMMA_LOCALES[0]);
+        i++)
+    {
+        if (setlocale(LC_NUMERIC, COMMA_LOCALES[i]) != NULL)
+        {
+            break;
+        }
+    }
+    std::locale::global(std::locale(std::locale::classic(),
+        new CommaNumpunct));
+
+    std::string text;
+    SaveModuleGraph(GetCodegenTestGraph(), text);
+    GraphCodeGenerator generator;
+    generator.SetFunctionName(CODEGEN_TEST_FUNCTION_NAME);
+    std::string source;
+    generator.Generate(text, source);
+
+    FILE* pFile = fopen(argv[1], "w");
+    if (pFile == NULL
+        || fwrite(source.data(), 1, source.size(), pFile) != source.size()
+        || fclose(pFile) != 0)
+    {
+        fprintf(stderr, "cannot write %s\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}
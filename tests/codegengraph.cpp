@@ -0,0 +1,160 @@
+// codegengraph.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+
+#include "codegengraph.h"
+
+using namespace noise;
+using namespace noise::module;
+
+namespace
+{
+
+    // The noise modules of the test graph.
+    struct CodegenTestGraph
+    {
+        Perlin perlin;
+        Billow billow;
+        RidgedMulti ridgedMulti;
+        Voronoi voronoi;
+        Checkerboard checkerboard;
+        Const constant;
+        Add add;
+        Multiply multiply;
+        Select select;
+        Select constSelect;
+        Blend blend;
+        Curve curve;
+        Terrace terrace;
+        Turbulence turbulence;
+        Turbulence jointTurbulence;
+        PerlinVector perlinVector;
+        Displace displace;
+        RotatePoint rotatePoint;
+        ScalePoint scalePoint;
+        TranslatePoint translatePoint;
+        Instrument instrument;
+        Cache cache;
+        Exponent exponent;
+        Clamp clamp;
+        ScaleBias scaleBias;
+        Abs abs;
+        Invert invert;
+        Max max;
+        Min min;
+        Const two;
+        Power power;
+
+        CodegenTestGraph():
+            instrument("codegen")
+        {
+            perlin.SetSeed(7);
+            perlin.SetOctaveCount(8);
+            perlin.SetFrequency(1.3);
+            perlin.SetPersistence(0.47);
+            perlin.SetNoiseQuality(QUALITY_BEST);
+            billow.SetSeed(-3);
+            billow.SetOctaveCount(5);
+            ridgedMulti.SetSeed(2147483647);
+            ridgedMulti.SetLacunarity(2.1);
+            ridgedMulti.SetOctaveCount(9);
+            voronoi.SetFrequency(2.5);
+            voronoi.EnableDistance(true);
+            voronoi.SetSeed(11);
+            voronoi.SetDisplacement(0.3);
+            constant.SetConstValue(-0.25);
+
+            add.SetSourceModule(0, perlin);
+            add.SetSourceModule(1, billow);
+            multiply.SetSourceModule(0, add);
+            multiply.SetSourceModule(1, ridgedMulti);
+            select.SetSourceModule(0, multiply);
+            select.SetSourceModule(1, voronoi);
+            select.SetControlModule(perlin);
+            select.SetBounds(-0.2, 0.4);
+            select.SetEdgeFalloff(0.1);
+            constSelect.SetSourceModule(0, checkerboard);
+            constSelect.SetSourceModule(1, constant);
+            constSelect.SetControlModule(billow);
+            constSelect.SetBounds(0.0, 1.0);
+            blend.SetSourceModule(0, select);
+            blend.SetSourceModule(1, constSelect);
+            blend.SetSourceModule(2, ridgedMulti);
+
+            curve.SetSourceModule(0, blend);
+            curve.AddControlPoint(-2.0, -1.5);
+            curve.AddControlPoint(-0.5, 0.2);
+            curve.AddControlPoint(0.3, 0.1);
+            curve.AddControlPoint(0.9, 1.1);
+            curve.AddControlPoint(2.0, 2.0);
+            terrace.SetSourceModule(0, curve);
+            terrace.AddControlPoint(-1.0);
+            terrace.AddControlPoint(0.0);
+            terrace.AddControlPoint(0.5);
+            terrace.AddControlPoint(1.0);
+            terrace.InvertTerraces(true);
+            turbulence.SetSourceModule(0, terrace);
+            turbulence.SetPower(0.2);
+            turbulence.SetRoughness(3);
+            turbulence.SetSeed(5);
+            jointTurbulence.SetSourceModule(0, turbulence);
+            jointTurbulence.SetJointDistortion(true);
+            jointTurbulence.SetPower(0.1);
+            jointTurbulence.SetFrequency(0.7);
+
+            perlinVector.SetChannelCount(2);
+            perlinVector.SetSeed(99);
+            perlinVector.SetOctaveCount(3);
+            displace.SetSourceModule(0, jointTurbulence);
+            displace.SetSourceModule(1, perlinVector);
+            displace.SetSourceModule(2, perlinVector);
+            rotatePoint.SetSourceModule(0, displace);
+            rotatePoint.SetAngles(10.0, 20.0, 33.0);
+            scalePoint.SetSourceModule(0, rotatePoint);
+            scalePoint.SetXScale(1.5);
+            scalePoint.SetYScale(0.75);
+            translatePoint.SetSourceModule(0, scalePoint);
+            translatePoint.SetXTranslation(3.25);
+            translatePoint.SetYTranslation(-1.1);
+            instrument.SetSourceModule(0, translatePoint);
+            cache.SetSourceModule(0, instrument);
+
+            exponent.SetSourceModule(0, cache);
+            exponent.SetExponent(1.7);
+            clamp.SetSourceModule(0, exponent);
+            clamp.SetBounds(-0.8, 0.9);
+            scaleBias.SetSourceModule(0, clamp);
+            scaleBias.SetScale(0.9);
+            scaleBias.SetBias(0.05);
+            abs.SetSourceModule(0, scaleBias);
+            invert.SetSourceModule(0, abs);
+            max.SetSourceModule(0, invert);
+            max.SetSourceModule(1, constant);
+            min.SetSourceModule(0, max);
+            min.SetSourceModule(1, curve);
+            two.SetConstValue(2.0);
+            power.SetSourceModule(0, two);
+            power.SetSourceModule(1, min);
+        }
+    };
+
+}
+
+const Module& GetCodegenTestGraph()
+{
+    static CodegenTestGraph graph;
+    return graph.power;
+}
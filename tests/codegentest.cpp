@@ -0,0 +1,138 @@
+// codegentest.cpp
+//
+// This library is free software; you can redistribute it and/or modify it
+// under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation; either version 2.1 of the License, or (at
+// your option) any later version.
+//
+// This library is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+// License (COPYING.txt) for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with this library; if not, write to the Free Software Foundation,
+// Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//
+// Checks that the source code generated for the test graph of
+// codegengraph.h, compiled into this program, returns the values of
+// noise::module::Module::GetValue(), bit for bit, and that the graph reads
+// back from its text format unchanged.
+
+#include <cstdio>
+#include <cstring>
+#include <locale>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "LibnoiseCodegen.h"
+#include "LibnoiseGraph.h"
+#include "codegengraph.h"
+
+using namespace noise;
+using namespace noise::utils;
+
+// The functions of the generated source code.
+NOISE_REAL GetTestGraphValue(NOISE_REAL x, NOISE_REAL y);
+void GetTestGraphValueBatch(const NOISE_REAL* pX, const NOISE_REAL* pY,
+    int count, NOISE_REAL* pOut);
+
+namespace
+{
+
+    // Numbers with a decimal comma.
+    class CommaNumpunct: public std::numpunct<char>
+    {
+
+        protected:
+
+            char do_decimal_point() const
+            {
+                return ',';
+            }
+
+    };
+
+    // Returns true if two values have the same bits.
+    bool IsSameValue(NOISE_REAL a, NOISE_REAL b)
+    {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    // Counts the points where a noise module and the generated functions
+    // differ.
+    int CountMismatches(const module::Module& sourceModule, const char* pName)
+    {
+        // A grid around the origin, then points far from it.
+        std::vector<NOISE_REAL> xs;
+        std::vector<NOISE_REAL> ys;
+        for (int i = 0; i < 20000; i++)
+        {
+            xs.push_back((i % 200) * 0.037 - 3.1);
+            ys.push_back((i / 200) * 0.051 - 2.3);
+        }
+        const NOISE_REAL FAR_POINTS[][2] = {{0.0, 0.0}, {-0.0, 1.0},
+            {1.0e6, -2.5e6}, {-3.0e7, 4.0e7}, {123456.789, -0.001}};
+        for (size_t i = 0; i < sizeof(FAR_POINTS) / sizeof(FAR_POINTS[0]); i++)
+        {
+            xs.push_back(FAR_POINTS[i][0]);
+            ys.push_back(FAR_POINTS[i][1]);
+        }
+
+        int count = (int)xs.size();
+        std::vector<NOISE_REAL> batch((size_t)count);
+        GetTestGraphValueBatch(&xs[0], &ys[0], count, &batch[0]);
+        int mismatchCount = 0;
+        for (int i = 0; i < count; i++)
+        {
+            NOISE_REAL expected = sourceModule.GetValue(xs[i], ys[i]);
+            NOISE_REAL scalar = GetTestGraphValue(xs[i], ys[i]);
+            if (!IsSameValue(expected, scalar)
+                || !IsSameValue(expected, batch[i]))
+            {
+                if (mismatchCount < 5)
+                {
+                    printf("%s: (%.17g, %.17g): GetValue %.17g, generated "
+                        "%.17g, batch %.17g\n", pName, xs[i], ys[i], expected,
+                        scalar, batch[i]);
+                }
+                mismatchCount++;
+            }
+        }
+        return mismatchCount;
+    }
+
+}
+
+int main()
+{
+    int failureCount = 0;
+    const module::Module& graph = GetCodegenTestGraph();
+    failureCount += CountMismatches(graph, "graph");
+
+    // Read the graph back under a locale with a decimal comma.
+    std::string text;
+    SaveModuleGraph(graph, text);
+    std::locale::global(std::locale(std::locale::classic(),
+        new CommaNumpunct));
+    VersionedGraph loadedGraph;
+    int rootId = LoadModuleGraph(text, loadedGraph);
+    std::shared_ptr<const GraphSnapshot> pSnapshot = loadedGraph.Commit();
+    const module::Module& loadedRoot = pSnapshot->GetModule(rootId);
+    std::string loadedText;
+    SaveModuleGraph(loadedRoot, loadedText);
+    if (loadedText != text)
+    {
+        printf("the loaded graph is written differently\n");
+        failureCount++;
+    }
+    failureCount += CountMismatches(loadedRoot, "loaded graph");
+
+    if (failureCount != 0)
+    {
+        printf("%d failures\n", failureCount);
+        return 1;
+    }
+    return 0;
+}